@@ -0,0 +1,87 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_METRICS_HISTOGRAM_HPP__
+#define __PROCESS_METRICS_HISTOGRAM_HPP__
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include <process/future.hpp>
+
+#include <process/metrics/metric.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/none.hpp>
+#include <stout/option.hpp>
+
+namespace process {
+namespace metrics {
+
+// A Metric that represents the distribution of recorded values (e.g.,
+// sizes or latencies). Its value is the most recently recorded value,
+// and snapshots include the count, minimum, maximum and percentiles of
+// the values within the window (or of all values without a window).
+//
+// The percentiles are estimated from a `QuantileSketch`, so recording
+// a value takes constant time and the memory does not depend on the
+// number of values (see `Percentiles::ESTIMATED`). Without a window,
+// recording a value does not lock; with a window, it reads the clock,
+// which takes the lock of the libprocess clock (see
+// `SlidingQuantileSketch`).
+class Histogram : public Metric
+{
+public:
+  explicit Histogram(
+      const std::string& name,
+      const Option<Duration>& window = None())
+    : Metric(name, window, Percentiles::ESTIMATED),
+      data(new Data()) {}
+
+  virtual ~Histogram() {}
+
+  virtual Future<double> value() const
+  {
+    const double value = data->last.load(std::memory_order_relaxed);
+
+    if (std::isnan(value)) {
+      return Failure("No value");
+    }
+
+    return value;
+  }
+
+  void record(double value)
+  {
+    data->last.store(value, std::memory_order_relaxed);
+    push(value);
+  }
+
+private:
+  struct Data
+  {
+    Data() : last(std::numeric_limits<double>::quiet_NaN()) {}
+
+    // The most recently recorded value, NaN until a value is recorded.
+    std::atomic<double> last;
+  };
+
+  std::shared_ptr<Data> data;
+};
+
+} // namespace metrics {
+} // namespace process {
+
+#endif // __PROCESS_METRICS_HISTOGRAM_HPP__
@@ -14,11 +14,13 @@
 #define __PROCESS_METRICS_METRIC_HPP__
 
 #include <atomic>
+#include <map>
 #include <memory>
 #include <string>
 
 #include <process/future.hpp>
 #include <process/owned.hpp>
+#include <process/quantile_sketch.hpp>
 #include <process/statistics.hpp>
 #include <process/timeseries.hpp>
 
@@ -29,6 +31,22 @@
 namespace process {
 namespace metrics {
 
+// How the percentiles (and the other statistics) of the values of a
+// metric get computed for snapshots.
+enum class Percentiles
+{
+  // From the values within the window, which get kept in a
+  // `TimeSeries`. This requires a window and sorting the values for
+  // each snapshot.
+  EXACT,
+
+  // Estimated (within 1%) from the values within the window (or all
+  // values without a window), which get recorded in a fixed-size
+  // `QuantileSketch` without locking. See `SlidingQuantileSketch`.
+  ESTIMATED
+};
+
+
 // The base class for Metrics.
 class Metric {
 public:
@@ -41,11 +59,40 @@ public:
     return data->name;
   }
 
+  // The name of the metric family and the labels under which this
+  // metric gets exposed in the OpenMetrics format (see the
+  // `/metrics/openmetrics` endpoint). By default, every metric is a
+  // family of its own without labels. Metrics with key-encoded names,
+  // e.g., "allocator/mesos/offer_filters/roles/<role>/active", can be
+  // exposed as a single family with a label instead, so that they can
+  // be aggregated by the monitoring system.
+  //
+  // NOTE: The labels must be set before the metric gets added.
+  void setLabels(
+      const std::string& family,
+      const std::map<std::string, std::string>& labels)
+  {
+    data->family = family;
+    data->labels = labels;
+  }
+
+  const std::string& family() const
+  {
+    return data->family.isSome() ? data->family.get() : data->name;
+  }
+
+  const std::map<std::string, std::string>& labels() const
+  {
+    return data->labels;
+  }
+
   Option<Statistics<double>> statistics() const
   {
     Option<Statistics<double>> statistics = None();
 
-    if (data->history.isSome()) {
+    if (data->sketch.isSome()) {
+      statistics = data->sketch.get()->statistics();
+    } else if (data->history.isSome()) {
       synchronized (data->lock) {
         statistics = Statistics<double>::from(*data->history.get());
       }
@@ -54,14 +101,32 @@ public:
     return statistics;
   }
 
+  // Returns the sketch of all values recorded so far, if the
+  // percentiles are estimated without a window. Unlike the statistics
+  // within a window, the counts of such a sketch never decrease, so
+  // that it can be exposed as a histogram.
+  Option<const QuantileSketch*> sketch() const
+  {
+    if (data->sketch.isSome()) {
+      return data->sketch.get()->total();
+    }
+
+    return None();
+  }
+
 protected:
   // Only derived classes can construct.
-  Metric(const std::string& name, const Option<Duration>& window)
-    : data(new Data(name, window)) {}
+  Metric(
+      const std::string& name,
+      const Option<Duration>& window,
+      Percentiles percentiles = Percentiles::EXACT)
+    : data(new Data(name, window, percentiles)) {}
 
   // Inserts 'value' into the history for this metric.
   void push(double value) {
-    if (data->history.isSome()) {
+    if (data->sketch.isSome()) {
+      data->sketch.get()->record(value);
+    } else if (data->history.isSome()) {
       Time now = Clock::now();
 
       synchronized (data->lock) {
@@ -72,11 +137,18 @@ protected:
 
 private:
   struct Data {
-    Data(const std::string& _name, const Option<Duration>& window)
+    Data(
+        const std::string& _name,
+        const Option<Duration>& window,
+        Percentiles percentiles)
       : name(_name),
-        history(None())
+        history(None()),
+        sketch(None())
     {
-      if (window.isSome()) {
+      if (percentiles == Percentiles::ESTIMATED) {
+        sketch = Owned<SlidingQuantileSketch>(
+            new SlidingQuantileSketch(window));
+      } else if (window.isSome()) {
         history =
           Owned<TimeSeries<double>>(new TimeSeries<double>(window.get()));
       }
@@ -84,9 +156,16 @@ private:
 
     const std::string name;
 
+    Option<std::string> family;
+
+    std::map<std::string, std::string> labels;
+
     std::atomic_flag lock = ATOMIC_FLAG_INIT;
 
     Option<Owned<TimeSeries<double>>> history;
+
+    // Used instead of `history` for `Percentiles::ESTIMATED`.
+    Option<Owned<SlidingQuantileSketch>> sketch;
   };
 
   std::shared_ptr<Data> data;
@@ -15,17 +15,21 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <process/dispatch.hpp>
 #include <process/future.hpp>
+#include <process/http.hpp>
 #include <process/limiter.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
+#include <process/time.hpp>
 
 #include <process/metrics/metric.hpp>
 
 #include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
 #include <stout/nothing.hpp>
 #include <stout/option.hpp>
 
@@ -49,8 +53,14 @@ protected:
   virtual void initialize();
 
 private:
+  // The state of a response of the `/openmetrics` endpoint which is
+  // being encoded. Defined in metrics.cpp.
+  struct Exposition;
+
   static std::string help();
 
+  static std::string openmetricsHelp();
+
   MetricsProcess(
       const Option<Owned<RateLimiter>>& _limiter,
       const Option<std::string>& _authenticationRealm)
@@ -74,9 +84,55 @@ private:
       hashmap<std::string, Future<double>>&& metrics,
       hashmap<std::string, Option<Statistics<double>>>&& statistics);
 
+  Future<http::Response> openmetrics(
+      const http::Request& request,
+      const Option<http::authentication::Principal>&);
+
+  Future<http::Response> exposition(const Option<Duration>& timeout);
+
+  // Leaves out the (sorted) entries whose samples collide with those
+  // of preceding entries, e.g., of metrics whose names only differ in
+  // characters which get replaced when sanitized.
+  void deduplicate(const Owned<Exposition>& exposition);
+
+  http::Response _exposition(const Owned<Exposition>& exposition);
+
+  // Encodes the next chunk of the response into the pipe, and then
+  // dispatches to itself for the following chunk (if any), so that
+  // large responses neither get buffered as a whole nor block the
+  // metrics process for long.
+  void encode(const Owned<Exposition>& exposition, http::Pipe::Writer writer);
+
+  // The value of a metric for a snapshot.
+  struct Sample
+  {
+    double value;
+
+    // When the value was taken, if it is from a previous snapshot.
+    Option<Time> stale;
+  };
+
+  // Returns the value of the metric for a snapshot, if any. If the
+  // value is not ready before the snapshot timed out, this is the
+  // value from a previous snapshot.
+  Option<Sample> value(
+      const std::string& name,
+      const Future<double>& value,
+      const Option<Duration>& timeout);
+
   // The Owned<Metric> is an explicit copy of the Metric passed to 'add'.
   hashmap<std::string, Owned<Metric>> metrics;
 
+  // The metrics which were left out of the OpenMetrics format as their
+  // samples collide with those of other metrics, so that each of them
+  // only gets logged once.
+  hashset<std::string> colliding;
+
+  // The most recent value of each metric and when it was taken, which
+  // gets used in place of a value that is not ready before a snapshot
+  // times out (e.g., of a `PullGauge` of a busy `Process`).
+  hashmap<std::string, std::pair<double, Time>> cache;
+
   // Used to rate limit the snapshot endpoint.
   Option<Owned<RateLimiter>> limiter;
 
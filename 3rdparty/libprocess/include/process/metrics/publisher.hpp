@@ -0,0 +1,217 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_METRICS_PUBLISHER_HPP__
+#define __PROCESS_METRICS_PUBLISHER_HPP__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <process/clock.hpp>
+#include <process/dispatch.hpp>
+#include <process/event.hpp>
+#include <process/pid.hpp>
+#include <process/process.hpp>
+#include <process/time.hpp>
+
+#include <process/metrics/pull_gauge.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/option.hpp>
+#include <stout/stopwatch.hpp>
+
+namespace process {
+namespace metrics {
+
+// Publishes the values of gauges which are computed from the state of
+// a `Process`, so that the gauges can be sampled by metrics snapshots
+// without dispatching to (and waiting behind the events of) the
+// `Process` (see `PullGauge::sampled`).
+//
+// The `Process` must invoke `served()` after serving each event (see
+// `ProcessBase::serve`), which publishes the values once the event
+// queue is empty, i.e., once per burst of events rather than once per
+// event (and at least once per second for a `Process` which is never
+// idle). If publishing gets expensive, the publishes get delayed to
+// spend about 1% of the time on them.
+//
+// NOTE: Except for the sampled gauges, a `Publisher` must only be used
+// from within its `Process`.
+class Publisher
+{
+public:
+  explicit Publisher(const ProcessBase& process)
+    : data(new Data(process.self()))
+  {
+    data->counters = {
+      process.eventCounter<MessageEvent>(),
+      process.eventCounter<DispatchEvent>(),
+      process.eventCounter<HttpEvent>(),
+      process.eventCounter<ExitedEvent>(),
+      process.eventCounter<TerminateEvent>()
+    };
+  }
+
+  // Returns a gauge whose value gets computed by 'f' from within the
+  // `Process` on each publish. The gauge is 0 until the first publish.
+  PullGauge gauge(const std::string& name, const std::function<double()>& f)
+  {
+    return gauge(name, f, [](double value) { return value; });
+  }
+
+  // As above, but the value sampled by the gauge is 'sample' applied
+  // to the published value, e.g., to compute an uptime from the
+  // published start time. Thus 'sample' must be thread-safe.
+  PullGauge gauge(
+      const std::string& name,
+      const std::function<double()>& f,
+      const std::function<double(double)>& sample)
+  {
+    std::shared_ptr<std::atomic<double>> value(new std::atomic<double>(0.0));
+
+    data->gauges.push_back(Gauge{name, f, value});
+
+    return PullGauge::sampled(name, [value, sample]() {
+      return sample(value->load(std::memory_order_relaxed));
+    });
+  }
+
+  // Stops publishing the given gauge, e.g., before removing it.
+  void remove(const PullGauge& gauge)
+  {
+    for (auto it = data->gauges.begin(); it != data->gauges.end(); ++it) {
+      if (it->name == gauge.name()) {
+        data->gauges.erase(it);
+        return;
+      }
+    }
+  }
+
+  // Computes and publishes the values of all gauges now.
+  void publish()
+  {
+    data->publish();
+  }
+
+  // Publishes the values of all gauges if the served event ended a
+  // burst of events, unless a publish is pending or the served event
+  // was the publish itself.
+  void served()
+  {
+    if (data->publishing) {
+      data->publishing = false;
+      return;
+    }
+
+    if (data->scheduled) {
+      return;
+    }
+
+    const Duration elapsed = Clock::now() - data->published;
+
+    if (data->queued() > 0 && elapsed < Seconds(1)) {
+      return;
+    }
+
+    // Delay the publish to spend about 1% of the time publishing. No
+    // delay applies while the clock is paused (i.e., in tests) since
+    // the publish would otherwise wait for the clock to be advanced.
+    const Duration delay = data->cost * 100 - elapsed;
+
+    if (Clock::paused() || delay <= Duration::zero()) {
+      data->publish();
+      return;
+    }
+
+    data->scheduled = true;
+
+    std::weak_ptr<Data> weak = data;
+
+    const UPID pid = data->pid;
+
+    Clock::timer(delay, [pid, weak]() {
+      dispatch(pid, [weak]() {
+        std::shared_ptr<Data> data = weak.lock();
+        if (data) {
+          data->publishing = true;
+          data->scheduled = false;
+          data->publish();
+        }
+      });
+    });
+  }
+
+private:
+  struct Gauge
+  {
+    std::string name;
+    std::function<double()> f;
+    std::shared_ptr<std::atomic<double>> value;
+  };
+
+  // The state is shared with the pending publishes, which must not
+  // publish once the `Publisher` has been destroyed.
+  struct Data
+  {
+    explicit Data(const UPID& _pid)
+      : pid(_pid), publishing(false), scheduled(false) {}
+
+    void publish()
+    {
+      Stopwatch stopwatch;
+      stopwatch.start();
+
+      for (const Gauge& gauge : gauges) {
+        gauge.value->store(gauge.f(), std::memory_order_relaxed);
+      }
+
+      cost = stopwatch.elapsed();
+      published = Clock::now();
+    }
+
+    // Returns the number of events queued for the `Process`.
+    size_t queued() const
+    {
+      size_t count = 0;
+      for (const std::function<size_t()>& counter : counters) {
+        count += counter();
+      }
+      return count;
+    }
+
+    const UPID pid;
+
+    std::vector<std::function<size_t()>> counters;
+
+    std::vector<Gauge> gauges;
+
+    // Whether the event being served is a delayed publish.
+    bool publishing;
+
+    // Whether a delayed publish is pending.
+    bool scheduled;
+
+    // How long the last publish took, and when it happened.
+    Duration cost;
+    Time published;
+  };
+
+  std::shared_ptr<Data> data;
+};
+
+} // namespace metrics {
+} // namespace process {
+
+#endif // __PROCESS_METRICS_PUBLISHER_HPP__
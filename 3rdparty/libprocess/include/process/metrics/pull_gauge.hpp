@@ -43,6 +43,12 @@ namespace metrics {
 // experience very light load, and (2) use functions that do not
 // perform heavyweight computation to compute the value (e.g. looping
 // over a large collection).
+//
+// Alternatively, a pull-based gauge can be created with a thread-safe
+// function via `PullGauge::sampled`, e.g., a function which reads a
+// value that the `Process` publishes in an atomic. Such gauges get
+// sampled directly by the metrics snapshot rather than by dispatching
+// to the `Process`, so snapshots do not wait for busy `Process`es.
 class PullGauge : public Metric
 {
 public:
@@ -56,18 +62,42 @@ public:
   PullGauge(const std::string& name, const std::function<Future<double>()>& f)
     : Metric(name, None()), data(new Data(f)) {}
 
+  // Returns a gauge whose value is computed by calling 'f' from
+  // whichever thread takes the metrics snapshot. Thus 'f' must be
+  // thread-safe and must not block. The same lifetime requirements
+  // as above apply.
+  static PullGauge sampled(
+      const std::string& name,
+      const std::function<double()>& f)
+  {
+    return PullGauge(name, std::make_shared<Data>(f));
+  }
+
   virtual ~PullGauge() {}
 
-  virtual Future<double> value() const { return data->f(); }
+  virtual Future<double> value() const
+  {
+    if (data->sample) {
+      return data->sample();
+    }
+
+    return data->f();
+  }
 
 private:
   struct Data
   {
     explicit Data(const std::function<Future<double>()>& _f) : f(_f) {}
 
+    explicit Data(const std::function<double()>& _sample) : sample(_sample) {}
+
     const std::function<Future<double>()> f;
+    const std::function<double()> sample;
   };
 
+  PullGauge(const std::string& name, const std::shared_ptr<Data>& _data)
+    : Metric(name, None()), data(_data) {}
+
   std::shared_ptr<Data> data;
 };
 
@@ -38,8 +38,15 @@ class Timer : public Metric
 {
 public:
   // The Timer name will have a unit suffix added automatically.
-  Timer(const std::string& name, const Option<Duration>& window = None())
-    : Metric(name + "_" + T::units(), window),
+  //
+  // With `Percentiles::ESTIMATED`, the statistics of the timings get
+  // estimated from a sketch, which is much cheaper than keeping the
+  // timings within the window for frequent timings and snapshots.
+  Timer(
+      const std::string& name,
+      const Option<Duration>& window = None(),
+      Percentiles percentiles = Percentiles::EXACT)
+    : Metric(name + "_" + T::units(), window, percentiles),
       data(new Data()) {}
 
   Future<double> value() const
@@ -15,6 +15,7 @@
 
 #include <stdint.h>
 
+#include <functional>
 #include <memory>
 #include <map>
 #include <queue>
@@ -45,6 +46,7 @@ class EventQueue;
 class Gate;
 class Logging;
 class Sequence;
+struct ProcessStatistics;
 
 namespace firewall {
 
@@ -78,6 +80,16 @@ public:
 
   const UPID& self() const { return pid; }
 
+  /**
+   * Returns a function which returns the number of events of the given
+   * type currently on the event queue. Unlike `eventCount`, the
+   * function can be invoked from any thread, e.g., to sample a gauge
+   * without dispatching to (and waiting behind the events of) the
+   * process. The count may briefly lag behind the queue.
+   */
+  template <typename T>
+  std::function<size_t()> eventCounter() const;
+
 protected:
   /**
    * Invoked when an event is serviced.
@@ -481,6 +493,12 @@ private:
   // a pointer so we can hide the implementation of `EventQueue`.
   std::unique_ptr<EventQueue> events;
 
+  // Statistics about running this process, see process_statistics.hpp.
+  // Like with `events`, we use a pointer to hide the implementation.
+  // The pointer is shared so that the statistics can be read without
+  // holding on to the process (e.g., by the metrics exposing them).
+  std::shared_ptr<ProcessStatistics> statistics;
+
   // NOTE: this is a shared pointer to a _pointer_, hence this is not
   // responsible for the ProcessBase itself.
   std::shared_ptr<ProcessBase*> reference;
@@ -0,0 +1,441 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_QUANTILE_SKETCH_HPP__
+#define __PROCESS_QUANTILE_SKETCH_HPP__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <process/clock.hpp>
+#include <process/statistics.hpp>
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/none.hpp>
+#include <stout/option.hpp>
+
+namespace process {
+
+// A sketch of a distribution of values from which quantiles can be
+// estimated with a relative error of at most 1%, see "DDSketch: A
+// Fast and Fully-Mergeable Quantile Sketch with Relative-Error
+// Guarantees" by Masson, Rim and Lee.
+//
+// Values get counted in buckets whose bounds grow exponentially, so
+// that the sketch uses a fixed amount of memory (~19KB) regardless of
+// the number of values and estimating a quantile takes constant time.
+// The buckets cover the values from 1e-9 to 1e12; smaller values
+// (including zero and negative values) are estimated as 0 and larger
+// values as 1e12. The minimum and maximum are tracked exactly (as is
+// the sum), and estimates are never outside of them.
+//
+// Values can be recorded concurrently without locking. Since all
+// sketches use the same buckets, they can be merged, e.g., to combine
+// the sketches of several intervals.
+class QuantileSketch
+{
+public:
+  QuantileSketch()
+  {
+    clear();
+  }
+
+  QuantileSketch(const QuantileSketch&) = delete;
+  QuantileSketch& operator=(const QuantileSketch&) = delete;
+
+  void record(double value)
+  {
+    buckets[index(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    add(&sum_, value);
+
+    update(&min_, value, [](double a, double b) { return a < b; });
+    update(&max_, value, [](double a, double b) { return a > b; });
+  }
+
+  // Adds the values of the other sketch to this sketch.
+  void merge(const QuantileSketch& that)
+  {
+    for (size_t i = 0; i < BUCKETS; i++) {
+      const uint64_t count = that.buckets[i].load(std::memory_order_relaxed);
+      if (count > 0) {
+        buckets[i].fetch_add(count, std::memory_order_relaxed);
+      }
+    }
+
+    count_.fetch_add(that.count(), std::memory_order_relaxed);
+    add(&sum_, that.sum());
+
+    update(&min_, that.min(), [](double a, double b) { return a < b; });
+    update(&max_, that.max(), [](double a, double b) { return a > b; });
+  }
+
+  // NOTE: Values which get recorded concurrently might get lost.
+  void clear()
+  {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0.0, std::memory_order_relaxed);
+
+    min_.store(
+        std::numeric_limits<double>::infinity(), std::memory_order_relaxed);
+    max_.store(
+        -std::numeric_limits<double>::infinity(), std::memory_order_relaxed);
+  }
+
+  uint64_t count() const
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  double sum() const
+  {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+  // NOTE: These are infinite if the sketch is empty.
+  double min() const
+  {
+    return min_.load(std::memory_order_relaxed);
+  }
+
+  double max() const
+  {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the estimate of the given quantile (in [0, 1]), or none if
+  // the sketch is empty.
+  Option<double> quantile(double q) const
+  {
+    std::array<double, 1> quantiles = {{q}};
+    std::array<double, 1> estimates;
+
+    if (!estimate(quantiles, &estimates)) {
+      return None();
+    }
+
+    return estimates[0];
+  }
+
+  // Returns the estimates of the statistics of the values, or none if
+  // there are fewer than 2 values (like `Statistics<double>::from`).
+  Option<Statistics<double>> statistics() const
+  {
+    std::array<double, 6> quantiles = {{0.5, 0.9, 0.95, 0.99, 0.999, 0.9999}};
+    std::array<double, 6> estimates;
+
+    Statistics<double> statistics;
+    statistics.count = estimate(quantiles, &estimates);
+
+    if (statistics.count < 2) {
+      return None();
+    }
+
+    statistics.min = min();
+    statistics.max = max();
+    statistics.p50 = estimates[0];
+    statistics.p90 = estimates[1];
+    statistics.p95 = estimates[2];
+    statistics.p99 = estimates[3];
+    statistics.p999 = estimates[4];
+    statistics.p9999 = estimates[5];
+
+    return statistics;
+  }
+
+  // Returns the estimates of the number of values which are at most
+  // each of the given (ascending) bounds, i.e., the cumulative counts
+  // of a histogram with these bucket bounds. The values which are in
+  // the same bucket of the sketch as a bound are counted as being at
+  // most the bound.
+  std::vector<uint64_t> cumulative(const std::vector<double>& bounds) const
+  {
+    std::vector<uint64_t> counts;
+    counts.reserve(bounds.size());
+
+    size_t i = 0;
+    uint64_t seen = 0;
+
+    for (double bound : bounds) {
+      for (const size_t last = index(bound); i <= last; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+      }
+
+      counts.push_back(seen);
+    }
+
+    return counts;
+  }
+
+private:
+  // The bounds of the buckets grow by a factor of
+  // GAMMA = (1 + ACCURACY) / (1 - ACCURACY), with an ACCURACY of 1%,
+  // from 1e-9 to 1e12, i.e., we need log(1e21) / log(GAMMA) buckets,
+  // plus one for the values below the smallest bound.
+  static constexpr size_t BUCKETS = 2419;
+
+  static double gamma()
+  {
+    return 1.01 / 0.99;
+  }
+
+  // Returns log(GAMMA) = 2 * atanh(ACCURACY).
+  static double logGamma()
+  {
+    return 0.020000666706669;
+  }
+
+  static double lowest()
+  {
+    return 1e-9;
+  }
+
+  // Returns the index of the bucket of the given value: bucket 0 holds
+  // the values up to the lowest bound, bucket `i` holds the values in
+  // (lowest * GAMMA^(i - 1), lowest * GAMMA^i].
+  static size_t index(double value)
+  {
+    if (!(value > lowest())) {
+      return 0; // Also catches NaN.
+    }
+
+    const double i = std::ceil(std::log(value / lowest()) / logGamma());
+
+    return static_cast<size_t>(
+        std::max(1.0, std::min(i, static_cast<double>(BUCKETS - 1))));
+  }
+
+  // Returns the estimate for the values in the given bucket, which is
+  // within ACCURACY of all of them.
+  static double estimate(size_t index)
+  {
+    if (index == 0) {
+      return 0.0;
+    }
+
+    return 2.0 * lowest() * std::pow(gamma(), static_cast<double>(index)) /
+           (gamma() + 1.0);
+  }
+
+  // Stores the estimates of the given (ascending) quantiles in a single
+  // pass over the buckets and returns the number of values.
+  template <size_t N>
+  uint64_t estimate(
+      const std::array<double, N>& quantiles,
+      std::array<double, N>* estimates) const
+  {
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t total = 0;
+
+    // NOTE: We count the values from the buckets rather than using
+    // `count_` since values might get recorded concurrently.
+    for (size_t i = 0; i < BUCKETS; i++) {
+      counts[i] = buckets[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+
+    if (total == 0) {
+      return 0;
+    }
+
+    const double min = this->min();
+    const double max = this->max();
+
+    size_t q = 0;
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < BUCKETS && q < N; i++) {
+      seen += counts[i];
+
+      // The rank of the quantile is `quantile * (total - 1)` (counting
+      // from 0), which is in this bucket if fewer values were seen
+      // before this bucket and more are seen including it.
+      while (q < N && seen > quantiles[q] * (total - 1)) {
+        (*estimates)[q] = std::max(min, std::min(estimate(i), max));
+        q++;
+      }
+    }
+
+    // Only possible due to rounding for quantiles close to 1.
+    for (; q < N; q++) {
+      (*estimates)[q] = max;
+    }
+
+    return total;
+  }
+
+  static void add(std::atomic<double>* sum, double value)
+  {
+    double current = sum->load(std::memory_order_relaxed);
+
+    while (!sum->compare_exchange_weak(
+               current, current + value, std::memory_order_relaxed)) {}
+  }
+
+  template <typename F>
+  static void update(std::atomic<double>* extreme, double value, F&& better)
+  {
+    double current = extreme->load(std::memory_order_relaxed);
+
+    while (better(value, current) &&
+           !extreme->compare_exchange_weak(
+               current, value, std::memory_order_relaxed)) {}
+  }
+
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets;
+  std::atomic<uint64_t> count_;
+  std::atomic<double> sum_;
+  std::atomic<double> min_;
+  std::atomic<double> max_;
+};
+
+
+// A `QuantileSketch` of the values recorded within a sliding window.
+//
+// The window is approximated by two sketches which cover consecutive
+// intervals of the length of the window. Values get recorded in the
+// sketch of the current interval, and the statistics are estimated
+// from both sketches, i.e., from the values of at least the last
+// window and at most the last two windows. When the current interval
+// is over, the sketch of the previous interval gets cleared and
+// becomes the sketch of the current interval.
+//
+// Without a window, this is a single sketch of all values.
+//
+// NOTE: With a window, recording a value (and estimating statistics)
+// without passing the time reads `Clock::now()`, which takes the lock
+// of the libprocess clock. Without a window, the clock is not read, so
+// values are recorded without locking.
+class SlidingQuantileSketch
+{
+public:
+  explicit SlidingQuantileSketch(const Option<Duration>& _window = None())
+    : window(_window),
+      current(0),
+      start(Clock::now().duration().ns())
+  {
+    sketches[0].reset(new QuantileSketch());
+
+    if (window.isSome()) {
+      sketches[1].reset(new QuantileSketch());
+    }
+  }
+
+  void record(double value)
+  {
+    if (window.isNone()) {
+      sketches[0]->record(value);
+      return;
+    }
+
+    record(value, Clock::now());
+  }
+
+  void record(double value, const Time& time)
+  {
+    advance(time);
+
+    sketches[current.load(std::memory_order_acquire)]->record(value);
+  }
+
+  Option<Statistics<double>> statistics()
+  {
+    return statistics(window.isSome() ? Clock::now() : Time::epoch());
+  }
+
+  Option<Statistics<double>> statistics(const Time& time)
+  {
+    advance(time);
+
+    if (window.isNone()) {
+      return sketches[0]->statistics();
+    }
+
+    std::unique_ptr<QuantileSketch> merged(new QuantileSketch());
+    merged->merge(*sketches[0]);
+    merged->merge(*sketches[1]);
+
+    return merged->statistics();
+  }
+
+  // Returns the sketch of all values recorded so far, or none if there
+  // is a window (in which case values get dropped from the sketches).
+  Option<const QuantileSketch*> total() const
+  {
+    if (window.isSome()) {
+      return None();
+    }
+
+    return sketches[0].get();
+  }
+
+private:
+  // Starts new intervals if the current one is over.
+  void advance(const Time& time)
+  {
+    if (window.isNone()) {
+      return;
+    }
+
+    const int64_t now = time.duration().ns();
+    const int64_t length = window->ns();
+
+    int64_t start = this->start.load(std::memory_order_relaxed);
+
+    if (now - start < length) {
+      return;
+    }
+
+    // Only one of the threads noticing that the interval is over gets
+    // to start the new one.
+    if (!this->start.compare_exchange_strong(start, now)) {
+      return;
+    }
+
+    const size_t previous = current.load(std::memory_order_relaxed);
+    const size_t next = 1 - previous;
+
+    // All values are older than a window if we missed an interval.
+    if (now - start >= 2 * length) {
+      sketches[previous]->clear();
+    }
+
+    sketches[next]->clear();
+
+    current.store(next, std::memory_order_release);
+  }
+
+  const Option<Duration> window;
+
+  std::array<std::unique_ptr<QuantileSketch>, 2> sketches;
+
+  // The index of the sketch of the current interval and the time (in
+  // nanoseconds since the epoch) when the current interval started.
+  std::atomic<size_t> current;
+  std::atomic<int64_t> start;
+};
+
+} // namespace process {
+
+#endif // __PROCESS_QUANTILE_SKETCH_HPP__
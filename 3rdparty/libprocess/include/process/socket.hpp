@@ -19,6 +19,7 @@
 #endif // __WINDOWS__
 
 #include <memory>
+#include <vector>
 
 #include <process/address.hpp>
 #include <process/future.hpp>
@@ -184,6 +185,33 @@ public:
   // enabling reuse of a pool of preallocated strings/buffers.
   virtual Future<Nothing> send(const std::string& data);
 
+  /**
+   * A contiguous range of data to send, see below.
+   */
+  struct Buffer
+  {
+    const char* data;
+    size_t size;
+  };
+
+  /**
+   * An overload of `send`, which sends the data of the specified
+   * buffers in order, like `send` would if they were contiguous, but
+   * without having to copy them into a contiguous buffer (i.e., using
+   * "scatter/gather" I/O where supported).
+   *
+   * Like with `send`, the data must remain valid until the returned
+   * future is completed, and fewer bytes than requested may be sent.
+   * The default implementation copies the leading buffers into a
+   * single send as long as they are small, and otherwise only sends
+   * the first non-empty buffer.
+   *
+   * @param buffers The buffers to send, which must not all be empty.
+   *
+   * @return The number of bytes sent.
+   */
+  virtual Future<size_t> send(const std::vector<Buffer>& buffers);
+
   /**
    * Shuts down the socket. Accepts an integer which specifies the
    * shutdown mode.
@@ -388,6 +416,11 @@ public:
     return impl->send(data);
   }
 
+  Future<size_t> send(const std::vector<SocketImpl::Buffer>& buffers) const
+  {
+    return impl->send(buffers);
+  }
+
   enum class Shutdown
   {
     READ,
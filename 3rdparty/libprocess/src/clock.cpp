@@ -31,6 +31,7 @@
 #include <stout/unreachable.hpp>
 
 #include "event_loop.hpp"
+#include "timer_wheel.hpp"
 
 using std::list;
 using std::map;
@@ -39,10 +40,10 @@ using std::set;
 
 namespace process {
 
-// We store the timers in a map of lists indexed by the timeout of the
-// timer so that we can have two timers that have the same timeout. We
-// exploit that the map is SORTED!
-static map<Time, list<Timer>>* timers = new map<Time, list<Timer>>();
+// We store the timers in a timing wheel (see timer_wheel.hpp) so that
+// creating and canceling a timer is O(1), which keeps the time spent
+// holding `timers_mutex` short when there are lots of timers.
+static TimerWheel* timers = new TimerWheel();
 static recursive_mutex* timers_mutex = new recursive_mutex();
 
 
@@ -77,32 +78,38 @@ lambda::function<void(const list<Timer>&)>* callback =
 set<Time>* ticks = new set<Time>();
 
 
-// Helper for determining the time when the next timer elapses,
-// or None if no timers are pending, or the clock is paused and no
-// timers are expired. Note that we don't manipulate 'timers' directly
-// so that it's clear from the callsite that the use of 'timers' is
-// within a 'synchronized' block.
-//
-// TODO(benh): Create a generic 'Timers' abstraction which hides this
-// and more away (i.e., all manipulations of 'timers' below).
-Option<Time> next(const map<Time, list<Timer>>& timers)
+// Helper for determining the time when the next timer elapses (or,
+// if no timer is expired, a time at which to check again, see
+// `TimerWheel::earliest`), or None if no timers are pending, or the
+// clock is paused and no timers are expired. Note that we don't
+// manipulate 'timers' directly so that it's clear from the callsite
+// that the use of 'timers' is within a 'synchronized' block.
+Option<Time> next(TimerWheel* timers)
 {
-  if (!timers.empty()) {
-    Time first = timers.begin()->first;
-
-    // If the clock is paused and no timers are expired, the
-    // timers cannot fire until the clock is advanced, so we
-    // return None() here. Note that we pass nullptr to ensure
-    // that this looks at the global clock, since this can be
-    // called from a Process context through Clock::timer.
-    if (Clock::paused() && first > Clock::now(nullptr)) {
-      return None();
-    }
+  // Note that we pass nullptr to ensure that this looks at the
+  // global clock, since this can be called from a Process context
+  // through Clock::timer.
+  const Time now = Clock::now(nullptr);
 
-    return first;
+  Option<Time> first = timers->earliest(now);
+
+  // If the clock is paused and no timers are expired, the timers
+  // cannot fire until the clock is advanced, so we return None()
+  // here.
+  if (first.isSome() && Clock::paused() && first.get() > now) {
+    return None();
   }
 
-  return None();
+  return first;
+}
+
+
+// Helper for determining whether any timers are expired at the given
+// time, see `next` above for why this needs to be synchronized.
+bool expired(TimerWheel* timers, const Time& time)
+{
+  Option<Time> first = timers->earliest(time);
+  return first.isSome() && first.get() <= time;
 }
 
 
@@ -116,7 +123,7 @@ void tick(const Time& time);
 // a 'synchronized' block.
 // TODO(bmahler): Consider taking an optional 'now' to avoid
 // excessive syscalls via Clock::now(nullptr).
-void scheduleTick(const map<Time, list<Timer>>& timers, set<Time>* ticks)
+void scheduleTick(TimerWheel* timers, set<Time>* ticks)
 {
   // Determine when the next 'tick' should fire.
   const Option<Time> next = clock::next(timers);
@@ -139,6 +146,8 @@ void scheduleTick(const map<Time, list<Timer>>& timers, set<Time>* ticks)
 // NOTE: This method must remain robust to arbitrary invocations.
 // i.e. `tick` should not make any assumptions of what is held in `timers`,
 // which can be empty or have timers that trigger later than the current time.
+// With the timing wheel, a "tick" may also fire before any timer is
+// expired (see `TimerWheel::earliest`).
 void tick(const Time& time)
 {
   list<Timer> timedout;
@@ -151,12 +160,12 @@ void tick(const Time& time)
 
     VLOG(3) << "Handling timers up to " << now;
 
-    foreachkey (const Time& timeout, *timers) {
-      if (timeout > now) {
-        break;
-      }
+    timedout = timers->expire(now);
 
-      VLOG(3) << "Have timeout(s) at " << timeout;
+    if (!timedout.empty()) {
+      VLOG(3) << "Have " << timedout.size() << " timeout(s) between "
+              << timedout.front().timeout().time() << " and "
+              << timedout.back().timeout().time();
 
       // Need to toggle 'settling' so that we don't prematurely say
       // we're settled until after the timers are executed below,
@@ -164,15 +173,10 @@ void tick(const Time& time)
       if (clock::paused) {
         clock::settling = true;
       }
-
-      timedout.splice(timedout.end(), (*timers)[timeout]);
     }
 
-    // Now erase the range of timers that timed out.
-    timers->erase(timers->begin(), timers->upper_bound(now));
-
     // Okay, so the timeout for the next timer should not have fired.
-    CHECK(timers->empty() || (timers->begin()->first > now));
+    CHECK(!expired(timers, now));
 
     // Remove this tick from the scheduled 'ticks', it may have
     // been removed already if the clock was paused / manipulated
@@ -180,7 +184,7 @@ void tick(const Time& time)
     ticks->erase(time);
 
     // Schedule another "tick" if necessary.
-    scheduleTick(*timers, ticks);
+    scheduleTick(timers, ticks);
   }
 
   (*clock::callback)(timedout);
@@ -191,9 +195,7 @@ void tick(const Time& time)
   // that will expire before the paused time and we've finished
   // executing expired timers.
   synchronized (timers_mutex) {
-    if (clock::paused &&
-        (timers->size() == 0 ||
-         timers->begin()->first > *clock::current)) {
+    if (clock::paused && !expired(timers, *clock::current)) {
       VLOG(3) << "Clock has settled";
       clock::settling = false;
     }
@@ -281,17 +283,14 @@ Timer Clock::timer(
 
   // Add the timer.
   synchronized (timers_mutex) {
-    if (timers->size() == 0 ||
-        timer.timeout().time() < timers->begin()->first) {
-      // Need to interrupt the loop to update/set timer repeat.
-      (*timers)[timer.timeout().time()].push_back(timer);
+    timers->insert(timer.id, timer);
 
+    if (clock::ticks->empty() ||
+        timer.timeout().time() < *clock::ticks->begin()) {
+      // Need to interrupt the loop to update/set timer repeat.
+      //
       // Schedule another "tick" if necessary.
-      clock::scheduleTick(*timers, clock::ticks);
-    } else {
-      // Timer repeat is adequate, just add the timeout.
-      CHECK(timers->size() >= 1);
-      (*timers)[timer.timeout().time()].push_back(timer);
+      clock::scheduleTick(timers, clock::ticks);
     }
   }
 
@@ -301,22 +300,12 @@ Timer Clock::timer(
 
 bool Clock::cancel(const Timer& timer)
 {
-  bool canceled = false;
   synchronized (timers_mutex) {
-    // Check if the timeout is still pending, and if so, erase it. In
-    // addition, erase an empty list if we just removed the last
-    // timeout.
-    Time time = timer.timeout().time();
-    if (timers->count(time) > 0) {
-      canceled = true;
-      (*timers)[time].remove(timer);
-      if ((*timers)[time].empty()) {
-        timers->erase(time);
-      }
-    }
+    // Erase the timer if it is still pending.
+    return timers->cancel(timer.id);
   }
 
-  return canceled;
+  UNREACHABLE();
 }
 
 
@@ -365,7 +354,7 @@ void Clock::resume()
       clock::currents->clear();
 
       // Schedule another "tick" if necessary.
-      clock::scheduleTick(*timers, clock::ticks);
+      clock::scheduleTick(timers, clock::ticks);
     }
   }
 }
@@ -383,7 +372,7 @@ void Clock::advance(const Duration& duration)
       // Schedule another "tick" if necessary. Only "ticks" that
       // fire immediately will be scheduled here, since the clock
       // is paused.
-      clock::scheduleTick(*timers, clock::ticks);
+      clock::scheduleTick(timers, clock::ticks);
     }
   }
 }
@@ -420,7 +409,7 @@ void Clock::update(const Time& time)
         // Schedule another "tick" if necessary. Only "ticks" that
         // fire immediately will be scheduled here, since the clock
         // is paused.
-        clock::scheduleTick(*timers, clock::ticks);
+        clock::scheduleTick(timers, clock::ticks);
       }
     }
   }
@@ -460,8 +449,7 @@ bool Clock::settled()
     if (clock::settling) {
       VLOG(3) << "Clock still not settled";
       return false;
-    } else if (timers->size() == 0 ||
-               timers->begin()->first > *clock::current) {
+    } else if (!clock::expired(timers, *clock::current)) {
       VLOG(3) << "Clock is settled";
       return true;
     }
@@ -19,9 +19,14 @@
 #include <limits>
 #include <map>
 #include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <process/http.hpp>
+#include <process/message.hpp>
 #include <process/process.hpp>
+#include <process/socket.hpp>
 
 #include <stout/foreach.hpp>
 #include <stout/gzip.hpp>
@@ -44,7 +49,8 @@ public:
   enum Kind
   {
     DATA,
-    FILE
+    FILE,
+    MESSAGE
   };
 
   Encoder() = default;
@@ -62,8 +68,8 @@ public:
 class DataEncoder : public Encoder
 {
 public:
-  DataEncoder(const std::string& _data)
-    : data(_data), index(0) {}
+  DataEncoder(std::string _data)
+    : data(std::move(_data)), index(0) {}
 
   virtual ~DataEncoder() {}
 
@@ -98,13 +104,109 @@ private:
 };
 
 
-class MessageEncoder : public DataEncoder
+// Encodes a message as an HTTP request. Unlike with a `DataEncoder`,
+// the body of the message is not copied into a single buffer with the
+// rest of the request, instead the header, the body and the trailer
+// get sent from separate buffers using scatter/gather I/O (see
+// `SocketImpl::send`). Since the body is moved from the message, this
+// avoids copying the (potentially large) serialized protobufs.
+//
+// Several messages can be coalesced into one encoder (see `append`),
+// in which case they get sent back to back (i.e., as pipelined HTTP
+// requests) with as few writes as possible.
+class MessageEncoder : public Encoder
 {
 public:
-  MessageEncoder(const Message& message)
-    : DataEncoder(encode(message)) {}
+  MessageEncoder(Message&& message)
+    : messages_(0), size(0), index(0)
+  {
+    add(encode(message, false));
+
+    if (!message.body.empty()) {
+      add(std::move(message.body));
+      add(TRAILER);
+    }
+
+    messages_++;
+  }
+
+  virtual ~MessageEncoder() {}
+
+  virtual Kind kind() const
+  {
+    return Encoder::MESSAGE;
+  }
+
+  // Returns the buffers with the remaining data.
+  virtual std::vector<network::internal::SocketImpl::Buffer> next(
+      size_t* length)
+  {
+    std::vector<network::internal::SocketImpl::Buffer> buffers;
+
+    size_t skip = index;
+    foreach (const std::string& data, this->data) {
+      if (skip >= data.size()) {
+        skip -= data.size();
+        continue;
+      }
+
+      buffers.push_back({data.data() + skip, data.size() - skip});
+      skip = 0;
+    }
+
+    *length = remaining();
+    index = size;
+    return buffers;
+  }
+
+  virtual void backup(size_t length)
+  {
+    if (index >= length) {
+      index -= length;
+    }
+  }
+
+  virtual size_t remaining() const
+  {
+    return size - index;
+  }
+
+  // Appends the messages of the given encoder so that they get sent
+  // after the messages of this encoder. Neither encoder may have been
+  // (partially) sent yet.
+  void append(MessageEncoder&& that)
+  {
+    CHECK_EQ(0u, index);
+    CHECK_EQ(0u, that.index);
+
+    foreach (std::string& data, that.data) {
+      add(std::move(data));
+    }
+
+    messages_ += that.messages_;
+
+    that.data.clear();
+    that.messages_ = 0;
+    that.size = 0;
+  }
+
+  // Returns the number of messages in this encoder.
+  size_t messages() const
+  {
+    return messages_;
+  }
 
   static std::string encode(const Message& message)
+  {
+    return encode(message, true);
+  }
+
+private:
+  static constexpr const char* TRAILER = "\r\n0\r\n\r\n";
+
+  // Returns the HTTP request for the message, including the body and
+  // the trailer only if `complete` is true.
+  static std::string encode(const Message& message, bool complete)
   {
     std::ostringstream out;
 
@@ -127,16 +229,28 @@ public:
     if (message.body.size() > 0) {
       out << "Transfer-Encoding: chunked\r\n\r\n"
           << std::hex << message.body.size() << "\r\n";
-      out.write(message.body.data(), message.body.size());
-      out << "\r\n"
-          << "0\r\n"
-          << "\r\n";
+
+      if (complete) {
+        out.write(message.body.data(), message.body.size());
+        out << TRAILER;
+      }
     } else {
       out << "\r\n";
     }
 
     return out.str();
   }
+
+  void add(std::string&& data)
+  {
+    size += data.size();
+    this->data.push_back(std::move(data));
+  }
+
+  std::vector<std::string> data;
+  size_t messages_;
+  size_t size;
+  size_t index;
 };
 
 
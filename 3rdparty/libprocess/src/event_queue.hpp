@@ -13,7 +13,11 @@
 #ifndef __PROCESS_EVENT_QUEUE_HPP__
 #define __PROCESS_EVENT_QUEUE_HPP__
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <iterator>
 #include <mutex>
 #include <string>
 
@@ -21,6 +25,7 @@
 #include <process/http.hpp>
 
 #include <stout/json.hpp>
+#include <stout/option.hpp>
 #include <stout/stringify.hpp>
 #include <stout/synchronized.hpp>
 
@@ -40,6 +45,8 @@ namespace process {
 //
 //   * Consumers _must_ call `empty()` before calling
 //     `dequeue()`. Failing to do so may result in undefined behavior.
+//     This does not apply to `fill()` which moves up to a given
+//     number of events into the consumer's batch.
 //
 //   * After a consumer calls `decomission()` they _must_ not call any
 //     thing else (not even `empty()` and especially not
@@ -73,7 +80,11 @@ public:
   class Producer
   {
   public:
-    void enqueue(Event* event) { queue->enqueue(event); }
+    void enqueue(Event* event)
+    {
+      queue->sample(event);
+      queue->enqueue(event);
+    }
 
   private:
     friend class EventQueue;
@@ -86,12 +97,86 @@ public:
   class Consumer
   {
   public:
-    Event* dequeue() { return queue->dequeue(); }
-    bool empty() { return queue->empty(); }
-    void decomission() { queue->decomission(); }
+    // Returns the next event, serving the events that were moved
+    // into the batch by `fill()` first. If the event was sampled (see
+    // `EventQueue::sample()`), `wait` is set to how long it waited.
+    Event* dequeue(
+        Option<std::chrono::steady_clock::duration>* wait = nullptr)
+    {
+      Event* event = nullptr;
+
+      if (!batch.empty()) {
+        event = batch.front();
+        batch.pop_front();
+      } else {
+        event = queue->dequeue();
+      }
+
+      if (event != nullptr &&
+          event == queue->sampled.load(std::memory_order_acquire)) {
+        const std::chrono::steady_clock::time_point enqueued(
+            std::chrono::steady_clock::duration(
+                queue->sampledAt.load(std::memory_order_relaxed)));
+
+        if (wait != nullptr) {
+          *wait = std::chrono::steady_clock::now() - enqueued;
+        }
+
+        queue->sampled.store(nullptr, std::memory_order_release);
+      }
+
+      return event;
+    }
+
+    // Moves up to `max` events from the queue into the batch, i.e.,
+    // acquiring the queue's mutex only once for all of them. Returns
+    // the number of moved events.
+    size_t fill(size_t max) { return queue->dequeue(&batch, max); }
+
+    // Returns the number of events in the batch.
+    size_t batched() { return batch.size(); }
+
+    // NOTE: The batched events are still considered to be in the
+    // queue until they are dequeued, e.g., so that they show up in
+    // `/__processes__`.
+    bool empty() { return batch.empty() && queue->empty(); }
+    size_t size() { return batch.size() + queue->size(); }
+
+    void decomission()
+    {
+      foreach (Event* event, batch) {
+        delete event;
+      }
+      batch.clear();
+      queue->decomission();
+    }
+
     template <typename T>
-    size_t count() { return queue->count<T>(); }
-    operator JSON::Array() { return queue->operator JSON::Array(); }
+    size_t count()
+    {
+      return queue->count<T>() + std::count_if(
+          batch.begin(),
+          batch.end(),
+          [](const Event* event) {
+            return event->is<T>();
+          });
+    }
+
+    operator JSON::Array()
+    {
+      JSON::Array array;
+      foreach (Event* event, batch) {
+        array.values.push_back(JSON::Object(*event));
+      }
+
+      JSON::Array queued = queue->operator JSON::Array();
+      array.values.insert(
+          array.values.end(),
+          std::make_move_iterator(queued.values.begin()),
+          std::make_move_iterator(queued.values.end()));
+
+      return array;
+    }
 
   private:
     friend class EventQueue;
@@ -99,12 +184,36 @@ public:
     Consumer(EventQueue* queue) : queue(queue) {}
 
     EventQueue* queue;
+
+    // Events that were dequeued from the queue but not yet served.
+    // Like the rest of the consumer interface, this must only be
+    // accessed by the single consumer (i.e., from within the process).
+    std::deque<Event*> batch;
   } consumer;
 
 private:
   friend class Producer;
   friend class Consumer;
 
+  // To measure how long events wait in the queue without reading the
+  // clock for every event, only one event at a time gets timestamped:
+  // an event is sampled if no other sampled event is in the queue.
+  void sample(Event* event)
+  {
+    Event* expected = nullptr;
+    if (sampled.load(std::memory_order_relaxed) == nullptr &&
+        sampled.compare_exchange_strong(expected, event)) {
+      sampledAt.store(
+          std::chrono::steady_clock::now().time_since_epoch().count(),
+          std::memory_order_relaxed);
+    }
+  }
+
+  // The sampled event, if any, and when it got enqueued.
+  std::atomic<Event*> sampled = ATOMIC_VAR_INIT(nullptr);
+  std::atomic<std::chrono::steady_clock::rep> sampledAt =
+    ATOMIC_VAR_INIT(0);
+
 #ifndef LOCK_FREE_EVENT_QUEUE
   void enqueue(Event* event)
   {
@@ -138,6 +247,20 @@ private:
     return CHECK_NOTNULL(event);
   }
 
+  // Dequeues up to `max` events at once, i.e., acquiring the mutex
+  // only once. Returns the number of dequeued events.
+  size_t dequeue(std::deque<Event*>* batch, size_t max)
+  {
+    synchronized (mutex) {
+      const size_t count = std::min(max, events.size());
+
+      batch->insert(batch->end(), events.begin(), events.begin() + count);
+      events.erase(events.begin(), events.begin() + count);
+
+      return count;
+    }
+  }
+
   bool empty()
   {
     synchronized (mutex) {
@@ -145,6 +268,13 @@ private:
     }
   }
 
+  size_t size()
+  {
+    synchronized (mutex) {
+      return events.size();
+    }
+  }
+
   void decomission()
   {
     synchronized (mutex) {
@@ -188,6 +318,7 @@ private:
   void enqueue(Event* event)
   {
     if (comissioned.load()) {
+      count_.fetch_add(1, std::memory_order_relaxed);
       queue.enqueue(event);
     } else {
       delete event;
@@ -196,7 +327,25 @@ private:
 
   Event* dequeue()
   {
-    return queue.dequeue();
+    Event* event = queue.dequeue();
+    if (event != nullptr) {
+      count_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return event;
+  }
+
+  size_t dequeue(std::deque<Event*>* batch, size_t max)
+  {
+    size_t count = 0;
+    while (count < max) {
+      Event* event = dequeue();
+      if (event == nullptr) {
+        break;
+      }
+      batch->push_back(event);
+      count++;
+    }
+    return count;
   }
 
   bool empty()
@@ -204,6 +353,13 @@ private:
     return queue.empty();
   }
 
+  // NOTE: This is only an estimate since producers increment the
+  // count before they enqueue the event.
+  size_t size()
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
   void decomission()
   {
     comissioned.store(true);
@@ -241,6 +397,10 @@ private:
   // be atomic as it can be read by a producer even though it's only
   // written by a consumer.
   std::atomic<bool> comissioned = ATOMIC_VAR_INIT(true);
+
+  // Number of events in the queue, see `size()`. We keep track of it
+  // because the underlying queue can not be sized in O(1).
+  std::atomic<size_t> count_ = ATOMIC_VAR_INIT(0);
 #endif // LOCK_FREE_EVENT_QUEUE
 };
 
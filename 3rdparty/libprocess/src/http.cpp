@@ -1524,6 +1524,10 @@ Future<Nothing> send(network::Socket socket, Encoder* encoder)
             int_fd fd = static_cast<FileEncoder*>(encoder)->next(&offset, size);
             return socket.sendfile(fd, offset, *size);
           }
+          case Encoder::MESSAGE: {
+            return socket.send(
+                static_cast<MessageEncoder*>(encoder)->next(size));
+          }
         }
         UNREACHABLE();
       },
@@ -10,19 +10,32 @@
 // See the License for the specific language governing permissions and
 // limitations under the License
 
+#include <stdint.h>
+#include <stdio.h>
+
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <map>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <process/after.hpp>
+#include <process/clock.hpp>
 #include <process/collect.hpp>
 #include <process/dispatch.hpp>
 #include <process/help.hpp>
+#include <process/http.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
+#include <process/quantile_sketch.hpp>
+#include <process/time.hpp>
 
+#include <process/metrics/counter.hpp>
 #include <process/metrics/metrics.hpp>
 
 #include <stout/duration.hpp>
@@ -32,6 +45,7 @@
 #include <stout/numify.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
+#include <stout/unreachable.hpp>
 
 using std::map;
 using std::string;
@@ -41,6 +55,215 @@ namespace process {
 namespace metrics {
 namespace internal {
 
+// The (approximate) size of the chunks in which the responses of the
+// `/openmetrics` endpoint get encoded.
+static const size_t EXPOSITION_CHUNK_SIZE = 64 * 1024;
+
+
+struct MetricsProcess::Exposition
+{
+  // The types of the metric families, see the OpenMetrics
+  // specification. Counters and pull/push gauges are exposed as
+  // counters and gauges, the distributions of values (e.g., of timers)
+  // as summaries (within a window) or histograms (of all values).
+  enum Type
+  {
+    COUNTER,
+    GAUGE,
+    SUMMARY,
+    HISTOGRAM
+  };
+
+  // The samples of a metric for one metric family.
+  struct Entry
+  {
+    std::string family;
+    Type type;
+
+    // The encoded labels, e.g., `role="a",resource="cpus"`.
+    std::string labels;
+
+    // The name of the metric, and its value (for counters and gauges).
+    std::string name;
+    Future<double> value;
+
+    // The statistics of the metric (for summaries).
+    Option<Statistics<double>> statistics;
+
+    // The bucket bounds and cumulative counts as well as the total
+    // count and sum of the values of the metric (for histograms).
+    std::vector<double> bounds;
+    std::vector<uint64_t> counts;
+    uint64_t count;
+    double sum;
+  };
+
+  explicit Exposition(const Option<Duration>& _timeout)
+    : timeout(_timeout), next(0) {}
+
+  const Option<Duration> timeout;
+
+  // Sorted by family, so that the samples of each family are
+  // contiguous as required by the format.
+  std::vector<Entry> entries;
+
+  // The next entry to encode and the family of the last encoded entry.
+  size_t next;
+  std::string family;
+};
+
+
+// Returns the given name with all characters which are not allowed in
+// metric family and label names replaced by '_', e.g.,
+// "allocator/mesos/allocation_runs" becomes
+// "allocator_mesos_allocation_runs".
+static string sanitize(const string& name)
+{
+  string result = name;
+
+  foreach (char& c, result) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '_') {
+      c = '_';
+    }
+  }
+
+  if (result.empty() || isdigit(static_cast<unsigned char>(result[0]))) {
+    result = "_" + result;
+  }
+
+  return result;
+}
+
+
+static string encodeLabels(const std::map<string, string>& labels)
+{
+  string result;
+
+  foreachpair (const string& name, const string& value, labels) {
+    if (!result.empty()) {
+      result += ",";
+    }
+
+    result += sanitize(name) + "=\"";
+
+    foreach (char c, value) {
+      switch (c) {
+        case '\\': result += "\\\\"; break;
+        case '"':  result += "\\\""; break;
+        case '\n': result += "\\n"; break;
+        default:   result += c; break;
+      }
+    }
+
+    result += "\"";
+  }
+
+  return result;
+}
+
+
+// Returns the shortest representation of the given value which parses
+// back to the same value.
+static string format(double value)
+{
+  if (std::isnan(value)) {
+    return "NaN";
+  } else if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+
+  char buffer[32];
+
+  snprintf(buffer, sizeof(buffer), "%.15g", value);
+
+  if (strtod(buffer, nullptr) != value) {
+    snprintf(buffer, sizeof(buffer), "%.17g", value);
+  }
+
+  return buffer;
+}
+
+
+// Appends a sample of the given family, e.g., `familycount{labels} 1`.
+static void sample(
+    string* chunk,
+    const string& name,
+    const string& labels,
+    const string& label,
+    double value,
+    const Option<Time>& timestamp = None())
+{
+  *chunk += name;
+
+  if (!labels.empty() || !label.empty()) {
+    *chunk += "{" + labels;
+
+    if (!labels.empty() && !label.empty()) {
+      *chunk += ",";
+    }
+
+    *chunk += label + "}";
+  }
+
+  *chunk += " " + format(value);
+
+  if (timestamp.isSome()) {
+    *chunk += " " + format(timestamp->secs());
+  }
+
+  *chunk += "\n";
+}
+
+
+// Returns the bucket bounds of a histogram of values between 'min'
+// and 'max', i.e., the 1-2-5 series of bounds from the power of ten
+// below 'min' up to the first bound which is at least 'max' (within
+// the range of a `QuantileSketch`). Since the bounds only depend on
+// the range of the values, they only ever get extended over time.
+static vector<double> bounds(double min, double max)
+{
+  const int from = static_cast<int>(
+      std::floor(std::log10(std::max(min, 1e-9))));
+  const int to = static_cast<int>(
+      std::ceil(std::log10(std::min(std::max(max, 1e-9), 1e12))));
+
+  vector<double> bounds;
+
+  for (int exponent = from; exponent <= to; exponent++) {
+    for (double multiple : {1.0, 2.0, 5.0}) {
+      const double bound = multiple * std::pow(10.0, exponent);
+
+      bounds.push_back(bound);
+
+      if (bound >= max) {
+        return bounds;
+      }
+    }
+  }
+
+  return bounds;
+}
+
+
+static Try<Option<Duration>> parseTimeout(const http::Request& request)
+{
+  if (!request.url.query.contains("timeout")) {
+    return None();
+  }
+
+  string parameter = request.url.query.get("timeout").get();
+
+  Try<Duration> duration = Duration::parse(parameter);
+
+  if (duration.isError()) {
+    return Error(
+        "Invalid timeout '" + parameter + "': " + duration.error() + ".\n");
+  }
+
+  return duration.get();
+}
+
+
 MetricsProcess* MetricsProcess::create(
     const Option<string>& authenticationRealm)
 {
@@ -99,6 +322,11 @@ void MetricsProcess::initialize()
         authenticationRealm,
         help(),
         &MetricsProcess::_snapshot);
+
+  route("/openmetrics",
+        authenticationRealm,
+        openmetricsHelp(),
+        &MetricsProcess::openmetrics);
 }
 
 
@@ -112,13 +340,61 @@ string MetricsProcess::help()
           "",
           "The optional query parameter 'timeout' determines the maximum",
           "amount of time the endpoint will take to respond. If the timeout",
-          "is exceeded, some metrics may not be included in the response.",
+          "is exceeded, the metrics whose values are not yet available are",
+          "reported with their values from a previous snapshot, if any, and",
+          "are not included in the response otherwise. For each value from",
+          "a previous snapshot, the response also contains the key",
+          "'<name>/staleness_secs', the age of the value in seconds.",
           "",
           "The key is the metric name, and the value is a double-type."),
       AUTHENTICATION(true));
 }
 
 
+string MetricsProcess::openmetricsHelp()
+{
+  return HELP(
+      TLDR("Provides the current metrics in the OpenMetrics text format."),
+      DESCRIPTION(
+          "This endpoint provides the metrics of the `snapshot` endpoint in",
+          "the OpenMetrics text exposition format, which can be scraped by",
+          "Prometheus. The response gets streamed as it is encoded.",
+          "",
+          "Metric names are converted to metric family names by replacing",
+          "all characters other than letters, digits and '_' with '_'.",
+          "Some metrics (e.g., per-role metrics) are exposed as a single",
+          "family with labels rather than with their key-encoded names.",
+          "Counters are exposed with the suffix '_total'. The distribution",
+          "of the values of a metric is exposed as a separate family with",
+          "the suffix '_distribution': as a histogram of all values, or as",
+          "a summary of the values within a window. Metrics whose samples",
+          "would collide with those of other metrics once converted are",
+          "left out (and logged), e.g., only one of 'a/b' and 'a_b'.",
+          "",
+          "The optional query parameter 'timeout' determines the maximum",
+          "amount of time the endpoint will take to start responding, as",
+          "for the `snapshot` endpoint. Values from a previous snapshot",
+          "are exposed with the timestamp of when they were taken."),
+      AUTHENTICATION(true));
+}
+
+
+// Returns the metric family under which the value of the given metric
+// gets exposed in the OpenMetrics format, see `exposition`.
+static string exposedFamily(const Metric& metric)
+{
+  string family = sanitize(metric.family());
+
+  // The samples of counters get the suffix "_total".
+  if (dynamic_cast<const Counter*>(&metric) != nullptr &&
+      strings::endsWith(family, "_total")) {
+    family = strings::remove(family, "_total", strings::SUFFIX);
+  }
+
+  return family;
+}
+
+
 Future<Nothing> MetricsProcess::add(Owned<Metric> metric)
 {
   if (metrics.contains(metric->name())) {
@@ -126,6 +402,7 @@ Future<Nothing> MetricsProcess::add(Owned<Metric> metric)
   }
 
   metrics[metric->name()] = metric;
+
   return Nothing();
 }
 
@@ -137,6 +414,8 @@ Future<Nothing> MetricsProcess::remove(const string& name)
   }
 
   metrics.erase(name);
+  cache.erase(name);
+  colliding.erase(name);
 
   return Nothing();
 }
@@ -177,20 +456,10 @@ Future<http::Response> MetricsProcess::_snapshot(
     const http::Request& request,
     const Option<http::authentication::Principal>&)
 {
-  // Parse the 'timeout' parameter.
-  Option<Duration> timeout;
-
-  if (request.url.query.contains("timeout")) {
-    string parameter = request.url.query.get("timeout").get();
-
-    Try<Duration> duration = Duration::parse(parameter);
-
-    if (duration.isError()) {
-      return http::BadRequest(
-          "Invalid timeout '" + parameter + "': " + duration.error() + ".\n");
-    }
+  Try<Option<Duration>> timeout = parseTimeout(request);
 
-    timeout = duration.get();
+  if (timeout.isError()) {
+    return http::BadRequest(timeout.error());
   }
 
   Future<Nothing> acquire = Nothing();
@@ -199,7 +468,7 @@ Future<http::Response> MetricsProcess::_snapshot(
     acquire = limiter.get()->acquire();
   }
 
-  return acquire.then(defer(self(), &Self::snapshot, timeout))
+  return acquire.then(defer(self(), &Self::snapshot, timeout.get()))
       .then([request](const map<string, double>& metrics)
             -> http::Response {
         return http::OK(jsonify(metrics), request.url.query.get("jsonp"));
@@ -214,15 +483,16 @@ Future<map<string, double>> MetricsProcess::__snapshot(
 {
   map<string, double> snapshot;
 
-  foreachpair (const string& key, const Future<double>& value, metrics) {
-    // TODO(dhamon): Maybe add the failure message for this metric to the
-    // response if value.isFailed().
-    if (value.isPending()) {
-      CHECK_SOME(timeout);
-      VLOG(1) << "Exceeded timeout of " << timeout.get()
-              << " when attempting to get metric '" << key << "'";
-    } else if (value.isReady()) {
-      snapshot[key] = value.get();
+  foreachpair (const string& key, const Future<double>& future, metrics) {
+    Option<Sample> sample = value(key, future, timeout);
+
+    if (sample.isSome()) {
+      snapshot[key] = sample->value;
+
+      if (sample->stale.isSome()) {
+        snapshot[key + "/staleness_secs"] =
+          (Clock::now() - sample->stale.get()).secs();
+      }
     }
 
     Option<Statistics<double>> statistics_ = statistics.get(key).get();
@@ -246,6 +516,373 @@ Future<map<string, double>> MetricsProcess::__snapshot(
   return std::move(snapshot);
 }
 
+
+Future<http::Response> MetricsProcess::openmetrics(
+    const http::Request& request,
+    const Option<http::authentication::Principal>&)
+{
+  Try<Option<Duration>> timeout = parseTimeout(request);
+
+  if (timeout.isError()) {
+    return http::BadRequest(timeout.error());
+  }
+
+  Future<Nothing> acquire = Nothing();
+
+  if (limiter.isSome()) {
+    acquire = limiter.get()->acquire();
+  }
+
+  return acquire.then(defer(self(), &Self::exposition, timeout.get()));
+}
+
+
+Future<http::Response> MetricsProcess::exposition(
+    const Option<Duration>& timeout)
+{
+  Owned<Exposition> exposition(new Exposition(timeout));
+
+  vector<Future<double>> values;
+
+  foreachvalue (const Owned<Metric>& metric, metrics) {
+    Exposition::Entry entry;
+    entry.family = exposedFamily(*metric);
+    entry.labels = encodeLabels(metric->labels());
+    entry.name = metric->name();
+    entry.value = metric->value();
+
+    const string family = sanitize(metric->family());
+
+    if (dynamic_cast<const Counter*>(metric.get()) != nullptr) {
+      entry.type = Exposition::COUNTER;
+    } else {
+      entry.type = Exposition::GAUGE;
+    }
+
+    values.push_back(entry.value);
+    exposition->entries.push_back(entry);
+
+    Option<const QuantileSketch*> sketch = metric->sketch();
+
+    if (sketch.isSome() && sketch.get()->count() > 0) {
+      Exposition::Entry histogram;
+      histogram.family = family + "_distribution";
+      histogram.type = Exposition::HISTOGRAM;
+      histogram.labels = entry.labels;
+      histogram.name = entry.name;
+      histogram.bounds = bounds(sketch.get()->min(), sketch.get()->max());
+      histogram.counts = sketch.get()->cumulative(histogram.bounds);
+      histogram.count = histogram.counts.back();
+      histogram.sum = sketch.get()->sum();
+
+      exposition->entries.push_back(histogram);
+    } else {
+      // TODO(dhamon): It would be nice to compute these asynchronously.
+      Option<Statistics<double>> statistics = metric->statistics();
+
+      if (statistics.isSome()) {
+        Exposition::Entry summary;
+        summary.family = family + "_distribution";
+        summary.type = Exposition::SUMMARY;
+        summary.labels = entry.labels;
+        summary.name = entry.name;
+        summary.statistics = statistics;
+
+        exposition->entries.push_back(summary);
+      }
+    }
+  }
+
+  std::sort(
+      exposition->entries.begin(),
+      exposition->entries.end(),
+      [](const Exposition::Entry& left, const Exposition::Entry& right) {
+        return std::tie(left.family, left.labels, left.name) <
+               std::tie(right.family, right.labels, right.name);
+      });
+
+  deduplicate(exposition);
+
+  Future<Nothing> timedout =
+    after(timeout.getOrElse(Duration::max()));
+
+  // Start responding once all values are ready or we time out.
+  return select<Nothing>({
+      timedout,
+      await(std::move(values)).then([]{ return Nothing(); }) })
+    .onAny([=]() mutable { timedout.discard(); }) // Don't accumulate timers.
+    .then(defer(self(), &Self::_exposition, exposition));
+}
+
+
+void MetricsProcess::deduplicate(const Owned<Exposition>& exposition)
+{
+  // The names of the samples of an entry, see `encode`.
+  auto samples = [](const Exposition::Entry& entry) -> vector<string> {
+    switch (entry.type) {
+      case Exposition::COUNTER:
+        return {entry.family + "_total"};
+      case Exposition::GAUGE:
+        return {entry.family};
+      case Exposition::SUMMARY:
+        return {entry.family, entry.family + "_count"};
+      case Exposition::HISTOGRAM:
+        return {
+          entry.family + "_bucket",
+          entry.family + "_count",
+          entry.family + "_sum"};
+    }
+
+    UNREACHABLE();
+  };
+
+  // The type of each family, the family of each sample, and the metric
+  // exposed under each family and labels, along with the name of the
+  // metric that came first.
+  hashmap<string, std::pair<Exposition::Type, string>> types;
+  hashmap<string, std::pair<string, string>> families;
+  hashmap<string, string> series;
+
+  vector<Exposition::Entry> entries;
+  entries.reserve(exposition->entries.size());
+
+  foreach (Exposition::Entry& entry, exposition->entries) {
+    const string key = entry.family + "{" + entry.labels + "}";
+
+    Option<string> collision = None();
+
+    if (types.contains(entry.family) &&
+        types.at(entry.family).first != entry.type) {
+      collision = "metric '" + types.at(entry.family).second + "' of a"
+                  " different type in metric family '" + entry.family + "'";
+    } else if (series.contains(key)) {
+      collision = "metric '" + series.at(key) + "' as '" + key + "'";
+    } else {
+      foreach (const string& sample, samples(entry)) {
+        if (families.contains(sample) &&
+            families.at(sample).first != entry.family) {
+          collision = "metric '" + families.at(sample).second +
+                      "' as sample '" + sample + "'";
+          break;
+        }
+      }
+    }
+
+    if (collision.isSome()) {
+      // Different names can become the same metric family once
+      // sanitized (e.g., "allocator/mesos/roles/a/b/shares/dominant"
+      // and "allocator/mesos/roles/a_b/shares/dominant"), or the same
+      // samples once suffixed (e.g., the counter "a" and the gauge
+      // "a_total"), which would make the exposition invalid. We keep
+      // the first such entry in the sort order.
+      if (!colliding.contains(entry.name)) {
+        LOG(WARNING) << "Not exposing metric '" << entry.name << "' in the"
+                     << " OpenMetrics format as it collides with "
+                     << collision.get();
+
+        colliding.insert(entry.name);
+      }
+
+      continue;
+    }
+
+    types.emplace(entry.family, std::make_pair(entry.type, entry.name));
+    series.emplace(key, entry.name);
+
+    foreach (const string& sample, samples(entry)) {
+      families.emplace(sample, std::make_pair(entry.family, entry.name));
+    }
+
+    entries.push_back(std::move(entry));
+  }
+
+  exposition->entries = std::move(entries);
+}
+
+
+http::Response MetricsProcess::_exposition(const Owned<Exposition>& exposition)
+{
+  http::Pipe pipe;
+
+  http::OK response;
+  response.type = http::Response::PIPE;
+  response.reader = pipe.reader();
+  response.headers["Content-Type"] =
+    "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+  encode(exposition, pipe.writer());
+
+  return response;
+}
+
+
+void MetricsProcess::encode(
+    const Owned<Exposition>& exposition,
+    http::Pipe::Writer writer)
+{
+  string chunk;
+
+  while (exposition->next < exposition->entries.size() &&
+         chunk.size() < EXPOSITION_CHUNK_SIZE) {
+    const Exposition::Entry& entry =
+      exposition->entries[exposition->next++];
+
+    // Counters and gauges without a value get skipped entirely, as
+    // they are in snapshots.
+    Option<Sample> value_ = None();
+
+    if (entry.type == Exposition::COUNTER ||
+        entry.type == Exposition::GAUGE) {
+      value_ = value(entry.name, entry.value, exposition->timeout);
+
+      if (value_.isNone()) {
+        continue;
+      }
+    }
+
+    if (entry.family != exposition->family) {
+      exposition->family = entry.family;
+
+      chunk += "# TYPE " + entry.family + " ";
+
+      switch (entry.type) {
+        case Exposition::COUNTER:   chunk += "counter\n"; break;
+        case Exposition::GAUGE:     chunk += "gauge\n"; break;
+        case Exposition::SUMMARY:   chunk += "summary\n"; break;
+        case Exposition::HISTOGRAM: chunk += "histogram\n"; break;
+      }
+    }
+
+    switch (entry.type) {
+      case Exposition::COUNTER: {
+        sample(
+            &chunk,
+            entry.family + "_total",
+            entry.labels,
+            "",
+            value_->value,
+            value_->stale);
+        break;
+      }
+      case Exposition::GAUGE: {
+        sample(
+            &chunk,
+            entry.family,
+            entry.labels,
+            "",
+            value_->value,
+            value_->stale);
+        break;
+      }
+      case Exposition::SUMMARY: {
+        const Statistics<double>& statistics = entry.statistics.get();
+
+        const std::vector<std::pair<string, double>> quantiles = {
+          {"0", statistics.min},
+          {"0.5", statistics.p50},
+          {"0.9", statistics.p90},
+          {"0.95", statistics.p95},
+          {"0.99", statistics.p99},
+          {"0.999", statistics.p999},
+          {"0.9999", statistics.p9999},
+          {"1", statistics.max},
+        };
+
+        foreachpair (const string& quantile, double estimate, quantiles) {
+          sample(
+              &chunk,
+              entry.family,
+              entry.labels,
+              "quantile=\"" + quantile + "\"",
+              estimate);
+        }
+
+        sample(
+            &chunk,
+            entry.family + "_count",
+            entry.labels,
+            "",
+            static_cast<double>(statistics.count));
+        break;
+      }
+      case Exposition::HISTOGRAM: {
+        for (size_t i = 0; i < entry.bounds.size(); i++) {
+          sample(
+              &chunk,
+              entry.family + "_bucket",
+              entry.labels,
+              "le=\"" + format(entry.bounds[i]) + "\"",
+              static_cast<double>(entry.counts[i]));
+        }
+
+        sample(
+            &chunk,
+            entry.family + "_bucket",
+            entry.labels,
+            "le=\"+Inf\"",
+            static_cast<double>(entry.count));
+
+        sample(
+            &chunk,
+            entry.family + "_count",
+            entry.labels,
+            "",
+            static_cast<double>(entry.count));
+
+        sample(&chunk, entry.family + "_sum", entry.labels, "", entry.sum);
+        break;
+      }
+    }
+  }
+
+  const bool done = exposition->next == exposition->entries.size();
+
+  if (done) {
+    chunk += "# EOF\n";
+  }
+
+  // Stop encoding if the client went away.
+  if (!writer.write(std::move(chunk))) {
+    return;
+  }
+
+  if (done) {
+    writer.close();
+    return;
+  }
+
+  dispatch(self(), &Self::encode, exposition, writer);
+}
+
+
+Option<MetricsProcess::Sample> MetricsProcess::value(
+    const string& name,
+    const Future<double>& value,
+    const Option<Duration>& timeout)
+{
+  // TODO(dhamon): Maybe add the failure message for this metric to the
+  // response if value.isFailed().
+  if (value.isPending()) {
+    CHECK_SOME(timeout);
+    VLOG(1) << "Exceeded timeout of " << timeout.get()
+            << " when attempting to get metric '" << name << "'";
+
+    // NOTE: The metric might have been removed in the meantime.
+    if (cache.contains(name) && metrics.contains(name)) {
+      const std::pair<double, Time>& cached = cache.at(name);
+      return Sample{cached.first, cached.second};
+    }
+  } else if (value.isReady()) {
+    if (metrics.contains(name)) {
+      cache[name] = std::make_pair(value.get(), Clock::now());
+    }
+
+    return Sample{value.get(), None()};
+  }
+
+  return None();
+}
+
 }  // namespace internal {
 
 }  // namespace metrics {
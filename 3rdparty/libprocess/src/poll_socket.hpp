@@ -11,6 +11,7 @@
 // limitations under the License
 
 #include <memory>
+#include <vector>
 
 #include <process/socket.hpp>
 
@@ -35,6 +36,7 @@ public:
   virtual Future<Nothing> connect(const Address& address);
   virtual Future<size_t> recv(char* data, size_t size);
   virtual Future<size_t> send(const char* data, size_t size);
+  virtual Future<size_t> send(const std::vector<Buffer>& buffers);
   virtual Future<size_t> sendfile(int_fd fd, off_t offset, size_t size);
   virtual Kind kind() const { return SocketImpl::Kind::POLL; }
 };
@@ -26,6 +26,10 @@
 
 #include "io_internal.hpp"
 
+#ifdef ENABLE_IO_URING
+#include "posix/io_uring/io_uring.hpp"
+#endif // ENABLE_IO_URING
+
 namespace process {
 namespace io {
 namespace internal {
@@ -38,6 +42,12 @@ Future<size_t> read(int_fd fd, void* data, size_t size)
     return 0;
   }
 
+#ifdef ENABLE_IO_URING
+  if (io_uring::enabled()) {
+    return io_uring::read(fd, data, size);
+  }
+#endif // ENABLE_IO_URING
+
   return loop(
       None(),
       [=]() -> Future<Option<size_t>> {
@@ -88,6 +98,12 @@ Future<size_t> write(int_fd fd, const void* data, size_t size)
     return 0;
   }
 
+#ifdef ENABLE_IO_URING
+  if (io_uring::enabled()) {
+    return io_uring::write(fd, data, size);
+  }
+#endif // ENABLE_IO_URING
+
   return loop(
       None(),
       [=]() -> Future<Option<size_t>> {
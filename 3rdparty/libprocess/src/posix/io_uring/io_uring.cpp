@@ -0,0 +1,714 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <endian.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <ev.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <process/future.hpp>
+#include <process/io.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/lambda.hpp>
+#include <stout/none.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/stringify.hpp>
+#include <stout/synchronized.hpp>
+#include <stout/try.hpp>
+
+#include <stout/os/getenv.hpp>
+#include <stout/os/strerror.hpp>
+
+#include "posix/io_uring/io_uring.hpp"
+#include "posix/libev/libev.hpp"
+
+using std::string;
+using std::vector;
+
+namespace process {
+namespace io_uring {
+
+// Number of entries of the submission queue, the completion queue has
+// twice as many. More operations can be in flight, since we submit
+// whenever the submission queue is full and the kernel buffers the
+// completions which do not fit in the completion queue (we require
+// `IORING_FEAT_NODROP`).
+static const unsigned ENTRIES = 1024;
+
+
+// The memory shared with the kernel, see io_uring(7).
+struct Ring
+{
+  ~Ring()
+  {
+    if (sqes != MAP_FAILED) {
+      ::munmap(sqes, sqesSize);
+    }
+
+    if (cq != MAP_FAILED && cq != sq) {
+      ::munmap(cq, cqSize);
+    }
+
+    if (sq != MAP_FAILED) {
+      ::munmap(sq, sqSize);
+    }
+
+    if (eventfd >= 0) {
+      ::close(eventfd);
+    }
+
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  int fd = -1;
+
+  // Gets signaled by the kernel for each completion.
+  int eventfd = -1;
+
+  void* sq = MAP_FAILED;
+  size_t sqSize = 0;
+
+  void* cq = MAP_FAILED;
+  size_t cqSize = 0;
+
+  struct io_uring_sqe* sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+  size_t sqesSize = 0;
+
+  unsigned* sqHead = nullptr;
+  unsigned* sqTail = nullptr;
+  unsigned* sqMask = nullptr;
+  unsigned* sqEntries = nullptr;
+  unsigned* sqFlags = nullptr;
+  unsigned* sqArray = nullptr;
+
+  unsigned* cqHead = nullptr;
+  unsigned* cqTail = nullptr;
+  unsigned* cqMask = nullptr;
+  struct io_uring_cqe* cqes = nullptr;
+};
+
+
+// An operation which has been submitted (or is about to be submitted)
+// to the kernel. The kernel may access the iovecs and the message
+// header until the operation completes.
+struct Operation
+{
+  Operation(uint8_t opcode, int_fd fd) : id(ids.fetch_add(1))
+  {
+    memset(&sqe, 0, sizeof(sqe));
+    memset(&message, 0, sizeof(message));
+
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = id;
+  }
+
+  // Identifies the operation in the completion queue. We use 0 for
+  // cancellations, whose completions we ignore.
+  const uint64_t id;
+
+  struct io_uring_sqe sqe;
+
+  vector<struct iovec> iov;
+  struct msghdr message;
+
+  Promise<int32_t> promise;
+
+  static std::atomic<uint64_t> ids;
+};
+
+
+std::atomic<uint64_t> Operation::ids(1);
+
+
+// Set up by `initialize` (if successful) before the event loop starts.
+static Ring* ring = nullptr;
+
+// Whether the ring should not be used, see `initialize`.
+static bool disabled = false;
+
+// Wakes up the event loop to submit operations from other threads.
+static ev_async submit_watcher;
+
+// Submits the operations before the event loop blocks.
+static ev_prepare prepare_watcher;
+
+// Watches the eventfd signaled for completions.
+static ev_io completion_watcher;
+
+// Operations and cancellations (the ids of the operations to cancel)
+// to be submitted by the event loop.
+static std::mutex* submissions_mutex = new std::mutex();
+static vector<Operation*>* submissions = new vector<Operation*>();
+static vector<uint64_t>* cancellations = new vector<uint64_t>();
+
+// Operations which have been submitted to the kernel but have not yet
+// completed. Only accessed in the event loop.
+static hashmap<uint64_t, Operation*>* operations =
+  new hashmap<uint64_t, Operation*>();
+
+
+static unsigned load(const unsigned* value)
+{
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+
+static void store(unsigned* value, unsigned v)
+{
+  __atomic_store_n(value, v, __ATOMIC_RELEASE);
+}
+
+
+static int enter(unsigned submit, unsigned flags)
+{
+  return ::syscall(
+      __NR_io_uring_enter, ring->fd, submit, 0, flags, nullptr, 0);
+}
+
+
+static void reap()
+{
+  while (true) {
+    unsigned head = *ring->cqHead;
+
+    if (head == load(ring->cqTail)) {
+      // The kernel buffers the completions which do not fit in the
+      // completion queue, we need to ask it to flush them.
+      if ((load(ring->sqFlags) & IORING_SQ_CQ_OVERFLOW) != 0) {
+        enter(0, IORING_ENTER_GETEVENTS);
+
+        if (head != load(ring->cqTail)) {
+          continue;
+        }
+      }
+
+      break;
+    }
+
+    const struct io_uring_cqe cqe = ring->cqes[head & *ring->cqMask];
+
+    store(ring->cqHead, head + 1);
+
+    if (cqe.user_data == 0) {
+      continue; // A cancellation.
+    }
+
+    Option<Operation*> operation = operations->get(cqe.user_data);
+    CHECK_SOME(operation);
+
+    operations->erase(cqe.user_data);
+
+    // NOTE: Completing the operation may run arbitrary callbacks which
+    // may submit (but not flush) more operations.
+    if (cqe.res == -ECANCELED) {
+      operation.get()->promise.discard();
+    } else {
+      operation.get()->promise.set(cqe.res);
+    }
+
+    delete operation.get();
+  }
+}
+
+
+// Submits the queued entries of the submission queue.
+static void submitEntries()
+{
+  while (true) {
+    const unsigned pending = *ring->sqTail - load(ring->sqHead);
+
+    if (pending == 0) {
+      return;
+    }
+
+    int result = enter(pending, 0);
+
+    if (result < 0 && errno == EINTR) {
+      continue;
+    } else if ((result < 0 && (errno == EAGAIN || errno == EBUSY)) ||
+               result == 0) {
+      // The kernel is out of resources for new operations (e.g., the
+      // completion queue is full), make room and try again.
+      reap();
+      continue;
+    } else if (result < 0) {
+      LOG(FATAL) << "Failed to submit to io_uring: " << os::strerror(errno);
+    }
+  }
+}
+
+
+// Returns the next free entry of the submission queue, submitting the
+// queued entries first if the queue is full. The entry gets queued
+// with `push`.
+static struct io_uring_sqe* next()
+{
+  if (*ring->sqTail - load(ring->sqHead) == *ring->sqEntries) {
+    submitEntries();
+  }
+
+  return &ring->sqes[*ring->sqTail & *ring->sqMask];
+}
+
+
+static void push()
+{
+  const unsigned tail = *ring->sqTail;
+
+  ring->sqArray[tail & *ring->sqMask] = tail & *ring->sqMask;
+
+  store(ring->sqTail, tail + 1);
+}
+
+
+// Submits all operations and cancellations to the kernel with (unless
+// the submission queue fills up) a single system call.
+static void flush()
+{
+  vector<Operation*> submitted;
+  vector<uint64_t> canceled;
+
+  synchronized (submissions_mutex) {
+    std::swap(submitted, *submissions);
+    std::swap(canceled, *cancellations);
+  }
+
+  if (submitted.empty() && canceled.empty()) {
+    return;
+  }
+
+  foreach (Operation* operation, submitted) {
+    *next() = operation->sqe;
+    push();
+
+    operations->put(operation->id, operation);
+  }
+
+  foreach (uint64_t id, canceled) {
+    // The operation might have already completed.
+    if (!operations->contains(id)) {
+      continue;
+    }
+
+    struct io_uring_sqe* sqe = next();
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = id;
+    sqe->user_data = 0;
+
+    push();
+  }
+
+  submitEntries();
+}
+
+
+static void submitted(struct ev_loop* loop, ev_async* watcher, int revents)
+{
+  flush();
+}
+
+
+static void prepared(struct ev_loop* loop, ev_prepare* watcher, int revents)
+{
+  flush();
+}
+
+
+static void completed(struct ev_loop* loop, ev_io* watcher, int revents)
+{
+  // Reset the eventfd before reaping so that we get signaled for any
+  // completion we miss.
+  uint64_t count;
+  ssize_t length = ::read(ring->eventfd, &count, sizeof(count));
+  (void) length;
+
+  reap();
+}
+
+
+static void wakeup()
+{
+  // The prepare watcher flushes before the event loop blocks again.
+  if (!__in_event_loop__) {
+    ev_async_send(loop, &submit_watcher);
+  }
+}
+
+
+static void cancel(uint64_t id)
+{
+  synchronized (submissions_mutex) {
+    cancellations->push_back(id);
+  }
+
+  wakeup();
+}
+
+
+// Returns the result of the operation, i.e., the number of bytes or
+// the events for successful operations and a negated errno otherwise.
+static Future<int32_t> submit(Operation* operation)
+{
+  Future<int32_t> future = operation->promise.future();
+
+  future.onDiscard(lambda::bind(&cancel, operation->id));
+
+  synchronized (submissions_mutex) {
+    submissions->push_back(operation);
+  }
+
+  wakeup();
+
+  return future;
+}
+
+
+// Performs the operation created by `f`, retrying if it gets
+// interrupted and polling for the given events first if the file
+// descriptor is not ready (which the kernel does not poll for itself
+// for all kinds of file descriptors).
+//
+// NOTE: We can not use `process::loop` here since it clashes with the
+// libev `loop`, but retries are rare.
+static Future<size_t> perform(
+    int_fd fd,
+    short events,
+    const lambda::function<Operation*()>& f)
+{
+  return submit(f())
+    .then([fd, events, f](int32_t result) -> Future<size_t> {
+      if (result >= 0) {
+        return static_cast<size_t>(result);
+      } else if (result == -EINTR) {
+        return perform(fd, events, f);
+      } else if (result == -EAGAIN || result == -EWOULDBLOCK) {
+        return io_uring::poll(fd, events)
+          .then([fd, events, f]() {
+            return perform(fd, events, f);
+          });
+      }
+
+      return Failure(os::strerror(-result));
+    });
+}
+
+
+static Try<Nothing> setup(Ring* ring)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  ring->fd = ::syscall(__NR_io_uring_setup, ENTRIES, &params);
+  if (ring->fd < 0) {
+    return ErrnoError("Failed to create io_uring");
+  }
+
+  if ((params.features & IORING_FEAT_NODROP) == 0) {
+    return Error("Kernel does not support IORING_FEAT_NODROP");
+  }
+
+  // Check that the kernel supports all the operations we use.
+  const size_t size =
+    sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+
+  std::unique_ptr<char[]> buffer(new char[size]());
+
+  struct io_uring_probe* probe =
+    reinterpret_cast<struct io_uring_probe*>(buffer.get());
+
+  if (::syscall(
+          __NR_io_uring_register,
+          ring->fd,
+          IORING_REGISTER_PROBE,
+          probe,
+          256) < 0) {
+    return ErrnoError("Failed to probe io_uring operations");
+  }
+
+  foreach (uint8_t opcode, vector<uint8_t>({
+               IORING_OP_POLL_ADD,
+               IORING_OP_ASYNC_CANCEL,
+               IORING_OP_READ,
+               IORING_OP_WRITE,
+               IORING_OP_SEND,
+               IORING_OP_SENDMSG})) {
+    if (opcode > probe->last_op ||
+        (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) == 0) {
+      return Error(
+          "Kernel does not support io_uring operation " + stringify(opcode));
+    }
+  }
+
+  ring->sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cqSize =
+    params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    ring->sqSize = ring->cqSize = std::max(ring->sqSize, ring->cqSize);
+  }
+
+  ring->sq = ::mmap(
+      nullptr,
+      ring->sqSize,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      ring->fd,
+      IORING_OFF_SQ_RING);
+
+  if (ring->sq == MAP_FAILED) {
+    return ErrnoError("Failed to map io_uring submission queue");
+  }
+
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    ring->cq = ring->sq;
+  } else {
+    ring->cq = ::mmap(
+        nullptr,
+        ring->cqSize,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring->fd,
+        IORING_OFF_CQ_RING);
+
+    if (ring->cq == MAP_FAILED) {
+      return ErrnoError("Failed to map io_uring completion queue");
+    }
+  }
+
+  ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = static_cast<struct io_uring_sqe*>(::mmap(
+      nullptr,
+      ring->sqesSize,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      ring->fd,
+      IORING_OFF_SQES));
+
+  if (ring->sqes == MAP_FAILED) {
+    return ErrnoError("Failed to map io_uring submission queue entries");
+  }
+
+  char* sq = static_cast<char*>(ring->sq);
+  ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  ring->sqEntries =
+    reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+  ring->sqFlags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+  ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+  char* cq = static_cast<char*>(ring->cq);
+  ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  ring->cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  ring->eventfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ring->eventfd < 0) {
+    return ErrnoError("Failed to create eventfd");
+  }
+
+  if (::syscall(
+          __NR_io_uring_register,
+          ring->fd,
+          IORING_REGISTER_EVENTFD,
+          &ring->eventfd,
+          1) < 0) {
+    return ErrnoError("Failed to register eventfd with io_uring");
+  }
+
+  return Nothing();
+}
+
+
+void initialize()
+{
+  // NOTE: This gets called again when libprocess gets reinitialized
+  // (see `process::reinitialize`). We then keep the ring, since there
+  // might still be operations in flight, but we might stop using it.
+  const Option<string> value = os::getenv("LIBPROCESS_IO_URING");
+
+  disabled = value.isSome() && (value.get() == "false" || value.get() == "0");
+
+  if (disabled) {
+    LOG(INFO) << "Not using io_uring for I/O: disabled by LIBPROCESS_IO_URING";
+    return;
+  }
+
+  if (ring != nullptr) {
+    return;
+  }
+
+  std::unique_ptr<Ring> created(new Ring());
+
+  Try<Nothing> setup = io_uring::setup(created.get());
+  if (setup.isError()) {
+    LOG(WARNING) << "Not using io_uring for I/O: " << setup.error();
+    return;
+  }
+
+  ring = created.release();
+
+  ev_async_init(&submit_watcher, submitted);
+  ev_prepare_init(&prepare_watcher, prepared);
+  ev_io_init(&completion_watcher, completed, ring->eventfd, EV_READ);
+
+  ev_async_start(loop, &submit_watcher);
+  ev_prepare_start(loop, &prepare_watcher);
+  ev_io_start(loop, &completion_watcher);
+
+  VLOG(1) << "Using io_uring for I/O";
+}
+
+
+bool enabled()
+{
+  return ring != nullptr && !disabled;
+}
+
+
+Future<short> poll(int_fd fd, short events)
+{
+  uint32_t mask = 0;
+
+  if ((events & io::READ) != 0) {
+    mask |= POLLIN;
+  }
+
+  if ((events & io::WRITE) != 0) {
+    mask |= POLLOUT;
+  }
+
+  Operation* operation = new Operation(IORING_OP_POLL_ADD, fd);
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+  mask = (mask << 16) | (mask >> 16);
+#endif // __BYTE_ORDER == __BIG_ENDIAN
+
+  operation->sqe.poll32_events = mask;
+
+  return submit(operation)
+    .then([events](int32_t result) -> Future<short> {
+      if (result < 0) {
+        return Failure(os::strerror(-result));
+      }
+
+      // Like libev, we report errors as readiness for the requested
+      // events so that the subsequent I/O surfaces the error.
+      short revents = 0;
+
+      if ((events & io::READ) != 0 &&
+          (result & (POLLIN | POLLERR | POLLHUP)) != 0) {
+        revents |= io::READ;
+      }
+
+      if ((events & io::WRITE) != 0 &&
+          (result & (POLLOUT | POLLERR | POLLHUP)) != 0) {
+        revents |= io::WRITE;
+      }
+
+      return revents;
+    });
+}
+
+
+// NOTE: The results are 32-bit, so we cap the sizes of the operations
+// (the callers handle short reads and writes).
+static uint32_t length(size_t size)
+{
+  return static_cast<uint32_t>(
+      std::min(size, static_cast<size_t>(INT32_MAX)));
+}
+
+
+Future<size_t> read(int_fd fd, void* data, size_t size)
+{
+  return perform(fd, io::READ, [=]() {
+    Operation* operation = new Operation(IORING_OP_READ, fd);
+    operation->sqe.addr = reinterpret_cast<uint64_t>(data);
+    operation->sqe.len = length(size);
+    operation->sqe.off = static_cast<uint64_t>(-1); // Current position.
+    return operation;
+  });
+}
+
+
+Future<size_t> write(int_fd fd, const void* data, size_t size)
+{
+  return perform(fd, io::WRITE, [=]() {
+    Operation* operation = new Operation(IORING_OP_WRITE, fd);
+    operation->sqe.addr = reinterpret_cast<uint64_t>(data);
+    operation->sqe.len = length(size);
+    operation->sqe.off = static_cast<uint64_t>(-1); // Current position.
+    return operation;
+  });
+}
+
+
+Future<size_t> send(int_fd fd, const void* data, size_t size)
+{
+  return perform(fd, io::WRITE, [=]() {
+    Operation* operation = new Operation(IORING_OP_SEND, fd);
+    operation->sqe.addr = reinterpret_cast<uint64_t>(data);
+    operation->sqe.len = length(size);
+    operation->sqe.msg_flags = MSG_NOSIGNAL;
+    return operation;
+  });
+}
+
+
+Future<size_t> sendmsg(int_fd fd, const vector<struct iovec>& iov)
+{
+  return perform(fd, io::WRITE, [=]() {
+    Operation* operation = new Operation(IORING_OP_SENDMSG, fd);
+    operation->iov = iov;
+    operation->message.msg_iov = operation->iov.data();
+    operation->message.msg_iovlen = operation->iov.size();
+    operation->sqe.addr = reinterpret_cast<uint64_t>(&operation->message);
+    operation->sqe.len = 1;
+    operation->sqe.msg_flags = MSG_NOSIGNAL;
+    return operation;
+  });
+}
+
+} // namespace io_uring {
+} // namespace process {
@@ -0,0 +1,75 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_POSIX_IO_URING_HPP__
+#define __PROCESS_POSIX_IO_URING_HPP__
+
+#include <sys/uio.h>
+
+#include <vector>
+
+#include <process/future.hpp>
+
+#include <stout/os/int_fd.hpp>
+
+namespace process {
+namespace io_uring {
+
+// Completion-based I/O on top of a Linux io_uring which is driven by
+// the (libev) event loop: operations can be submitted from any thread,
+// get submitted to the kernel in batches (with a single system call)
+// each time the event loop is about to block, and get completed in the
+// event loop when the kernel signals completions via an eventfd.
+//
+// Unlike with the readiness-based I/O (see `io::poll`), reading from
+// or writing to a file descriptor which is not ready does not require
+// a system call to find out that it is not ready, followed by a poll,
+// followed by another system call once it is ready.
+//
+// NOTE: If the future of an operation gets discarded, the operation
+// gets canceled, but the future only transitions once the kernel has
+// completed the cancellation (i.e., it might still be satisfied if the
+// operation completed in the meantime). Until then, the kernel may
+// still access the memory of the operation (as it may for a pending
+// `io::read` until its future transitions).
+
+// Sets up the ring. Must be called from `EventLoop::initialize`, after
+// the event loop has been created. If the kernel does not support
+// io_uring (or the operations we use), this logs a warning and the
+// readiness-based I/O gets used instead. The same happens if the
+// `LIBPROCESS_IO_URING` environment variable is set to `false`.
+void initialize();
+
+
+// Returns true if `initialize` succeeded, i.e., if the functions below
+// can be used.
+bool enabled();
+
+
+// Semantics of `io::poll`.
+Future<short> poll(int_fd fd, short events);
+
+
+// Semantics of `io::read` and `io::write` (for a non-zero size).
+Future<size_t> read(int_fd fd, void* data, size_t size);
+Future<size_t> write(int_fd fd, const void* data, size_t size);
+
+
+// Sends on a socket with `MSG_NOSIGNAL`. The memory of the iovecs (but
+// not the vector itself) must stay valid until the future transitions.
+Future<size_t> send(int_fd fd, const void* data, size_t size);
+Future<size_t> sendmsg(int_fd fd, const std::vector<struct iovec>& iov);
+
+} // namespace io_uring {
+} // namespace process {
+
+#endif // __PROCESS_POSIX_IO_URING_HPP__
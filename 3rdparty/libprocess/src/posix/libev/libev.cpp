@@ -22,6 +22,10 @@
 #include "event_loop.hpp"
 #include "libev.hpp"
 
+#ifdef ENABLE_IO_URING
+#include "posix/io_uring/io_uring.hpp"
+#endif // ENABLE_IO_URING
+
 namespace process {
 
 ev_async async_watcher;
@@ -88,6 +92,10 @@ void EventLoop::initialize()
 
   ev_async_start(loop, &async_watcher);
   ev_async_start(loop, &shutdown_watcher);
+
+#ifdef ENABLE_IO_URING
+  io_uring::initialize();
+#endif // ENABLE_IO_URING
 }
 
 
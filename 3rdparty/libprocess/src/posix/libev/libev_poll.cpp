@@ -21,6 +21,10 @@
 
 #include "libev.hpp"
 
+#ifdef ENABLE_IO_URING
+#include "posix/io_uring/io_uring.hpp"
+#endif // ENABLE_IO_URING
+
 namespace process {
 
 // Data necessary for polling so we can discard polling and actually
@@ -135,6 +139,12 @@ Future<short> poll(int_fd fd, short events)
 
   // TODO(benh): Check if the file descriptor is non-blocking?
 
+#ifdef ENABLE_IO_URING
+  if (io_uring::enabled()) {
+    return io_uring::poll(fd, events);
+  }
+#endif // ENABLE_IO_URING
+
   return run_in_event_loop<short>(lambda::bind(&internal::poll, fd, events));
 }
 
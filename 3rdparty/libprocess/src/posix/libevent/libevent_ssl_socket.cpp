@@ -20,11 +20,14 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
+#include <vector>
+
 #include <process/queue.hpp>
 #include <process/socket.hpp>
 
 #include <process/ssl/flags.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/net.hpp>
 #include <stout/synchronized.hpp>
 
@@ -69,6 +72,7 @@
 
 using std::queue;
 using std::string;
+using std::vector;
 
 // Specialization of 'synchronize' to use bufferevent with the
 // 'synchronized' macro.
@@ -784,6 +788,74 @@ Future<size_t> LibeventSSLSocketImpl::send(const char* data, size_t size)
 }
 
 
+Future<size_t> LibeventSSLSocketImpl::send(const vector<Buffer>& buffers)
+{
+  // Since the data gets copied into an evbuffer anyway (see the
+  // `send` above), we can gather all of the buffers into a single
+  // evbuffer and write it to the bufferevent at once, rather than
+  // sending the buffers one at a time via the default implementation.
+  size_t size = 0;
+  foreach (const Buffer& buffer, buffers) {
+    size += buffer.size;
+  }
+
+  CHECK(size > 0);
+
+  // Optimistically construct a 'SendRequest' and future.
+  Owned<SendRequest> request(new SendRequest(size));
+  Future<size_t> future = request->promise.future();
+
+  // See `send` above for why there is no 'onDiscard' continuation.
+
+  // Assign 'send_request' under lock, fail on error.
+  synchronized (lock) {
+    if (send_request.get() != nullptr) {
+      return Failure("Socket is already sending");
+    }
+    std::swap(request, send_request);
+  }
+
+  evbuffer* buffer = CHECK_NOTNULL(evbuffer_new());
+
+  foreach (const Buffer& data, buffers) {
+    if (data.size > 0) {
+      int result = evbuffer_add(buffer, data.data, data.size);
+      CHECK_EQ(0, result);
+    }
+  }
+
+  // Extend the life-time of 'this' through the execution of the
+  // lambda in the event loop, see `send` above.
+  auto self = shared(this);
+
+  run_in_event_loop(
+      [self, buffer]() {
+        CHECK(__in_event_loop__);
+        CHECK(self);
+
+        // Check if the socket is closed or the write end has
+        // encountered an error in the interim.
+        bool write = false;
+
+        synchronized (self->lock) {
+          if (self->send_request.get() != nullptr) {
+            write = true;
+          }
+        }
+
+        if (write) {
+          int result = bufferevent_write_buffer(self->bev, buffer);
+          CHECK_EQ(0, result);
+        }
+
+        evbuffer_free(buffer);
+      },
+      DISALLOW_SHORT_CIRCUIT);
+
+  return future;
+}
+
+
 Future<size_t> LibeventSSLSocketImpl::sendfile(
     int_fd fd,
     off_t offset,
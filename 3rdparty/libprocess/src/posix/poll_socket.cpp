@@ -14,9 +14,16 @@
 #ifdef __WINDOWS__
 #include <stout/windows.hpp>
 #else
+#include <limits.h>
+
 #include <netinet/tcp.h>
+
+#include <sys/uio.h>
 #endif // __WINDOWS__
 
+#include <algorithm>
+#include <vector>
+
 #include <process/io.hpp>
 #include <process/loop.hpp>
 #include <process/network.hpp>
@@ -29,7 +36,12 @@
 #include "config.hpp"
 #include "poll_socket.hpp"
 
+#ifdef ENABLE_IO_URING
+#include "posix/io_uring/io_uring.hpp"
+#endif // ENABLE_IO_URING
+
 using std::string;
+using std::vector;
 
 namespace process {
 namespace network {
@@ -181,6 +193,15 @@ Future<size_t> PollSocketImpl::send(const char* data, size_t size)
   // doesn't end up getting reused before we return.
   auto self = shared(this);
 
+#ifdef ENABLE_IO_URING
+  if (io_uring::enabled()) {
+    return io_uring::send(get(), data, size)
+      .then([self](size_t length) {
+        return length;
+      });
+  }
+#endif // ENABLE_IO_URING
+
   // TODO(benh): Reuse `io::write`? Or is `net::send` and
   // `MSG_NOSIGNAL` critical here?
   return loop(
@@ -226,6 +247,84 @@ Future<size_t> PollSocketImpl::send(const char* data, size_t size)
 }
 
 
+Future<size_t> PollSocketImpl::send(const vector<Buffer>& buffers)
+{
+#ifdef __WINDOWS__
+  // NOTE: On Windows we send the buffers one at a time.
+  return SocketImpl::send(buffers);
+#else
+  vector<struct iovec> iov;
+  iov.reserve(std::min(buffers.size(), static_cast<size_t>(IOV_MAX)));
+
+  foreach (const Buffer& buffer, buffers) {
+    if (iov.size() == IOV_MAX) {
+      break;
+    }
+
+    if (buffer.size > 0) {
+      iov.push_back({const_cast<char*>(buffer.data), buffer.size});
+    }
+  }
+
+  CHECK(!iov.empty());
+
+  // Need to hold a copy of `this` so that the underlying socket
+  // doesn't end up getting reused before we return.
+  auto self = shared(this);
+
+#ifdef ENABLE_IO_URING
+  if (io_uring::enabled()) {
+    return io_uring::sendmsg(get(), iov)
+      .then([self](size_t length) {
+        return length;
+      });
+  }
+#endif // ENABLE_IO_URING
+
+  // NOTE: We use `sendmsg` rather than `writev` since we need to pass
+  // `MSG_NOSIGNAL`, like `send` above.
+  return loop(
+      None(),
+      [self, iov]() -> Future<Option<size_t>> {
+        struct msghdr message = {};
+        message.msg_iov = const_cast<struct iovec*>(iov.data());
+        message.msg_iovlen = iov.size();
+
+        while (true) {
+          ssize_t length = ::sendmsg(self->get(), &message, MSG_NOSIGNAL);
+
+          if (length < 0) {
+            int error = errno;
+
+            if (net::is_restartable_error(error)) {
+              // Interrupted, try again now.
+              continue;
+            } else if (!net::is_retryable_error(error)) {
+              VLOG(1) << "Socket error while sending: " << os::strerror(error);
+              return Failure(os::strerror(error));
+            }
+
+            return None();
+          }
+
+          return length;
+        }
+      },
+      [self](const Option<size_t>& length) -> Future<ControlFlow<size_t>> {
+        // Retry after we've polled if we don't yet have a result.
+        if (length.isNone()) {
+          return io::poll(self->get(), io::WRITE)
+            .then([](short event) -> ControlFlow<size_t> {
+              CHECK_EQ(io::WRITE, event);
+              return Continue();
+            });
+        }
+        return Break(length.get());
+      });
+#endif // __WINDOWS__
+}
+
+
 Future<size_t> PollSocketImpl::sendfile(int_fd fd, off_t offset, size_t size)
 {
   CHECK(size > 0); // TODO(benh): Just return 0 if `size` is 0?
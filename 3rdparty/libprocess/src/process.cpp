@@ -43,6 +43,7 @@
 #endif // __WINDOWS__
 
 #include <algorithm>
+#include <chrono>
 #include <deque>
 #include <fstream>
 #include <iomanip>
@@ -94,6 +95,7 @@
 #include <process/windows/jobobject.hpp>
 #endif // __WINDOWS__
 
+#include <stout/bytes.hpp>
 #include <stout/duration.hpp>
 #include <stout/error.hpp>
 #include <stout/flags.hpp>
@@ -105,6 +107,7 @@
 #include <stout/os.hpp>
 #include <stout/os/strerror.hpp>
 #include <stout/path.hpp>
+#include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
 #include <stout/strings.hpp>
 #include <stout/synchronized.hpp>
@@ -119,6 +122,7 @@
 #include "http_proxy.hpp"
 #include "memory_profiler.hpp"
 #include "process_reference.hpp"
+#include "process_statistics.hpp"
 #include "socket_manager.hpp"
 #include "run_queue.hpp"
 
@@ -257,6 +261,44 @@ struct Flags : public virtual flags::FlagsBase
         "If set to false, disables the memory profiling functionality\n"
         "of libprocess.",
         false);
+
+    add(&Flags::resume_event_budget,
+        "resume_event_budget",
+        "The maximum number of events a worker thread serves to a process\n"
+        "before putting it back in the run queue, so that a process with a\n"
+        "large backlog of events does not monopolize a worker thread.\n"
+        "If not set, a process is run until it has no more events.",
+        [](const Option<size_t>& value) -> Option<Error> {
+          if (value.isSome() && value.get() == 0) {
+            return Error("Expected a positive number of events");
+          }
+          return None();
+        });
+
+    add(&Flags::resume_time_budget,
+        "resume_time_budget",
+        "The amount of time after which a worker thread puts a process\n"
+        "back in the run queue rather than serving it more events. This\n"
+        "is checked between batches of events, so a process may exceed\n"
+        "it by the time needed to serve a batch of events.\n"
+        "If not set, a process is run until it has no more events.");
+
+    add(&Flags::message_coalescing_budget,
+        "message_coalescing_budget",
+        "If set, the messages queued for sending on a persistent link get\n"
+        "coalesced, i.e., sent together with as few writes as possible, up\n"
+        "to this many bytes at a time. This does not delay any messages,\n"
+        "only messages which got queued while the previous messages were\n"
+        "being sent get coalesced.");
+
+    add(&Flags::process_metrics,
+        "process_metrics",
+        "A comma-separated list of process ID prefixes, e.g.,\n"
+        "`master,hierarchical-allocator`. The statistics of the processes\n"
+        "whose IDs match one of them (e.g., the number of events served\n"
+        "and the time spent serving them) get exposed as metrics under\n"
+        "`process/<id>/`. The statistics of all processes are available\n"
+        "via the `/__process_stats__` endpoint.");
   }
 
   Option<net::IP> ip;
@@ -266,6 +308,10 @@ struct Flags : public virtual flags::FlagsBase
   Option<int> advertise_port;
   bool require_peer_address_ip_match;
   bool memory_profiling;
+  Option<size_t> resume_event_budget;
+  Option<Duration> resume_time_budget;
+  Option<Bytes> message_coalescing_budget;
+  Option<std::string> process_metrics;
 };
 
 } // namespace internal {
@@ -405,6 +451,9 @@ public:
   // The /__processes__ route.
   Future<Response> __processes__(const Request&);
 
+  // The /__process_stats__ route.
+  Future<Response> __process_stats__(const Request& request);
+
   void install(Filter* f)
   {
     // NOTE: even though `filter` is atomic we still need to
@@ -473,6 +522,9 @@ static std::atomic_bool initialize_complete(false);
 // Server socket listen backlog.
 static const int LISTEN_BACKLOG = 500000;
 
+// Maximum number of events dequeued at once when resuming a process.
+static const size_t EVENT_BATCH_SIZE = 32;
+
 // Local server socket.
 static Socket* __s__ = nullptr;
 
@@ -520,6 +572,9 @@ static std::mutex* authorization_callbacks_mutex = new std::mutex();
 // Global route that returns process information.
 static Route* processes_route = nullptr;
 
+// Global route that returns process statistics.
+static Route* process_stats_route = nullptr;
+
 // Global help.
 PID<Help> help;
 
@@ -1198,6 +1253,10 @@ bool initialize(
       metrics::internal::MetricsProcess::create(readonlyAuthenticationRealm),
       true);
 
+  // Add the metrics of the global socket manager.
+  metrics::add(socket_manager->metrics.messages_sent);
+  metrics::add(socket_manager->metrics.message_writes);
+
   // Create the global logging process.
   _logging = spawn(new Logging(readwriteAuthenticationRealm), true);
 
@@ -1235,6 +1294,14 @@ bool initialize(
 
   processes_route = new Route("/__processes__", None(), __processes__);
 
+  // Add a route for getting process statistics.
+  lambda::function<Future<Response>(const Request&)> __process_stats__ =
+    lambda::bind(
+        &ProcessManager::__process_stats__, process_manager, lambda::_1);
+
+  process_stats_route =
+    new Route("/__process_stats__", None(), __process_stats__);
+
   VLOG(1) << "libprocess is initialized on " << address() << " with "
           << num_worker_threads << " worker threads";
 
@@ -1259,6 +1326,9 @@ void finalize(bool finalize_wsa)
   delete processes_route;
   processes_route = nullptr;
 
+  delete process_stats_route;
+  process_stats_route = nullptr;
+
   // Close the server socket.
   // This will prevent any further connections managed by the `SocketManager`.
   synchronized (socket_mutex) {
@@ -1277,6 +1347,10 @@ void finalize(bool finalize_wsa)
   // libprocess should be single-threaded.
   process_manager->finalize();
 
+  // The metrics process got terminated above, reset its PID so that
+  // processes spawned while reinitializing don't add metrics to it.
+  metrics::internal::metrics = PID<metrics::internal::MetricsProcess>();
+
   // Now that all threads except for the main thread have joined, we should
   // delete the one remaining `_executor_` pointer.
   delete _executor_;
@@ -1786,6 +1860,12 @@ Future<Nothing> _send(Encoder* encoder, Socket socket)
             send = socket.sendfile(fd, offset, size);
             break;
           }
+          case Encoder::MESSAGE: {
+            send = socket.send(
+                static_cast<MessageEncoder*>(encoder)->next(&size));
+            ++socket_manager->metrics.message_writes;
+            break;
+          }
         }
 
         return send
@@ -1802,6 +1882,11 @@ Future<Nothing> _send(Encoder* encoder, Socket socket)
       },
       [=](Nothing) -> ControlFlow<Nothing> {
         if (encoder->remaining() == 0) {
+          if (encoder->kind() == Encoder::MESSAGE) {
+            socket_manager->metrics.messages_sent +=
+              static_cast<MessageEncoder*>(encoder)->messages();
+          }
+
           delete encoder;
           return Break();
         }
@@ -1929,7 +2014,7 @@ void SocketManager::send_connect(
     return;
   }
 
-  Encoder* encoder = new MessageEncoder(message);
+  Encoder* encoder = new MessageEncoder(std::move(message));
 
   // Receive and ignore data from this socket. Note that we don't
   // expect to receive anything other than HTTP '202 Accepted'
@@ -1972,7 +2057,7 @@ void SocketManager::send(Message&& message, const SocketImpl::Kind& kind)
       }
 
       if (outgoing.count(socket.get()) > 0) {
-        outgoing[socket.get()].push(new MessageEncoder(message));
+        outgoing[socket.get()].push(new MessageEncoder(std::move(message)));
         return;
       } else {
         // Initialize the outgoing queue.
@@ -2022,7 +2107,7 @@ void SocketManager::send(Message&& message, const SocketImpl::Kind& kind)
   } else {
     // If we're not connecting and we haven't added the encoder to
     // the 'outgoing' queue then schedule it to be sent.
-    internal::send(new MessageEncoder(message), socket.get());
+    internal::send(new MessageEncoder(std::move(message)), socket.get());
   }
 }
 
@@ -2052,6 +2137,33 @@ Encoder* SocketManager::next(int_fd s)
         // More messages!
         Encoder* encoder = outgoing[s].front();
         outgoing[s].pop();
+
+        // Coalesce the messages queued on a persistent link, if enabled,
+        // so that they get sent with fewer writes.
+        const Option<Bytes>& budget =
+          libprocess_flags->message_coalescing_budget;
+
+        Option<Address> address = addresses.get(s);
+
+        if (budget.isSome() &&
+            encoder->kind() == Encoder::MESSAGE &&
+            address.isSome() &&
+            persists.get(address.get()) == s) {
+          MessageEncoder* coalesced = static_cast<MessageEncoder*>(encoder);
+
+          while (!outgoing[s].empty() &&
+                 outgoing[s].front()->kind() == Encoder::MESSAGE &&
+                 coalesced->remaining() + outgoing[s].front()->remaining() <=
+                   budget->bytes()) {
+            MessageEncoder* next =
+              static_cast<MessageEncoder*>(outgoing[s].front());
+            outgoing[s].pop();
+
+            coalesced->append(std::move(*next));
+            delete next;
+          }
+        }
+
         return encoder;
       } else {
         // No more messages ... erase the outgoing queue.
@@ -2788,6 +2900,93 @@ bool ProcessManager::deliver(
 }
 
 
+// Returns the metrics exposing the statistics of the process with the
+// given ID (see the `process_metrics` flag). The gauges only hold weak
+// references to the statistics, so they fail once the process is gone.
+static vector<metrics::PullGauge> statisticsGauges(
+    const string& id,
+    const std::shared_ptr<ProcessStatistics>& statistics)
+{
+  const std::weak_ptr<ProcessStatistics> weak = statistics;
+
+  auto gauge = [&id, &weak](
+      const string& name,
+      const std::function<double(const ProcessStatistics&)>& value) {
+    return metrics::PullGauge(
+        "process/" + id + "/" + name,
+        [weak, value]() -> Future<double> {
+          std::shared_ptr<ProcessStatistics> statistics = weak.lock();
+          if (!statistics) {
+            return Failure("Process has terminated");
+          }
+          return value(*statistics);
+        });
+  };
+
+  vector<metrics::PullGauge> gauges;
+
+  for (size_t type = 0; type < ProcessStatistics::EVENT_TYPES; type++) {
+    gauges.push_back(gauge(
+        "events/" + ProcessStatistics::name(
+            static_cast<ProcessStatistics::EventType>(type)),
+        [type](const ProcessStatistics& statistics) {
+          return statistics.events[type].load(std::memory_order_relaxed);
+        }));
+  }
+
+  gauges.push_back(gauge(
+      "handler_time_ms",
+      [](const ProcessStatistics& statistics) {
+        return statistics.handlerTime.load(std::memory_order_relaxed) / 1e6;
+      }));
+
+  gauges.push_back(gauge(
+      "handler_time_max_ms",
+      [](const ProcessStatistics& statistics) {
+        return statistics.maxHandlerTime.load(std::memory_order_relaxed) / 1e6;
+      }));
+
+  const vector<pair<string, double>> percentiles =
+    {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}};
+
+  foreach (const auto& percentile, percentiles) {
+    const double p = percentile.second;
+
+    gauges.push_back(gauge(
+        "wait_time_us/" + percentile.first,
+        [p](const ProcessStatistics& statistics) {
+          return statistics.waitTime.percentile(p);
+        }));
+
+    gauges.push_back(gauge(
+        "queue_depth/" + percentile.first,
+        [p](const ProcessStatistics& statistics) {
+          return statistics.queueDepth.percentile(p);
+        }));
+  }
+
+  gauges.push_back(gauge(
+      "wait_time_us/max",
+      [](const ProcessStatistics& statistics) {
+        return statistics.waitTime.max();
+      }));
+
+  gauges.push_back(gauge(
+      "queue_depth/max",
+      [](const ProcessStatistics& statistics) {
+        return statistics.queueDepth.max();
+      }));
+
+  gauges.push_back(gauge(
+      "preemptions",
+      [](const ProcessStatistics& statistics) {
+        return statistics.preemptions.load(std::memory_order_relaxed);
+      }));
+
+  return gauges;
+}
+
+
 UPID ProcessManager::spawn(ProcessBase* process, bool manage)
 {
   CHECK_NOTNULL(process);
@@ -2845,6 +3044,30 @@ UPID ProcessManager::spawn(ProcessBase* process, bool manage)
   // (e.g., when 'manage' is set to true).
   UPID pid = process->self();
 
+  // Expose the statistics of the process as metrics if requested. We
+  // do this before enqueueing the process so that we are done with
+  // the gauges before `cleanup` removes them.
+  //
+  // NOTE: This is not possible for the processes spawned before the
+  // metrics process (e.g., `help`) and the metrics process itself,
+  // which is still being spawned at this point.
+  if (libprocess_flags->process_metrics.isSome() &&
+      metrics::internal::metrics.id != "") {
+    foreach (const string& prefix,
+             strings::tokenize(libprocess_flags->process_metrics.get(), ",")) {
+      if (strings::startsWith(pid.id, strings::trim(prefix))) {
+        process->statistics->gauges =
+          statisticsGauges(pid.id, process->statistics);
+
+        foreach (const metrics::PullGauge& gauge,
+                 process->statistics->gauges) {
+          metrics::add(gauge);
+        }
+        break;
+      }
+    }
+  }
+
   // Add process to the run queue (so 'initialize' will get invoked).
   enqueue(process);
 
@@ -2893,15 +3116,59 @@ void ProcessManager::resume(ProcessBase* process)
   // we set the state to BLOCKED (see the comment below).
   ProcessReference reference = process->reference;
 
+  // To avoid a process with a large backlog of events monopolizing a
+  // worker, we put the process back in the run queue once it exhausts
+  // its budget for this resume (see the `resume_event_budget` and
+  // `resume_time_budget` flags). To reduce the contention on the event
+  // queue we dequeue the events in batches, and only check the budget
+  // between batches.
+  const Option<size_t>& eventBudget = libprocess_flags->resume_event_budget;
+  const Option<Duration>& timeBudget = libprocess_flags->resume_time_budget;
+
+  bool preempted = false;
+  size_t dequeued = 0;
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  EventQueue::Consumer& consumer = process->events->consumer;
+
+  process->statistics->queueDepth.record(consumer.size());
+
+  // To read the clock only once per event, the time spent serving an
+  // event is measured from the end of the previous one, i.e., it also
+  // includes dequeueing the event.
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+
   while (!terminate && !blocked) {
     Event* event = nullptr;
+    Option<std::chrono::steady_clock::duration> wait = None();
 
     // NOTE: the event queue requires only a _single_ consumer at a
     // time ... this is where we act as that single consumer (and down
     // in `ProcessManager::cleanup` which we call from here).
 
-    if (!process->events->consumer.empty()) {
-      event = process->events->consumer.dequeue();
+    if (consumer.batched() > 0) {
+      event = consumer.dequeue(&wait);
+    } else if (!consumer.empty()) {
+      if ((eventBudget.isSome() && dequeued >= eventBudget.get()) ||
+          (timeBudget.isSome() && stopwatch.elapsed() >= timeBudget.get())) {
+        preempted = true;
+        break;
+      }
+
+      size_t max = EVENT_BATCH_SIZE;
+      if (eventBudget.isSome()) {
+        max = std::min(max, eventBudget.get() - dequeued);
+      }
+
+      const size_t count = consumer.fill(max);
+
+      CHECK_GT(count, 0u);
+
+      dequeued += count;
+      event = consumer.dequeue(&wait);
     } else {
       // We now transition the process to BLOCKED. It's possible that
       // events get enqueued while we're still in the READY state.
@@ -2927,7 +3194,7 @@ void ProcessManager::resume(ProcessBase* process)
       process->state.store(state);
       blocked = true;
 
-      if (!process->events->consumer.empty()) {
+      if (!consumer.empty()) {
         if (process->state.compare_exchange_strong(
                 state,
                 ProcessBase::State::READY)) {
@@ -2947,12 +3214,20 @@ void ProcessManager::resume(ProcessBase* process)
       if (terminate) {
         // Now purge all events until the terminate event.
         while (!event->is<TerminateEvent>()) {
+          process->statistics->dequeued(ProcessStatistics::type(*event));
           delete event;
-          event = process->events->consumer.dequeue();
+          event = consumer.dequeue();
           CHECK_NOTNULL(event);
         }
       }
 
+      // NOTE: We need to determine the type before serving the event
+      // since it gets moved from.
+      const ProcessStatistics::EventType type =
+        ProcessStatistics::type(*event);
+
+      process->statistics->dequeued(type);
+
       // Determine if we should filter this event.
       //
       // NOTE: we use double-checked locking here to avoid
@@ -2994,10 +3269,31 @@ void ProcessManager::resume(ProcessBase* process)
                    << " threw unknown exception";
       }
 
+      const std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::now();
+
+      process->statistics->served(type, end - start);
+
+      if (wait.isSome()) {
+        process->statistics->waited(wait.get());
+      }
+
+      start = end;
+
       delete event;
     }
   }
 
+  // NOTE: If the process got blocked, another worker may already be
+  // running it (but the reference keeps it from being deleted), in
+  // which case we might rarely lose a count in the statistics.
+  process->statistics->resumeTime.record(
+      static_cast<uint64_t>(stopwatch.elapsed().us()));
+
+  if (preempted) {
+    process->statistics->preemptions.fetch_add(1, std::memory_order_relaxed);
+  }
+
   // Clear the reference before we cleanup!
   reference = ProcessReference();
 
@@ -3007,6 +3303,12 @@ void ProcessManager::resume(ProcessBase* process)
 
   __process__ = nullptr;
 
+  // A preempted process is still READY, so it would not get enqueued
+  // again when events are enqueued, hence we do it here.
+  if (preempted) {
+    enqueue(process);
+  }
+
   // Need to delete the process _after_ we've set `__process__` back
   // to `nullptr` otherwise during destruction we might execute code
   // that uses/dereferences `__process__` erroneously.
@@ -3043,6 +3345,12 @@ void ProcessManager::cleanup(ProcessBase* process)
   // Remove help strings for all installed routes for this process.
   dispatch(help, &Help::remove, process->pid.id);
 
+  // Remove the metrics exposing the statistics of this process.
+  foreach (const metrics::PullGauge& gauge, process->statistics->gauges) {
+    metrics::remove(gauge);
+  }
+  process->statistics->gauges.clear();
+
     // Possible gate non-libprocess threads are waiting at.
   std::shared_ptr<Gate> gate = process->gate;
 
@@ -3282,9 +3590,9 @@ void ProcessManager::enqueue(ProcessBase* process)
 
 ProcessBase* ProcessManager::dequeue()
 {
-  // TODO(benh): Remove a process from this thread's runq. If there
-  // are no processes to run, and this is not a dedicated thread, then
-  // steal one from another threads runq.
+  // NOTE: With the work-stealing run queue (see run_queue.hpp) this
+  // removes a process from this thread's runq if possible and steals
+  // one from another thread's runq otherwise.
 
   running.fetch_sub(1);
 
@@ -3368,6 +3676,57 @@ void ProcessManager::settle()
 }
 
 
+Future<Response> ProcessManager::__process_stats__(const Request& request)
+{
+  Option<size_t> limit = None();
+
+  Option<string> value = request.url.query.get("limit");
+  if (value.isSome()) {
+    Try<size_t> parse = numify<size_t>(value.get());
+    if (parse.isError()) {
+      return BadRequest("Failed to parse 'limit': " + parse.error());
+    }
+    limit = parse.get();
+  }
+
+  // Unlike `__processes__` we read the statistics directly (they are
+  // atomics) rather than dispatching to each process, so that we get
+  // a response even when the processes are busy, which is usually
+  // when one wants to look at them.
+  vector<pair<string, std::shared_ptr<ProcessStatistics>>> statistics;
+
+  synchronized (processes_mutex) {
+    foreachvalue (ProcessBase* process, processes) {
+      statistics.emplace_back(process->pid.id, process->statistics);
+    }
+  }
+
+  // The processes which spent the most time serving events first.
+  std::sort(
+      statistics.begin(),
+      statistics.end(),
+      [](const pair<string, std::shared_ptr<ProcessStatistics>>& left,
+         const pair<string, std::shared_ptr<ProcessStatistics>>& right) {
+        return left.second->handlerTime.load(std::memory_order_relaxed) >
+               right.second->handlerTime.load(std::memory_order_relaxed);
+      });
+
+  JSON::Array array;
+
+  foreach (const auto& entry, statistics) {
+    if (limit.isSome() && array.values.size() >= limit.get()) {
+      break;
+    }
+
+    JSON::Object object = entry.second->summary();
+    object.values["id"] = entry.first;
+    array.values.push_back(object);
+  }
+
+  return OK(array);
+}
+
+
 Future<Response> ProcessManager::__processes__(const Request&)
 {
   synchronized (processes_mutex) {
@@ -3395,6 +3754,7 @@ Future<Response> ProcessManager::__processes__(const Request&)
 
 ProcessBase::ProcessBase(const string& id)
   : events(new EventQueue()),
+    statistics(new ProcessStatistics()),
     reference(std::make_shared<ProcessBase*>(this)),
     gate(std::make_shared<Gate>())
 {
@@ -3460,6 +3820,57 @@ size_t ProcessBase::eventCount<TerminateEvent>()
 }
 
 
+// Returns a function reading the number of queued events of the given
+// type, which holds on to the statistics so that it remains safe to
+// invoke after the process has been terminated.
+static std::function<size_t()> counter(
+    const std::shared_ptr<ProcessStatistics>& statistics,
+    ProcessStatistics::EventType type)
+{
+  return [statistics, type]() -> size_t {
+    // NOTE: Producers account for an event before enqueueing it, so
+    // the count is never negative.
+    return static_cast<size_t>(
+        statistics->queued[type].load(std::memory_order_relaxed));
+  };
+}
+
+
+template <>
+std::function<size_t()> ProcessBase::eventCounter<MessageEvent>() const
+{
+  return counter(statistics, ProcessStatistics::MESSAGE);
+}
+
+
+template <>
+std::function<size_t()> ProcessBase::eventCounter<DispatchEvent>() const
+{
+  return counter(statistics, ProcessStatistics::DISPATCH);
+}
+
+
+template <>
+std::function<size_t()> ProcessBase::eventCounter<HttpEvent>() const
+{
+  return counter(statistics, ProcessStatistics::HTTP);
+}
+
+
+template <>
+std::function<size_t()> ProcessBase::eventCounter<ExitedEvent>() const
+{
+  return counter(statistics, ProcessStatistics::EXITED);
+}
+
+
+template <>
+std::function<size_t()> ProcessBase::eventCounter<TerminateEvent>() const
+{
+  return counter(statistics, ProcessStatistics::TERMINATE);
+}
+
+
 void ProcessBase::enqueue(Event* event)
 {
   CHECK_NOTNULL(event);
@@ -3477,6 +3888,7 @@ void ProcessBase::enqueue(Event* event)
     case State::BOTTOM:
     case State::READY:
     case State::BLOCKED:
+      statistics->enqueued(ProcessStatistics::type(*event));
       events->producer.enqueue(event);
       break;
     case State::TERMINATING:
@@ -3859,6 +4271,7 @@ ProcessBase:: operator JSON::Object()
   JSON::Object object;
   object.values["id"] = (const string&) pid.id;
   object.values["events"] = JSON::Array(events->consumer);
+  object.values["statistics"] = statistics->json();
   return object;
 }
 
@@ -0,0 +1,347 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_PROCESS_STATISTICS_HPP__
+#define __PROCESS_PROCESS_STATISTICS_HPP__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <process/event.hpp>
+
+#include <process/metrics/pull_gauge.hpp>
+
+#include <stout/json.hpp>
+#include <stout/stringify.hpp>
+
+namespace process {
+
+// A histogram of non-negative values with power-of-two buckets, i.e.,
+// bucket `i` counts the values in [2^(i-1), 2^i) and bucket 0 counts
+// zeros. This is cheap enough to record into on every resume of a
+// process and needs no allocations.
+//
+// NOTE: Values are recorded by a single writer at a time (the worker
+// running the process) but can be read concurrently, hence the
+// (relaxed) atomics.
+class Log2Histogram
+{
+public:
+  Log2Histogram()
+  {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void record(uint64_t value)
+  {
+    size_t index = 0;
+    for (uint64_t v = value; v != 0; v >>= 1) {
+      index++;
+    }
+
+    increment(&buckets[index], 1);
+    increment(&count, 1);
+    increment(&sum, value);
+
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t max() const
+  {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  // Returns an estimate of the given percentile (in [0, 1]), i.e., the
+  // upper bound of the bucket containing it, capped at the maximum.
+  uint64_t percentile(double p) const
+  {
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < BUCKETS; i++) {
+      counts[i] = buckets[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+      if (counts[i] > 0 && seen >= p * total) {
+        return std::min(bound(i), max());
+      }
+    }
+
+    return 0;
+  }
+
+  // Returns a compact JSON representation with only the count, the
+  // maximum and estimates of some percentiles.
+  JSON::Object summary() const
+  {
+    JSON::Object object;
+    object.values["count"] = count.load(std::memory_order_relaxed);
+    object.values["max"] = max();
+    object.values["p50"] = percentile(0.5);
+    object.values["p90"] = percentile(0.9);
+    object.values["p99"] = percentile(0.99);
+    return object;
+  }
+
+  // Returns the JSON representation, with the upper bounds of the
+  // occupied buckets as keys and with estimates of percentiles (the
+  // upper bound of the bucket containing the percentile).
+  JSON::Object json() const
+  {
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < BUCKETS; i++) {
+      counts[i] = buckets[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+
+    JSON::Object histogram;
+    JSON::Object percentiles;
+
+    const std::array<double, 4> ps = {{0.5, 0.9, 0.99, 0.999}};
+    size_t p = 0;
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < BUCKETS; i++) {
+      if (counts[i] == 0) {
+        continue;
+      }
+
+      histogram.values[stringify(bound(i))] = counts[i];
+
+      seen += counts[i];
+      while (p < ps.size() && seen >= ps[p] * total) {
+        percentiles.values["p" + stringify(ps[p] * 100)] = bound(i);
+        p++;
+      }
+    }
+
+    JSON::Object object;
+    object.values["count"] = count.load(std::memory_order_relaxed);
+    object.values["sum"] = sum.load(std::memory_order_relaxed);
+    object.values["max"] = max();
+    object.values["buckets"] = histogram;
+    object.values["percentiles"] = percentiles;
+    return object;
+  }
+
+private:
+  static constexpr size_t BUCKETS = 65;
+
+  // Returns the (inclusive) upper bound of the given bucket.
+  static uint64_t bound(size_t index)
+  {
+    return index == 0 ? 0 : (index == 64 ? UINT64_MAX : (1ull << index) - 1);
+  }
+
+  // Single writer, so we can avoid an atomic read-modify-write.
+  static void increment(std::atomic<uint64_t>* value, uint64_t delta)
+  {
+    value->store(
+        value->load(std::memory_order_relaxed) + delta,
+        std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets;
+  std::atomic<uint64_t> count = ATOMIC_VAR_INIT(0);
+  std::atomic<uint64_t> sum = ATOMIC_VAR_INIT(0);
+  std::atomic<uint64_t> max_ = ATOMIC_VAR_INIT(0);
+};
+
+
+// Statistics about how a process gets run by the worker threads (see
+// `ProcessManager::resume`), which help finding the processes that
+// are "hot", i.e., have large backlogs of events or hold on to the
+// workers for a long time.
+//
+// These are always collected (they are cheap enough) and exposed via
+// the `/__processes__` and `/__process_stats__` endpoints, as well as
+// via metrics for the processes selected by `LIBPROCESS_PROCESS_METRICS`.
+struct ProcessStatistics
+{
+  enum EventType
+  {
+    MESSAGE,
+    DISPATCH,
+    HTTP,
+    EXITED,
+    TERMINATE,
+
+    // Must be last.
+    EVENT_TYPES
+  };
+
+  static EventType type(const Event& event)
+  {
+    struct TypeVisitor : EventVisitor
+    {
+      void visit(const MessageEvent&) override { type = MESSAGE; }
+      void visit(const DispatchEvent&) override { type = DISPATCH; }
+      void visit(const HttpEvent&) override { type = HTTP; }
+      void visit(const ExitedEvent&) override { type = EXITED; }
+      void visit(const TerminateEvent&) override { type = TERMINATE; }
+
+      EventType type = MESSAGE;
+    } visitor;
+
+    event.visit(&visitor);
+    return visitor.type;
+  }
+
+  static std::string name(EventType type)
+  {
+    switch (type) {
+      case MESSAGE:     return "message";
+      case DISPATCH:    return "dispatch";
+      case HTTP:        return "http";
+      case EXITED:      return "exited";
+      case TERMINATE:   return "terminate";
+      case EVENT_TYPES: break;
+    }
+
+    return "unknown";
+  }
+
+  ProcessStatistics()
+  {
+    for (std::atomic<uint64_t>& count : events) {
+      count.store(0, std::memory_order_relaxed);
+    }
+
+    for (std::atomic<int64_t>& count : queued) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Records that an event of the given type got enqueued or dequeued
+  // (by any producer or by the consumer, respectively).
+  void enqueued(EventType type)
+  {
+    queued[type].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void dequeued(EventType type)
+  {
+    queued[type].fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Records that an event of the given type got served, running its
+  // handler for `handler`.
+  void served(
+      EventType type,
+      const std::chrono::steady_clock::duration& handler)
+  {
+    const uint64_t nanos =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(handler).count();
+
+    events[type].store(
+        events[type].load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+
+    handlerTime.store(
+        handlerTime.load(std::memory_order_relaxed) + nanos,
+        std::memory_order_relaxed);
+
+    if (nanos > maxHandlerTime.load(std::memory_order_relaxed)) {
+      maxHandlerTime.store(nanos, std::memory_order_relaxed);
+    }
+  }
+
+  // Records that a (sampled) event waited in the event queue for `wait`
+  // before it got served.
+  void waited(const std::chrono::steady_clock::duration& wait)
+  {
+    waitTime.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(wait).count());
+  }
+
+  // Number of events served, by type.
+  std::array<std::atomic<uint64_t>, EVENT_TYPES> events;
+
+  // Number of events in the event queue, by type. Unlike counting the
+  // events in the queue, reading these does not need to be done from
+  // within the process (see `ProcessBase::eventCounter`).
+  std::array<std::atomic<int64_t>, EVENT_TYPES> queued;
+
+  // Total and maximum time (in nanoseconds) spent in event handlers.
+  std::atomic<uint64_t> handlerTime = ATOMIC_VAR_INIT(0);
+  std::atomic<uint64_t> maxHandlerTime = ATOMIC_VAR_INIT(0);
+
+  // Time (in microseconds) events waited in the event queue before
+  // getting served. Only one event at a time is sampled, see
+  // `EventQueue::sample()`.
+  Log2Histogram waitTime;
+
+  // Number of events in the event queue when the process is resumed.
+  Log2Histogram queueDepth;
+
+  // Time (in microseconds) the process was run for in each resume.
+  Log2Histogram resumeTime;
+
+  // Number of times the process was put back in the run queue
+  // because it exhausted its budget for a resume.
+  std::atomic<uint64_t> preemptions = ATOMIC_VAR_INIT(0);
+
+  // Metrics exposing these statistics, if enabled for the process.
+  std::vector<metrics::PullGauge> gauges;
+
+  JSON::Object json() const
+  {
+    JSON::Object object = summary();
+    object.values["queue_depth"] = queueDepth.json();
+    object.values["resume_time_us"] = resumeTime.json();
+    object.values["wait_time_us"] = waitTime.json();
+    return object;
+  }
+
+  // Returns a compact JSON representation for `/__process_stats__`.
+  JSON::Object summary() const
+  {
+    JSON::Object counts;
+    for (size_t type = 0; type < EVENT_TYPES; type++) {
+      counts.values[name(static_cast<EventType>(type))] =
+        events[type].load(std::memory_order_relaxed);
+    }
+
+    JSON::Object object;
+    object.values["events"] = counts;
+    object.values["handler_time_ms"] =
+      handlerTime.load(std::memory_order_relaxed) / 1e6;
+    object.values["handler_time_max_ms"] =
+      maxHandlerTime.load(std::memory_order_relaxed) / 1e6;
+    object.values["wait_time_us"] = waitTime.summary();
+    object.values["queue_depth"] = queueDepth.summary();
+    object.values["resume_time_us"] = resumeTime.summary();
+    object.values["preemptions"] =
+      preemptions.load(std::memory_order_relaxed);
+    return object;
+  }
+};
+
+} // namespace process {
+
+#endif // __PROCESS_PROCESS_STATISTICS_HPP__
@@ -20,7 +20,12 @@
 //      -DENABLE_LOCK_FREE_RUN_QUEUE (cmake) which enables the
 //      lock-free run queue implementation (see below for more details).
 //
-//  (2) --enable-last-in-first-out-fixed-size-semaphore (autotools) or
+//  (2) --enable-work-stealing-run-queue (autotools) or
+//      -DENABLE_WORK_STEALING_RUN_QUEUE (cmake) which enables the
+//      work-stealing run queue implementation (see below for more
+//      details). This can not be combined with (1).
+//
+//  (3) --enable-last-in-first-out-fixed-size-semaphore (autotools) or
 //      -DENABLE_LAST_IN_FIRST_OUT_FIXED_SIZE_SEMAPHORE (cmake) which
 //      enables an optimized semaphore implementation (see semaphore.hpp
 //      for more details).
@@ -32,22 +37,337 @@
 // _runtime_ decisions because we wanted the run queue implementation
 // to be compile-time optimized (e.g., inlined, etc).
 
+#if defined(LOCK_FREE_RUN_QUEUE) && defined(WORK_STEALING_RUN_QUEUE)
+#error "The lock-free and the work-stealing run queue can not be combined"
+#endif
+
 #ifdef LOCK_FREE_RUN_QUEUE
 #include <concurrentqueue.h>
 #endif // LOCK_FREE_RUN_QUEUE
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
 #include <list>
+#include <mutex>
 
 #include <process/process.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/synchronized.hpp>
 
 #include "semaphore.hpp"
 
 namespace process {
 
-#ifndef LOCK_FREE_RUN_QUEUE
+#ifdef WORK_STEALING_RUN_QUEUE
+
+// A run queue where each worker thread has its own local queue of
+// processes, which avoids contention on a single shared queue.
+//
+// A process enqueued by a worker (e.g., because the process that the
+// worker is currently running sent it a message) is put in the
+// worker's "LIFO slot" so that the worker runs it next, while its
+// caches are still warm with the message. A process which was in the
+// slot is moved to the back of the worker's local queue. Workers run
+// the processes in their local queue in FIFO order, but a worker runs
+// at most `MAX_LIFO_STREAK` processes from its slot in a row to avoid
+// starving its local queue when processes keep on messaging each other.
+//
+// Processes enqueued by non-worker threads (e.g., the event loop) are
+// put in a shared queue, which each worker checks after its local
+// queue and (to avoid starvation) every `SHARED_QUEUE_INTERVAL`
+// dequeues. Workers which run out of processes steal the oldest
+// process from the local queues of the other workers.
+//
+// Like the other run queue implementations, a semaphore counts the
+// enqueued processes so that idle workers wait and get woken up by
+// `enqueue`, at which point they will steal the enqueued process if
+// the enqueuing worker has not run it yet.
+class RunQueue
+{
+public:
+  RunQueue()
+  {
+    foreach (std::atomic<Worker*>& worker, workers) {
+      worker.store(nullptr);
+    }
+  }
+
+  RunQueue(const RunQueue&) = delete;
+  RunQueue& operator=(const RunQueue&) = delete;
+
+  ~RunQueue()
+  {
+    foreach (std::atomic<Worker*>& worker, workers) {
+      delete worker.load();
+    }
+  }
+
+  bool extract(ProcessBase* process)
+  {
+    synchronized (shared.mutex) {
+      if (remove(&shared.processes, process)) {
+        return true;
+      }
+    }
+
+    const size_t count = std::min(attached.load(), workers.size());
+
+    for (size_t i = 0; i < count; i++) {
+      Worker* worker = workers[i].load();
+      if (worker == nullptr) {
+        continue;
+      }
+
+      synchronized (worker->mutex) {
+        if (worker->next == process) {
+          worker->next = nullptr;
+          return true;
+        }
+
+        if (remove(&worker->processes, process)) {
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  void wait()
+  {
+    semaphore.wait();
+  }
+
+  void enqueue(ProcessBase* process)
+  {
+    Worker* worker = local();
+
+    if (worker != nullptr && worker->queue == this) {
+      synchronized (worker->mutex) {
+        if (worker->next != nullptr) {
+          worker->processes.push_back(worker->next);
+        }
+        worker->next = process;
+      }
+    } else {
+      synchronized (shared.mutex) {
+        shared.processes.push_back(process);
+      }
+    }
+
+    epoch.fetch_add(1);
+    semaphore.signal();
+  }
+
+  // Precondition: `wait` must get called before `dequeue`!
+  //
+  // NOTE: This must only be called by worker threads, the calling
+  // thread is registered as a worker on its first call.
+  //
+  // NOTE: Like with the `LockingRunQueue`, this may return `nullptr`
+  // if the process that we were woken up for has been extracted or
+  // was run by another worker (e.g., one that had not been waiting).
+  ProcessBase* dequeue()
+  {
+    Worker* worker = attach();
+
+    ProcessBase* process = nullptr;
+
+    if (++worker->dequeues % SHARED_QUEUE_INTERVAL == 0) {
+      synchronized (shared.mutex) {
+        if (pop(&shared.processes, &process)) {
+          return process;
+        }
+      }
+    }
+
+    synchronized (worker->mutex) {
+      if (worker->next != nullptr &&
+          (worker->streak < MAX_LIFO_STREAK || worker->processes.empty())) {
+        std::swap(process, worker->next);
+        worker->streak++;
+        return process;
+      }
+
+      worker->streak = 0;
+
+      if (pop(&worker->processes, &process)) {
+        return process;
+      }
+    }
+
+    synchronized (shared.mutex) {
+      if (pop(&shared.processes, &process)) {
+        return process;
+      }
+    }
+
+    // Try to steal from the other workers, starting with the next
+    // worker so that thieves do not all go after the same victim.
+    const size_t count = std::min(attached.load(), workers.size());
+
+    for (size_t i = 1; i < count; i++) {
+      Worker* victim = workers[(worker->index + i) % count].load();
+      if (victim == nullptr) {
+        continue;
+      }
+
+      synchronized (victim->mutex) {
+        if (pop(&victim->processes, &process)) {
+          return process;
+        }
+
+        if (victim->next != nullptr) {
+          std::swap(process, victim->next);
+          return process;
+        }
+      }
+    }
+
+    return nullptr;
+  }
+
+  // NOTE: this function can't be const because `synchronized (mutex)`
+  // is not const ...
+  bool empty()
+  {
+    synchronized (shared.mutex) {
+      if (!shared.processes.empty()) {
+        return false;
+      }
+    }
+
+    const size_t count = std::min(attached.load(), workers.size());
+
+    for (size_t i = 0; i < count; i++) {
+      Worker* worker = workers[i].load();
+      if (worker == nullptr) {
+        continue;
+      }
+
+      synchronized (worker->mutex) {
+        if (worker->next != nullptr || !worker->processes.empty()) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  void decomission()
+  {
+    semaphore.decomission();
+  }
+
+  size_t capacity() const
+  {
+    return std::min(semaphore.capacity(), workers.size());
+  }
+
+  // Epoch used to capture changes to the run queue when settling.
+  std::atomic_long epoch = ATOMIC_VAR_INIT(0L);
+
+private:
+  // The maximum number of processes a worker runs from its LIFO slot
+  // in a row while there are processes in its local queue.
+  static constexpr size_t MAX_LIFO_STREAK = 16;
+
+  // How often (in number of dequeues) a worker checks the shared
+  // queue before its local queue.
+  static constexpr size_t SHARED_QUEUE_INTERVAL = 61;
+
+  struct Worker
+  {
+    Worker(RunQueue* _queue, size_t _index) : queue(_queue), index(_index) {}
+
+    RunQueue* const queue;
+    const size_t index;
+
+    std::mutex mutex;
+
+    // The process most recently enqueued by this worker.
+    ProcessBase* next = nullptr;
+
+    // The other processes enqueued by this worker, oldest first.
+    std::deque<ProcessBase*> processes;
+
+    // Only accessed by the worker thread itself.
+    size_t streak = 0;
+    size_t dequeues = 0;
+  };
+
+  // Returns the worker of the calling thread, if any.
+  static Worker*& local()
+  {
+    static thread_local Worker* worker = nullptr;
+    return worker;
+  }
+
+  // Returns the worker of the calling thread, registering the calling
+  // thread as a new worker if necessary.
+  Worker* attach()
+  {
+    Worker*& worker = local();
+
+    if (worker == nullptr || worker->queue != this) {
+      const size_t index = attached.fetch_add(1);
+      CHECK_LT(index, workers.size());
+
+      worker = new Worker(this, index);
+      workers[index].store(worker);
+    }
+
+    return worker;
+  }
+
+  static bool pop(std::deque<ProcessBase*>* processes, ProcessBase** process)
+  {
+    if (processes->empty()) {
+      return false;
+    }
+
+    *process = processes->front();
+    processes->pop_front();
+    return true;
+  }
+
+  static bool remove(std::deque<ProcessBase*>* processes, ProcessBase* process)
+  {
+    auto it = std::find(processes->begin(), processes->end(), process);
+
+    if (it == processes->end()) {
+      return false;
+    }
+
+    processes->erase(it);
+    return true;
+  }
+
+  // Processes enqueued by non-worker threads.
+  struct
+  {
+    std::mutex mutex;
+    std::deque<ProcessBase*> processes;
+  } shared;
+
+  // The registered workers, see `attach()`. The number of workers is
+  // bounded by the maximum value of `LIBPROCESS_NUM_WORKER_THREADS`.
+  std::array<std::atomic<Worker*>, 1024> workers;
+  std::atomic<size_t> attached = ATOMIC_VAR_INIT(0);
+
+  // Semaphore used for threads to wait.
+#ifndef LAST_IN_FIRST_OUT_FIXED_SIZE_SEMAPHORE
+  DecomissionableKernelSemaphore semaphore;
+#else
+  DecomissionableLastInFirstOutFixedSizeSemaphore semaphore;
+#endif // LAST_IN_FIRST_OUT_FIXED_SIZE_SEMAPHORE
+};
+
+#elif !defined(LOCK_FREE_RUN_QUEUE)
 class RunQueue
 {
 public:
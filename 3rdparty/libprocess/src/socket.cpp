@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/shared_array.hpp>
 
@@ -23,6 +24,7 @@
 
 #include <process/ssl/flags.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/os.hpp>
 #include <stout/unreachable.hpp>
 
@@ -32,6 +34,7 @@
 #include "poll_socket.hpp"
 
 using std::string;
+using std::vector;
 
 namespace process {
 namespace network {
@@ -218,6 +221,50 @@ Future<Nothing> SocketImpl::send(const string& data)
       });
 }
 
+
+Future<size_t> SocketImpl::send(const vector<Buffer>& buffers)
+{
+  // Coalesce the leading buffers into a single send as long as they
+  // are small enough to be cheap to copy, so that e.g. the header,
+  // body and trailer of a message do not take a send each.
+  static const size_t MAX_COALESCED_SIZE = 16 * 1024;
+
+  vector<const Buffer*> coalesced;
+  size_t size = 0;
+
+  foreach (const Buffer& buffer, buffers) {
+    if (buffer.size == 0) {
+      continue;
+    }
+
+    if (!coalesced.empty() && size + buffer.size > MAX_COALESCED_SIZE) {
+      break;
+    }
+
+    coalesced.push_back(&buffer);
+    size += buffer.size;
+  }
+
+  CHECK(!coalesced.empty());
+
+  if (coalesced.size() == 1) {
+    return send(coalesced.front()->data, coalesced.front()->size);
+  }
+
+  std::shared_ptr<string> data(new string());
+  data->reserve(size);
+
+  foreach (const Buffer* buffer, coalesced) {
+    data->append(buffer->data, buffer->size);
+  }
+
+  // Keep the copy alive until the send has completed.
+  return send(data->data(), data->size())
+    .then([data](size_t length) {
+      return length;
+    });
+}
+
 } // namespace internal {
 } // namespace network {
 } // namespace process {
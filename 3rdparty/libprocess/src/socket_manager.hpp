@@ -22,6 +22,8 @@
 #include <process/process.hpp>
 #include <process/socket.hpp>
 
+#include <process/metrics/counter.hpp>
+
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
 
@@ -86,6 +88,22 @@ public:
   void exited(const network::inet::Address& address);
   void exited(ProcessBase* process);
 
+  // Metrics about sending messages, which show how well messages get
+  // coalesced (see the `message_coalescing_budget` flag). These get
+  // added to the metrics in `process::initialize`.
+  struct Metrics
+  {
+    Metrics()
+      : messages_sent("libprocess/messages_sent"),
+        message_writes("libprocess/message_writes") {}
+
+    // Number of messages sent through sockets.
+    process::metrics::Counter messages_sent;
+
+    // Number of writes (i.e., system calls) needed to send them.
+    process::metrics::Counter message_writes;
+  } metrics;
+
 private:
   // TODO(bmahler): Leverage a bidirectional multimap instead, or
   // hide the complexity of manipulating 'links' through methods.
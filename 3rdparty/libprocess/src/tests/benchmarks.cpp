@@ -18,21 +18,27 @@
 
 #include <gmock/gmock.h>
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include <process/clock.hpp>
 #include <process/collect.hpp>
 #include <process/count_down_latch.hpp>
 #include <process/future.hpp>
 #include <process/gmock.hpp>
 #include <process/gtest.hpp>
+#include <process/metrics/metrics.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
 #include <process/protobuf.hpp>
+#include <process/timer.hpp>
 
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
@@ -45,6 +51,7 @@
 
 namespace http = process::http;
 
+using process::Clock;
 using process::CountDownLatch;
 using process::Future;
 using process::MessageEvent;
@@ -52,11 +59,14 @@ using process::Owned;
 using process::Process;
 using process::ProcessBase;
 using process::Promise;
+using process::Timer;
 using process::UPID;
 
 using std::cout;
 using std::endl;
+using std::map;
 using std::ostringstream;
+using std::pair;
 using std::string;
 using std::vector;
 
@@ -201,11 +211,24 @@ private:
 };
 
 
+// Returns the PID with the address replaced by the loopback address,
+// so that messages sent to it go through a socket rather than getting
+// delivered locally (unless libprocess uses the loopback address).
+static UPID loopback(const UPID& pid)
+{
+  UPID result = pid;
+  result.address.ip = net::IP(INADDR_LOOPBACK);
+  return result;
+}
+
+
 // A process that emulates the 'server' side of a ping pong game.
 // Note that the server links to any clients communicating to it.
 class ServerProcess : public Process<ServerProcess>
 {
 public:
+  explicit ServerProcess(bool _remote = false) : remote(_remote) {}
+
   virtual ~ServerProcess() {}
 
 protected:
@@ -223,27 +246,34 @@ private:
       links.insert(from);
     }
 
-    send(from, "pong", body.c_str(), body.size());
+    send(remote ? loopback(from) : from, "pong", body.c_str(), body.size());
   }
 
+  // Whether to send the responses through sockets, see `loopback`.
+  const bool remote;
+
   hashset<UPID> links;
 };
 
-// TODO(bmahler): Since there is no forking here, libprocess
-// avoids going through sockets for local messages. Either fork
-// or have the ability to disable local messages in libprocess.
+// NOTE: Since there is no forking here, libprocess avoids going
+// through sockets for local messages unless the messages are sent to
+// the loopback address (see `loopback`), which is what we do for the
+// "remote" runs below to measure the encoding and sending of messages.
 
 // Launches many clients against a central server and measures
 // client throughput.
-TEST(ProcessTest, Process_BENCHMARK_ClientServer)
+static void clientServerPerformance(
+    size_t numRequests,
+    const Bytes& messageSize,
+    bool remote)
 {
-  const size_t numRequests = 10000;
   const size_t concurrency = 250;
   const size_t numClients = 8;
-  const Bytes messageSize = Bytes(3);
 
-  ServerProcess server;
-  const UPID serverPid = spawn(&server);
+  ServerProcess server(remote);
+  spawn(&server);
+
+  const UPID serverPid = remote ? loopback(server.self()) : server.self();
 
   // Launch the clients.
   vector<Owned<ClientProcess>> clients;
@@ -289,7 +319,9 @@ TEST(ProcessTest, Process_BENCHMARK_ClientServer)
   }
 
   double throughput = (numRequests * numClients) / elapsed.secs();
-  cout << "Estimated Total: " << throughput << " rpcs / sec" << endl;
+  cout << "Estimated Total: " << throughput << " rpcs / sec, "
+       << Bytes(static_cast<uint64_t>(throughput * messageSize.bytes()))
+       << " / sec" << endl;
 
   foreach (const Owned<ClientProcess>& client, clients) {
     terminate(*client);
@@ -301,6 +333,33 @@ TEST(ProcessTest, Process_BENCHMARK_ClientServer)
 }
 
 
+TEST(ProcessTest, Process_BENCHMARK_ClientServer)
+{
+  cout << "Local messages of " << Bytes(3) << endl;
+  clientServerPerformance(10000, Bytes(3), false);
+
+  if (process::address().ip.isLoopback()) {
+    cout << "Skipping remote messages since libprocess uses the "
+         << "loopback address" << endl;
+    return;
+  }
+
+  // Large messages (e.g., offers or agent reregistrations in large
+  // clusters) stress the encoding and copying of messages.
+  const vector<pair<size_t, Bytes>> runs = {
+    {10000, Bytes(3)},
+    {10000, Kilobytes(64)},
+    {1000, Megabytes(1)},
+    {100, Megabytes(8)},
+  };
+
+  foreach (const auto& run, runs) {
+    cout << "Remote messages of " << run.second << endl;
+    clientServerPerformance(run.first, run.second, true);
+  }
+}
+
+
 class LinkerProcess : public Process<LinkerProcess>
 {
 public:
@@ -386,13 +445,32 @@ TEST(ProcessTest, Process_BENCHMARK_LargeNumberOfLinks)
 
 class Destination : public Process<Destination>
 {
+public:
+  explicit Destination(bool _remote = false) : remote(_remote) {}
+
 protected:
   void consume(MessageEvent&& event) override
   {
     if (event.message.name == "ping") {
-      send(event.message.from, "pong");
+      if (!remote) {
+        send(event.message.from, "pong");
+        return;
+      }
+
+      // Reply through a persistent link, see `Client`.
+      const UPID from = loopback(event.message.from);
+      if (!links.contains(from)) {
+        link(from);
+        links.insert(from);
+      }
+
+      send(from, "pong");
     }
   }
+
+private:
+  const bool remote;
+  hashset<UPID> links;
 };
 
 
@@ -403,6 +481,15 @@ public:
     : destination(destination), latch(latch), repeat(repeat) {}
 
 protected:
+  void initialize() override
+  {
+    // Messages only get coalesced on persistent links, so make sure
+    // that remote messages are sent through one.
+    if (destination.address != process::address()) {
+      link(destination);
+    }
+  }
+
   void consume(MessageEvent&& event) override
   {
     if (event.message.name == "pong") {
@@ -438,13 +525,23 @@ private:
 //
 // This benchmark was discussed here:
 // http://letitcrash.com/post/17607272336/scalability-of-fork-join-pool
-TEST(ProcessTest, Process_BENCHMARK_ThroughputPerformance)
+//
+// NOTE: The run queue implementation is chosen at compile time (see
+// run_queue.hpp), so compare the schedulers by running this benchmark
+// with libprocess built with and without the respective options. We
+// run with as many client/destination pairs as there are workers as
+// well as with more pairs than workers, where the workers contend
+// more for the run queue(s).
+//
+// The "remote" runs send the messages through sockets (see
+// `loopback`), compare them with and without the
+// `LIBPROCESS_MESSAGE_COALESCING_BUDGET` flag to see the effect of
+// coalescing messages.
+static void throughputPerformance(long numberOfClients, bool remote)
 {
-  long repeatFactor = 500L;
+  long repeatFactor = remote ? 5L : 500L;
   long defaultRepeat = 30000L * repeatFactor;
 
-  const long numberOfClients = process::workers();
-
   CountDownLatch latch(numberOfClients - 1);
 
   long repeat = defaultRepeat;
@@ -455,12 +552,12 @@ TEST(ProcessTest, Process_BENCHMARK_ThroughputPerformance)
   vector<Owned<Client>> clients;
 
   for (long _ = 0; _ < numberOfClients; _++) {
-    Owned<Destination> destination(new Destination());
+    Owned<Destination> destination(new Destination(remote));
 
     spawn(*destination);
 
     Owned<Client> client(new Client(
-        destination->self(),
+        remote ? loopback(destination->self()) : destination->self(),
         &latch,
         repeatsPerClient));
 
@@ -470,6 +567,9 @@ TEST(ProcessTest, Process_BENCHMARK_ThroughputPerformance)
     clients.push_back(client);
   }
 
+  Future<map<string, double>> before = process::metrics::snapshot(None());
+  AWAIT_READY(before);
+
   Stopwatch watch;
   watch.start();
 
@@ -483,7 +583,26 @@ TEST(ProcessTest, Process_BENCHMARK_ThroughputPerformance)
 
   double throughput = (double) repeat / elapsed.secs();
 
-  cout << "Estimated Total: " << std::fixed << throughput << endl;
+  cout << "Estimated Total with " << numberOfClients
+       << (remote ? " remote" : "") << " clients: "
+       << std::fixed << throughput << endl;
+
+  if (remote) {
+    Future<map<string, double>> after = process::metrics::snapshot(None());
+    AWAIT_READY(after);
+
+    const double messages =
+      after->at("libprocess/messages_sent") -
+      before->at("libprocess/messages_sent");
+
+    const double writes =
+      after->at("libprocess/message_writes") -
+      before->at("libprocess/message_writes");
+
+    cout << "Sent " << messages << " messages with " << writes
+         << " writes (" << messages / std::max(writes, 1.0)
+         << " messages / write)" << endl;
+  }
 
   foreach (const Owned<Client>& client, clients) {
     terminate(client->self());
@@ -497,6 +616,26 @@ TEST(ProcessTest, Process_BENCHMARK_ThroughputPerformance)
 }
 
 
+TEST(ProcessTest, Process_BENCHMARK_ThroughputPerformance)
+{
+  const long workers = process::workers();
+
+  foreach (long factor, vector<long>({1L, 2L, 4L})) {
+    throughputPerformance(workers * factor, false);
+  }
+
+  if (process::address().ip.isLoopback()) {
+    cout << "Skipping remote clients since libprocess uses the "
+         << "loopback address" << endl;
+    return;
+  }
+
+  foreach (long factor, vector<long>({1L, 2L, 4L})) {
+    throughputPerformance(workers * factor, true);
+  }
+}
+
+
 class DispatchProcess : public Process<DispatchProcess>
 {
 public:
@@ -536,27 +675,45 @@ public:
     return Nothing();
   }
 
+  // Runs `count` processes concurrently, each of which handles
+  // `repeats` dispatches.
   template <typename T>
-  static void run(const string& name, long repeats)
+  static void run(const string& name, long repeats, size_t count = 1)
   {
-    Promise<Nothing> promise;
+    vector<Owned<Promise<Nothing>>> promises;
+    vector<Owned<DispatchProcess>> processes;
+    vector<Future<Nothing>> futures;
+
+    for (size_t i = 0; i < count; i++) {
+      Owned<Promise<Nothing>> promise(new Promise<Nothing>());
+      Owned<DispatchProcess> process(
+          new DispatchProcess(promise.get(), repeats));
+
+      spawn(*process);
 
-    Owned<DispatchProcess> process(new DispatchProcess(&promise, repeats));
-    spawn(*process);
+      futures.push_back(promise->future());
+      promises.push_back(promise);
+      processes.push_back(process);
+    }
 
     T data{std::vector<int>(10240, 42)};
 
     Stopwatch watch;
     watch.start();
 
-    dispatch(process.get(), &DispatchProcess::handler<T>, data);
+    foreach (const Owned<DispatchProcess>& process, processes) {
+      dispatch(process.get(), &DispatchProcess::handler<T>, data);
+    }
 
-    AWAIT_READY(promise.future());
+    AWAIT_READY(process::collect(futures));
 
-    cout << name << " elapsed: " << watch.elapsed() << endl;
+    cout << name << " with " << count << " processes elapsed: "
+         << watch.elapsed() << endl;
 
-    terminate(process.get());
-    wait(process.get());
+    foreach (const Owned<DispatchProcess>& process, processes) {
+      terminate(process.get());
+      wait(process.get());
+    }
   }
 
 private:
@@ -582,6 +739,15 @@ TEST(ProcessTest, Process_BENCHMARK_DispatchDefer)
   // this resembles how most of the handlers are currently implemented.
   DispatchProcess::run<DispatchProcess::Movable>("Movable", repeats);
   DispatchProcess::run<DispatchProcess::Copyable>("Copyable", repeats);
+
+  // Also run as many processes as there are workers concurrently to
+  // compare the run queue implementations (see run_queue.hpp), which
+  // are chosen at compile time. Each dispatch here is enqueued by the
+  // worker running the dispatching process.
+  const size_t workers = process::workers();
+
+  DispatchProcess::run<DispatchProcess::Movable>("Movable", repeats, workers);
+  DispatchProcess::run<DispatchProcess::Copyable>("Copyable", repeats, workers);
 }
 
 
@@ -754,3 +920,92 @@ TEST(ProcessTest, Process_BENCHMARK_MpscLinkedQueue)
   cout << "Estimated total throughput: "
        << std::fixed << throughput << " op/s" << endl;
 }
+
+
+// Measures the throughput of creating and canceling timers from many
+// threads concurrently (e.g., like offer filters, timeouts and
+// heartbeats in a large master), as well as of expiring them.
+TEST(ProcessTest, Process_BENCHMARK_TimerThroughput)
+{
+  const size_t threads = process::workers();
+  const size_t timersPerThread = 100000;
+  const size_t total = threads * timersPerThread;
+
+  vector<vector<Timer>> timers(threads);
+  vector<std::thread> workers;
+
+  Stopwatch watch;
+  watch.start();
+
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&timers, t, timersPerThread]() {
+      for (size_t i = 0; i < timersPerThread; i++) {
+        // Spread the timeouts over an hour, none of them expire
+        // during the benchmark.
+        timers[t].push_back(Clock::timer(
+            Minutes(1) + Milliseconds(static_cast<int64_t>(i % 3600000)),
+            []() {}));
+      }
+    });
+  }
+
+  foreach (std::thread& worker, workers) {
+    worker.join();
+  }
+
+  Duration elapsed = watch.elapsed();
+
+  cout << "Created " << total << " timers from " << threads
+       << " threads in " << elapsed << " ("
+       << std::fixed << total / elapsed.secs() << " op/s)" << endl;
+
+  workers.clear();
+  watch.start();
+
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&timers, t]() {
+      foreach (const Timer& timer, timers[t]) {
+        Clock::cancel(timer);
+      }
+    });
+  }
+
+  foreach (std::thread& worker, workers) {
+    worker.join();
+  }
+
+  elapsed = watch.elapsed();
+
+  cout << "Canceled " << total << " timers from " << threads
+       << " threads in " << elapsed << " ("
+       << std::fixed << total / elapsed.secs() << " op/s)" << endl;
+
+  // Pause the clock so that all timers expire when we advance it.
+  Clock::pause();
+
+  std::atomic<size_t> fired(0);
+  Promise<Nothing> promise;
+
+  for (size_t i = 0; i < total; i++) {
+    Clock::timer(
+        Milliseconds(static_cast<int64_t>(i % 1000 + 1)),
+        [&fired, &promise, total]() {
+          if (++fired == total) {
+            promise.set(Nothing());
+          }
+        });
+  }
+
+  watch.start();
+
+  Clock::advance(Seconds(1));
+
+  AWAIT_READY(promise.future());
+
+  elapsed = watch.elapsed();
+
+  cout << "Expired " << total << " timers in " << elapsed << " ("
+       << std::fixed << total / elapsed.secs() << " op/s)" << endl;
+
+  Clock::resume();
+}
@@ -0,0 +1,298 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <sys/socket.h>
+
+#include <unistd.h>
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <process/collect.hpp>
+#include <process/future.hpp>
+#include <process/gtest.hpp>
+#include <process/io.hpp>
+
+#include <stout/bytes.hpp>
+#include <stout/gtest.hpp>
+#include <stout/os.hpp>
+
+#include <stout/os/pipe.hpp>
+
+#include "posix/io_uring/io_uring.hpp"
+
+namespace io = process::io;
+namespace io_uring = process::io_uring;
+
+using process::Future;
+
+using std::array;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace process {
+
+// We need to reinitialize libprocess in order to test against different
+// configurations, such as when io_uring is disabled.
+void reinitialize(
+    const Option<string>& delegate,
+    const Option<string>& readwriteAuthenticationRealm,
+    const Option<string>& readonlyAuthenticationRealm);
+
+} // namespace process {
+
+
+// Returns false if the io_uring operations can not be tested, i.e.,
+// if the kernel does not support io_uring.
+static bool supported()
+{
+  if (!io_uring::enabled()) {
+    cout << "Skipping test since io_uring is not supported" << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+// Returns a pipe whose ends are both non-blocking.
+static Try<array<int_fd, 2>> nonblockingPipe()
+{
+  Try<array<int_fd, 2>> pipes = os::pipe();
+  if (pipes.isError()) {
+    return pipes;
+  }
+
+  foreach (int_fd fd, pipes.get()) {
+    Try<Nothing> nonblock = os::nonblock(fd);
+    if (nonblock.isError()) {
+      os::close(pipes->at(0));
+      os::close(pipes->at(1));
+      return Error(nonblock.error());
+    }
+  }
+
+  return pipes;
+}
+
+
+// Returns a pair of connected sockets which are both non-blocking.
+static Try<array<int_fd, 2>> nonblockingSocketpair()
+{
+  array<int_fd, 2> sockets;
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets.data()) != 0) {
+    return ErrnoError();
+  }
+
+  foreach (int_fd fd, sockets) {
+    Try<Nothing> nonblock = os::nonblock(fd);
+    if (nonblock.isError()) {
+      os::close(sockets[0]);
+      os::close(sockets[1]);
+      return Error(nonblock.error());
+    }
+  }
+
+  return sockets;
+}
+
+
+class IOUringFallbackTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    os::setenv("LIBPROCESS_IO_URING", "false");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+
+  void TearDown() override
+  {
+    os::unsetenv("LIBPROCESS_IO_URING");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+};
+
+
+// When io_uring is disabled, the I/O falls back to polling the file
+// descriptors, whether or not the kernel supports io_uring.
+TEST_F(IOUringFallbackTest, ReadWrite)
+{
+  EXPECT_FALSE(io_uring::enabled());
+
+  Try<array<int_fd, 2>> pipes_ = nonblockingPipe();
+  ASSERT_SOME(pipes_);
+
+  const array<int_fd, 2>& pipes = pipes_.get();
+
+  char data[3];
+
+  Future<size_t> read = io::read(pipes[0], data, 3);
+  EXPECT_TRUE(read.isPending());
+
+  AWAIT_EXPECT_EQ(2u, io::write(pipes[1], "hi", 2));
+  AWAIT_EXPECT_EQ(2u, read);
+  EXPECT_EQ("hi", string(data, 2));
+
+  Future<short> poll = io::poll(pipes[0], io::READ);
+  EXPECT_TRUE(poll.isPending());
+
+  poll.discard();
+  AWAIT_DISCARDED(poll);
+
+  ASSERT_SOME(os::close(pipes[0]));
+  ASSERT_SOME(os::close(pipes[1]));
+}
+
+
+// Discarding the future of a pending operation cancels the operation
+// in the kernel, which must then not consume any data.
+TEST(IOUringTest, Discard)
+{
+  if (!supported()) {
+    return;
+  }
+
+  Try<array<int_fd, 2>> pipes_ = nonblockingPipe();
+  ASSERT_SOME(pipes_);
+
+  const array<int_fd, 2>& pipes = pipes_.get();
+
+  char data[3];
+
+  Future<size_t> read = io_uring::read(pipes[0], data, 3);
+  EXPECT_TRUE(read.isPending());
+
+  read.discard();
+  AWAIT_DISCARDED(read);
+
+  ASSERT_EQ(2, ::write(pipes[1], "hi", 2));
+  ASSERT_EQ(2, ::read(pipes[0], data, 3));
+  EXPECT_EQ("hi", string(data, 2));
+
+  Future<short> poll = io_uring::poll(pipes[0], io::READ);
+  EXPECT_TRUE(poll.isPending());
+
+  poll.discard();
+  AWAIT_DISCARDED(poll);
+
+  ASSERT_SOME(os::close(pipes[0]));
+  ASSERT_SOME(os::close(pipes[1]));
+}
+
+
+// Like the system calls, the operations complete with whatever could
+// be read or written rather than waiting to read or write everything.
+TEST(IOUringTest, ShortReadWrite)
+{
+  if (!supported()) {
+    return;
+  }
+
+  Try<array<int_fd, 2>> pipes_ = nonblockingPipe();
+  ASSERT_SOME(pipes_);
+
+  const array<int_fd, 2>& pipes = pipes_.get();
+
+  char data[1024];
+
+  ASSERT_EQ(3, ::write(pipes[1], "abc", 3));
+  AWAIT_EXPECT_EQ(3u, io_uring::read(pipes[0], data, sizeof(data)));
+  EXPECT_EQ("abc", string(data, 3));
+
+  // Neither the pipe nor the socket can buffer a megabyte.
+  const string buffer(Megabytes(1).bytes(), 'x');
+
+  Future<size_t> write =
+    io_uring::write(pipes[1], buffer.data(), buffer.size());
+
+  AWAIT_READY(write);
+  EXPECT_LT(0u, write.get());
+  EXPECT_GT(buffer.size(), write.get());
+
+  ASSERT_SOME(os::close(pipes[0]));
+  ASSERT_SOME(os::close(pipes[1]));
+
+  Try<array<int_fd, 2>> sockets_ = nonblockingSocketpair();
+  ASSERT_SOME(sockets_);
+
+  const array<int_fd, 2>& sockets = sockets_.get();
+
+  Future<size_t> send =
+    io_uring::send(sockets[0], buffer.data(), buffer.size());
+
+  AWAIT_READY(send);
+  EXPECT_LT(0u, send.get());
+  EXPECT_GT(buffer.size(), send.get());
+
+  ASSERT_SOME(os::close(sockets[0]));
+  ASSERT_SOME(os::close(sockets[1]));
+}
+
+
+// Operations which wait in the kernel get completed once the kernel
+// signals their completion via the eventfd watched by the event loop,
+// here for more operations than fit in the completion queue at once.
+TEST(IOUringTest, EventfdCompletion)
+{
+  if (!supported()) {
+    return;
+  }
+
+  Try<array<int_fd, 2>> sockets_ = nonblockingSocketpair();
+  ASSERT_SOME(sockets_);
+
+  const array<int_fd, 2>& sockets = sockets_.get();
+
+  const size_t count = 4096;
+
+  vector<char> data(count);
+  vector<Future<size_t>> reads;
+
+  for (size_t i = 0; i < count; i++) {
+    reads.push_back(io_uring::read(sockets[0], &data[i], 1));
+  }
+
+  foreach (const Future<size_t>& read, reads) {
+    EXPECT_TRUE(read.isPending());
+  }
+
+  // Complete the reads by writing from this thread rather than by an
+  // operation of the event loop.
+  const string written(count, 'x');
+  ASSERT_EQ(
+      static_cast<ssize_t>(count),
+      ::write(sockets[1], written.data(), written.size()));
+
+  Future<vector<size_t>> sizes = process::collect(reads);
+  AWAIT_READY(sizes);
+
+  EXPECT_EQ(vector<size_t>(count, 1u), sizes.get());
+  EXPECT_EQ(written, string(data.data(), data.size()));
+
+  ASSERT_SOME(os::close(sockets[0]));
+  ASSERT_SOME(os::close(sockets[1]));
+}
@@ -12,16 +12,21 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <stout/base64.hpp>
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
+#include <stout/strings.hpp>
 
 #include <process/authenticator.hpp>
 #include <process/clock.hpp>
+#include <process/dispatch.hpp>
+#include <process/event.hpp>
 #include <process/future.hpp>
 #include <process/gtest.hpp>
 #include <process/http.hpp>
@@ -30,7 +35,9 @@
 #include <process/time.hpp>
 
 #include <process/metrics/counter.hpp>
+#include <process/metrics/histogram.hpp>
 #include <process/metrics/metrics.hpp>
+#include <process/metrics/publisher.hpp>
 #include <process/metrics/pull_gauge.hpp>
 #include <process/metrics/push_gauge.hpp>
 #include <process/metrics/timer.hpp>
@@ -48,6 +55,9 @@ using http::Response;
 using http::Unauthorized;
 
 using metrics::Counter;
+using metrics::Histogram;
+using metrics::Percentiles;
+using metrics::Publisher;
 using metrics::PullGauge;
 using metrics::PushGauge;
 using metrics::Timer;
@@ -90,6 +100,39 @@ public:
 };
 
 
+class PublisherProcess : public Process<PublisherProcess>
+{
+public:
+  PublisherProcess()
+    : publisher(*this),
+      gauge(publisher.gauge("test/published", [this]() { return value; })),
+      value(0.0) {}
+
+  void set(double _value)
+  {
+    value = _value;
+  }
+
+  void remove()
+  {
+    publisher.remove(gauge);
+  }
+
+  Publisher publisher;
+  PullGauge gauge;
+
+protected:
+  void serve(process::Event&& event) override
+  {
+    Process<PublisherProcess>::serve(std::move(event));
+    publisher.served();
+  }
+
+private:
+  double value;
+};
+
+
 // TODO(greggomann): Move this into a base class in 'mesos.hpp'.
 class MetricsTest : public ::testing::Test
 {
@@ -174,6 +217,76 @@ TEST_F(MetricsTest, PullGauge)
 }
 
 
+TEST_F(MetricsTest, SampledPullGauge)
+{
+  std::atomic<double> published(1.0);
+
+  PullGauge gauge = PullGauge::sampled(
+      "test/gauge",
+      [&published]() { return published.load(); });
+
+  AWAIT_READY(metrics::add(gauge));
+
+  AWAIT_EXPECT_EQ(1.0, gauge.value());
+
+  // The value is sampled rather than cached by the gauge.
+  published.store(42.0);
+
+  AWAIT_EXPECT_EQ(42.0, gauge.value());
+
+  Future<map<string, double>> snapshot = metrics::snapshot(None());
+
+  AWAIT_READY(snapshot);
+  EXPECT_EQ(42.0, snapshot->at("test/gauge"));
+
+  AWAIT_READY(metrics::remove(gauge));
+}
+
+
+// The gauges of a publisher are sampled without dispatching to the
+// process and get published once the process served its events.
+TEST_F(MetricsTest, Publisher)
+{
+  Clock::pause();
+
+  PublisherProcess process;
+  spawn(process);
+
+  AWAIT_READY(metrics::add(process.gauge));
+
+  AWAIT_EXPECT_EQ(0.0, process.gauge.value());
+
+  dispatch(process, &PublisherProcess::set, 42.0);
+
+  Clock::settle();
+
+  AWAIT_EXPECT_EQ(42.0, process.gauge.value());
+
+  Future<map<string, double>> snapshot = metrics::snapshot(None());
+
+  AWAIT_READY(snapshot);
+  EXPECT_EQ(42.0, snapshot->at("test/published"));
+
+  // Once removed from the publisher, the gauge keeps its last value.
+  dispatch(process, &PublisherProcess::remove);
+  dispatch(process, &PublisherProcess::set, 1.0);
+
+  Clock::settle();
+
+  AWAIT_EXPECT_EQ(42.0, process.gauge.value());
+
+  terminate(process);
+  wait(process);
+
+  // The gauge can still be sampled once the process is gone.
+  AWAIT_EXPECT_EQ(42.0, process.gauge.value());
+
+  AWAIT_READY(metrics::remove(process.gauge));
+
+  Clock::resume();
+}
+
+
 TEST_F(MetricsTest, PushGauge)
 {
   // Gauge with a value.
@@ -475,6 +588,107 @@ TEST_F(MetricsTest, THREADSAFE_SnapshotTimeout)
 }
 
 
+// Ensures that a metric whose value is not ready before the snapshot
+// times out is reported with its value from the previous snapshot,
+// along with the age of that value.
+TEST_F(MetricsTest, THREADSAFE_SnapshotTimeoutCachedValue)
+{
+  UPID upid("metrics", process::address());
+
+  Clock::pause();
+
+  // Advance the clock to avoid rate limit.
+  Clock::advance(Seconds(1));
+
+  std::atomic<bool> stalled(false);
+  Promise<double> promise;
+
+  PullGauge gauge(
+      "test/gauge_stalled",
+      [&stalled, &promise]() -> Future<double> {
+        if (stalled.load()) {
+          return promise.future();
+        }
+
+        return 42.0;
+      });
+
+  AWAIT_READY(metrics::add(gauge));
+
+  Future<Response> response = http::get(upid, "snapshot", "timeout=2secs");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  Try<JSON::Object> responseJSON = JSON::parse<JSON::Object>(response->body);
+  ASSERT_SOME(responseJSON);
+
+  map<string, JSON::Value> values = responseJSON->values;
+
+  EXPECT_EQ(1u, values.count("test/gauge_stalled"));
+  EXPECT_DOUBLE_EQ(
+      42.0, values["test/gauge_stalled"].as<JSON::Number>().as<double>());
+
+  EXPECT_EQ(0u, values.count("test/gauge_stalled/staleness_secs"));
+
+  stalled.store(true);
+
+  // Advance the clock to avoid rate limit.
+  Clock::advance(Seconds(1));
+
+  response = http::get(upid, "snapshot", "timeout=2secs");
+
+  // Make sure the request is pending before the timeout is exceeded.
+  os::sleep(Milliseconds(10));
+  Clock::settle();
+
+  ASSERT_TRUE(response.isPending());
+
+  // Advance the clock to trigger the timeout.
+  Clock::advance(Seconds(2));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  responseJSON = JSON::parse<JSON::Object>(response->body);
+  ASSERT_SOME(responseJSON);
+
+  values = responseJSON->values;
+
+  EXPECT_EQ(1u, values.count("test/gauge_stalled"));
+  EXPECT_DOUBLE_EQ(
+      42.0, values["test/gauge_stalled"].as<JSON::Number>().as<double>());
+
+  // The value was taken by the first snapshot, 3 seconds ago.
+  EXPECT_EQ(1u, values.count("test/gauge_stalled/staleness_secs"));
+  EXPECT_DOUBLE_EQ(
+      3.0,
+      values["test/gauge_stalled/staleness_secs"]
+        .as<JSON::Number>().as<double>());
+
+  // The OpenMetrics exposition reports the value with a timestamp.
+  Clock::advance(Seconds(1));
+
+  response = http::get(upid, "openmetrics", "timeout=2secs");
+
+  os::sleep(Milliseconds(10));
+  Clock::settle();
+
+  ASSERT_TRUE(response.isPending());
+
+  Clock::advance(Seconds(2));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  EXPECT_TRUE(strings::contains(
+      response->body,
+      "# TYPE test_gauge_stalled gauge\n"
+      "test_gauge_stalled 42 "));
+
+  AWAIT_READY(metrics::remove(gauge));
+
+  promise.set(0.0);
+}
+
+
 // Ensures that the aggregate statistics are correct in the snapshot.
 TEST_F(MetricsTest, SnapshotStatistics)
 {
@@ -567,6 +781,119 @@ TEST_F(MetricsTest, Timer)
 }
 
 
+TEST_F(MetricsTest, Histogram)
+{
+  Histogram histogram("test/histogram");
+
+  AWAIT_READY(metrics::add(histogram));
+
+  AWAIT_FAILED(histogram.value());
+  EXPECT_NONE(histogram.statistics());
+
+  for (int i = 1; i <= 100; ++i) {
+    histogram.record(i);
+  }
+
+  AWAIT_EXPECT_EQ(100.0, histogram.value());
+
+  Option<Statistics<double>> statistics = histogram.statistics();
+  ASSERT_SOME(statistics);
+
+  EXPECT_EQ(100u, statistics->count);
+
+  // The minimum and maximum are exact, the percentiles are estimated
+  // within 1%.
+  EXPECT_DOUBLE_EQ(1.0, statistics->min);
+  EXPECT_DOUBLE_EQ(100.0, statistics->max);
+
+  EXPECT_NEAR(50.0, statistics->p50, 0.5);
+  EXPECT_NEAR(90.0, statistics->p90, 0.9);
+  EXPECT_NEAR(99.0, statistics->p99, 1.0);
+  EXPECT_NEAR(99.0, statistics->p9999, 1.0);
+
+  AWAIT_READY(metrics::remove(histogram));
+}
+
+
+TEST_F(MetricsTest, HistogramWindow)
+{
+  Clock::pause();
+
+  Histogram histogram("test/histogram", Seconds(10));
+
+  histogram.record(1.0);
+  histogram.record(2.0);
+
+  Clock::advance(Seconds(10));
+
+  histogram.record(3.0);
+
+  // The values of the previous window are still included.
+  Option<Statistics<double>> statistics = histogram.statistics();
+  ASSERT_SOME(statistics);
+  EXPECT_EQ(3u, statistics->count);
+
+  Clock::advance(Seconds(10));
+
+  histogram.record(4.0);
+
+  statistics = histogram.statistics();
+  ASSERT_SOME(statistics);
+  EXPECT_EQ(2u, statistics->count);
+  EXPECT_DOUBLE_EQ(3.0, statistics->min);
+  EXPECT_DOUBLE_EQ(4.0, statistics->max);
+
+  // All values are dropped after two windows without values.
+  Clock::advance(Seconds(20));
+
+  EXPECT_NONE(histogram.statistics());
+
+  Clock::resume();
+}
+
+
+TEST_F(MetricsTest, TimerEstimatedPercentiles)
+{
+  UPID upid("metrics", process::address());
+
+  Clock::pause();
+
+  Timer<Milliseconds> timer("test/timer", Hours(1), Percentiles::ESTIMATED);
+
+  AWAIT_READY(metrics::add(timer));
+
+  for (int i = 1; i <= 10; ++i) {
+    timer.start();
+    Clock::advance(Milliseconds(i));
+    timer.stop();
+  }
+
+  Future<Response> response = http::get(upid, "snapshot");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  Try<JSON::Object> responseJSON = JSON::parse<JSON::Object>(response->body);
+  ASSERT_SOME(responseJSON);
+
+  hashmap<string, double> responseValues;
+  foreachpair (const string& key,
+               const JSON::Value& value,
+               responseJSON->values) {
+    if (value.is<JSON::Number>()) {
+      responseValues[key] = value.as<JSON::Number>().as<double>();
+    }
+  }
+
+  EXPECT_DOUBLE_EQ(10.0, responseValues["test/timer_ms"]);
+  EXPECT_DOUBLE_EQ(10.0, responseValues["test/timer_ms/count"]);
+  EXPECT_DOUBLE_EQ(1.0, responseValues["test/timer_ms/min"]);
+  EXPECT_DOUBLE_EQ(10.0, responseValues["test/timer_ms/max"]);
+  EXPECT_NEAR(5.0, responseValues["test/timer_ms/p50"], 0.1);
+
+  AWAIT_READY(metrics::remove(timer));
+}
+
+
 static Future<int> advanceAndReturn()
 {
   Clock::advance(Seconds(1));
@@ -600,6 +927,214 @@ TEST_F(MetricsTest, AsyncTimer)
 }
 
 
+// Ensures that the metrics are exposed in the OpenMetrics format,
+// including labels and the distributions of values.
+TEST_F(MetricsTest, THREADSAFE_OpenMetrics)
+{
+  UPID upid("metrics", process::address());
+
+  Clock::pause();
+
+  // Advance the clock to avoid rate limit.
+  Clock::advance(Seconds(1));
+
+  Counter counter("test/counter");
+
+  PushGauge gaugeA("test/roles/a/gauge");
+  gaugeA.setLabels("test/roles/gauge", {{"role", "a"}});
+
+  PushGauge gaugeB("test/roles/b/gauge");
+  gaugeB.setLabels("test/roles/gauge", {{"role", "b"}});
+
+  Histogram histogram("test/histogram");
+
+  AWAIT_READY(metrics::add(counter));
+  AWAIT_READY(metrics::add(gaugeA));
+  AWAIT_READY(metrics::add(gaugeB));
+  AWAIT_READY(metrics::add(histogram));
+
+  ++counter;
+  gaugeA = 1;
+  gaugeB = 2;
+  histogram.record(1.0);
+  histogram.record(10.0);
+
+  Future<Response> response = http::get(upid, "openmetrics");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+  AWAIT_EXPECT_RESPONSE_HEADER_EQ(
+      "application/openmetrics-text; version=1.0.0; charset=utf-8",
+      "Content-Type",
+      response);
+
+  const string& body = response->body;
+
+  EXPECT_TRUE(strings::contains(
+      body,
+      "# TYPE test_counter counter\n"
+      "test_counter_total 1\n"));
+
+  EXPECT_TRUE(strings::contains(
+      body,
+      "# TYPE test_roles_gauge gauge\n"
+      "test_roles_gauge{role=\"a\"} 1\n"
+      "test_roles_gauge{role=\"b\"} 2\n"));
+
+  EXPECT_TRUE(strings::contains(
+      body,
+      "# TYPE test_histogram gauge\n"
+      "test_histogram 10\n"));
+
+  EXPECT_TRUE(strings::contains(
+      body,
+      "# TYPE test_histogram_distribution histogram\n"
+      "test_histogram_distribution_bucket{le=\"1\"} 1\n"
+      "test_histogram_distribution_bucket{le=\"2\"} 1\n"
+      "test_histogram_distribution_bucket{le=\"5\"} 1\n"
+      "test_histogram_distribution_bucket{le=\"10\"} 2\n"
+      "test_histogram_distribution_bucket{le=\"+Inf\"} 2\n"
+      "test_histogram_distribution_count 2\n"
+      "test_histogram_distribution_sum 11\n"));
+
+  EXPECT_TRUE(strings::endsWith(body, "# EOF\n"));
+
+  AWAIT_READY(metrics::remove(counter));
+  AWAIT_READY(metrics::remove(gaugeA));
+  AWAIT_READY(metrics::remove(gaugeB));
+  AWAIT_READY(metrics::remove(histogram));
+}
+
+
+// Metrics whose names would be exposed as the same samples, or as
+// samples of different types in the same family, can be added but
+// only the first of them (in sort order) is exposed.
+TEST_F(MetricsTest, THREADSAFE_OpenMetricsCollision)
+{
+  UPID upid("metrics", process::address());
+
+  Clock::pause();
+
+  // Advance the clock to avoid rate limit.
+  Clock::advance(Seconds(1));
+
+  PushGauge gauge("test/a/b");
+  PushGauge sanitized("test/a_b");
+  Counter counter("test/a/b_total");
+
+  // The samples of a counter get the suffix "_total".
+  Counter total("test/c");
+  PushGauge totalGauge("test/c_total");
+
+  // The samples of a distribution get the suffixes "_bucket", "_count"
+  // and "_sum", and its family the suffix "_distribution".
+  Histogram histogram("test/h");
+  PushGauge distribution("test/h/distribution");
+  PushGauge bucket("test/h/distribution_bucket");
+  PushGauge count("test/h/distribution_count");
+  PushGauge sum("test/h/distribution_sum");
+
+  // Labels keep the samples apart.
+  PushGauge gaugeA("test/roles/a/b/gauge");
+  gaugeA.setLabels("test/roles/gauge", {{"role", "a/b"}});
+
+  PushGauge gaugeB("test/roles/a_b/gauge");
+  gaugeB.setLabels("test/roles/gauge", {{"role", "a_b"}});
+
+  AWAIT_READY(metrics::add(gauge));
+  AWAIT_READY(metrics::add(sanitized));
+  AWAIT_READY(metrics::add(counter));
+  AWAIT_READY(metrics::add(total));
+  AWAIT_READY(metrics::add(totalGauge));
+  AWAIT_READY(metrics::add(histogram));
+  AWAIT_READY(metrics::add(distribution));
+  AWAIT_READY(metrics::add(bucket));
+  AWAIT_READY(metrics::add(count));
+  AWAIT_READY(metrics::add(sum));
+  AWAIT_READY(metrics::add(gaugeA));
+  AWAIT_READY(metrics::add(gaugeB));
+
+  gauge = 1;
+  sanitized = 2;
+  ++counter;
+  ++total;
+  totalGauge = 3;
+  histogram.record(1.0);
+  distribution = 4;
+  bucket = 5;
+  count = 6;
+  sum = 7;
+  gaugeA = 8;
+  gaugeB = 9;
+
+  Future<Response> response = http::get(upid, "openmetrics");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  const string& body = response->body;
+
+  EXPECT_TRUE(strings::contains(
+      body,
+      "# TYPE test_a_b gauge\n"
+      "test_a_b 1\n"
+      "# TYPE test_c counter\n"
+      "test_c_total 1\n"
+      "# TYPE test_h gauge\n"
+      "test_h 1\n"
+      "# TYPE test_h_distribution histogram\n"));
+
+  EXPECT_TRUE(strings::contains(
+      body,
+      "test_h_distribution_count 1\n"
+      "test_h_distribution_sum 1\n"
+      "# TYPE test_roles_gauge gauge\n"
+      "test_roles_gauge{role=\"a/b\"} 8\n"
+      "test_roles_gauge{role=\"a_b\"} 9\n"));
+
+  EXPECT_FALSE(strings::contains(body, "test_a_b 2\n"));
+  EXPECT_FALSE(strings::contains(body, "test_a_b_total"));
+  EXPECT_FALSE(strings::contains(body, "test_c_total 3\n"));
+  EXPECT_FALSE(strings::contains(body, "test_h_distribution 4\n"));
+  EXPECT_FALSE(strings::contains(body, "# TYPE test_h_distribution_"));
+
+  // All of the metrics are still in snapshots.
+  Future<map<string, double>> snapshot = metrics::snapshot(None());
+
+  AWAIT_READY(snapshot);
+
+  EXPECT_EQ(1, snapshot->at("test/a/b"));
+  EXPECT_EQ(2, snapshot->at("test/a_b"));
+  EXPECT_EQ(1, snapshot->at("test/a/b_total"));
+  EXPECT_EQ(3, snapshot->at("test/c_total"));
+  EXPECT_EQ(7, snapshot->at("test/h/distribution_sum"));
+
+  // Removing a metric lets the next one in sort order be exposed.
+  AWAIT_READY(metrics::remove(gauge));
+
+  // Advance the clock to avoid rate limit.
+  Clock::advance(Seconds(1));
+
+  response = http::get(upid, "openmetrics");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+  EXPECT_TRUE(strings::contains(
+      response->body,
+      "# TYPE test_a_b counter\n"
+      "test_a_b_total 1\n"));
+
+  AWAIT_READY(metrics::remove(sanitized));
+  AWAIT_READY(metrics::remove(counter));
+  AWAIT_READY(metrics::remove(total));
+  AWAIT_READY(metrics::remove(totalGauge));
+  AWAIT_READY(metrics::remove(histogram));
+  AWAIT_READY(metrics::remove(distribution));
+  AWAIT_READY(metrics::remove(bucket));
+  AWAIT_READY(metrics::remove(count));
+  AWAIT_READY(metrics::remove(sum));
+  AWAIT_READY(metrics::remove(gaugeA));
+  AWAIT_READY(metrics::remove(gaugeB));
+}
+
+
 // Tests that the `/metrics/snapshot` endpoint rejects unauthenticated requests
 // when HTTP authentication is enabled.
 TEST_F(MetricsTest, THREADSAFE_SnapshotAuthenticationEnabled)
@@ -22,9 +22,12 @@
 #ifndef __WINDOWS__
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/socket.h>
 #endif // __WINDOWS__
 
 #include <atomic>
+#include <functional>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -40,6 +43,7 @@
 #include <process/future.hpp>
 #include <process/gmock.hpp>
 #include <process/gtest.hpp>
+#include <process/http.hpp>
 #include <process/network.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
@@ -49,15 +53,19 @@
 #include <process/subprocess.hpp>
 #include <process/time.hpp>
 
+#include <process/metrics/metrics.hpp>
+
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
+#include <stout/json.hpp>
 #include <stout/lambda.hpp>
 #include <stout/nothing.hpp>
 #include <stout/os.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
+#include <stout/strings.hpp>
 #include <stout/try.hpp>
 
 #include <stout/os/killtree.hpp>
@@ -74,6 +82,7 @@ using process::Clock;
 using process::CountDownLatch;
 using process::defer;
 using process::Deferred;
+using process::DispatchEvent;
 using process::Event;
 using process::Executor;
 using process::ExitedEvent;
@@ -85,6 +94,7 @@ using process::Owned;
 using process::PID;
 using process::Process;
 using process::ProcessBase;
+using process::Promise;
 using process::run;
 using process::Subprocess;
 using process::TerminateEvent;
@@ -108,6 +118,17 @@ using testing::InvokeWithoutArgs;
 using testing::Return;
 using testing::ReturnArg;
 
+namespace process {
+
+// We need to reinitialize libprocess in order to test against different
+// configurations, such as when libprocess is given a resume budget.
+void reinitialize(
+    const Option<string>& delegate,
+    const Option<string>& readwriteAuthenticationRealm,
+    const Option<string>& readonlyAuthenticationRealm);
+
+} // namespace process {
+
 // TODO(bmahler): Move tests into their own files as appropriate.
 
 TEST(ProcessTest, Event)
@@ -1195,6 +1216,679 @@ TEST(ProcessTest, Settle)
 }
 
 
+// Blocks the worker thread running it until released, so that events
+// can be queued up behind the blocking event.
+class BlockingProcess : public Process<BlockingProcess>
+{
+public:
+  explicit BlockingProcess(const string& id = "")
+    : ProcessBase(id), served(0) {}
+
+  void block(std::atomic_bool* started, std::atomic_bool* released)
+  {
+    started->store(true);
+    while (!released->load()) {
+      os::sleep(Milliseconds(1));
+    }
+  }
+
+  void serve()
+  {
+    served.fetch_add(1);
+  }
+
+  size_t dispatches()
+  {
+    return eventCount<DispatchEvent>();
+  }
+
+  std::atomic<size_t> served;
+};
+
+
+// Returns the statistics of the process with the given ID in the
+// response of the `/__process_stats__` endpoint.
+static Option<JSON::Object> statistics(
+    const http::Response& response,
+    const string& id)
+{
+  Try<JSON::Array> array = JSON::parse<JSON::Array>(response.body);
+  if (array.isError()) {
+    return None();
+  }
+
+  foreach (const JSON::Value& value, array->values) {
+    if (!value.is<JSON::Object>()) {
+      continue;
+    }
+
+    const JSON::Object& object = value.as<JSON::Object>();
+
+    Result<JSON::String> processId = object.find<JSON::String>("id");
+    if (processId.isSome() && processId->value == id) {
+      return object;
+    }
+  }
+
+  return None();
+}
+
+
+// Events that were dequeued as part of a batch but not yet served are
+// still part of the process' event queue.
+TEST(ProcessTest, BatchedEvents)
+{
+  BlockingProcess process;
+  PID<BlockingProcess> pid = spawn(process);
+
+  std::atomic_bool started(false);
+  std::atomic_bool released(false);
+
+  dispatch(pid, &BlockingProcess::block, &started, &released);
+
+  while (!started.load()) {
+    os::sleep(Milliseconds(1));
+  }
+
+  // These all get dequeued at once when the process is released.
+  Future<size_t> dispatches = dispatch(pid, &BlockingProcess::dispatches);
+
+  for (int i = 0; i < 4; i++) {
+    dispatch(pid, &BlockingProcess::serve);
+  }
+
+  released.store(true);
+
+  AWAIT_EXPECT_EQ(4u, dispatches);
+
+  terminate(process);
+  wait(process);
+}
+
+
+// The event counters can be read from outside of the process, e.g.,
+// while the process is busy serving an event.
+TEST(ProcessTest, EventCounter)
+{
+  BlockingProcess process;
+  PID<BlockingProcess> pid = spawn(process);
+
+  const std::function<size_t()> dispatches =
+    process.eventCounter<DispatchEvent>();
+
+  const std::function<size_t()> messages =
+    process.eventCounter<MessageEvent>();
+
+  std::atomic_bool started(false);
+  std::atomic_bool released(false);
+
+  dispatch(pid, &BlockingProcess::block, &started, &released);
+
+  while (!started.load()) {
+    os::sleep(Milliseconds(1));
+  }
+
+  EXPECT_EQ(0u, dispatches());
+
+  for (int i = 0; i < 4; i++) {
+    dispatch(pid, &BlockingProcess::serve);
+  }
+
+  EXPECT_EQ(4u, dispatches());
+  EXPECT_EQ(0u, messages());
+
+  released.store(true);
+
+  AWAIT_EXPECT_EQ(0u, dispatch(pid, &BlockingProcess::dispatches));
+
+  EXPECT_EQ(0u, dispatches());
+  EXPECT_EQ(4u, process.served.load());
+
+  terminate(process);
+  wait(process);
+
+  // The counter remains readable once the process is gone.
+  EXPECT_EQ(0u, dispatches());
+}
+
+
+class ProcessResumeBudgetTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    // With a single worker thread the processes can only get served
+    // one after another, which makes the preemptions observable.
+    os::setenv("LIBPROCESS_NUM_WORKER_THREADS", "1");
+    os::setenv("LIBPROCESS_RESUME_EVENT_BUDGET", "1");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+
+  void TearDown() override
+  {
+    os::unsetenv("LIBPROCESS_NUM_WORKER_THREADS");
+    os::unsetenv("LIBPROCESS_RESUME_EVENT_BUDGET");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+};
+
+
+// A process with a backlog of events gets put back in the run queue
+// once it exhausts its budget, so other processes get served before
+// it has worked through its backlog.
+TEST_F(ProcessResumeBudgetTest, Fairness)
+{
+  BlockingProcess backlogged;
+  PID<BlockingProcess> pid = spawn(backlogged);
+
+  BlockingProcess other;
+  spawn(other);
+
+  std::atomic_bool started(false);
+  std::atomic_bool released(false);
+
+  dispatch(pid, &BlockingProcess::block, &started, &released);
+
+  while (!started.load()) {
+    os::sleep(Milliseconds(1));
+  }
+
+  const size_t backlog = 100;
+
+  for (size_t i = 0; i < backlog; i++) {
+    dispatch(pid, &BlockingProcess::serve);
+  }
+
+  // Returns how many events of the backlogged process were served
+  // once `other` got to run.
+  Future<size_t> served = dispatch(other.self(), [&backlogged]() {
+    return backlogged.served.load();
+  });
+
+  Future<Nothing> drained = dispatch(pid, []() { return Nothing(); });
+
+  released.store(true);
+
+  AWAIT_READY(served);
+  AWAIT_READY(drained);
+
+  EXPECT_LT(served.get(), backlog);
+  EXPECT_EQ(backlog, backlogged.served.load());
+
+  // Each of the events queued up behind the blocking event got served
+  // after a preemption.
+  Future<http::Response> response = http::get(http::URL(
+      "http",
+      process::address().ip,
+      process::address().port,
+      "/__process_stats__"));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+
+  Option<JSON::Object> backloggedStatistics =
+    statistics(response.get(), pid.id);
+
+  ASSERT_SOME(backloggedStatistics);
+  EXPECT_SOME_EQ(
+      JSON::Number(backlog + 1),
+      backloggedStatistics->find<JSON::Number>("preemptions"));
+
+  terminate(other);
+  wait(other);
+
+  terminate(backlogged);
+  wait(backlogged);
+}
+
+
+class ProcessRunQueueTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    // Use more worker threads than there are likely to be cores, so
+    // that workers regularly run out of processes and steal them from
+    // each other (with the work-stealing run queue).
+    os::setenv("LIBPROCESS_NUM_WORKER_THREADS", "8");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+
+  void TearDown() override
+  {
+    os::unsetenv("LIBPROCESS_NUM_WORKER_THREADS");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+};
+
+
+// Relays each event along a chain of processes for a number of hops.
+// At each hop it also sends a "leaf" event to yet another process, so
+// that the workers enqueue more than one process at a time.
+class RelayProcess : public Process<RelayProcess>
+{
+public:
+  RelayProcess(
+      const vector<PID<RelayProcess>>* _relays,
+      size_t _hops,
+      vector<std::atomic<size_t>>* _served,
+      std::atomic<size_t>* _remaining,
+      Promise<Nothing>* _done)
+    : relays(_relays),
+      hops(_hops),
+      served(_served),
+      remaining(_remaining),
+      done(_done) {}
+
+  // Returns the index of the given event in `served`.
+  static size_t index(size_t hops, size_t event, size_t hop, bool leaf)
+  {
+    return (event * (hops + 1) + hop) * 2 + (leaf ? 1 : 0);
+  }
+
+  void relay(size_t event, size_t hop, bool leaf)
+  {
+    (*served)[index(hops, event, hop, leaf)].fetch_add(1);
+
+    // Occasionally hold up the worker so that the processes in its
+    // local queue get stolen by other workers.
+    if (leaf && hop % 8 == 0) {
+      os::sleep(Microseconds(100));
+    }
+
+    if (!leaf && hop < hops) {
+      const size_t count = relays->size();
+
+      dispatch(
+          (*relays)[(event + hop + 1) % count],
+          &RelayProcess::relay,
+          event,
+          hop + 1,
+          false);
+
+      dispatch(
+          (*relays)[(event * 31 + hop * 17) % count],
+          &RelayProcess::relay,
+          event,
+          hop + 1,
+          true);
+    }
+
+    if (remaining->fetch_sub(1) == 1) {
+      done->set(Nothing());
+    }
+  }
+
+private:
+  const vector<PID<RelayProcess>>* relays;
+  const size_t hops;
+  vector<std::atomic<size_t>>* served;
+  std::atomic<size_t>* remaining;
+  Promise<Nothing>* done;
+};
+
+
+// Runs many processes across the workers, most of which get enqueued
+// by the workers themselves (i.e., put in their local queues when
+// using the work-stealing run queue, see run_queue.hpp), and checks
+// that each event is served exactly once.
+TEST_F(ProcessRunQueueTest, EventsServedOnce)
+{
+  // There are fewer events in flight than processes, so most events
+  // get sent to a process which is not already in the run queue.
+  const size_t processes = 256;
+  const size_t events = 64;
+  const size_t hops = 200;
+
+  vector<PID<RelayProcess>> relays;
+  vector<std::atomic<size_t>> served(events * (hops + 1) * 2);
+  std::atomic<size_t> remaining(events * (2 * hops + 1));
+  Promise<Nothing> done;
+
+  vector<Owned<RelayProcess>> owned;
+
+  for (size_t i = 0; i < processes; i++) {
+    owned.push_back(Owned<RelayProcess>(
+        new RelayProcess(&relays, hops, &served, &remaining, &done)));
+
+    relays.push_back(spawn(owned.back().get()));
+  }
+
+  for (size_t event = 0; event < events; event++) {
+    dispatch(
+        relays[event % processes], &RelayProcess::relay, event, 0u, false);
+  }
+
+  AWAIT_READY(done.future());
+
+  for (size_t event = 0; event < events; event++) {
+    for (size_t hop = 0; hop <= hops; hop++) {
+      ASSERT_EQ(
+          1u,
+          served[RelayProcess::index(hops, event, hop, false)].load())
+        << "Event " << event << " at hop " << hop;
+
+      // There is no leaf event at the first hop.
+      ASSERT_EQ(
+          hop == 0 ? 0u : 1u,
+          served[RelayProcess::index(hops, event, hop, true)].load())
+        << "Leaf event " << event << " at hop " << hop;
+    }
+  }
+
+  foreach (const Owned<RelayProcess>& relay, owned) {
+    terminate(relay.get());
+    wait(relay.get());
+  }
+}
+
+
+// The statistics of all processes are served by `/__process_stats__`,
+// the processes which spent the most time serving events first.
+TEST(ProcessTest, ProcessStats)
+{
+  BlockingProcess process;
+  PID<BlockingProcess> pid = spawn(process);
+
+  const size_t dispatches = 10;
+
+  for (size_t i = 0; i < dispatches; i++) {
+    dispatch(pid, &BlockingProcess::serve);
+  }
+
+  // The events above have been recorded once this one gets served.
+  AWAIT_READY(dispatch(pid, &BlockingProcess::dispatches));
+
+  http::URL url(
+      "http",
+      process::address().ip,
+      process::address().port,
+      "/__process_stats__");
+
+  Future<http::Response> response = http::get(url);
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+
+  Option<JSON::Object> processStatistics = statistics(response.get(), pid.id);
+  ASSERT_SOME(processStatistics);
+
+  Result<JSON::Number> served =
+    processStatistics->find<JSON::Number>("events.dispatch");
+
+  ASSERT_SOME(served);
+  EXPECT_LE(dispatches, served->as<uint64_t>());
+
+  ASSERT_SOME(processStatistics->find<JSON::Number>("handler_time_ms"));
+  ASSERT_SOME(processStatistics->find<JSON::Number>("wait_time_us.count"));
+
+  url.query["limit"] = "1";
+  response = http::get(url);
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+
+  Try<JSON::Array> array = JSON::parse<JSON::Array>(response->body);
+  ASSERT_SOME(array);
+  EXPECT_EQ(1u, array->values.size());
+
+  url.query["limit"] = "one";
+  response = http::get(url);
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::BadRequest().status, response);
+
+  terminate(process);
+  wait(process);
+}
+
+
+class ProcessMetricsTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    // The `help` and `metrics` processes are spawned before metrics
+    // can be added, so they must not expose their statistics.
+    os::setenv("LIBPROCESS_PROCESS_METRICS", "blocking,help,metrics");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+
+  void TearDown() override
+  {
+    os::unsetenv("LIBPROCESS_PROCESS_METRICS");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+};
+
+
+// The statistics of the processes selected by the `process_metrics`
+// flag are exposed as metrics until the processes terminate.
+TEST_F(ProcessMetricsTest, Gauges)
+{
+  BlockingProcess process("blocking");
+  PID<BlockingProcess> pid = spawn(process);
+
+  BlockingProcess other;
+  spawn(other);
+
+  const size_t dispatches = 10;
+
+  for (size_t i = 0; i < dispatches; i++) {
+    dispatch(pid, &BlockingProcess::serve);
+  }
+
+  // The events above have been recorded once this one gets served.
+  AWAIT_READY(dispatch(pid, &BlockingProcess::dispatches));
+
+  Future<std::map<string, double>> snapshot =
+    process::metrics::snapshot(None());
+
+  AWAIT_READY(snapshot);
+
+  const string gauge = "process/blocking/events/dispatch";
+
+  ASSERT_EQ(1u, snapshot->count(gauge));
+  EXPECT_LE(dispatches, snapshot->at(gauge));
+
+  EXPECT_EQ(1u, snapshot->count("process/blocking/wait_time_us/max"));
+  EXPECT_EQ(1u, snapshot->count("process/blocking/preemptions"));
+
+  foreachkey (const string& key, snapshot.get()) {
+    EXPECT_FALSE(strings::startsWith(key, "process/help")) << key;
+    EXPECT_FALSE(strings::startsWith(key, "process/metrics")) << key;
+    EXPECT_FALSE(strings::startsWith(key, "process/" + other.self().id))
+      << key;
+  }
+
+  terminate(process);
+  wait(process);
+
+  snapshot = process::metrics::snapshot(None());
+
+  AWAIT_READY(snapshot);
+  EXPECT_EQ(0u, snapshot->count(gauge));
+
+  terminate(other);
+  wait(other);
+}
+
+
+class ProcessMessageCoalescingTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    os::setenv("LIBPROCESS_MESSAGE_COALESCING_BUDGET", "1MB");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+
+  void TearDown() override
+  {
+    os::unsetenv("LIBPROCESS_MESSAGE_COALESCING_BUDGET");
+
+    process::reinitialize(
+        None(),
+        process::READWRITE_HTTP_AUTHENTICATION_REALM,
+        process::READONLY_HTTP_AUTHENTICATION_REALM);
+  }
+};
+
+
+// Links to the given process so that messages to it get sent over a
+// persistent link.
+class LinkedSenderProcess : public Process<LinkedSenderProcess>
+{
+public:
+  explicit LinkedSenderProcess(const UPID& to) : to(to) {}
+
+  void initialize() override
+  {
+    link(to);
+  }
+
+  Nothing send(const vector<Message>& messages)
+  {
+    foreach (const Message& message, messages) {
+      ProcessBase::send(
+          message.to,
+          message.name,
+          message.body.data(),
+          message.body.size());
+    }
+
+    return Nothing();
+  }
+
+private:
+  const UPID to;
+};
+
+
+// The messages queued on a persistent link get coalesced, i.e., sent
+// with fewer writes, without changing the bytes on the wire.
+TEST_F_TEMP_DISABLED_ON_WINDOWS(ProcessMessageCoalescingTest, PersistentLink)
+{
+  Try<Socket> server = Socket::create();
+  ASSERT_SOME(server);
+
+  // With a small receive buffer, the writes of the link stall while we
+  // don't read, so the messages queue up on the link.
+  int size = 4096;
+  ASSERT_EQ(
+      0,
+      ::setsockopt(
+          server->get(), SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)));
+
+  Try<Address> address = server->bind(Address(process::address().ip, 0));
+  ASSERT_SOME(address);
+  ASSERT_SOME(server->listen(1));
+
+  Future<Socket> accept = server->accept();
+
+  const UPID receiver("receiver", address.get());
+
+  LinkedSenderProcess sender(receiver);
+
+  // Interleave two kinds of messages, with empty and non-empty bodies
+  // of different sizes. The bodies are tagged with the index of the
+  // message, so the expected bytes also check the ordering. Together,
+  // the messages are larger than what the socket buffers can hold.
+  const size_t count = 10000;
+
+  vector<Message> messages;
+  string expected;
+
+  for (size_t i = 0; i < count; i++) {
+    Message message;
+    message.name = i % 2 == 0 ? "ping" : "pong";
+    message.from = sender.self();
+    message.to = receiver;
+
+    if (i % 3 != 0) {
+      message.body = stringify(i) + string((i % 3) * 1024, '.');
+    }
+
+    expected += MessageEncoder::encode(message);
+    messages.push_back(message);
+  }
+
+  spawn(sender);
+
+  AWAIT_READY(accept);
+
+  Socket socket = accept.get();
+
+  // All the messages get queued before we start reading.
+  AWAIT_READY(dispatch(sender, &LinkedSenderProcess::send, messages));
+
+  string received;
+  while (received.size() < expected.size()) {
+    Future<string> data = socket.recv();
+    AWAIT_READY(data);
+    ASSERT_FALSE(data->empty());
+
+    received += data.get();
+  }
+
+  // NOTE: We don't compare the bytes with `EXPECT_EQ` to avoid printing
+  // all the messages on failure.
+  EXPECT_EQ(expected.size(), received.size());
+  EXPECT_TRUE(expected == received);
+
+  // The messages are counted as sent once their last write completes,
+  // which can happen after we received them.
+  std::map<string, double> values;
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  do {
+    Future<std::map<string, double>> snapshot =
+      process::metrics::snapshot(None());
+
+    AWAIT_READY(snapshot);
+    values = snapshot.get();
+
+    if (values["libprocess/messages_sent"] >= count) {
+      break;
+    }
+
+    os::sleep(Milliseconds(10));
+  } while (stopwatch.elapsed() < process::TEST_AWAIT_TIMEOUT);
+
+  EXPECT_EQ(count, values["libprocess/messages_sent"]);
+  EXPECT_LT(values["libprocess/message_writes"], count);
+
+  terminate(sender);
+  wait(sender);
+}
+
+
 TEST(ProcessTest, Pid)
 {
   TimeoutProcess process;
@@ -0,0 +1,221 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <process/clock.hpp>
+#include <process/quantile_sketch.hpp>
+#include <process/statistics.hpp>
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/gtest.hpp>
+
+using process::Clock;
+using process::QuantileSketch;
+using process::SlidingQuantileSketch;
+using process::Statistics;
+using process::Time;
+
+using std::vector;
+
+TEST(QuantileSketchTest, Empty)
+{
+  QuantileSketch sketch;
+
+  EXPECT_EQ(0u, sketch.count());
+  EXPECT_NONE(sketch.quantile(0.5));
+  EXPECT_NONE(sketch.statistics());
+
+  sketch.record(1.0);
+
+  EXPECT_SOME_EQ(1.0, sketch.quantile(0.5));
+  EXPECT_NONE(sketch.statistics());
+}
+
+
+TEST(QuantileSketchTest, RelativeAccuracy)
+{
+  // Values spanning many orders of magnitude, including values outside
+  // the range of the buckets.
+  vector<double> values;
+
+  std::mt19937 generator(42);
+  std::lognormal_distribution<double> distribution(0.0, 4.0);
+
+  for (int i = 0; i < 10000; ++i) {
+    values.push_back(distribution(generator));
+  }
+
+  QuantileSketch sketch;
+
+  foreach (double value, values) {
+    sketch.record(value);
+  }
+
+  std::sort(values.begin(), values.end());
+
+  EXPECT_EQ(values.size(), sketch.count());
+  EXPECT_DOUBLE_EQ(values.front(), sketch.min());
+  EXPECT_DOUBLE_EQ(values.back(), sketch.max());
+
+  foreach (double q, vector<double>({0.0, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0})) {
+    const double expected =
+      values[static_cast<size_t>(q * (values.size() - 1))];
+
+    Option<double> estimate = sketch.quantile(q);
+    ASSERT_SOME(estimate);
+
+    EXPECT_NEAR(expected, estimate.get(), expected * 0.01) << q;
+  }
+}
+
+
+TEST(QuantileSketchTest, NonPositive)
+{
+  QuantileSketch sketch;
+
+  sketch.record(-1.0);
+  sketch.record(0.0);
+  sketch.record(0.0);
+  sketch.record(1.0);
+
+  Option<Statistics<double>> statistics = sketch.statistics();
+  ASSERT_SOME(statistics);
+
+  EXPECT_EQ(4u, statistics->count);
+  EXPECT_DOUBLE_EQ(-1.0, statistics->min);
+  EXPECT_DOUBLE_EQ(1.0, statistics->max);
+  EXPECT_DOUBLE_EQ(0.0, statistics->p50);
+}
+
+
+TEST(QuantileSketchTest, Merge)
+{
+  QuantileSketch sketch1;
+  QuantileSketch sketch2;
+  QuantileSketch sketch;
+
+  for (int i = 1; i <= 1000; ++i) {
+    (i % 2 == 0 ? sketch1 : sketch2).record(i);
+    sketch.record(i);
+  }
+
+  sketch1.merge(sketch2);
+
+  EXPECT_EQ(sketch.count(), sketch1.count());
+  EXPECT_EQ(sketch.min(), sketch1.min());
+  EXPECT_EQ(sketch.max(), sketch1.max());
+
+  foreach (double q, vector<double>({0.5, 0.9, 0.99})) {
+    EXPECT_SOME_EQ(sketch.quantile(q).get(), sketch1.quantile(q));
+  }
+}
+
+
+TEST(QuantileSketchTest, Cumulative)
+{
+  QuantileSketch sketch;
+
+  for (int i = 1; i <= 100; ++i) {
+    sketch.record(i);
+  }
+
+  EXPECT_EQ(5050.0, sketch.sum());
+
+  vector<uint64_t> counts = sketch.cumulative({0.5, 1.0, 10.0, 50.0, 1e6});
+
+  ASSERT_EQ(5u, counts.size());
+  EXPECT_EQ(0u, counts[0]);
+  EXPECT_EQ(1u, counts[1]);
+  EXPECT_EQ(10u, counts[2]);
+  EXPECT_EQ(50u, counts[3]);
+  EXPECT_EQ(100u, counts[4]);
+}
+
+
+TEST(QuantileSketchTest, THREADSAFE_Record)
+{
+  QuantileSketch sketch;
+
+  vector<std::thread> threads;
+
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&sketch, i]() {
+      for (int j = 0; j < 10000; ++j) {
+        sketch.record(i * 10000 + j + 1);
+      }
+    });
+  }
+
+  foreach (std::thread& thread, threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(40000u, sketch.count());
+  EXPECT_DOUBLE_EQ(1.0, sketch.min());
+  EXPECT_DOUBLE_EQ(40000.0, sketch.max());
+
+  Option<double> median = sketch.quantile(0.5);
+  ASSERT_SOME(median);
+  EXPECT_NEAR(20000.0, median.get(), 200.0);
+}
+
+
+TEST(QuantileSketchTest, Sliding)
+{
+  Clock::pause();
+
+  SlidingQuantileSketch sketch(Seconds(10));
+
+  const Time start = Clock::now();
+
+  for (int i = 1; i <= 100; ++i) {
+    sketch.record(i, start);
+  }
+
+  // The values of the previous interval are still included.
+  sketch.record(1000.0, start + Seconds(10));
+  sketch.record(1000.0, start + Seconds(10));
+
+  Option<Statistics<double>> statistics =
+    sketch.statistics(start + Seconds(10));
+
+  ASSERT_SOME(statistics);
+  EXPECT_EQ(102u, statistics->count);
+  EXPECT_DOUBLE_EQ(1.0, statistics->min);
+
+  // Once they are older than two windows, they are not.
+  statistics = sketch.statistics(start + Seconds(20));
+
+  ASSERT_SOME(statistics);
+  EXPECT_EQ(2u, statistics->count);
+  EXPECT_DOUBLE_EQ(1000.0, statistics->min);
+
+  // Without a window, the sketch (and its total) includes all values.
+  SlidingQuantileSketch total;
+
+  total.record(1.0);
+  total.record(2.0);
+
+  ASSERT_SOME(total.total());
+  EXPECT_EQ(2u, total.total().get()->count());
+  EXPECT_SOME(total.statistics());
+
+  Clock::resume();
+}
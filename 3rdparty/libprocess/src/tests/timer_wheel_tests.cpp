@@ -0,0 +1,284 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <stdint.h>
+
+#include <list>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <process/clock.hpp>
+#include <process/future.hpp>
+#include <process/gtest.hpp>
+#include <process/time.hpp>
+#include <process/timer.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/gtest.hpp>
+#include <stout/nothing.hpp>
+
+#include "timer_wheel.hpp"
+
+using process::Clock;
+using process::Future;
+using process::Promise;
+using process::Time;
+using process::Timer;
+using process::TimerWheel;
+
+using std::list;
+using std::vector;
+
+
+class TimerWheelTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    Clock::pause();
+    start = Clock::now();
+  }
+
+  virtual void TearDown()
+  {
+    Clock::resume();
+  }
+
+  // Returns a timer which expires at the given time (not before the
+  // current time of the paused clock) and records the given value in
+  // `fired` when invoked. The timer is created via the clock (as its
+  // constructor is private) and then canceled, so that it only gets
+  // added to the wheel under test.
+  Timer timer(const Time& time, int value)
+  {
+    Timer timer = Clock::timer(time - Clock::now(), [=]() {
+      fired.push_back(value);
+    });
+
+    Clock::cancel(timer);
+
+    return timer;
+  }
+
+  // Returns the first time after `time` at which the block of the given
+  // level of the wheel changes, i.e., at which the timers in the next
+  // slot of the level above get cascaded.
+  static Time boundary(const Time& time, size_t level)
+  {
+    // Ticks are 2^20 nanoseconds and each level has 2^6 slots.
+    const int64_t block = int64_t(1) << (20 + 6 * (level + 1));
+    const int64_t nanoseconds = time.duration().ns();
+
+    return Time::epoch() +
+           Nanoseconds(nanoseconds - nanoseconds % block + block);
+  }
+
+  static void invoke(const list<Timer>& timers)
+  {
+    foreach (const Timer& timer, timers) {
+      timer();
+    }
+  }
+
+  Time start;
+  vector<int> fired;
+};
+
+
+// Tests that timers which are kept at higher levels of the wheel are
+// cascaded down and expire exactly at their timeouts.
+TEST_F(TimerWheelTest, Cascade)
+{
+  TimerWheel wheel;
+
+  // Move the wheel to the current time.
+  EXPECT_TRUE(wheel.expire(start).empty());
+
+  // The timers get kept at increasing levels of the wheel, up to 4.
+  const vector<Time> timeouts = {
+    start + Milliseconds(1),
+    boundary(start, 0) + Milliseconds(1),
+    boundary(start, 1) + Milliseconds(2),
+    boundary(start, 2) + Milliseconds(3),
+    boundary(start, 3) + Milliseconds(4),
+  };
+
+  // Insert the timers in reverse order.
+  for (size_t i = timeouts.size(); i > 0; i--) {
+    wheel.insert(i, timer(timeouts[i - 1], i));
+  }
+
+  EXPECT_EQ(timeouts.size(), wheel.size());
+
+  for (size_t i = 0; i < timeouts.size(); i++) {
+    const Time& timeout = timeouts[i];
+
+    // The earliest timeout may be approximated before the timer got
+    // cascaded to the lowest level, but never beyond the timeout.
+    Option<Time> earliest = wheel.earliest(start);
+    ASSERT_SOME(earliest);
+    EXPECT_LE(earliest.get(), timeout);
+
+    EXPECT_TRUE(wheel.expire(timeout - Nanoseconds(1)).empty());
+    EXPECT_SOME_EQ(timeout, wheel.earliest(timeout));
+
+    invoke(wheel.expire(timeout));
+
+    EXPECT_EQ(vector<int>(1, i + 1), fired);
+    EXPECT_EQ(timeouts.size() - i - 1, wheel.size());
+
+    fired.clear();
+    start = timeout;
+  }
+
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_NONE(wheel.earliest(start));
+}
+
+
+// Tests that a timer can be canceled after it has been cascaded to a
+// lower level of the wheel.
+TEST_F(TimerWheelTest, CancelAfterCascade)
+{
+  TimerWheel wheel;
+
+  EXPECT_TRUE(wheel.expire(start).empty());
+
+  const Time timeout = boundary(start, 2) + Milliseconds(5);
+
+  wheel.insert(1, timer(timeout, 1));
+  wheel.insert(2, timer(timeout + Seconds(1), 2));
+
+  // Cascade the timers down from level 3.
+  EXPECT_SOME_EQ(timeout, wheel.earliest(timeout));
+
+  EXPECT_TRUE(wheel.cancel(1));
+  EXPECT_FALSE(wheel.cancel(1));
+
+  EXPECT_EQ(1u, wheel.size());
+
+  invoke(wheel.expire(timeout));
+
+  EXPECT_TRUE(fired.empty());
+
+  EXPECT_TRUE(wheel.cancel(2));
+
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_NONE(wheel.earliest(timeout + Seconds(1)));
+
+  invoke(wheel.expire(timeout + Seconds(1)));
+
+  EXPECT_TRUE(fired.empty());
+}
+
+
+// Tests that timers with the same timeout expire in insertion order,
+// even if some of them were inserted before and others after the
+// timeout was cascaded, and that the ids do not affect the order.
+TEST_F(TimerWheelTest, EqualTimeoutsExpireInInsertionOrder)
+{
+  TimerWheel wheel;
+
+  EXPECT_TRUE(wheel.expire(start).empty());
+
+  const Time timeout = boundary(start, 1) + Milliseconds(7);
+
+  wheel.insert(30, timer(timeout, 1));
+  wheel.insert(10, timer(timeout + Milliseconds(1), 4));
+  wheel.insert(20, timer(timeout, 2));
+
+  // Cascade the timers, then insert another timer with the same
+  // timeout (directly into level 0).
+  EXPECT_TRUE(wheel.expire(timeout - Milliseconds(1)).empty());
+
+  wheel.insert(5, timer(timeout, 3));
+
+  invoke(wheel.expire(timeout + Milliseconds(1)));
+
+  EXPECT_EQ(vector<int>({1, 2, 3, 4}), fired);
+  EXPECT_TRUE(wheel.empty());
+}
+
+
+// Tests that timers which are already past due when inserted expire
+// right away, before any later timers.
+TEST_F(TimerWheelTest, PastDue)
+{
+  TimerWheel wheel;
+
+  const Time now = boundary(start, 1) + Milliseconds(3);
+
+  wheel.insert(1, timer(now + Milliseconds(1), 3));
+
+  EXPECT_TRUE(wheel.expire(now).empty());
+
+  // These are already past due, by more than a block of level 0 and
+  // by a nanosecond.
+  wheel.insert(2, timer(start + Milliseconds(1), 1));
+  wheel.insert(3, timer(now - Nanoseconds(1), 2));
+
+  EXPECT_SOME_EQ(start + Milliseconds(1), wheel.earliest(now));
+
+  invoke(wheel.expire(now));
+
+  EXPECT_EQ(vector<int>({1, 2}), fired);
+  EXPECT_EQ(1u, wheel.size());
+
+  invoke(wheel.expire(now + Milliseconds(1)));
+
+  EXPECT_EQ(vector<int>({1, 2, 3}), fired);
+  EXPECT_TRUE(wheel.empty());
+}
+
+
+// Tests that the clock fires the timers which were cascaded while it
+// was advanced across several level boundaries of the wheel, and that
+// it keeps firing (and not firing) timers once it is resumed.
+TEST_F(TimerWheelTest, ClockResumeAfterAdvance)
+{
+  Promise<Nothing> promise1;
+  Promise<Nothing> promise2;
+  Promise<Nothing> promise3;
+  Promise<Nothing> promise4;
+
+  // These are kept at different levels of the wheel.
+  Clock::timer(Milliseconds(10), [&]() { promise1.set(Nothing()); });
+  Clock::timer(Seconds(1), [&]() { promise2.set(Nothing()); });
+  Clock::timer(Minutes(1), [&]() { promise3.set(Nothing()); });
+
+  Timer timer4 =
+    Clock::timer(Hours(10), [&]() { promise4.set(Nothing()); });
+
+  // Advance across many blocks of levels 0 to 2 of the wheel, which
+  // cascades the timers down as they expire.
+  Clock::advance(Hours(2));
+  Clock::settle();
+
+  EXPECT_TRUE(promise1.future().isReady());
+  EXPECT_TRUE(promise2.future().isReady());
+  EXPECT_TRUE(promise3.future().isReady());
+  EXPECT_TRUE(promise4.future().isPending());
+
+  Clock::resume();
+
+  // Timers keep firing once the clock is resumed, at the time relative
+  // to the advanced clock.
+  Promise<Nothing> promise5;
+  Clock::timer(Milliseconds(10), [&]() { promise5.set(Nothing()); });
+
+  AWAIT_READY(promise5.future());
+
+  EXPECT_TRUE(promise4.future().isPending());
+  EXPECT_TRUE(Clock::cancel(timer4));
+}
@@ -0,0 +1,373 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_TIMER_WHEEL_HPP__
+#define __PROCESS_TIMER_WHEEL_HPP__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include <process/time.hpp>
+#include <process/timer.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/none.hpp>
+#include <stout/option.hpp>
+
+namespace process {
+
+// A hierarchical timing wheel holding the pending timers of the clock,
+// see "Hashed and Hierarchical Timing Wheels" by Varghese and Lauck.
+//
+// Time is divided into ticks of 2^20 nanoseconds (~1ms). Level 0 of
+// the wheel has a slot for each tick of the current block of 64 ticks
+// (i.e., the block containing `base`), level 1 has a slot for each
+// block of 64 ticks of the current block of 64^2 ticks, and so on. A
+// timer is kept at the lowest level whose current block contains its
+// tick, which makes inserting and canceling a timer O(1) (unlike with
+// a sorted map). When `base` moves into another block, the timers in
+// the slot of the higher level which corresponds to the new block get
+// "cascaded", i.e., moved down to the lower levels.
+//
+// All timers at a level are earlier than the timers at the levels
+// above it, so the earliest timers are in the first occupied slot of
+// the lowest occupied level. Since the ticks only determine where the
+// timers are kept, we still compare the exact timeouts of the timers
+// in a slot of level 0 when expiring timers.
+//
+// NOTE: This is not thread-safe, the clock synchronizes all access.
+class TimerWheel
+{
+public:
+  TimerWheel() : base(0), sequence(0)
+  {
+    masks.fill(0);
+  }
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // Adds the timer with the given (unique) id.
+  void insert(uint64_t id, const Timer& timer)
+  {
+    Slot slot;
+    slot.push_back(
+        Entry{id, sequence++, tickOf(timer.timeout().time()), timer});
+
+    place(&slot, slot.begin());
+  }
+
+  // Removes the timer with the given id, returns false if the timer is
+  // not pending (e.g., it has already expired).
+  bool cancel(uint64_t id)
+  {
+    auto position = positions.find(id);
+    if (position == positions.end()) {
+      return false;
+    }
+
+    const Position& p = position->second;
+
+    Slot& slot = slots[p.level][p.index];
+    slot.erase(p.entry);
+
+    if (slot.empty()) {
+      masks[p.level] &= ~(1ull << p.index);
+    }
+
+    positions.erase(position);
+
+    return true;
+  }
+
+  // Returns the timeout of the earliest timer if it is at or before
+  // `now`. Otherwise returns a time after `now` which is at or before
+  // the timeout of the earliest timer, so that callers can wait until
+  // then and check again. Returns none if there are no timers.
+  Option<Time> earliest(const Time& now)
+  {
+    const uint64_t tick = tickOf(now);
+
+    Option<std::pair<size_t, size_t>> first = this->first();
+
+    while (first.isSome()) {
+      const size_t level = first->first;
+      const size_t index = first->second;
+
+      if (level == 0) {
+        const Slot& slot = slots[0][index];
+
+        return std::min_element(
+            slot.begin(),
+            slot.end(),
+            [](const Entry& left, const Entry& right) {
+              return left.timer.timeout().time() <
+                     right.timer.timeout().time();
+            })->timer.timeout().time();
+      }
+
+      const uint64_t start = tickOf(level, index);
+
+      if (start > tick) {
+        return Time::epoch() +
+               Nanoseconds(static_cast<int64_t>(start << RESOLUTION_BITS));
+      }
+
+      advance(start);
+
+      first = this->first();
+    }
+
+    return None();
+  }
+
+  // Removes and returns the timers whose timeout is at or before `now`,
+  // ordered by timeout and, for equal timeouts, by insertion order.
+  std::list<Timer> expire(const Time& now)
+  {
+    const uint64_t tick = tickOf(now);
+
+    std::vector<Entry> expired;
+
+    Option<std::pair<size_t, size_t>> first = this->first();
+
+    while (first.isSome()) {
+      const size_t level = first->first;
+      const size_t index = first->second;
+      const uint64_t start = tickOf(level, index);
+
+      // NOTE: The slot of `base` may contain timers which were already
+      // expired when they were inserted (see `place()`), so we always
+      // check it.
+      if (start > tick && (level > 0 || start != base)) {
+        break;
+      }
+
+      advance(start);
+
+      if (level == 0) {
+        Slot& slot = slots[0][index];
+
+        bool remaining = false;
+
+        for (auto entry = slot.begin(); entry != slot.end();) {
+          if (entry->timer.timeout().time() <= now) {
+            positions.erase(entry->id);
+            expired.push_back(std::move(*entry));
+            entry = slot.erase(entry);
+          } else {
+            remaining = true;
+            ++entry;
+          }
+        }
+
+        if (slot.empty()) {
+          masks[0] &= ~(1ull << index);
+        }
+
+        if (remaining) {
+          break;
+        }
+      }
+
+      first = this->first();
+    }
+
+    // All remaining timers are after `now`.
+    advance(tick);
+
+    std::sort(
+        expired.begin(),
+        expired.end(),
+        [](const Entry& left, const Entry& right) {
+          if (left.timer.timeout().time() != right.timer.timeout().time()) {
+            return left.timer.timeout().time() < right.timer.timeout().time();
+          }
+          return left.sequence < right.sequence;
+        });
+
+    std::list<Timer> timers;
+    foreach (Entry& entry, expired) {
+      timers.push_back(std::move(entry.timer));
+    }
+
+    return timers;
+  }
+
+  size_t size() const
+  {
+    return positions.size();
+  }
+
+  bool empty() const
+  {
+    return positions.empty();
+  }
+
+  void clear()
+  {
+    foreach (auto& level, slots) {
+      foreach (Slot& slot, level) {
+        slot.clear();
+      }
+    }
+
+    masks.fill(0);
+    positions.clear();
+  }
+
+private:
+  static constexpr uint64_t RESOLUTION_BITS = 20;
+  static constexpr uint64_t SLOT_BITS = 6;
+  static constexpr size_t SLOTS = 64;
+
+  // Ticks of (non-negative) nanosecond timestamps have at most 43 bits,
+  // which are covered by 8 levels of 6 bits.
+  static constexpr size_t LEVELS = 8;
+
+  struct Entry
+  {
+    uint64_t id;
+
+    // Used to expire timers with the same timeout in insertion order.
+    uint64_t sequence;
+
+    uint64_t tick;
+    Timer timer;
+  };
+
+  typedef std::list<Entry> Slot;
+
+  struct Position
+  {
+    size_t level;
+    size_t index;
+    Slot::iterator entry;
+  };
+
+  static uint64_t tickOf(const Time& time)
+  {
+    const int64_t nanoseconds = time.duration().ns();
+    return nanoseconds <= 0 ? 0 : nanoseconds >> RESOLUTION_BITS;
+  }
+
+  // Returns the index of the slot of the tick at the given level.
+  static size_t digit(uint64_t tick, size_t level)
+  {
+    return (tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+  }
+
+  // Returns the first tick of the given slot of the current block.
+  uint64_t tickOf(size_t level, size_t index) const
+  {
+    const uint64_t shift = SLOT_BITS * (level + 1);
+
+    return ((base >> shift) << shift) | (index << (SLOT_BITS * level));
+  }
+
+  // Returns the level and index of the first occupied slot.
+  Option<std::pair<size_t, size_t>> first() const
+  {
+    for (size_t level = 0; level < LEVELS; level++) {
+      const uint64_t mask = masks[level] >> digit(base, level);
+
+      if (mask != 0) {
+        size_t index = digit(base, level);
+        while ((mask & (1ull << (index - digit(base, level)))) == 0) {
+          index++;
+        }
+
+        return std::make_pair(level, index);
+      }
+    }
+
+    return None();
+  }
+
+  // Moves `base` forward to `tick`, cascading the timers of the slots
+  // of the new blocks. All timers must be at or after `tick`.
+  void advance(uint64_t tick)
+  {
+    if (tick <= base) {
+      return;
+    }
+
+    const uint64_t changed = base ^ tick;
+
+    base = tick;
+
+    // NOTE: We start at the highest level so that the timers of higher
+    // levels end up at the lowest possible level.
+    for (size_t level = LEVELS - 1; level > 0; level--) {
+      if ((changed >> (SLOT_BITS * level)) == 0) {
+        continue;
+      }
+
+      const size_t index = digit(base, level);
+
+      if ((masks[level] & (1ull << index)) != 0) {
+        Slot& slot = slots[level][index];
+
+        masks[level] &= ~(1ull << index);
+
+        while (!slot.empty()) {
+          place(&slot, slot.begin());
+        }
+      }
+    }
+  }
+
+  // Moves the entry into the slot of its tick. Timers which are earlier
+  // than `base` (i.e., already expired) are put in the slot of `base`.
+  void place(Slot* from, Slot::iterator entry)
+  {
+    const uint64_t tick = std::max(entry->tick, base);
+
+    size_t level = 0;
+    while (level < LEVELS - 1 &&
+           ((tick ^ base) >> (SLOT_BITS * (level + 1))) != 0) {
+      level++;
+    }
+
+    const size_t index = digit(tick, level);
+
+    Slot& slot = slots[level][index];
+    slot.splice(slot.end(), *from, entry);
+
+    masks[level] |= (1ull << index);
+
+    positions[entry->id] = Position{level, index, entry};
+  }
+
+  std::array<std::array<Slot, SLOTS>, LEVELS> slots;
+
+  // The occupied slots of each level.
+  std::array<uint64_t, LEVELS> masks;
+
+  hashmap<uint64_t, Position> positions;
+
+  // The current tick, see above.
+  uint64_t base;
+
+  uint64_t sequence;
+};
+
+} // namespace process {
+
+#endif // __PROCESS_TIMER_WHEEL_HPP__
@@ -15,6 +15,7 @@
 # limitations under the License.
 
 include(CMakePushCheckState)
+include(CheckCXXSourceCompiles)
 
 # GENERAL OPTIONS.
 ##################
@@ -111,6 +112,40 @@ option(
   "Use Windows IOCP instead of libev as the core event loop implementation."
   FALSE)
 
+option(
+  ENABLE_IO_URING
+  "Use io_uring (Linux only) for I/O in libprocess when supported by the kernel."
+  FALSE)
+
+if (ENABLE_IO_URING AND (NOT LINUX OR ENABLE_LIBEVENT))
+  message(
+    FATAL_ERROR
+    "ENABLE_IO_URING is only supported on Linux and can not be combined "
+    "with ENABLE_LIBEVENT.")
+endif ()
+
+if (ENABLE_IO_URING)
+  # NOTE: We check for the newest definitions we use rather than only
+  # for the header, e.g., `poll32_events` requires 5.9 headers.
+  CHECK_CXX_SOURCE_COMPILES("
+    #include <linux/io_uring.h>
+    int main()
+    {
+      struct io_uring_sqe sqe;
+      sqe.poll32_events = 0;
+      return IORING_OP_SENDMSG + IORING_OP_SEND + IORING_REGISTER_PROBE +
+        IORING_FEAT_NODROP + IORING_SQ_CQ_OVERFLOW;
+    }"
+    HAVE_IO_URING_HEADERS)
+
+  if (NOT HAVE_IO_URING_HEADERS)
+    message(
+      FATAL_ERROR
+      "Linux kernel headers with io_uring support (5.10+) are required for "
+      "ENABLE_IO_URING.")
+  endif ()
+endif ()
+
 option(
   ENABLE_SSL
   "Build libprocess with SSL support."
@@ -121,6 +156,18 @@ option(
   "Build libprocess with lock free run queue."
   FALSE)
 
+option(
+  ENABLE_WORK_STEALING_RUN_QUEUE
+  "Build libprocess with work stealing run queue."
+  FALSE)
+
+if (ENABLE_LOCK_FREE_RUN_QUEUE AND ENABLE_WORK_STEALING_RUN_QUEUE)
+  message(
+    FATAL_ERROR
+    "ENABLE_LOCK_FREE_RUN_QUEUE and ENABLE_WORK_STEALING_RUN_QUEUE "
+    "can not be combined.")
+endif ()
+
 option(
   ENABLE_LOCK_FREE_EVENT_QUEUE
   "Build libprocess with lock free event queue."
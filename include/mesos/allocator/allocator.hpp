@@ -17,6 +17,7 @@
 #ifndef __MESOS_ALLOCATOR_ALLOCATOR_HPP__
 #define __MESOS_ALLOCATOR_ALLOCATOR_HPP__
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -41,6 +42,70 @@
 namespace mesos {
 namespace allocator {
 
+/**
+ * Pass in configuration to the allocator.
+ */
+struct Options
+{
+  /**
+   * The allocate interval for the allocator, it determines how often the
+   * allocator should perform the batch allocation. An allocator may also
+   * perform allocation based on events (a framework is added and so on),
+   * this depends on the implementation.
+   */
+  Duration allocationInterval = Seconds(1);
+
+  /**
+   * Resources (by name) that will be excluded from a role's fair share.
+   */
+  Option<std::set<std::string>> fairnessExcludeResourceNames = None();
+
+  /**
+   * Filter GPU resources based on the `GPU_RESOURCES` framework capability.
+   */
+  bool filterGpuResources = true;
+
+  /**
+   * The master's domain, if any.
+   */
+  Option<DomainInfo> domain = None();
+
+  /**
+   * The minimum allocatable resource quantities, if any.
+   */
+  Option<std::vector<Resources>> minAllocatableResources = None();
+
+  /**
+   * The number of shards the agents are partitioned into when computing
+   * offers. Offers for each shard are computed in parallel; `1` means
+   * offers are computed sequentially on the allocator actor. This is only
+   * a hint, allocators may choose to ignore it.
+   */
+  size_t allocationShards = 1;
+
+  /**
+   * If set, offers are sent in batches of (at least) this many offers as
+   * soon as they are computed, rather than all at once at the end of an
+   * allocation cycle. This is only a hint, allocators may choose to
+   * ignore it.
+   */
+  Option<size_t> offerBatchSize = None();
+
+  /**
+   * Whether to validate incrementally maintained allocator state (e.g.,
+   * the available quota headroom) against a full recomputation at the
+   * start of each allocation run. This is expensive and meant for
+   * debugging and testing only.
+   */
+  bool validateQuotaHeadroom = false;
+
+  /**
+   * The authentication realm of the allocator's HTTP endpoints, if any.
+   */
+  Option<std::string> authenticationRealm = None();
+};
+
+
 /**
  * Basic model of an allocator: resources are allocated to a framework
  * in the form of offers. A framework can refuse some resources in
@@ -438,6 +503,39 @@ public:
    */
   virtual void updateWeights(
       const std::vector<WeightInfo>& weightInfos) = 0;
+
+  /**
+   * Initializes the allocator when the master starts up, see above. This
+   * is what the master calls; `options` carries both the arguments of the
+   * overload above and the allocation hints added since. By default the
+   * hints are ignored and the overload above is invoked, so allocators
+   * only need to override this to support them.
+   *
+   * NOTE: This is declared last so that adding it did not change the
+   * layout of the existing virtual functions.
+   *
+   * @param options Configuration of the allocator, see `Options`.
+   */
+  virtual void initialize(
+      const Options& options,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<std::string, hashmap<SlaveID, Resources>>&)>&
+                   offerCallback,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, UnavailableResources>&)>&
+        inverseOfferCallback)
+  {
+    initialize(
+        options.allocationInterval,
+        offerCallback,
+        inverseOfferCallback,
+        options.fairnessExcludeResourceNames,
+        options.filterGpuResources,
+        options.domain,
+        options.minAllocatableResources);
+  }
 };
 
 } // namespace allocator {
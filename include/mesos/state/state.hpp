@@ -64,6 +64,11 @@ class State;
 class Variable
 {
 public:
+  std::string name() const
+  {
+    return entry.name();
+  }
+
   std::string value() const
   {
     return entry.value();
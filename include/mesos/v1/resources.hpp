@@ -17,8 +17,11 @@
 #ifndef __MESOS_V1_RESOURCES_HPP__
 #define __MESOS_V1_RESOURCES_HPP__
 
+#include <stdint.h>
+
 #include <map>
 #include <iosfwd>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -98,6 +101,8 @@ private:
       if (resource.has_shared()) {
         sharedCount = 1;
       }
+
+      intern();
     }
 
     // By implicitly converting to Resource we are able to keep Resource_
@@ -140,6 +145,15 @@ private:
         std::ostream& stream, const Resource_& resource_);
 
   private:
+    // The metadata of a resource, i.e., everything but its value,
+    // interned in a process-wide table.
+    struct Metadata;
+
+    // Interns the metadata of 'resource' and caches its scalar value.
+    // Must be called whenever 'resource' is modified other than by the
+    // arithmetic operators of this class.
+    void intern();
+
     // The protobuf Resource that is being managed.
     Resource resource;
 
@@ -147,6 +161,17 @@ private:
     // 'resource' is non-shared. This is an int so as to support arithmetic
     // operations involving subtraction.
     Option<int> sharedCount;
+
+    // Shared by all `Resource_` objects whose 'resource' has the same
+    // metadata (as compared by `addable()` and `subtractable()`), so
+    // that finding the objects to combine compares a pointer instead of
+    // the names, reservations, etc. of the protobufs.
+    std::shared_ptr<const Metadata> metadata;
+
+    // The value of a SCALAR 'resource' in thousandths, i.e., in the
+    // fixed-point representation used for scalar arithmetic; 0 for other
+    // types. The value in 'resource' is kept in sync.
+    int64_t scalar;
   };
 
 public:
@@ -613,13 +638,27 @@ private:
   // returns Resources.
   Option<Resources> find(const Resource& target) const;
 
+  // Positions of the combinable resources (see `Resource_::Metadata`)
+  // in `resources`, keyed by their metadata.
+  typedef hashmap<const Resource_::Metadata*, size_t> Index;
+
+  // Returns the index of `resources`, which lets the arithmetic and
+  // `contains()` of large `Resources` objects find the resource to
+  // combine with without scanning. Returns None if some metadata is
+  // shared by multiple resources (e.g., after `allocate()`), in which
+  // case scanning is needed to find the first one that matches.
+  Option<Index> index() const;
+
   // Validation-free versions of += and -= `Resource_` operators.
   // These can be used when `r` is already validated.
   //
+  // If an `index` of `resources` is given, it is used to find the
+  // resource to combine `r` with and it is kept up to date.
+  //
   // NOTE: `Resource` objects are implicitly converted to `Resource_`
   // objects, so here the API can also accept a `Resource` object.
-  void add(const Resource_& r);
-  void subtract(const Resource_& r);
+  void add(const Resource_& r, Index* index = nullptr);
+  void subtract(const Resource_& r, Index* index = nullptr);
 
   Resources operator+(const Resource_& that) const;
   Resources& operator+=(const Resource_& that);
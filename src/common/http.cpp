@@ -101,6 +101,7 @@ hashset<string> AUTHORIZABLE_ENDPOINTS{
     "/files/debug",
     "/files/debug.json",
     "/logging/toggle",
+    "/metrics/openmetrics",
     "/metrics/snapshot",
     "/monitor/statistics",
     "/monitor/statistics.json"};
@@ -857,6 +858,7 @@ const AuthorizationCallbacks createAuthorizationCallbacks(
       };
 
   callbacks.insert(std::make_pair("/logging/toggle", getEndpoint));
+  callbacks.insert(std::make_pair("/metrics/openmetrics", getEndpoint));
   callbacks.insert(std::make_pair("/metrics/snapshot", getEndpoint));
 
   return callbacks;
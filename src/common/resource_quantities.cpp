@@ -0,0 +1,311 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common/resource_quantities.hpp"
+
+#include <algorithm>
+
+#include <mesos/values.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
+#include <stout/strings.hpp>
+
+#include "common/values.hpp"
+
+using std::pair;
+using std::string;
+using std::vector;
+
+using mesos::internal::values::convertToFixed;
+using mesos::internal::values::convertToFloating;
+
+namespace mesos {
+namespace internal {
+
+static Value::Scalar toScalar(int64_t value)
+{
+  Value::Scalar scalar;
+  scalar.set_value(convertToFloating(value));
+  return scalar;
+}
+
+
+// Orders the quantities by the IDs of their names; used for binary
+// searching the sorted quantities.
+static bool compareName(
+    const pair<const ResourceName*, int64_t>& quantity,
+    const ResourceName* name)
+{
+  return quantity.first->id < name->id;
+}
+
+
+pair<const string&, Value::Scalar>
+ResourceQuantities::const_iterator::operator*() const
+{
+  return pair<const string&, Value::Scalar>(
+      it->first->value, toScalar(it->second));
+}
+
+
+Try<ResourceQuantities> ResourceQuantities::fromString(const string& text)
+{
+  ResourceQuantities result;
+
+  foreach (const string& token, strings::tokenize(text, ";")) {
+    vector<string> pair = strings::split(token, ":");
+    if (pair.size() != 2) {
+      return Error("Failed to parse '" + token + "': expected 'name:value'");
+    }
+
+    const string name = strings::trim(pair[0]);
+    if (name.empty()) {
+      return Error("Failed to parse '" + token + "': empty name");
+    }
+
+    Try<double> value = numify<double>(strings::trim(pair[1]));
+    if (value.isError()) {
+      return Error(
+          "Failed to parse '" + token + "': " + value.error());
+    }
+
+    if (value.get() < 0) {
+      return Error("Failed to parse '" + token + "': negative value");
+    }
+
+    result.add(internResourceName(name), convertToFixed(value.get()));
+  }
+
+  return result;
+}
+
+
+ResourceQuantities ResourceQuantities::fromScalarResources(
+    const Resources& resources)
+{
+  ResourceQuantities result;
+
+  // NOTE: We use the interned names and the fixed-point values that
+  // `Resources` keeps for its scalar resources.
+  foreach (const Resources::Resource_& resource_, resources.resources) {
+    if (resource_.resource.type() == Value::SCALAR) {
+      result.add(resource_.name(), resource_.scalar);
+    }
+  }
+
+  return result;
+}
+
+
+Value::Scalar ResourceQuantities::get(const string& name) const
+{
+  foreach (const auto& quantity, quantities) {
+    // NOTE: The names obtained by iterating over quantities are the
+    // interned strings, so we compare their addresses first.
+    if (&quantity.first->value == &name || quantity.first->value == name) {
+      return toScalar(quantity.second);
+    }
+  }
+
+  return toScalar(0);
+}
+
+
+bool ResourceQuantities::contains(const ResourceQuantities& that) const
+{
+  // Both vectors are sorted by name, so we can walk them in lockstep.
+  auto it = quantities.begin();
+
+  foreach (const auto& quantity, that.quantities) {
+    while (it != quantities.end() && it->first->id < quantity.first->id) {
+      ++it;
+    }
+
+    if (it == quantities.end() ||
+        it->first != quantity.first ||
+        quantity.second > it->second) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+Resources ResourceQuantities::toResources() const
+{
+  Resources result;
+
+  foreach (const auto& quantity, quantities) {
+    Resource resource;
+    resource.set_name(quantity.first->value);
+    resource.set_type(Value::SCALAR);
+    resource.mutable_scalar()->CopyFrom(toScalar(quantity.second));
+
+    result += resource;
+  }
+
+  return result;
+}
+
+
+bool ResourceQuantities::operator==(const ResourceQuantities& that) const
+{
+  return quantities == that.quantities;
+}
+
+
+bool ResourceQuantities::operator!=(const ResourceQuantities& that) const
+{
+  return !(*this == that);
+}
+
+
+ResourceQuantities& ResourceQuantities::operator+=(
+    const ResourceQuantities& that)
+{
+  size_t i = 0;
+
+  foreach (const auto& quantity, that.quantities) {
+    while (i < quantities.size() &&
+           quantities[i].first->id < quantity.first->id) {
+      ++i;
+    }
+
+    if (i < quantities.size() && quantities[i].first == quantity.first) {
+      quantities[i].second += quantity.second;
+    } else {
+      quantities.insert(quantities.begin() + i, quantity);
+    }
+
+    ++i;
+  }
+
+  return *this;
+}
+
+
+ResourceQuantities& ResourceQuantities::operator-=(
+    const ResourceQuantities& that)
+{
+  if (this == &that) {
+    quantities.clear();
+    return *this;
+  }
+
+  size_t i = 0;
+
+  foreach (const auto& quantity, that.quantities) {
+    while (i < quantities.size() &&
+           quantities[i].first->id < quantity.first->id) {
+      ++i;
+    }
+
+    if (i == quantities.size()) {
+      break;
+    }
+
+    if (quantities[i].first != quantity.first) {
+      continue;
+    }
+
+    if (quantities[i].second <= quantity.second) {
+      quantities.erase(quantities.begin() + i);
+    } else {
+      quantities[i].second -= quantity.second;
+      ++i;
+    }
+  }
+
+  return *this;
+}
+
+
+ResourceQuantities ResourceQuantities::operator+(
+    const ResourceQuantities& that) const
+{
+  ResourceQuantities result = *this;
+  result += that;
+  return result;
+}
+
+
+ResourceQuantities ResourceQuantities::operator-(
+    const ResourceQuantities& that) const
+{
+  ResourceQuantities result = *this;
+  result -= that;
+  return result;
+}
+
+
+void ResourceQuantities::add(const ResourceName* name, int64_t value)
+{
+  // Like `Resources`, we do not keep empty quantities around.
+  if (value <= 0) {
+    return;
+  }
+
+  auto it = std::lower_bound(
+      quantities.begin(), quantities.end(), name, compareName);
+
+  if (it != quantities.end() && it->first == name) {
+    it->second += value;
+  } else {
+    quantities.insert(it, std::make_pair(name, value));
+  }
+}
+
+
+std::ostream& operator<<(
+    std::ostream& stream,
+    const ResourceQuantities& quantities)
+{
+  if (quantities.empty()) {
+    return stream << "{}";
+  }
+
+  // Print the quantities in order of their names rather than of the
+  // IDs of the interned names, which depend on the interning order.
+  vector<pair<string, Value::Scalar>> sorted(
+      quantities.begin(), quantities.end());
+
+  std::sort(
+      sorted.begin(),
+      sorted.end(),
+      [](const pair<string, Value::Scalar>& left,
+         const pair<string, Value::Scalar>& right) {
+        return left.first < right.first;
+      });
+
+  bool first = true;
+  foreach (const auto& quantity, sorted) {
+    if (!first) {
+      stream << "; ";
+    }
+
+    first = false;
+
+    stream << quantity.first << ":" << quantity.second;
+  }
+
+  return stream;
+}
+
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,168 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __COMMON_RESOURCE_QUANTITIES_HPP__
+#define __COMMON_RESOURCE_QUANTITIES_HPP__
+
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mesos/mesos.hpp>
+#include <mesos/resources.hpp>
+
+#include <stout/try.hpp>
+
+#include "common/resources_utils.hpp"
+
+namespace mesos {
+namespace internal {
+
+// An efficient collection of resource quantities, i.e., the aggregated
+// scalar values of resources keyed by resource name, without any of the
+// other `Resource` metadata (reservations, disk info, sharedness, ...).
+//
+// This is meant to replace the use of `Resources` objects holding the
+// result of `Resources::createStrippedScalarQuantity()` for accounting,
+// e.g., in the sorters and for quota headroom. Unlike `Resources`, it
+// is a flat vector of (name, value) pairs, where names are interned (see
+// `internResourceName()`) and values are kept as fixed-point integers.
+// The pairs are sorted by the IDs of the names, so the arithmetic and
+// comparisons walk the vectors in lockstep, and neither compare strings
+// nor go through protobuf messages.
+//
+// Only positive quantities are stored: like with `Resources`, a
+// subtraction that would result in a non-positive quantity removes
+// the entry, and adding or subtracting a resource that is absent in
+// the subtrahend is a no-op for that resource.
+//
+// NOTE: Values are kept in thousandths, i.e., with the precision and
+// the rounding of the fixed-point arithmetic of `Value::Scalar`. The
+// conversion to `Value::Scalar` is only done at the API boundary.
+class ResourceQuantities
+{
+public:
+  // Iterates over the (name, scalar) pairs in order of the IDs of the
+  // interned names, i.e., not alphabetically. The pairs are created
+  // when dereferencing the iterator.
+  class const_iterator
+    : public std::iterator<
+          std::forward_iterator_tag,
+          std::pair<const std::string&, Value::Scalar>>
+  {
+  public:
+    std::pair<const std::string&, Value::Scalar> operator*() const;
+
+    const_iterator& operator++()
+    {
+      ++it;
+      return *this;
+    }
+
+    bool operator==(const const_iterator& that) const
+    {
+      return it == that.it;
+    }
+
+    bool operator!=(const const_iterator& that) const
+    {
+      return it != that.it;
+    }
+
+  private:
+    friend class ResourceQuantities;
+
+    explicit const_iterator(
+        std::vector<std::pair<const ResourceName*, int64_t>>::const_iterator
+          _it)
+      : it(_it) {}
+
+    std::vector<std::pair<const ResourceName*, int64_t>>::const_iterator it;
+  };
+
+  typedef const_iterator iterator;
+
+  // Parses a string of the form "cpus:1;mem:128" into quantities.
+  // Quantities of the same name are summed up. Returns an error if
+  // a name is empty or a value is not a non-negative number.
+  static Try<ResourceQuantities> fromString(const std::string& text);
+
+  // Aggregates the scalar resources by name, ignoring all other
+  // `Resource` metadata. Non-scalar resources are ignored.
+  static ResourceQuantities fromScalarResources(const Resources& resources);
+
+  ResourceQuantities() = default;
+
+  ResourceQuantities(const ResourceQuantities& that) = default;
+  ResourceQuantities(ResourceQuantities&& that) = default;
+
+  ResourceQuantities& operator=(const ResourceQuantities& that) = default;
+  ResourceQuantities& operator=(ResourceQuantities&& that) = default;
+
+  // NOTE: Non-`const` `begin()` and `end()` are intentionally not
+  // provided to prevent callers from breaking the sorted invariant.
+  const_iterator begin() const { return const_iterator(quantities.begin()); }
+  const_iterator end() const { return const_iterator(quantities.end()); }
+
+  size_t size() const { return quantities.size(); }
+
+  bool empty() const { return quantities.empty(); }
+
+  // Returns the quantity of the resource with the given name, or a
+  // zero scalar if there is none.
+  //
+  // NOTE: This scans the quantities, which is cheaper than interning
+  // the name for the handful of names there are in practice.
+  Value::Scalar get(const std::string& name) const;
+
+  // Returns true if each quantity in `that` is less than or equal to
+  // the quantity of the same name in this object.
+  bool contains(const ResourceQuantities& that) const;
+
+  // Converts the quantities into `Resources`, e.g., for use with the
+  // APIs which are not yet converted.
+  Resources toResources() const;
+
+  bool operator==(const ResourceQuantities& that) const;
+  bool operator!=(const ResourceQuantities& that) const;
+
+  ResourceQuantities& operator+=(const ResourceQuantities& that);
+  ResourceQuantities& operator-=(const ResourceQuantities& that);
+
+  ResourceQuantities operator+(const ResourceQuantities& that) const;
+  ResourceQuantities operator-(const ResourceQuantities& that) const;
+
+private:
+  // Adds the quantity (in thousandths) for the given name, keeping the
+  // vector sorted.
+  void add(const ResourceName* name, int64_t value);
+
+  // Sorted by the IDs of the names; all values are positive thousandths.
+  std::vector<std::pair<const ResourceName*, int64_t>> quantities;
+};
+
+
+std::ostream& operator<<(
+    std::ostream& stream,
+    const ResourceQuantities& quantities);
+
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __COMMON_RESOURCE_QUANTITIES_HPP__
@@ -14,11 +14,17 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <mutex>
+#include <string>
+
 #include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
 #include <stout/stringify.hpp>
+#include <stout/synchronized.hpp>
 
 #include "common/resources_utils.hpp"
 
+using std::string;
 using std::vector;
 
 using google::protobuf::Descriptor;
@@ -907,4 +913,31 @@ Try<Nothing> downgradeResources(Message* message)
       message, downgradeResource, resourcesContainment);
 }
 
+
+namespace internal {
+
+const ResourceName* internResourceName(const string& name)
+{
+  static hashmap<string, const ResourceName*>* names =
+    new hashmap<string, const ResourceName*>();
+  static std::mutex* names_mutex = new std::mutex();
+
+  const ResourceName* interned;
+
+  synchronized (names_mutex) {
+    Option<const ResourceName*> found = names->get(name);
+
+    if (found.isSome()) {
+      interned = found.get();
+    } else {
+      interned = new ResourceName{static_cast<uint32_t>(names->size()), name};
+      names->put(name, interned);
+    }
+  }
+
+  return interned;
+}
+
+} // namespace internal {
+
 } // namespace mesos {
@@ -17,6 +17,9 @@
 #ifndef __RESOURCES_UTILS_HPP__
 #define __RESOURCES_UTILS_HPP__
 
+#include <stdint.h>
+
+#include <string>
 #include <vector>
 
 #include <google/protobuf/repeated_field.h>
@@ -217,6 +220,25 @@ Try<Nothing> downgradeResources(std::vector<Resource>* resources);
 Try<Nothing> downgradeResources(google::protobuf::Message* message);
 
 
+namespace internal {
+
+// A resource name interned in a process-wide table. The IDs are assigned
+// in the order in which the names are first interned, which allows to
+// compare and order names without comparing the strings.
+struct ResourceName
+{
+  const uint32_t id;
+  const std::string value;
+};
+
+
+// Returns the interned resource name, interning it first if needed.
+// Interned names are never freed, so the returned pointer remains
+// valid for the lifetime of the process.
+const ResourceName* internResourceName(const std::string& name);
+
+} // namespace internal {
+
 } // namespace mesos {
 
 #endif // __RESOURCES_UTILS_HPP__
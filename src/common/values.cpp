@@ -40,37 +40,13 @@ using std::ostream;
 using std::string;
 using std::vector;
 
+using mesos::internal::values::convertToFixed;
+using mesos::internal::values::convertToFloating;
 using mesos::internal::values::intervalSetToRanges;
 using mesos::internal::values::rangesToIntervalSet;
 
 namespace mesos {
 
-// We manipulate scalar values by converting them from floating point to a
-// fixed point representation, doing a calculation, and then converting
-// the result back to floating point. We deliberately only preserve three
-// decimal digits of precision in the fixed point representation. This
-// ensures that client applications see predictable numerical behavior, at
-// the expense of sacrificing some precision.
-
-static long long convertToFixed(double floatValue)
-{
-  return std::llround(floatValue * 1000);
-}
-
-
-static double convertToFloating(long long fixedValue)
-{
-  // NOTE: We do the conversion from fixed point via integer division
-  // and then modulus, rather than a single floating point division.
-  // This ensures that we only apply floating point division to inputs
-  // in the range [0,999], which is easier to check for correctness.
-  double quotient = static_cast<double>(fixedValue / 1000);
-  double remainder = static_cast<double>(fixedValue % 1000) / 1000.0;
-
-  return quotient + remainder;
-}
-
-
 ostream& operator<<(ostream& stream, const Value::Scalar& scalar)
 {
   // Output the scalar's full significant digits and save the old
@@ -17,6 +17,9 @@
 #ifndef __COMMON_VALUES_HPP__
 #define __COMMON_VALUES_HPP__
 
+#include <stdint.h>
+
+#include <cmath>
 #include <limits>
 #include <type_traits>
 
@@ -30,6 +33,31 @@ namespace mesos {
 namespace internal {
 namespace values {
 
+// We manipulate scalar values by converting them from floating point to a
+// fixed point representation, doing a calculation, and then converting
+// the result back to floating point. We deliberately only preserve three
+// decimal digits of precision in the fixed point representation. This
+// ensures that client applications see predictable numerical behavior, at
+// the expense of sacrificing some precision.
+inline int64_t convertToFixed(double floatValue)
+{
+  return std::llround(floatValue * 1000);
+}
+
+
+inline double convertToFloating(int64_t fixedValue)
+{
+  // NOTE: We do the conversion from fixed point via integer division
+  // and then modulus, rather than a single floating point division.
+  // This ensures that we only apply floating point division to inputs
+  // in the range [0,999], which is easier to check for correctness.
+  double quotient = static_cast<double>(fixedValue / 1000);
+  double remainder = static_cast<double>(fixedValue % 1000) / 1000.0;
+
+  return quotient + remainder;
+}
+
+
 // Convert Ranges value to IntervalSet value.
 template <typename T>
 Try<IntervalSet<T>> rangesToIntervalSet(const Value::Ranges& ranges)
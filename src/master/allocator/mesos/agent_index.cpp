@@ -0,0 +1,239 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "master/allocator/mesos/agent_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <boost/functional/hash.hpp>
+
+#include <glog/logging.h>
+
+#include <mesos/type_utils.hpp>
+
+#include <stout/check.hpp>
+#include <stout/foreach.hpp>
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace internal {
+
+// Returns the exponent of the smallest power of two which is not
+// less than `value`, or `None()` if `value` is not positive.
+static Option<int> exponent(const Option<Value::Scalar>& value)
+{
+  if (value.isNone() || value->value() <= 0) {
+    return None();
+  }
+
+  int result = static_cast<int>(std::ceil(std::log2(value->value())));
+
+  // Guard against rounding in `log2()`.
+  if (std::ldexp(1.0, result) < value->value()) {
+    ++result;
+  }
+
+  return result;
+}
+
+
+// Returns true if the power of two with the given exponent, if any,
+// is not less than `value`.
+static bool bounds(const Option<int>& exponent, double value)
+{
+  return exponent.isSome() && std::ldexp(1.0, exponent.get()) >= value;
+}
+
+
+void AgentShapeIndex::update(
+    const SlaveID& slaveId,
+    const Resources& available,
+    const Resources& total)
+{
+  const Shape newShape = shape(available, total);
+
+  auto it = shapes.find(slaveId);
+  if (it != shapes.end()) {
+    if (it->second == newShape) {
+      return;
+    }
+
+    auto bucket = agents.find(it->second);
+    CHECK(bucket != agents.end());
+
+    bucket->second.erase(slaveId);
+    if (bucket->second.empty()) {
+      agents.erase(bucket);
+    }
+
+    it->second = newShape;
+  } else {
+    shapes.put(slaveId, newShape);
+  }
+
+  agents[newShape].insert(slaveId);
+}
+
+
+void AgentShapeIndex::remove(const SlaveID& slaveId)
+{
+  auto it = shapes.find(slaveId);
+  if (it == shapes.end()) {
+    return;
+  }
+
+  auto bucket = agents.find(it->second);
+  CHECK(bucket != agents.end());
+
+  bucket->second.erase(slaveId);
+  if (bucket->second.empty()) {
+    agents.erase(bucket);
+  }
+
+  shapes.erase(it);
+}
+
+
+bool AgentShapeIndex::Candidates::contains(const SlaveID& slaveId) const
+{
+  auto shape = index->shapes.find(slaveId);
+  if (shape == index->shapes.end()) {
+    return false;
+  }
+
+  auto bucket = index->agents.find(shape->second);
+  CHECK(bucket != index->agents.end());
+
+  // There are only a few shapes, so a linear search is fine.
+  return std::find(buckets.begin(), buckets.end(), &bucket->second) !=
+    buckets.end();
+}
+
+
+AgentShapeIndex::Candidates AgentShapeIndex::candidates(
+    const Option<vector<Resources>>& minAllocatableResources) const
+{
+  Candidates result(this);
+
+  foreachpair (const Shape& shape,
+               const hashset<SlaveID>& slaveIds,
+               agents) {
+    // Without minimum allocatable resources, any resources (even none)
+    // are allocatable, see `HierarchicalAllocatorProcess::allocatable()`.
+    bool matches =
+      minAllocatableResources.isNone() || minAllocatableResources->empty();
+
+    if (!matches) {
+      foreach (const Resources& minResources, minAllocatableResources.get()) {
+        if (satisfiable(shape, minResources)) {
+          matches = true;
+          break;
+        }
+      }
+    }
+
+    if (matches) {
+      result.buckets.push_back(&slaveIds);
+      result.count += slaveIds.size();
+    }
+  }
+
+  return result;
+}
+
+
+size_t AgentShapeIndex::ShapeHash::operator()(const Shape& shape) const
+{
+  size_t seed = 0;
+
+  boost::hash_combine(seed, shape.cpus.isSome());
+  boost::hash_combine(seed, shape.cpus.getOrElse(0));
+  boost::hash_combine(seed, shape.mem.isSome());
+  boost::hash_combine(seed, shape.mem.getOrElse(0));
+  boost::hash_combine(seed, shape.other);
+  boost::hash_combine(seed, shape.reserved);
+  boost::hash_combine(seed, shape.revocable);
+  boost::hash_combine(seed, shape.shared);
+
+  return seed;
+}
+
+
+AgentShapeIndex::Shape AgentShapeIndex::shape(
+    const Resources& available,
+    const Resources& total)
+{
+  const Resources unreserved = available.nonRevocable().unreserved();
+
+  Shape result;
+  result.cpus = exponent(unreserved.get<Value::Scalar>("cpus"));
+  result.mem = exponent(unreserved.get<Value::Scalar>("mem"));
+
+  result.other = !unreserved.filter([](const Resource& resource) {
+    return resource.name() != "cpus" && resource.name() != "mem";
+  }).empty();
+
+  result.reserved = !available.reserved().empty();
+  result.revocable = !available.revocable().empty();
+  result.shared = !total.shared().empty();
+
+  return result;
+}
+
+
+bool AgentShapeIndex::satisfiable(
+    const Shape& shape,
+    const Resources& minResources)
+{
+  // We do not look into reserved, revocable or shared resources
+  // since whether they are allocatable depends on the role and
+  // the framework; the allocation loop checks these agents.
+  if (shape.reserved || shape.revocable || shape.shared) {
+    return true;
+  }
+
+  foreach (const string& name, minResources.names()) {
+    const double value =
+      CHECK_NOTNONE(minResources.get<Value::Scalar>(name)).value();
+
+    if (name == "cpus") {
+      if (!bounds(shape.cpus, value)) {
+        return false;
+      }
+    } else if (name == "mem") {
+      if (!bounds(shape.mem, value)) {
+        return false;
+      }
+    } else if (!shape.other) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace internal {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
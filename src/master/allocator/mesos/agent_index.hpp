@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MASTER_ALLOCATOR_MESOS_AGENT_INDEX_HPP__
+#define __MASTER_ALLOCATOR_MESOS_AGENT_INDEX_HPP__
+
+#include <vector>
+
+#include <mesos/mesos.hpp>
+#include <mesos/resources.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/option.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace internal {
+
+// Index of agents by the coarse "shape" of their available resources.
+// The allocator uses it to skip, in O(1) per shape rather than per
+// agent and role, the agents that cannot have allocatable resources
+// for any role, e.g., the fully allocated agents of a busy cluster.
+//
+// The shape records the power-of-two upper bounds of the available
+// unreserved non-revocable cpus and memory, and whether the agent has
+// any other available unreserved non-revocable resources, available
+// reservations, available revocable resources or shared resources.
+// Since the shape only gives upper bounds on what can be allocated,
+// the index is conservative: every agent that could pass the
+// allocator's `allocatable()` check is a candidate, but not every
+// candidate necessarily passes it.
+class AgentShapeIndex
+{
+public:
+  // Adds or updates the agent given its available and total resources.
+  void update(
+      const SlaveID& slaveId,
+      const Resources& available,
+      const Resources& total);
+
+  void remove(const SlaveID& slaveId);
+
+  // The agents which might have allocatable resources, as returned by
+  // `candidates()`. These are the agents of the shapes that match, so
+  // this does not copy the agents; it refers to the index and must not
+  // be used once the index is modified.
+  class Candidates
+  {
+  public:
+    // Returns the number of candidate agents.
+    size_t size() const { return count; }
+
+    bool contains(const SlaveID& slaveId) const;
+
+    // Returns the (disjoint) sets of candidate agents of each
+    // matching shape.
+    const std::vector<const hashset<SlaveID>*>& agents() const
+    {
+      return buckets;
+    }
+
+  private:
+    friend class AgentShapeIndex;
+
+    explicit Candidates(const AgentShapeIndex* _index)
+      : index(_index), count(0) {}
+
+    const AgentShapeIndex* index;
+    std::vector<const hashset<SlaveID>*> buckets;
+    size_t count;
+  };
+
+  // Returns the agents which might have allocatable resources given
+  // the allocator's minimum allocatable resources. This only visits
+  // the shapes of the agents, not the agents themselves.
+  Candidates candidates(
+      const Option<std::vector<Resources>>& minAllocatableResources) const;
+
+private:
+  struct Shape
+  {
+    // Exponents of the power-of-two upper bounds of the available
+    // unreserved non-revocable cpus and memory, or `None()` if none
+    // are available.
+    Option<int> cpus;
+    Option<int> mem;
+
+    // Whether there are available unreserved non-revocable resources
+    // other than cpus and memory.
+    bool other;
+
+    // Whether there are available reserved resources. These are only
+    // allocatable to the reservation role (and its descendants), which
+    // is left for the allocation loop to determine.
+    bool reserved;
+
+    // Whether there are available revocable resources.
+    bool revocable;
+
+    // Whether there are shared resources, which can be offered even
+    // when they are in use.
+    bool shared;
+
+    bool operator==(const Shape& that) const
+    {
+      return cpus == that.cpus &&
+             mem == that.mem &&
+             other == that.other &&
+             reserved == that.reserved &&
+             revocable == that.revocable &&
+             shared == that.shared;
+    }
+  };
+
+  struct ShapeHash
+  {
+    size_t operator()(const Shape& shape) const;
+  };
+
+  static Shape shape(const Resources& available, const Resources& total);
+
+  // Returns true if an agent of the given shape might have resources
+  // which contain `minResources`.
+  static bool satisfiable(const Shape& shape, const Resources& minResources);
+
+  hashmap<Shape, hashset<SlaveID>, ShapeHash> agents;
+  hashmap<SlaveID, Shape> shapes;
+};
+
+} // namespace internal {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_AGENT_INDEX_HPP__
@@ -60,7 +60,19 @@ public:
         fairnessExcludeResourceNames = None(),
       bool filterGpuResources = true,
       const Option<DomainInfo>& domain = None(),
-      const Option<std::vector<Resources>>& minAllocatableResources = None());
+      const Option<std::vector<Resources>>&
+        minAllocatableResources = None());
+
+  void initialize(
+      const mesos::allocator::Options& options,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<std::string, hashmap<SlaveID, Resources>>&)>&
+                   offerCallback,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, UnavailableResources>&)>&
+        inverseOfferCallback);
 
   void recover(
       const int expectedAgentCount,
@@ -194,7 +206,7 @@ public:
   using process::ProcessBase::initialize;
 
   virtual void initialize(
-      const Duration& allocationInterval,
+      const mesos::allocator::Options& options,
       const lambda::function<
           void(const FrameworkID&,
                const hashmap<std::string, hashmap<SlaveID, Resources>>&)>&
@@ -202,13 +214,7 @@ public:
       const lambda::function<
           void(const FrameworkID&,
                const hashmap<SlaveID, UnavailableResources>&)>&
-        inverseOfferCallback,
-      const Option<std::set<std::string>>&
-        fairnessExcludeResourceNames = None(),
-      bool filterGpuResources = true,
-      const Option<DomainInfo>& domain = None(),
-      const Option<std::vector<Resources>>&
-        minAllocatableResources = None()) = 0;
+        inverseOfferCallback) = 0;
 
   virtual void recover(
       const int expectedAgentCount,
@@ -365,17 +371,37 @@ inline void MesosAllocator<AllocatorProcess>::initialize(
     bool filterGpuResources,
     const Option<DomainInfo>& domain,
     const Option<std::vector<Resources>>& minAllocatableResources)
+{
+  mesos::allocator::Options options;
+
+  options.allocationInterval = allocationInterval;
+  options.fairnessExcludeResourceNames = fairnessExcludeResourceNames;
+  options.filterGpuResources = filterGpuResources;
+  options.domain = domain;
+  options.minAllocatableResources = minAllocatableResources;
+
+  initialize(options, offerCallback, inverseOfferCallback);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::initialize(
+    const mesos::allocator::Options& options,
+    const lambda::function<
+        void(const FrameworkID&,
+             const hashmap<std::string, hashmap<SlaveID, Resources>>&)>&
+                 offerCallback,
+    const lambda::function<
+        void(const FrameworkID&,
+              const hashmap<SlaveID, UnavailableResources>&)>&
+      inverseOfferCallback)
 {
   process::dispatch(
       process,
       &MesosAllocatorProcess::initialize,
-      allocationInterval,
+      options,
       offerCallback,
-      inverseOfferCallback,
-      fairnessExcludeResourceNames,
-      filterGpuResources,
-      domain,
-      minAllocatableResources);
+      inverseOfferCallback);
 }
 
 
@@ -27,15 +27,20 @@
 #include <mesos/type_utils.hpp>
 
 #include <process/after.hpp>
+#include <process/clock.hpp>
 #include <process/delay.hpp>
 #include <process/dispatch.hpp>
 #include <process/event.hpp>
+#include <process/help.hpp>
+#include <process/http.hpp>
 #include <process/id.hpp>
 #include <process/loop.hpp>
+#include <process/time.hpp>
 #include <process/timeout.hpp>
 
 #include <stout/check.hpp>
 #include <stout/hashset.hpp>
+#include <stout/numify.hpp>
 #include <stout/set.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
@@ -49,15 +54,23 @@ using std::vector;
 using mesos::allocator::InverseOfferStatus;
 
 using process::after;
+using process::Clock;
 using process::Continue;
 using process::ControlFlow;
 using process::Failure;
 using process::Future;
+using process::HELP;
+using process::TLDR;
+using process::DESCRIPTION;
+using process::AUTHENTICATION;
 using process::loop;
 using process::Owned;
 using process::PID;
+using process::Time;
 using process::Timeout;
 
+using process::http::authentication::Principal;
+
 using mesos::internal::protobuf::framework::Capabilities;
 
 namespace mesos {
@@ -66,36 +79,6 @@ namespace master {
 namespace allocator {
 namespace internal {
 
-// Used to represent "filters" for resources unused in offers.
-class OfferFilter
-{
-public:
-  virtual ~OfferFilter() {}
-
-  virtual bool filter(const Resources& resources) const = 0;
-};
-
-
-class RefusedOfferFilter : public OfferFilter
-{
-public:
-  RefusedOfferFilter(const Resources& _resources) : resources(_resources) {}
-
-  virtual bool filter(const Resources& _resources) const
-  {
-    // TODO(jieyu): Consider separating the superset check for regular
-    // and revocable resources. For example, frameworks might want
-    // more revocable resources only or non-revocable resources only,
-    // but currently the filter only expires if there is more of both
-    // revocable and non-revocable resources.
-    return resources.contains(_resources); // Refused resources are superset.
-  }
-
-private:
-  const Resources resources;
-};
-
-
 // Used to represent "filters" for inverse offers.
 //
 // NOTE: Since this specific allocator implementation only sends inverse offers
@@ -143,8 +126,85 @@ HierarchicalAllocatorProcess::Framework::Framework(
     active(_active) {}
 
 
+ShardWorkers::ShardWorkers(size_t size)
+  : pending(0),
+    stopping(false)
+{
+  for (size_t i = 0; i < size; i++) {
+    threads.emplace_back(&ShardWorkers::work, this);
+  }
+}
+
+
+ShardWorkers::~ShardWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+
+  queued.notify_all();
+
+  foreach (std::thread& thread, threads) {
+    thread.join();
+  }
+}
+
+
+void ShardWorkers::run(const vector<lambda::function<void()>>& functions)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  CHECK_EQ(0u, pending);
+
+  queue.insert(queue.end(), functions.begin(), functions.end());
+  pending = functions.size();
+
+  queued.notify_all();
+
+  // Rather than idling, the calling thread runs queued functions too.
+  while (!queue.empty()) {
+    lambda::function<void()> function = queue.front();
+    queue.pop_front();
+
+    lock.unlock();
+    function();
+    lock.lock();
+
+    pending--;
+  }
+
+  finished.wait(lock, [this]() { return pending == 0; });
+}
+
+
+void ShardWorkers::work()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    queued.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+    if (stopping) {
+      return;
+    }
+
+    lambda::function<void()> function = queue.front();
+    queue.pop_front();
+
+    lock.unlock();
+    function();
+    lock.lock();
+
+    if (--pending == 0) {
+      finished.notify_all();
+    }
+  }
+}
+
+
 void HierarchicalAllocatorProcess::initialize(
-    const Duration& _allocationInterval,
+    const mesos::allocator::Options& _options,
     const lambda::function<
         void(const FrameworkID&,
              const hashmap<string, hashmap<SlaveID, Resources>>&)>&
@@ -152,37 +212,45 @@ void HierarchicalAllocatorProcess::initialize(
     const lambda::function<
         void(const FrameworkID&,
              const hashmap<SlaveID, UnavailableResources>&)>&
-      _inverseOfferCallback,
-    const Option<set<string>>& _fairnessExcludeResourceNames,
-    bool _filterGpuResources,
-    const Option<DomainInfo>& _domain,
-    const Option<std::vector<Resources>>& _minAllocatableResources)
+      _inverseOfferCallback)
 {
-  allocationInterval = _allocationInterval;
+  options = _options;
   offerCallback = _offerCallback;
   inverseOfferCallback = _inverseOfferCallback;
-  fairnessExcludeResourceNames = _fairnessExcludeResourceNames;
-  filterGpuResources = _filterGpuResources;
-  domain = _domain;
-  minAllocatableResources = _minAllocatableResources;
   initialized = true;
   paused = false;
 
   // Resources for quota'ed roles are allocated separately and prior to
   // non-quota'ed roles, hence a dedicated sorter for quota'ed roles is
   // necessary.
-  roleSorter->initialize(fairnessExcludeResourceNames);
-  quotaRoleSorter->initialize(fairnessExcludeResourceNames);
+  roleSorter->initialize(options.fairnessExcludeResourceNames);
+  quotaRoleSorter->initialize(options.fairnessExcludeResourceNames);
+
+  // The allocator actor computes the allocations of one of the shards
+  // itself, see `allocateShards()`.
+  if (options.allocationShards > 1) {
+    shardWorkers.reset(new ShardWorkers(options.allocationShards - 1));
+  }
+
+  route(
+      "/profile",
+      options.authenticationRealm,
+      profileHelp(),
+      &HierarchicalAllocatorProcess::profile);
 
   VLOG(1) << "Initialized hierarchical allocator process";
 
   // Start a loop to run allocation periodically.
   PID<HierarchicalAllocatorProcess> _self = self();
 
+  // Set a local copy of the allocation interval so that the lambda
+  // below does not capture `this`.
+  Duration allocationInterval = options.allocationInterval;
+
   loop(
       None(), // Use `None` so we iterate outside the allocator process.
-      [_allocationInterval]() {
-        return after(_allocationInterval);
+      [allocationInterval]() {
+        return after(allocationInterval);
       },
       [_self](const Nothing&) {
         return dispatch(_self, &HierarchicalAllocatorProcess::allocate)
@@ -337,8 +405,10 @@ void HierarchicalAllocatorProcess::removeFramework(
     untrackFrameworkUnderRole(frameworkId, role);
   }
 
+  offerFilters.remove(frameworkId);
+
   // Do not delete the filters contained in this
-  // framework's `offerFilters` hashset yet, see comments in
+  // framework's `inverseOfferFilters` hashset yet, see comments in
   // HierarchicalAllocatorProcess::reviveOffers and
   // HierarchicalAllocatorProcess::expire.
   frameworks.erase(frameworkId);
@@ -397,11 +467,12 @@ void HierarchicalAllocatorProcess::deactivateFramework(
 
   framework.active = false;
 
+  offerFilters.remove(frameworkId);
+
   // Do not delete the filters contained in this
-  // framework's `offerFilters` hashset yet, see comments in
+  // framework's `inverseOfferFilters` hashset yet, see comments in
   // HierarchicalAllocatorProcess::reviveOffers and
   // HierarchicalAllocatorProcess::expire.
-  framework.offerFilters.clear();
   framework.inverseOfferFilters.clear();
 
   LOG(INFO) << "Deactivated framework " << frameworkId;
@@ -452,9 +523,7 @@ void HierarchicalAllocatorProcess::updateFramework(
       untrackFrameworkUnderRole(frameworkId, role);
     }
 
-    if (framework.offerFilters.contains(role)) {
-      framework.offerFilters.erase(role);
-    }
+    offerFilters.remove(frameworkId, role);
   }
 
   const set<string> addedRoles = [&]() {
@@ -518,13 +587,15 @@ void HierarchicalAllocatorProcess::addSlave(
 
   Slave& slave = slaves.at(slaveId);
 
+  trackSlaveAvailable(slaveId);
+
   // NOTE: We currently implement maintenance in the allocator to be able to
   // leverage state and features such as the FrameworkSorter and OfferFilter.
   if (unavailability.isSome()) {
     slave.maintenance = Slave::Maintenance(unavailability.get());
   }
 
-  trackReservations(total.reservations());
+  trackReservations(slave.getReservationScalarQuantities());
 
   roleSorter->add(slaveId, total);
 
@@ -599,7 +670,9 @@ void HierarchicalAllocatorProcess::removeSlave(
   quotaRoleSorter->remove(
       slaveId, slaves.at(slaveId).getTotal().nonRevocable());
 
-  untrackReservations(slaves.at(slaveId).getTotal().reservations());
+  untrackReservations(slaves.at(slaveId).getReservationScalarQuantities());
+
+  untrackSlaveAvailable(slaveId);
 
   slaves.erase(slaveId);
   allocationCandidates.erase(slaveId);
@@ -711,6 +784,7 @@ void HierarchicalAllocatorProcess::addResourceProvider(
   Slave& slave = slaves.at(slaveId);
   updateSlaveTotal(slaveId, slave.getTotal() + total);
   slave.allocate(Resources::sum(used));
+  trackSlaveAvailable(slaveId);
 
   VLOG(1)
     << "Grew agent " << slaveId << " by "
@@ -723,23 +797,21 @@ void HierarchicalAllocatorProcess::removeFilters(const SlaveID& slaveId)
 {
   CHECK(initialized);
 
-  foreachpair (const FrameworkID& id,
-               Framework& framework,
-               frameworks) {
+  foreachvalue (Framework& framework, frameworks) {
     framework.inverseOfferFilters.erase(slaveId);
+  }
 
-    // Need a typedef here, otherwise the preprocessor gets confused
-    // by the comma in the template argument list.
-    typedef hashmap<SlaveID, hashset<OfferFilter*>> Filters;
-    foreachpair(const string& role,
-                Filters& filters,
-                framework.offerFilters) {
-      size_t erased = filters.erase(slaveId);
-      if (erased) {
-        frameworkSorters.at(role)->activate(id.value());
-        framework.suppressedRoles.erase(role);
-      }
-    }
+  // Need a typedef here, otherwise the preprocessor gets confused
+  // by the comma in the template argument list.
+  typedef std::pair<FrameworkID, string> FrameworkRole;
+  foreach (const FrameworkRole& frameworkRole, offerFilters.remove(slaveId)) {
+    const FrameworkID& frameworkId = frameworkRole.first;
+    const string& role = frameworkRole.second;
+
+    CHECK(frameworks.contains(frameworkId));
+
+    frameworkSorters.at(role)->activate(frameworkId.value());
+    frameworks.at(frameworkId).suppressedRoles.erase(role);
   }
 
   LOG(INFO) << "Removed all filters for agent " << slaveId;
@@ -849,6 +921,7 @@ void HierarchicalAllocatorProcess::updateAllocation(
   // Update the per-slave allocation.
   slave.unallocate(offeredResources);
   slave.allocate(updatedOfferedResources);
+  trackSlaveAvailable(slaveId);
 
   // Update the allocation in the framework sorter.
   frameworkSorter->update(
@@ -858,11 +931,15 @@ void HierarchicalAllocatorProcess::updateAllocation(
       updatedOfferedResources);
 
   // Update the allocation in the role sorter.
+  totalAllocatedScalarQuantities -=
+    roleSorter->allocationScalarQuantities(role);
   roleSorter->update(
       role,
       slaveId,
       offeredResources,
       updatedOfferedResources);
+  totalAllocatedScalarQuantities +=
+    roleSorter->allocationScalarQuantities(role);
 
   // Update the allocated resources in the quota sorter. We only update
   // the allocated resources if this role has quota set.
@@ -875,6 +952,9 @@ void HierarchicalAllocatorProcess::updateAllocation(
         updatedOfferedResources.nonRevocable());
   }
 
+  untrackAllocatedReservations(role, offeredResources);
+  trackAllocatedReservations(role, updatedOfferedResources);
+
   // Update the agent total resources so they are consistent with the updated
   // allocation. We do not directly use `updatedOfferedResources` here because
   // the agent's total resources shouldn't contain:
@@ -931,12 +1011,12 @@ void HierarchicalAllocatorProcess::updateAllocation(
   //
   // TODO(chhsiao): Revisit this constraint if we want to support other type of
   // resource conversions. See MESOS-9015.
-  const Resources removedAllocationQuantities =
-    frameworkAllocation.createStrippedScalarQuantity() -
-    updatedFrameworkAllocation.createStrippedScalarQuantity();
+  const ResourceQuantities removedAllocationQuantities =
+    ResourceQuantities::fromScalarResources(frameworkAllocation) -
+    ResourceQuantities::fromScalarResources(updatedFrameworkAllocation);
   CHECK_EQ(
       removedAllocationQuantities,
-      removedResources.createStrippedScalarQuantity());
+      ResourceQuantities::fromScalarResources(removedResources));
 
   LOG(INFO) << "Updated allocation of framework " << frameworkId
             << " on agent " << slaveId
@@ -1206,6 +1286,7 @@ void HierarchicalAllocatorProcess::recoverResources(
       << slave.getAllocated() << " does not contain " << resources;
 
     slave.unallocate(resources);
+    trackSlaveAvailable(slaveId);
 
     VLOG(1) << "Recovered " << resources
             << " (total: " << slave.getTotal()
@@ -1262,38 +1343,28 @@ void HierarchicalAllocatorProcess::recoverResources(
     Resources unallocated = resources;
     unallocated.unallocate();
 
-    OfferFilter* offerFilter = new RefusedOfferFilter(unallocated);
-    frameworks.at(frameworkId)
-      .offerFilters[role][slaveId].insert(offerFilter);
-
     // Expire the filter after both an `allocationInterval` and the
     // `timeout` have elapsed. This ensures that the filter does not
     // expire before we perform the next allocation for this agent,
     // see MESOS-4302 for more information.
     //
     // Because the next periodic allocation goes through a dispatch
-    // after `allocationInterval`, we do the same for `expire()`
-    // (with a helper `_expire()`) to achieve the above.
+    // after `allocationInterval`, we do the same for
+    // `expireOfferFilters()` (with a helper `_expireOfferFilters()`)
+    // to achieve the above.
     //
     // TODO(alexr): If we allocated upon resource recovery
     // (MESOS-3078), we would not need to increase the timeout here.
-    timeout = std::max(allocationInterval, timeout.get());
+    timeout = std::max(options.allocationInterval, timeout.get());
 
-    // We need to disambiguate the function call to pick the correct
-    // `expire()` overload.
-    void (Self::*expireOffer)(
-        const FrameworkID&,
-        const string&,
-        const SlaveID&,
-        OfferFilter*) = &Self::expire;
+    offerFilters.add(
+        frameworkId,
+        role,
+        slaveId,
+        unallocated,
+        Clock::now() + timeout.get());
 
-    delay(timeout.get(),
-          self(),
-          expireOffer,
-          frameworkId,
-          role,
-          slaveId,
-          offerFilter);
+    scheduleOfferFilterExpiry();
   }
 }
 
@@ -1332,7 +1403,7 @@ void HierarchicalAllocatorProcess::reviveOffers(
   CHECK(frameworks.contains(frameworkId));
 
   Framework& framework = frameworks.at(frameworkId);
-  framework.offerFilters.clear();
+  offerFilters.remove(frameworkId);
   framework.inverseOfferFilters.clear();
 
   const set<string>& roles = roles_.empty() ? framework.roles : roles_;
@@ -1347,10 +1418,10 @@ void HierarchicalAllocatorProcess::reviveOffers(
     framework.suppressedRoles.erase(role);
   }
 
-  // We delete each actual `OfferFilter` when
+  // We delete each actual `InverseOfferFilter` when
   // `HierarchicalAllocatorProcess::expire` gets invoked. If we delete the
-  // `OfferFilter` here it's possible that the same `OfferFilter` (i.e., same
-  // address) could get reused and `HierarchicalAllocatorProcess::expire`
+  // `InverseOfferFilter` here it's possible that the same filter (i.e.,
+  // same address) could get reused and `HierarchicalAllocatorProcess::expire`
   // would expire that filter too soon. Note that this only works
   // right now because ALL Filter types "expire".
 
@@ -1522,16 +1593,39 @@ Nothing HierarchicalAllocatorProcess::_allocate()
   Stopwatch stopwatch;
   stopwatch.start();
   metrics.allocation_run.start();
+  profiler.start();
+
+  const uint64_t offerFilterLookups = offerFilters.lookups();
+  const uint64_t offerFilterHits = offerFilters.hits();
+  const Duration offerFilterLookupTime = offerFilters.lookupTime();
 
   __allocate();
 
+  const uint64_t lookups = offerFilters.lookups() - offerFilterLookups;
+  if (lookups > 0) {
+    metrics.offer_filter_lookups += lookups;
+    offerFilterLookupLatency =
+      (offerFilters.lookupTime() - offerFilterLookupTime).us() / lookups;
+  }
+
+  profiler.record(
+      AllocationProfiler::FILTER,
+      offerFilters.lookupTime() - offerFilterLookupTime);
+
+  profiler.current().filtered = offerFilters.hits() - offerFilterHits;
+
   // NOTE: For now, we implement maintenance inverse offers within the
   // allocator. We leverage the existing timer/cycle of offers to also do any
   // "deallocation" (inverse offers) necessary to satisfy maintenance needs.
   deallocate();
 
+  profiler.finish(AllocationProfiler::DEALLOCATION);
+  profiler.stop();
+
   metrics.allocation_run.stop();
 
+  metrics.publish(offerFilterLookupLatency, profiler.last().get());
+
   VLOG(1) << "Performed allocation for " << allocationCandidates.size()
           << " agents in " << stopwatch.elapsed();
 
@@ -1556,24 +1650,55 @@ void HierarchicalAllocatorProcess::__allocate()
   // `allocationCandidates`, we have to make sure that we don't
   // assume cluster knowledge when summing resources from that set.
 
+  // Only consider the agents whose available resources might be
+  // allocatable to some role. Since all allocation candidates are
+  // typically considered in a batch allocation, looking up the
+  // candidates in the shape index avoids visiting e.g. the fully
+  // allocated agents of a busy cluster, once per role, below.
+  const AgentShapeIndex::Candidates allocatableSlaveIds =
+    agentShapes.candidates(options.minAllocatableResources);
+
   vector<SlaveID> slaveIds;
-  slaveIds.reserve(allocationCandidates.size());
+  slaveIds.reserve(
+      std::min(allocationCandidates.size(), allocatableSlaveIds.size()));
 
   // Filter out non-whitelisted, removed, and deactivated slaves
   // in order not to send offers for them.
-  foreach (const SlaveID& slaveId, allocationCandidates) {
+  auto consider = [&](const SlaveID& slaveId) {
     if (isWhitelisted(slaveId) &&
         slaves.contains(slaveId) &&
         slaves.at(slaveId).activated) {
       slaveIds.push_back(slaveId);
     }
+  };
+
+  // Iterate over the smaller of the two sets.
+  if (allocatableSlaveIds.size() < allocationCandidates.size()) {
+    foreach (const hashset<SlaveID>* agents, allocatableSlaveIds.agents()) {
+      foreach (const SlaveID& slaveId, *agents) {
+        if (allocationCandidates.contains(slaveId)) {
+          consider(slaveId);
+        }
+      }
+    }
+  } else {
+    foreach (const SlaveID& slaveId, allocationCandidates) {
+      if (allocatableSlaveIds.contains(slaveId)) {
+        consider(slaveId);
+      }
+    }
   }
 
   // Randomize the order in which slaves' resources are allocated.
+  // Since agents of the same shape are interchangeable as far as the
+  // index is concerned, this keeps the selection among them fair.
   //
   // TODO(vinod): Implement a smarter sorting algorithm.
   std::random_shuffle(slaveIds.begin(), slaveIds.end());
 
+  profiler.current().agents = slaveIds.size();
+  profiler.finish(AllocationProfiler::SELECT_AGENTS);
+
   // Returns the __quantity__ of resources allocated to a role with
   // non-default quota. Since we account for reservations and persistent
   // volumes toward quota, we strip reservation and persistent volumes
@@ -1600,8 +1725,11 @@ void HierarchicalAllocatorProcess::__allocate()
   // the target sizes (e.g. need to exclude 1 of 2 disks); this function
   // will make a random choice in these cases.
   auto shrinkResources =
-    [](const Resources& resources,
-       hashmap<string, Value::Scalar> targetScalarQuantites) {
+    [this](const Resources& resources,
+           hashmap<string, Value::Scalar> targetScalarQuantites) {
+    Stopwatch stopwatch;
+    stopwatch.start();
+
     google::protobuf::RepeatedPtrField<Resource>
       resourceVector = resources;
 
@@ -1624,6 +1752,8 @@ void HierarchicalAllocatorProcess::__allocate()
       }
     }
 
+    profiler.record(AllocationProfiler::SHRINK, stopwatch.elapsed());
+
     return result;
   };
 
@@ -1649,7 +1779,7 @@ void HierarchicalAllocatorProcess::__allocate()
   //       would no longer need to track reservations separately.
   //
   // Note these are __quantities__ with no meta-data.
-  hashmap<string, Resources> rolesConsumedQuotaScalarQuantites;
+  hashmap<string, ResourceQuantities> rolesConsumedQuotaScalarQuantites;
 
   // We charge a role against its quota by considering its allocation as well
   // as any unallocated reservations since reservations are bound to the role.
@@ -1662,20 +1792,16 @@ void HierarchicalAllocatorProcess::__allocate()
   foreachkey (const string& role, quotas) {
     // First add reservations.
     rolesConsumedQuotaScalarQuantites[role] +=
-      reservationScalarQuantities.get(role).getOrElse(Resources());
+      reservationScalarQuantities.get(role).getOrElse(ResourceQuantities());
 
     // Then add allocated resoruces.
     rolesConsumedQuotaScalarQuantites[role] +=
       getQuotaRoleAllocatedScalarQuantities(role);
 
-    // Lastly subtract allocated reservations on each agent.
-    const hashmap<SlaveID, Resources> allocations =
-      quotaRoleSorter->allocation(role);
-
-    foreachvalue (const Resources& resources, allocations) {
-      rolesConsumedQuotaScalarQuantites[role] -=
-        resources.reserved().createStrippedScalarQuantity();
-    }
+    // Lastly subtract allocated reservations.
+    rolesConsumedQuotaScalarQuantites[role] -=
+      allocatedReservationScalarQuantities.get(role)
+        .getOrElse(ResourceQuantities());
   }
 
   // We need to constantly make sure that we are holding back enough
@@ -1688,13 +1814,15 @@ void HierarchicalAllocatorProcess::__allocate()
   // Given the above, if a role has more reservations (which count towards
   // consumed quota) than quota guarantee, we don't need to hold back any
   // unreserved headroom for it.
-  Resources requiredHeadroom;
+  ResourceQuantities requiredHeadroom;
   foreachpair (const string& role, const Quota& quota, quotas) {
-    // We can safely subtract resources without checking inclusion. If the
-    // minuend resource is less than the subtrahend resource, the result is an
-    // empty resource.
-    requiredHeadroom += Resources(quota.info.guarantee()) -
-      rolesConsumedQuotaScalarQuantites.get(role).getOrElse(Resources());
+    // We can safely subtract quantities without checking inclusion. If the
+    // minuend quantity is less than the subtrahend quantity, the result is
+    // an empty quantity.
+    requiredHeadroom +=
+      ResourceQuantities::fromScalarResources(quota.info.guarantee()) -
+      rolesConsumedQuotaScalarQuantites.get(role)
+        .getOrElse(ResourceQuantities());
   }
 
   // We will allocate resources while ensuring that the required
@@ -1709,42 +1837,13 @@ void HierarchicalAllocatorProcess::__allocate()
   //                        allocated resources -
   //                        unallocated reservations -
   //                        unallocated revocable resources
-  Resources availableHeadroom = roleSorter->totalScalarQuantities();
-
-  // Subtract allocated resources from the total.
-  foreachkey (const string& role, roles) {
-    availableHeadroom -= roleSorter->allocationScalarQuantities(role);
-  }
-
-  // Calculate total allocated reservations. Note that we need to ensure
-  // we count a reservation for "a" being allocated to "a/b", therefore
-  // we cannot simply loop over the reservations' roles.
-  Resources totalAllocatedReservationScalarQuantities;
-  foreachkey (const string& role, roles) {
-    hashmap<SlaveID, Resources> allocations;
-    if (quotaRoleSorter->contains(role)) {
-      allocations = quotaRoleSorter->allocation(role);
-    } else if (roleSorter->contains(role)) {
-      allocations = roleSorter->allocation(role);
-    } else {
-      continue; // This role has no allocation.
-    }
-
-    foreachvalue (const Resources& resources, allocations) {
-      totalAllocatedReservationScalarQuantities +=
-        resources.reserved().createStrippedScalarQuantity();
-    }
-  }
-
-  // Subtract total unallocated reservations.
-  availableHeadroom -=
-    Resources::sum(reservationScalarQuantities) -
-    totalAllocatedReservationScalarQuantities;
+  //
+  // The terms are maintained incrementally, so this does not need to
+  // iterate over all roles and agents, see `getAvailableHeadroom()`.
+  ResourceQuantities availableHeadroom = getAvailableHeadroom();
 
-  // Subtract revocable resources.
-  foreachvalue (const Slave& slave, slaves) {
-    availableHeadroom -=
-      slave.getAvailable().revocable().createStrippedScalarQuantity();
+  if (options.validateQuotaHeadroom) {
+    CHECK_EQ(computeAvailableHeadroom(), availableHeadroom);
   }
 
   // Due to the two stages in the allocation algorithm and the nature of
@@ -1758,6 +1857,8 @@ void HierarchicalAllocatorProcess::__allocate()
   // allocated in the current cycle.
   hashmap<SlaveID, Resources> offeredSharedResources;
 
+  profiler.finish(AllocationProfiler::QUOTA_HEADROOM);
+
   // Quota guarantee comes first and bursting above the quota guarantee
   // up to the quota limit comes second. Here we process only those
   // roles for that have a non-empty quota guarantee.
@@ -1772,7 +1873,7 @@ void HierarchicalAllocatorProcess::__allocate()
   // roles with unsatisfied guarantee can have more choices and higher
   // probability in getting their guarantee satisfied.
   foreach (const SlaveID& slaveId, slaveIds) {
-    foreach (const string& role, quotaRoleSorter->sort()) {
+    foreach (const string& role, sort(quotaRoleSorter)) {
       CHECK(quotas.contains(role));
 
       const Quota& quota = quotas.at(role);
@@ -1783,12 +1884,16 @@ void HierarchicalAllocatorProcess::__allocate()
         continue;
       }
 
+      ++profiler.current().roles;
+
       // Fetch frameworks according to their fair share.
       // NOTE: Suppressed frameworks are not included in the sort.
       CHECK(frameworkSorters.contains(role));
       const Owned<Sorter>& frameworkSorter = frameworkSorters.at(role);
 
-      foreach (const string& frameworkId_, frameworkSorter->sort()) {
+      foreach (const string& frameworkId_, sort(frameworkSorter)) {
+        ++profiler.current().frameworks;
+
         FrameworkID frameworkId;
         frameworkId.set_value(frameworkId_);
 
@@ -1803,7 +1908,7 @@ void HierarchicalAllocatorProcess::__allocate()
         // Only offer resources from slaves that have GPUs to
         // frameworks that are capable of receiving GPUs.
         // See MESOS-5634.
-        if (filterGpuResources &&
+        if (options.filterGpuResources &&
             !framework.capabilities.gpuResources &&
             slave.getTotal().gpus().getOrElse(0) > 0) {
           continue;
@@ -1815,19 +1920,20 @@ void HierarchicalAllocatorProcess::__allocate()
           continue;
         }
 
-        // Calculate the currently available resources on the slave, which
-        // is the difference in non-shared resources between total and
-        // allocated, plus all shared resources on the agent (if applicable).
-        Resources available = slave.getAvailable().nonShared();
-
+        // The currently available resources on the slave are the difference
+        // in non-shared resources between total and allocated, plus all
+        // shared resources on the agent (if applicable). We look up the
+        // non-shared resources in the slave's reservation index.
+        //
         // Since shared resources are offerable even when they are in use, we
         // make one copy of the shared resources available regardless of the
         // past allocations. Offer a shared resource only if it has not been
         // offered in this offer cycle to a framework.
+        Resources availableShared;
         if (framework.capabilities.sharedResources) {
-          available += slave.getTotal().shared();
+          availableShared = slave.getTotal().shared();
           if (offeredSharedResources.contains(slaveId)) {
-            available -= offeredSharedResources[slaveId];
+            availableShared -= offeredSharedResources[slaveId];
           }
         }
 
@@ -1865,21 +1971,25 @@ void HierarchicalAllocatorProcess::__allocate()
         //
         // NOTE: Since we currently only support top-level roles to
         // have quota, there are no ancestor reservations involved here.
-        Resources toAllocate = available.reserved(role).nonRevocable();
+        Resources toAllocate =
+          (slave.getAvailableReserved(role) + availableShared.reserved(role))
+            .nonRevocable();
 
-        // This is a scalar quantity with no meta-data.
-        Resources unsatisfiedQuotaGuarantee =
-          Resources(quota.info.guarantee()) -
-            rolesConsumedQuotaScalarQuantites.get(role).getOrElse(Resources());
+        ResourceQuantities unsatisfiedQuotaGuarantee =
+          ResourceQuantities::fromScalarResources(quota.info.guarantee()) -
+            rolesConsumedQuotaScalarQuantites.get(role)
+              .getOrElse(ResourceQuantities());
 
-        Resources unreserved = available.nonRevocable().unreserved();
+        Resources unreserved =
+          (slave.getAvailableUnreserved() + availableShared.unreserved())
+            .nonRevocable();
 
         // First, allocate resources up to a role's quota guarantee.
 
         hashmap<string, Value::Scalar> unsatisfiedQuotaGuaranteeScalarLimit;
-        foreach (const string& name, unsatisfiedQuotaGuarantee.names()) {
-          unsatisfiedQuotaGuaranteeScalarLimit[name] +=
-            CHECK_NOTNONE(unsatisfiedQuotaGuarantee.get<Value::Scalar>(name));
+        foreach (const auto& quantity, unsatisfiedQuotaGuarantee) {
+          unsatisfiedQuotaGuaranteeScalarLimit[quantity.first] +=
+            quantity.second;
         }
 
         Resources newQuotaAllocation =
@@ -1916,12 +2026,12 @@ void HierarchicalAllocatorProcess::__allocate()
           );
 
         // Allocation Limit = Available Headroom - Required Headroom
-        Resources headroomResourcesLimit = availableHeadroom - requiredHeadroom;
+        ResourceQuantities headroomQuantitiesLimit =
+          availableHeadroom - requiredHeadroom;
 
         hashmap<string, Value::Scalar> headroomScalarLimit;
-        foreach (const string& name, headroomResourcesLimit.names()) {
-          headroomScalarLimit[name] =
-            CHECK_NOTNONE(headroomResourcesLimit.get<Value::Scalar>(name));
+        foreach (const auto& quantity, headroomQuantitiesLimit) {
+          headroomScalarLimit[quantity.first] = quantity.second;
         }
 
         // If a resource type is absent in `headroomScalarLimit`, it means this
@@ -1988,8 +2098,8 @@ void HierarchicalAllocatorProcess::__allocate()
         offerable[frameworkId][role][slaveId] += toAllocate;
         offeredSharedResources[slaveId] += toAllocate.shared();
 
-        Resources allocatedUnreserved =
-          toAllocate.unreserved().createStrippedScalarQuantity();
+        ResourceQuantities allocatedUnreserved =
+          ResourceQuantities::fromScalarResources(toAllocate.unreserved());
 
         // Update role consumed quota.
         rolesConsumedQuotaScalarQuantites[role] += allocatedUnreserved;
@@ -2001,19 +2111,30 @@ void HierarchicalAllocatorProcess::__allocate()
         // role's guarantee should be subtracted. Allocation of reserved
         // resources or resources that this role has unset guarantee do not
         // affect `requiredHeadroom`.
-        requiredHeadroom -= newQuotaAllocation.createStrippedScalarQuantity();
+        requiredHeadroom -=
+          ResourceQuantities::fromScalarResources(newQuotaAllocation);
 
         // `availableHeadroom` counts total unreserved non-revocable resources
         // in the cluster.
         availableHeadroom -= allocatedUnreserved;
 
         slave.allocate(toAllocate);
+        trackSlaveAvailable(slaveId);
 
         trackAllocatedResources(slaveId, frameworkId, toAllocate);
       }
     }
+
+    // Offers are only ever sent in between agents, so that the
+    // resources of an agent allocated to a role of a framework
+    // are never split into multiple offers.
+    if (options.offerBatchSize.isSome()) {
+      sendOffers(&offerable, options.offerBatchSize.get());
+    }
   }
 
+  profiler.finish(AllocationProfiler::QUOTA_ALLOCATION);
+
   // Similar to the first stage, we will allocate resources while ensuring
   // that the required unreserved non-revocable headroom is still available
   // for unsastified quota guarantees. Otherwise, we will not be able to
@@ -2022,159 +2143,474 @@ void HierarchicalAllocatorProcess::__allocate()
   // are not part of the headroom (and therefore can't be used to satisfy
   // quota guarantees).
 
-  foreach (const SlaveID& slaveId, slaveIds) {
-    foreach (const string& role, roleSorter->sort()) {
-      // In the second allocation stage, we only allocate
-      // for non-quota roles.
-      if (quotas.contains(role)) {
-        continue;
+  if (options.allocationShards > 1 && slaveIds.size() > 1) {
+    allocateShards(
+        slaveIds,
+        requiredHeadroom,
+        &availableHeadroom,
+        &offeredSharedResources,
+        &offerable);
+  } else {
+    foreach (const SlaveID& slaveId, slaveIds) {
+      foreach (const string& role, sort(roleSorter)) {
+        // In the second allocation stage, we only allocate
+        // for non-quota roles.
+        if (quotas.contains(role)) {
+          continue;
+        }
+
+        ++profiler.current().roles;
+
+        // NOTE: Suppressed frameworks are not included in the sort.
+        CHECK(frameworkSorters.contains(role));
+        const Owned<Sorter>& frameworkSorter = frameworkSorters.at(role);
+
+        foreach (const string& frameworkId_, sort(frameworkSorter)) {
+          ++profiler.current().frameworks;
+
+          FrameworkID frameworkId;
+          frameworkId.set_value(frameworkId_);
+
+          CHECK(slaves.contains(slaveId));
+          CHECK(frameworks.contains(frameworkId));
+
+          const Framework& framework = frameworks.at(frameworkId);
+          Slave& slave = slaves.at(slaveId);
+
+          // Only offer resources from slaves that have GPUs to
+          // frameworks that are capable of receiving GPUs.
+          // See MESOS-5634.
+          if (options.filterGpuResources &&
+              !framework.capabilities.gpuResources &&
+              slave.getTotal().gpus().getOrElse(0) > 0) {
+            continue;
+          }
+
+          // If this framework is not region-aware, don't offer it
+          // resources on agents in remote regions.
+          if (!framework.capabilities.regionAware && isRemoteSlave(slave)) {
+            continue;
+          }
+
+          // The currently available resources on the slave are the
+          // difference in non-shared resources between total and allocated,
+          // plus all shared resources on the agent (if applicable). We look
+          // up the non-shared resources in the slave's reservation index.
+          //
+          // Since shared resources are offerable even when they are in use, we
+          // make one copy of the shared resources available regardless of the
+          // past allocations. Offer a shared resource only if it has not been
+          // offered in this offer cycle to a framework.
+          Resources availableShared;
+          if (framework.capabilities.sharedResources) {
+            availableShared = slave.getTotal().shared();
+            if (offeredSharedResources.contains(slaveId)) {
+              availableShared -= offeredSharedResources[slaveId];
+            }
+          }
+
+          // The resources we offer are the unreserved resources as well as the
+          // reserved resources for this particular role and all its ancestors
+          // in the role hierarchy.
+          //
+          // NOTE: Currently, frameworks are allowed to have '*' role.
+          // Calling reserved('*') returns an empty Resources object.
+          //
+          // TODO(mpark): Offer unreserved resources as revocable beyond quota.
+          Resources toAllocate =
+            slave.getAvailableAllocatableTo(role) +
+            availableShared.allocatableTo(role);
+
+          // It is safe to break here, because all frameworks under a role would
+          // consider the same resources, so in case we don't have allocatable
+          // resources, we don't have to check for other frameworks under the
+          // same role. We only break out of the innermost loop, so the next
+          // step will use the same slaveId, but a different role.
+          //
+          // The difference to the second `allocatable` check is that here we
+          // also check for revocable resources, which can be disabled on a per
+          // framework basis, which requires us to go through all frameworks in
+          // case we have allocatable revocable resources.
+          if (!allocatable(toAllocate)) {
+            break;
+          }
+
+          // Remove revocable resources if the framework has not opted for them.
+          if (!framework.capabilities.revocableResources) {
+            toAllocate = toAllocate.nonRevocable();
+          }
+
+          // When reservation refinements are present, old frameworks without
+          // the RESERVATION_REFINEMENT capability won't be able to understand
+          // the new format. While it's possible to translate the refined
+          // reservations into the old format by "hiding" the intermediate
+          // reservations in the "stack", this leads to ambiguity when
+          // processing RESERVE / UNRESERVE operations. This is due to the loss
+          // of information when we drop the intermediate reservations.
+          // Therefore, for now we simply filter out resources with refined
+          // reservations if the framework does not have the capability.
+          if (!framework.capabilities.reservationRefinement) {
+            toAllocate = toAllocate.filter([](const Resource& resource) {
+              return !Resources::hasRefinedReservations(resource);
+            });
+          }
+
+          // If allocating these resources would reduce the headroom
+          // below what is required, we will hold them back.
+          const Resources headroomToAllocate = toAllocate
+            .scalars().unreserved().nonRevocable();
+
+          bool sufficientHeadroom =
+            (availableHeadroom -
+              ResourceQuantities::fromScalarResources(headroomToAllocate))
+              .contains(requiredHeadroom);
+
+          if (!sufficientHeadroom) {
+            toAllocate -= headroomToAllocate;
+          }
+
+          // If the resources are not allocatable, ignore. We cannot break
+          // here, because another framework under the same role could accept
+          // revocable resources and breaking would skip all other frameworks.
+          if (!allocatable(toAllocate)) {
+            continue;
+          }
+
+          // If the framework filters these resources, ignore.
+          if (isFiltered(frameworkId, role, slaveId, toAllocate)) {
+            continue;
+          }
+
+          VLOG(2) << "Allocating " << toAllocate << " on agent " << slaveId
+                  << " to role " << role << " of framework " << frameworkId;
+
+          toAllocate.allocate(role);
+
+          // NOTE: We perform "coarse-grained" allocation, meaning that we
+          // always allocate the entire remaining slave resources to a single
+          // framework.
+          offerable[frameworkId][role][slaveId] += toAllocate;
+          offeredSharedResources[slaveId] += toAllocate.shared();
+
+          if (sufficientHeadroom) {
+            availableHeadroom -=
+              ResourceQuantities::fromScalarResources(headroomToAllocate);
+          }
+
+          slave.allocate(toAllocate);
+          trackSlaveAvailable(slaveId);
+
+          trackAllocatedResources(slaveId, frameworkId, toAllocate);
+        }
       }
 
-      // NOTE: Suppressed frameworks are not included in the sort.
-      CHECK(frameworkSorters.contains(role));
-      const Owned<Sorter>& frameworkSorter = frameworkSorters.at(role);
+      if (options.offerBatchSize.isSome()) {
+        sendOffers(&offerable, options.offerBatchSize.get());
+      }
+    }
+  }
 
-      foreach (const string& frameworkId_, frameworkSorter->sort()) {
-        FrameworkID frameworkId;
-        frameworkId.set_value(frameworkId_);
+  profiler.finish(AllocationProfiler::ALLOCATION);
 
-        CHECK(slaves.contains(slaveId));
-        CHECK(frameworks.contains(frameworkId));
+  if (offerable.empty()) {
+    if (profiler.current().offers == 0) {
+      VLOG(2) << "No allocations performed";
+    }
+  } else {
+    // Now offer the (remaining) resources to each framework.
+    sendOffers(&offerable, 0);
+  }
+
+  profiler.finish(AllocationProfiler::OFFER_CALLBACKS);
+}
+
+
+void HierarchicalAllocatorProcess::sendOffers(
+    hashmap<FrameworkID, hashmap<string, hashmap<SlaveID, Resources>>>*
+      offerable,
+    size_t batchSize)
+{
+  // Each (framework, role, agent) entry results in one offer.
+  size_t count = 0;
+  foreachvalue (const auto& roles, *offerable) {
+    foreachvalue (const auto& agents, roles) {
+      count += agents.size();
+    }
+  }
+
+  if (count == 0 || count < batchSize) {
+    return;
+  }
+
+  foreachkey (const FrameworkID& frameworkId, *offerable) {
+    offerCallback(frameworkId, offerable->at(frameworkId));
+  }
+
+  profiler.current().offers += offerable->size();
+
+  offerable->clear();
+}
+
+
+void HierarchicalAllocatorProcess::allocateShards(
+    const vector<SlaveID>& slaveIds,
+    const ResourceQuantities& requiredHeadroom,
+    ResourceQuantities* availableHeadroom,
+    hashmap<SlaveID, Resources>* offeredSharedResources,
+    hashmap<FrameworkID, hashmap<string, hashmap<SlaveID, Resources>>>*
+      offerable)
+{
+  // Take a snapshot of the order in which roles and frameworks are
+  // visited. Sorting may update the sorters, so this has to be done
+  // before any of the workers starts reading allocator state. As in
+  // the sequential second stage, we only allocate for non-quota roles.
+  vector<string> roleOrder;
+  hashmap<string, vector<FrameworkID>> frameworkOrder;
+
+  foreach (const string& role, sort(roleSorter)) {
+    if (quotas.contains(role)) {
+      continue;
+    }
+
+    // NOTE: Suppressed frameworks are not included in the sort.
+    CHECK(frameworkSorters.contains(role));
+    const Owned<Sorter>& frameworkSorter = frameworkSorters.at(role);
+
+    vector<FrameworkID>& frameworkIds = frameworkOrder[role];
+
+    foreach (const string& frameworkId_, sort(frameworkSorter)) {
+      FrameworkID frameworkId;
+      frameworkId.set_value(frameworkId_);
+
+      CHECK(frameworks.contains(frameworkId));
+
+      frameworkIds.push_back(frameworkId);
+    }
+
+    roleOrder.push_back(role);
+  }
+
+  const size_t shardCount =
+    std::min(options.allocationShards, slaveIds.size());
+
+  const size_t shardSize = (slaveIds.size() + shardCount - 1) / shardCount;
+
+  vector<vector<ShardAllocation>> shardAllocations(shardCount);
+
+  // Each shard counts the roles and frameworks it visits separately.
+  vector<AllocationProfiler::Run> shardProfiles(shardCount);
+
+  vector<lambda::function<void()>> shards;
+  shards.reserve(shardCount);
+
+  // The allocator actor blocks until all shards have been computed,
+  // hence no allocator state is modified while they are reading it.
+  for (size_t shard = 0; shard < shardCount; shard++) {
+    vector<SlaveID>::const_iterator begin =
+      slaveIds.begin() + std::min(shard * shardSize, slaveIds.size());
+
+    vector<SlaveID>::const_iterator end =
+      slaveIds.begin() + std::min((shard + 1) * shardSize, slaveIds.size());
+
+    shards.push_back(
+        [=, &roleOrder, &frameworkOrder, &shardAllocations, &shardProfiles]() {
+      shardAllocations[shard] = computeShardAllocations(
+          begin,
+          end,
+          roleOrder,
+          frameworkOrder,
+          *offeredSharedResources,
+          *availableHeadroom,
+          requiredHeadroom,
+          &shardProfiles[shard]);
+    });
+  }
+
+  CHECK_NOTNULL(shardWorkers.get())->run(shards);
+
+  foreach (const AllocationProfiler::Run& shardProfile, shardProfiles) {
+    profiler.current().roles += shardProfile.roles;
+    profiler.current().frameworks += shardProfile.frameworks;
+  }
+
+  // Commit the allocations in shard order, which is the (shuffled)
+  // order of the agents. Each shard computed its allocations against
+  // the full available headroom, so we need to check the headroom
+  // again and hold back the headroom resources of any allocation that
+  // would reduce the available headroom below what is required.
+  foreach (const vector<ShardAllocation>& allocations, shardAllocations) {
+    foreach (const ShardAllocation& allocation, allocations) {
+      const FrameworkID& frameworkId = allocation.frameworkId;
+      const string& role = allocation.role;
+      const SlaveID& slaveId = allocation.slaveId;
+
+      Resources toAllocate = allocation.resources;
+
+      ResourceQuantities headroomToAllocate =
+        ResourceQuantities::fromScalarResources(allocation.headroomToAllocate);
+
+      if (!(*availableHeadroom - headroomToAllocate)
+             .contains(requiredHeadroom)) {
+        toAllocate -= allocation.headroomToAllocate;
+        headroomToAllocate = ResourceQuantities();
 
+        // The framework might not want (or be able to use) the
+        // remaining resources, so we have to check these again.
+        if (!allocatable(toAllocate) ||
+            isFiltered(frameworkId, role, slaveId, toAllocate)) {
+          continue;
+        }
+      }
+
+      VLOG(2) << "Allocating " << toAllocate << " on agent " << slaveId
+              << " to role " << role << " of framework " << frameworkId;
+
+      toAllocate.allocate(role);
+
+      (*offerable)[frameworkId][role][slaveId] += toAllocate;
+      (*offeredSharedResources)[slaveId] += toAllocate.shared();
+
+      *availableHeadroom -= headroomToAllocate;
+
+      slaves.at(slaveId).allocate(toAllocate);
+      trackSlaveAvailable(slaveId);
+
+      trackAllocatedResources(slaveId, frameworkId, toAllocate);
+    }
+
+    // Shards are made of whole agents, so we can send the offers
+    // in between shards without splitting them.
+    if (options.offerBatchSize.isSome()) {
+      sendOffers(offerable, options.offerBatchSize.get());
+    }
+  }
+}
+
+
+vector<HierarchicalAllocatorProcess::ShardAllocation>
+HierarchicalAllocatorProcess::computeShardAllocations(
+    vector<SlaveID>::const_iterator begin,
+    vector<SlaveID>::const_iterator end,
+    const vector<string>& roleOrder,
+    const hashmap<string, vector<FrameworkID>>& frameworkOrder,
+    const hashmap<SlaveID, Resources>& offeredSharedResources,
+    ResourceQuantities availableHeadroom,
+    const ResourceQuantities& requiredHeadroom,
+    AllocationProfiler::Run* profile) const
+{
+  vector<ShardAllocation> result;
+
+  // The sort order is not updated while a shard is computed. To avoid
+  // allocating every agent of the shard to the role (and framework)
+  // with the lowest share, we visit roles and frameworks round-robin,
+  // starting from their position in the sort order snapshot.
+  size_t nextRole = 0;
+  hashmap<string, size_t> nextFramework;
+
+  for (auto slaveId = begin; slaveId != end; ++slaveId) {
+    CHECK(slaves.contains(*slaveId));
+
+    const Slave& slave = slaves.at(*slaveId);
+
+    // Resources on this agent allocated by this shard so far. We cannot
+    // update the agent itself, since it is shared with the allocator.
+    Resources allocated;
+    Resources offeredShared =
+      offeredSharedResources.get(*slaveId).getOrElse(Resources());
+
+    const size_t firstRole = nextRole;
+
+    for (size_t i = 0; i < roleOrder.size(); i++) {
+      const size_t roleIndex = (firstRole + i) % roleOrder.size();
+      const string& role = roleOrder[roleIndex];
+
+      const vector<FrameworkID>& frameworkIds = frameworkOrder.at(role);
+      const size_t firstFramework = nextFramework[role];
+
+      ++profile->roles;
+
+      for (size_t j = 0; j < frameworkIds.size(); j++) {
+        ++profile->frameworks;
+
+        const size_t frameworkIndex =
+          (firstFramework + j) % frameworkIds.size();
+
+        const FrameworkID& frameworkId = frameworkIds[frameworkIndex];
         const Framework& framework = frameworks.at(frameworkId);
-        Slave& slave = slaves.at(slaveId);
 
-        // Only offer resources from slaves that have GPUs to
-        // frameworks that are capable of receiving GPUs.
-        // See MESOS-5634.
-        if (filterGpuResources &&
+        // The following mirrors the sequential second allocation stage
+        // in `__allocate()`, see there for details.
+        if (options.filterGpuResources &&
             !framework.capabilities.gpuResources &&
             slave.getTotal().gpus().getOrElse(0) > 0) {
           continue;
         }
 
-        // If this framework is not region-aware, don't offer it
-        // resources on agents in remote regions.
         if (!framework.capabilities.regionAware && isRemoteSlave(slave)) {
           continue;
         }
 
-        // Calculate the currently available resources on the slave, which
-        // is the difference in non-shared resources between total and
-        // allocated, plus all shared resources on the agent (if applicable).
-        Resources available = slave.getAvailable().nonShared();
+        Resources toAllocate =
+          slave.getAvailableAllocatableTo(role) - allocated;
 
-        // Since shared resources are offerable even when they are in use, we
-        // make one copy of the shared resources available regardless of the
-        // past allocations. Offer a shared resource only if it has not been
-        // offered in this offer cycle to a framework.
         if (framework.capabilities.sharedResources) {
-          available += slave.getTotal().shared();
-          if (offeredSharedResources.contains(slaveId)) {
-            available -= offeredSharedResources[slaveId];
-          }
+          toAllocate +=
+            (slave.getTotal().shared() - offeredShared).allocatableTo(role);
         }
 
-        // The resources we offer are the unreserved resources as well as the
-        // reserved resources for this particular role and all its ancestors
-        // in the role hierarchy.
-        //
-        // NOTE: Currently, frameworks are allowed to have '*' role.
-        // Calling reserved('*') returns an empty Resources object.
-        //
-        // TODO(mpark): Offer unreserved resources as revocable beyond quota.
-        Resources toAllocate = available.allocatableTo(role);
-
-        // It is safe to break here, because all frameworks under a role would
-        // consider the same resources, so in case we don't have allocatable
-        // resources, we don't have to check for other frameworks under the
-        // same role. We only break out of the innermost loop, so the next step
-        // will use the same slaveId, but a different role.
-        //
-        // The difference to the second `allocatable` check is that here we also
-        // check for revocable resources, which can be disabled on a per frame-
-        // work basis, which requires us to go through all frameworks in case we
-        // have allocatable revocable resources.
         if (!allocatable(toAllocate)) {
           break;
         }
 
-        // Remove revocable resources if the framework has not opted for them.
         if (!framework.capabilities.revocableResources) {
           toAllocate = toAllocate.nonRevocable();
         }
 
-        // When reservation refinements are present, old frameworks without the
-        // RESERVATION_REFINEMENT capability won't be able to understand the
-        // new format. While it's possible to translate the refined reservations
-        // into the old format by "hiding" the intermediate reservations in the
-        // "stack", this leads to ambiguity when processing RESERVE / UNRESERVE
-        // operations. This is due to the loss of information when we drop the
-        // intermediate reservations. Therefore, for now we simply filter out
-        // resources with refined reservations if the framework does not have
-        // the capability.
         if (!framework.capabilities.reservationRefinement) {
           toAllocate = toAllocate.filter([](const Resource& resource) {
             return !Resources::hasRefinedReservations(resource);
           });
         }
 
-        // If allocating these resources would reduce the headroom
-        // below what is required, we will hold them back.
-        const Resources headroomToAllocate = toAllocate
+        Resources headroomToAllocate = toAllocate
           .scalars().unreserved().nonRevocable();
 
         bool sufficientHeadroom =
           (availableHeadroom -
-            headroomToAllocate.createStrippedScalarQuantity())
+            ResourceQuantities::fromScalarResources(headroomToAllocate))
             .contains(requiredHeadroom);
 
         if (!sufficientHeadroom) {
           toAllocate -= headroomToAllocate;
+          headroomToAllocate = Resources();
         }
 
-        // If the resources are not allocatable, ignore. We cannot break
-        // here, because another framework under the same role could accept
-        // revocable resources and breaking would skip all other frameworks.
         if (!allocatable(toAllocate)) {
           continue;
         }
 
-        // If the framework filters these resources, ignore.
-        if (isFiltered(frameworkId, role, slaveId, toAllocate)) {
+        if (isFiltered(frameworkId, role, *slaveId, toAllocate)) {
           continue;
         }
 
-        VLOG(2) << "Allocating " << toAllocate << " on agent " << slaveId
-                << " to role " << role << " of framework " << frameworkId;
+        result.push_back(ShardAllocation{
+            frameworkId, role, *slaveId, toAllocate, headroomToAllocate});
 
-        toAllocate.allocate(role);
+        allocated += toAllocate.nonShared();
+        offeredShared += toAllocate.shared();
 
-        // NOTE: We perform "coarse-grained" allocation, meaning that we always
-        // allocate the entire remaining slave resources to a single framework.
-        offerable[frameworkId][role][slaveId] += toAllocate;
-        offeredSharedResources[slaveId] += toAllocate.shared();
+        availableHeadroom -=
+          ResourceQuantities::fromScalarResources(headroomToAllocate);
 
-        if (sufficientHeadroom) {
-          availableHeadroom -=
-            headroomToAllocate.createStrippedScalarQuantity();
-        }
-
-        slave.allocate(toAllocate);
-
-        trackAllocatedResources(slaveId, frameworkId, toAllocate);
+        // Start with the next role (and the next framework within
+        // this role) on the next agent.
+        nextRole = roleIndex + 1;
+        nextFramework[role] = frameworkIndex + 1;
       }
     }
   }
 
-  if (offerable.empty()) {
-    VLOG(2) << "No allocations performed";
-  } else {
-    // Now offer the resources to each framework.
-    foreachkey (const FrameworkID& frameworkId, offerable) {
-      offerCallback(frameworkId, offerable.at(frameworkId));
-    }
-  }
+  return result;
 }
 
 
@@ -2267,6 +2703,8 @@ void HierarchicalAllocatorProcess::deallocate()
     }
   }
 
+  profiler.current().inverseOffers = offerable.size();
+
   if (offerable.empty()) {
     VLOG(2) << "No inverse offers to send out!";
   } else {
@@ -2278,56 +2716,45 @@ void HierarchicalAllocatorProcess::deallocate()
 }
 
 
-void HierarchicalAllocatorProcess::_expire(
-    const FrameworkID& frameworkId,
-    const string& role,
-    const SlaveID& slaveId,
-    OfferFilter* offerFilter)
+void HierarchicalAllocatorProcess::expireOfferFilters()
 {
-  // The filter might have already been removed (e.g., if the
-  // framework no longer exists or in `reviveOffers()`) but not
-  // yet deleted (to keep the address from getting reused
-  // possibly causing premature expiration).
-  //
-  // Since this is a performance-sensitive piece of code,
-  // we use find to avoid the doing any redundant lookups.
-
-  auto frameworkIterator = frameworks.find(frameworkId);
-  if (frameworkIterator != frameworks.end()) {
-    Framework& framework = frameworkIterator->second;
+  // See the comment in `recoverResources()` on why we dispatch here.
+  dispatch(self(), &Self::_expireOfferFilters);
+}
 
-    auto roleFilters = framework.offerFilters.find(role);
-    if (roleFilters != framework.offerFilters.end()) {
-      auto agentFilters = roleFilters->second.find(slaveId);
 
-      if (agentFilters != roleFilters->second.end()) {
-        // Erase the filter (may be a no-op per the comment above).
-        agentFilters->second.erase(offerFilter);
+void HierarchicalAllocatorProcess::_expireOfferFilters()
+{
+  const Time now = Clock::now();
 
-        if (agentFilters->second.empty()) {
-          roleFilters->second.erase(slaveId);
-        }
-      }
-    }
+  if (offerFilterExpiryTimer.isSome() &&
+      offerFilterExpiryTimer->timeout().time() <= now) {
+    offerFilterExpiryTimer = None();
   }
 
-  delete offerFilter;
+  offerFilters.expire(now);
+
+  scheduleOfferFilterExpiry();
 }
 
 
-void HierarchicalAllocatorProcess::expire(
-    const FrameworkID& frameworkId,
-    const string& role,
-    const SlaveID& slaveId,
-    OfferFilter* offerFilter)
+void HierarchicalAllocatorProcess::scheduleOfferFilterExpiry()
 {
-  dispatch(
-      self(),
-      &Self::_expire,
-      frameworkId,
-      role,
-      slaveId,
-      offerFilter);
+  Option<Time> expiry = offerFilters.nextExpiry();
+  if (expiry.isNone()) {
+    return;
+  }
+
+  if (offerFilterExpiryTimer.isSome()) {
+    if (offerFilterExpiryTimer->timeout().time() <= expiry.get()) {
+      return;
+    }
+
+    Clock::cancel(offerFilterExpiryTimer.get());
+  }
+
+  offerFilterExpiryTimer =
+    delay(expiry.get() - Clock::now(), self(), &Self::expireOfferFilters);
 }
 
 
@@ -2413,27 +2840,13 @@ bool HierarchicalAllocatorProcess::isFiltered(
     return true;
   }
 
-  // Since this is a performance-sensitive piece of code,
-  // we use find to avoid the doing any redundant lookups.
-  auto roleFilters = framework.offerFilters.find(role);
-  if (roleFilters == framework.offerFilters.end()) {
-    return false;
-  }
-
-  auto agentFilters = roleFilters->second.find(slaveId);
-  if (agentFilters == roleFilters->second.end()) {
-    return false;
-  }
-
-  foreach (OfferFilter* offerFilter, agentFilters->second) {
-    if (offerFilter->filter(resources)) {
-      VLOG(1) << "Filtered offer with " << resources
-              << " on agent " << slaveId
-              << " for role " << role
-              << " of framework " << frameworkId;
+  if (offerFilters.filtered(frameworkId, role, slaveId, resources)) {
+    VLOG(1) << "Filtered offer with " << resources
+            << " on agent " << slaveId
+            << " for role " << role
+            << " of framework " << frameworkId;
 
-      return true;
-    }
+    return true;
   }
 
   return false;
@@ -2465,16 +2878,18 @@ bool HierarchicalAllocatorProcess::isFiltered(
 }
 
 
-bool HierarchicalAllocatorProcess::allocatable(const Resources& resources)
+bool HierarchicalAllocatorProcess::allocatable(
+    const Resources& resources) const
 {
-  if (minAllocatableResources.isNone() ||
-      CHECK_NOTNONE(minAllocatableResources).empty()) {
+  if (options.minAllocatableResources.isNone() ||
+      CHECK_NOTNONE(options.minAllocatableResources).empty()) {
     return true;
   }
 
   Resources quantity = resources.createStrippedScalarQuantity();
   foreach (
-      const Resources& minResources, CHECK_NOTNONE(minAllocatableResources)) {
+      const Resources& minResources,
+      CHECK_NOTNONE(options.minAllocatableResources)) {
     if (quantity.contains(minResources)) {
       return true;
     }
@@ -2484,6 +2899,20 @@ bool HierarchicalAllocatorProcess::allocatable(const Resources& resources)
 }
 
 
+vector<string> HierarchicalAllocatorProcess::sort(
+    const Owned<Sorter>& sorter)
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  vector<string> result = sorter->sort();
+
+  profiler.record(AllocationProfiler::SORT, stopwatch.elapsed());
+
+  return result;
+}
+
+
 double HierarchicalAllocatorProcess::_resources_offered_or_allocated(
     const string& resource)
 {
@@ -2502,14 +2931,17 @@ double HierarchicalAllocatorProcess::_resources_offered_or_allocated(
 }
 
 
-double HierarchicalAllocatorProcess::_resources_total(
+double HierarchicalAllocatorProcess::_quota_available_headroom(
     const string& resource)
 {
-  Option<Value::Scalar> total =
-    roleSorter->totalScalarQuantities()
-      .get<Value::Scalar>(resource);
+  return getAvailableHeadroom().get(resource).value();
+}
 
-  return total.isSome() ? total->value() : 0;
+
+double HierarchicalAllocatorProcess::_resources_total(
+    const string& resource)
+{
+  return roleSorter->totalScalarQuantities().get(resource).value();
 }
 
 
@@ -2523,30 +2955,70 @@ double HierarchicalAllocatorProcess::_quota_allocated(
     return 0.;
   }
 
-  Option<Value::Scalar> used =
-    roleSorter->allocationScalarQuantities(role)
-      .get<Value::Scalar>(resource);
-
-  return used.isSome() ? used->value() : 0;
+  return roleSorter->allocationScalarQuantities(role).get(resource).value();
 }
 
 
 double HierarchicalAllocatorProcess::_offer_filters_active(
     const string& role)
 {
-  double result = 0;
+  return static_cast<double>(offerFilters.size(role));
+}
+
+
+double HierarchicalAllocatorProcess::_offer_filters_active_total()
+{
+  return static_cast<double>(offerFilters.size());
+}
 
-  foreachvalue (const Framework& framework, frameworks) {
-    if (!framework.offerFilters.contains(role)) {
-      continue;
-    }
 
-    foreachkey (const SlaveID& slaveId, framework.offerFilters.at(role)) {
-      result += framework.offerFilters.at(role).at(slaveId).size();
+Future<process::http::Response> HierarchicalAllocatorProcess::profile(
+    const process::http::Request& request,
+    const Option<Principal>&)
+{
+  size_t limit = MAX_ALLOCATION_RUN_PROFILES;
+
+  Option<string> limit_ = request.url.query.get("limit");
+  if (limit_.isSome()) {
+    Try<size_t> result = numify<size_t>(limit_.get());
+    if (result.isError()) {
+      return process::http::BadRequest(
+          "Failed to parse 'limit': " + result.error());
     }
+
+    limit = result.get();
   }
 
-  return result;
+  return process::http::OK(
+      profiler.json(limit), request.url.query.get("jsonp"));
+}
+
+
+string HierarchicalAllocatorProcess::profileHelp()
+{
+  return HELP(
+      TLDR(
+          "Returns the time spent in each phase of recent allocation runs."),
+      DESCRIPTION(
+          "Returns the profiles of the most recent allocation runs, most",
+          "recent first.",
+          "",
+          "Each profile contains the start time and duration of the",
+          "allocation run, the time spent in each of its phases, and the",
+          "number of agents, roles and frameworks visited, offer filter",
+          "hits, and frameworks sent offers and inverse offers.",
+          "",
+          "The time spent sorting, shrinking resources and looking up offer",
+          "filters ('sort_ms', 'shrink_ms' and 'filter_ms') is included in",
+          "the time of the allocation phases. With allocation shards, the",
+          "offer filter lookups happen in parallel and their time may",
+          "exceed the time of the allocation phase.",
+          "",
+          "Query parameters:",
+          ">        limit=VALUE          Maximum number of allocation runs "
+          "returned (at most " + stringify(MAX_ALLOCATION_RUN_PROFILES) +
+          " are kept)."),
+      AUTHENTICATION(true));
 }
 
 
@@ -2575,7 +3047,8 @@ void HierarchicalAllocatorProcess::trackFrameworkUnderRole(
 
     CHECK(!frameworkSorters.contains(role));
     frameworkSorters.insert({role, Owned<Sorter>(frameworkSorterFactory())});
-    frameworkSorters.at(role)->initialize(fairnessExcludeResourceNames);
+    frameworkSorters.at(role)->initialize(
+        options.fairnessExcludeResourceNames);
     metrics.addRole(role);
   }
 
@@ -2624,31 +3097,28 @@ void HierarchicalAllocatorProcess::untrackFrameworkUnderRole(
 
 
 void HierarchicalAllocatorProcess::trackReservations(
-    const hashmap<std::string, Resources>& reservations)
+    const hashmap<std::string, ResourceQuantities>& reservations)
 {
   foreachpair (const string& role,
-               const Resources& resources, reservations) {
-    const Resources scalarQuantitesToTrack =
-      resources.createStrippedScalarQuantity();
-
-    reservationScalarQuantities[role] += scalarQuantitesToTrack;
+               const ResourceQuantities& quantities, reservations) {
+    reservationScalarQuantities[role] += quantities;
+    totalReservationScalarQuantities += quantities;
   }
 }
 
 
 void HierarchicalAllocatorProcess::untrackReservations(
-    const hashmap<std::string, Resources>& reservations)
+    const hashmap<std::string, ResourceQuantities>& reservations)
 {
   foreachpair (const string& role,
-               const Resources& resources, reservations) {
+               const ResourceQuantities& quantities, reservations) {
     CHECK(reservationScalarQuantities.contains(role));
-    Resources& currentReservationQuantity =
+    ResourceQuantities& currentReservationQuantity =
         reservationScalarQuantities.at(role);
 
-    const Resources scalarQuantitesToUntrack =
-      resources.createStrippedScalarQuantity();
-    CHECK(currentReservationQuantity.contains(scalarQuantitesToUntrack));
-    currentReservationQuantity -= scalarQuantitesToUntrack;
+    CHECK(currentReservationQuantity.contains(quantities));
+    currentReservationQuantity -= quantities;
+    totalReservationScalarQuantities -= quantities;
 
     if (currentReservationQuantity.empty()) {
       reservationScalarQuantities.erase(role);
@@ -2657,6 +3127,44 @@ void HierarchicalAllocatorProcess::untrackReservations(
 }
 
 
+void HierarchicalAllocatorProcess::trackAllocatedReservations(
+    const string& role,
+    const Resources& allocated)
+{
+  const ResourceQuantities quantities =
+    ResourceQuantities::fromScalarResources(allocated.reserved());
+
+  if (!quantities.empty()) {
+    allocatedReservationScalarQuantities[role] += quantities;
+    totalAllocatedReservationScalarQuantities += quantities;
+  }
+}
+
+
+void HierarchicalAllocatorProcess::untrackAllocatedReservations(
+    const string& role,
+    const Resources& allocated)
+{
+  const ResourceQuantities quantities =
+    ResourceQuantities::fromScalarResources(allocated.reserved());
+
+  if (quantities.empty()) {
+    return;
+  }
+
+  CHECK(allocatedReservationScalarQuantities.contains(role));
+  ResourceQuantities& current = allocatedReservationScalarQuantities.at(role);
+
+  CHECK(current.contains(quantities));
+  current -= quantities;
+  totalAllocatedReservationScalarQuantities -= quantities;
+
+  if (current.empty()) {
+    allocatedReservationScalarQuantities.erase(role);
+  }
+}
+
+
 bool HierarchicalAllocatorProcess::updateSlaveTotal(
     const SlaveID& slaveId,
     const Resources& total)
@@ -2671,14 +3179,15 @@ bool HierarchicalAllocatorProcess::updateSlaveTotal(
     return false;
   }
 
-  slave.updateTotal(total);
+  const hashmap<std::string, ResourceQuantities> oldReservations =
+    slave.getReservationScalarQuantities();
 
-  hashmap<std::string, Resources> oldReservations = oldTotal.reservations();
-  hashmap<std::string, Resources> newReservations = total.reservations();
+  slave.updateTotal(total);
+  trackSlaveAvailable(slaveId);
 
-  if (oldReservations != newReservations) {
+  if (oldReservations != slave.getReservationScalarQuantities()) {
     untrackReservations(oldReservations);
-    trackReservations(newReservations);
+    trackReservations(slave.getReservationScalarQuantities());
   }
 
   // Currently `roleSorter` and `quotaRoleSorter`, being the root-level
@@ -2697,6 +3206,96 @@ bool HierarchicalAllocatorProcess::updateSlaveTotal(
 }
 
 
+void HierarchicalAllocatorProcess::trackSlaveAvailable(const SlaveID& slaveId)
+{
+  CHECK(slaves.contains(slaveId));
+
+  Slave& slave = slaves.at(slaveId);
+
+  agentShapes.update(slaveId, slave.getAvailable(), slave.getTotal());
+
+  totalAvailableRevocableScalarQuantities -=
+    slave.availableRevocableScalarQuantities;
+
+  slave.availableRevocableScalarQuantities =
+    ResourceQuantities::fromScalarResources(slave.getAvailable().revocable());
+
+  totalAvailableRevocableScalarQuantities +=
+    slave.availableRevocableScalarQuantities;
+}
+
+
+void HierarchicalAllocatorProcess::untrackSlaveAvailable(
+    const SlaveID& slaveId)
+{
+  CHECK(slaves.contains(slaveId));
+
+  Slave& slave = slaves.at(slaveId);
+
+  agentShapes.remove(slaveId);
+
+  totalAvailableRevocableScalarQuantities -=
+    slave.availableRevocableScalarQuantities;
+
+  slave.availableRevocableScalarQuantities = ResourceQuantities();
+}
+
+
+ResourceQuantities HierarchicalAllocatorProcess::getAvailableHeadroom() const
+{
+  //   available headroom = total resources -
+  //                        allocated resources -
+  //                        unallocated reservations -
+  //                        unallocated revocable resources
+  ResourceQuantities headroom = roleSorter->totalScalarQuantities();
+
+  headroom -= totalAllocatedScalarQuantities;
+
+  headroom -=
+    totalReservationScalarQuantities -
+    totalAllocatedReservationScalarQuantities;
+
+  headroom -= totalAvailableRevocableScalarQuantities;
+
+  return headroom;
+}
+
+
+ResourceQuantities
+HierarchicalAllocatorProcess::computeAvailableHeadroom() const
+{
+  ResourceQuantities headroom = roleSorter->totalScalarQuantities();
+
+  // Subtract allocated resources from the total.
+  foreachkey (const string& role, roles) {
+    headroom -= roleSorter->allocationScalarQuantities(role);
+  }
+
+  // Subtract total unallocated reservations.
+  ResourceQuantities totalReservations;
+  foreachvalue (const ResourceQuantities& quantities,
+                reservationScalarQuantities) {
+    totalReservations += quantities;
+  }
+
+  ResourceQuantities totalAllocatedReservations;
+  foreachvalue (const ResourceQuantities& quantities,
+                allocatedReservationScalarQuantities) {
+    totalAllocatedReservations += quantities;
+  }
+
+  headroom -= totalReservations - totalAllocatedReservations;
+
+  // Subtract revocable resources.
+  foreachvalue (const Slave& slave, slaves) {
+    headroom -= ResourceQuantities::fromScalarResources(
+        slave.getAvailable().revocable());
+  }
+
+  return headroom;
+}
+
+
 bool HierarchicalAllocatorProcess::isRemoteSlave(const Slave& slave) const
 {
   // If the slave does not have a configured domain, assume it is not remote.
@@ -2716,14 +3315,14 @@ bool HierarchicalAllocatorProcess::isRemoteSlave(const Slave& slave) const
   // If the slave has a configured domain (and it has been allowed to
   // register with the master), the master must also have a configured
   // domain.
-  CHECK(domain.isSome());
+  CHECK(options.domain.isSome());
 
   // The master will not startup if configured with a domain but no
   // fault domain.
-  CHECK(domain->has_fault_domain());
+  CHECK(options.domain->has_fault_domain());
 
   const DomainInfo::FaultDomain::RegionInfo& masterRegion =
-    domain->fault_domain().region();
+    options.domain->fault_domain().region();
   const DomainInfo::FaultDomain::RegionInfo& slaveRegion =
     slave.info.domain().fault_domain().region();
 
@@ -2755,7 +3354,11 @@ void HierarchicalAllocatorProcess::trackAllocatedResources(
     CHECK(frameworkSorters.contains(role));
     CHECK(frameworkSorters.at(role)->contains(frameworkId.value()));
 
+    totalAllocatedScalarQuantities -=
+      roleSorter->allocationScalarQuantities(role);
     roleSorter->allocated(role, slaveId, allocation);
+    totalAllocatedScalarQuantities +=
+      roleSorter->allocationScalarQuantities(role);
     frameworkSorters.at(role)->add(slaveId, allocation);
     frameworkSorters.at(role)->allocated(
         frameworkId.value(), slaveId, allocation);
@@ -2764,6 +3367,8 @@ void HierarchicalAllocatorProcess::trackAllocatedResources(
       // See comment at `quotaRoleSorter` declaration regarding non-revocable.
       quotaRoleSorter->allocated(role, slaveId, allocation.nonRevocable());
     }
+
+    trackAllocatedReservations(role, allocation);
   }
 }
 
@@ -2794,12 +3399,18 @@ void HierarchicalAllocatorProcess::untrackAllocatedResources(
         frameworkId.value(), slaveId, allocation);
     frameworkSorters.at(role)->remove(slaveId, allocation);
 
+    totalAllocatedScalarQuantities -=
+      roleSorter->allocationScalarQuantities(role);
     roleSorter->unallocated(role, slaveId, allocation);
+    totalAllocatedScalarQuantities +=
+      roleSorter->allocationScalarQuantities(role);
 
     if (quotas.contains(role)) {
       // See comment at `quotaRoleSorter` declaration regarding non-revocable.
       quotaRoleSorter->unallocated(role, slaveId, allocation.nonRevocable());
     }
+
+    untrackAllocatedReservations(role, allocation);
   }
 }
 
@@ -17,25 +17,40 @@
 #ifndef __MASTER_ALLOCATOR_MESOS_HIERARCHICAL_HPP__
 #define __MASTER_ALLOCATOR_MESOS_HIERARCHICAL_HPP__
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <mesos/mesos.hpp>
+#include <mesos/roles.hpp>
 
+#include <process/event.hpp>
 #include <process/future.hpp>
+#include <process/http.hpp>
 #include <process/id.hpp>
 #include <process/owned.hpp>
+#include <process/timer.hpp>
 
 #include <stout/duration.hpp>
+#include <stout/foreach.hpp>
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
 #include <stout/lambda.hpp>
 #include <stout/option.hpp>
 
 #include "common/protobuf_utils.hpp"
+#include "common/resource_quantities.hpp"
 
+#include "master/allocator/mesos/agent_index.hpp"
 #include "master/allocator/mesos/allocator.hpp"
 #include "master/allocator/mesos/metrics.hpp"
+#include "master/allocator/mesos/offer_filter.hpp"
+#include "master/allocator/mesos/profiler.hpp"
 
 #include "master/allocator/sorter/drf/sorter.hpp"
 #include "master/allocator/sorter/random/sorter.hpp"
@@ -71,10 +86,45 @@ HierarchicalRandomAllocator;
 namespace internal {
 
 // Forward declarations.
-class OfferFilter;
 class InverseOfferFilter;
 
 
+// A fixed set of threads used to compute the allocations for the shards
+// of agents in parallel, see `allocateShards()`. The threads are started
+// once rather than for every allocation run.
+class ShardWorkers
+{
+public:
+  explicit ShardWorkers(size_t size);
+
+  ~ShardWorkers();
+
+  // Runs the given functions on the workers and the calling thread,
+  // and returns once all of them have finished.
+  void run(const std::vector<lambda::function<void()>>& functions);
+
+private:
+  void work();
+
+  std::mutex mutex;
+
+  // Signaled when functions are queued or the workers are stopped.
+  std::condition_variable queued;
+
+  // Signaled when the last of the queued functions has finished.
+  std::condition_variable finished;
+
+  std::deque<lambda::function<void()>> queue;
+
+  // The number of queued functions which have not finished yet.
+  size_t pending;
+
+  bool stopping;
+
+  std::vector<std::thread> threads;
+};
+
+
 // Implements the basic allocator algorithm - first pick a role by
 // some criteria, then pick one of their frameworks to allocate to.
 class HierarchicalAllocatorProcess : public MesosAllocatorProcess
@@ -87,6 +137,8 @@ public:
     : initialized(false),
       paused(true),
       metrics(*this),
+      offerFilterLookupLatency(0.0),
+      profiler(MAX_ALLOCATION_RUN_PROFILES),
       roleSorter(roleSorterFactory()),
       quotaRoleSorter(quotaRoleSorterFactory()),
       frameworkSorterFactory(_frameworkSorterFactory) {}
@@ -99,7 +151,7 @@ public:
   }
 
   void initialize(
-      const Duration& allocationInterval,
+      const mesos::allocator::Options& options,
       const lambda::function<
           void(const FrameworkID&,
                const hashmap<std::string, hashmap<SlaveID, Resources>>&)>&
@@ -107,13 +159,7 @@ public:
       const lambda::function<
           void(const FrameworkID&,
                const hashmap<SlaveID, UnavailableResources>&)>&
-        inverseOfferCallback,
-      const Option<std::set<std::string>>&
-        fairnessExcludeResourceNames = None(),
-      bool filterGpuResources = true,
-      const Option<DomainInfo>& domain = None(),
-      const Option<std::vector<Resources>>&
-        minAllocatableResources = None());
+        inverseOfferCallback);
 
   void recover(
       const int _expectedAgentCount,
@@ -230,6 +276,14 @@ protected:
   typedef HierarchicalAllocatorProcess Self;
   typedef HierarchicalAllocatorProcess This;
 
+  void serve(process::Event&& event) override
+  {
+    MesosAllocatorProcess::serve(std::move(event));
+
+    // Publish the gauges once the queued events have been served.
+    metrics.publisher.served();
+  }
+
   // Idempotent helpers for pausing and resuming allocation.
   void pause();
   void resume();
@@ -250,21 +304,68 @@ protected:
   // Helper for `_allocate()` that allocates resources for offers.
   void __allocate();
 
+  // Helper for `__allocate()` that invokes the offer callback for each
+  // framework in `offerable` and clears it, if `offerable` holds at least
+  // `batchSize` offers (i.e., allocations to a role on an agent). This is
+  // used to pipeline offers to the master when `options.offerBatchSize`
+  // is set, and to send the remaining offers at the end of a run.
+  void sendOffers(
+      hashmap<FrameworkID, hashmap<std::string, hashmap<SlaveID, Resources>>>*
+        offerable,
+      size_t batchSize);
+
+  // An allocation made to a framework on an agent by a shard of agents
+  // during the second allocation stage, see `allocateShards()`.
+  struct ShardAllocation
+  {
+    FrameworkID frameworkId;
+    std::string role;
+    SlaveID slaveId;
+
+    // The resources to allocate. These are not yet allocated to `role`.
+    Resources resources;
+
+    // The part of `resources` that is charged against the available
+    // quota headroom. This is empty if the shard held these back.
+    Resources headroomToAllocate;
+  };
+
+  // Helper for `__allocate()` that performs the second allocation stage
+  // by partitioning the agents into `options.allocationShards` shards.
+  // The allocations for each shard are computed in parallel on the
+  // `shardWorkers`, then committed on the allocator actor in agent order.
+  void allocateShards(
+      const std::vector<SlaveID>& slaveIds,
+      const ResourceQuantities& requiredHeadroom,
+      ResourceQuantities* availableHeadroom,
+      hashmap<SlaveID, Resources>* offeredSharedResources,
+      hashmap<FrameworkID, hashmap<std::string, hashmap<SlaveID, Resources>>>*
+        offerable);
+
+  // Computes the allocations for the agents in [begin, end) given a
+  // snapshot of the role and framework sort order. This runs on one
+  // of the `shardWorkers` while the allocator actor is blocked in
+  // `allocateShards()`, so it must only read allocator state.
+  std::vector<ShardAllocation> computeShardAllocations(
+      std::vector<SlaveID>::const_iterator begin,
+      std::vector<SlaveID>::const_iterator end,
+      const std::vector<std::string>& roleOrder,
+      const hashmap<std::string, std::vector<FrameworkID>>& frameworkOrder,
+      const hashmap<SlaveID, Resources>& offeredSharedResources,
+      ResourceQuantities availableHeadroom,
+      const ResourceQuantities& requiredHeadroom,
+      AllocationProfiler::Run* profile) const;
+
   // Helper for `_allocate()` that deallocates resources for inverse offers.
   void deallocate();
 
-  // Remove an offer filter for the specified role of the framework.
-  void expire(
-      const FrameworkID& frameworkId,
-      const std::string& role,
-      const SlaveID& slaveId,
-      OfferFilter* offerFilter);
+  // Remove the offer filters that have expired.
+  void expireOfferFilters();
+  void _expireOfferFilters();
 
-  void _expire(
-      const FrameworkID& frameworkId,
-      const std::string& role,
-      const SlaveID& slaveId,
-      OfferFilter* offerFilter);
+  // Arms the offer filter expiration timer for the earliest pending
+  // expiration, unless the timer is already armed for it.
+  void scheduleOfferFilterExpiry();
 
   // Remove an inverse offer filter for the specified framework.
   void expire(
@@ -289,7 +390,11 @@ protected:
       const FrameworkID& frameworkID,
       const SlaveID& slaveID) const;
 
-  bool allocatable(const Resources& resources);
+  bool allocatable(const Resources& resources) const;
+
+  // Returns the clients of the sorter in sort order, recording the
+  // time spent sorting in the profile of the current allocation run.
+  std::vector<std::string> sort(const process::Owned<Sorter>& sorter);
 
   bool initialized;
   bool paused;
@@ -297,7 +402,12 @@ protected:
   // Recovery data.
   Option<int> expectedAgentCount;
 
-  Duration allocationInterval;
+  // Configuration of the allocator passed in `initialize()`.
+  mesos::allocator::Options options;
+
+  // The threads computing the allocations for the shards of agents,
+  // only set if `options.allocationShards` is greater than one.
+  process::Owned<ShardWorkers> shardWorkers;
 
   lambda::function<
       void(const FrameworkID&,
@@ -325,26 +435,22 @@ protected:
 
     protobuf::framework::Capabilities capabilities;
 
-    // Active offer and inverse offer filters for the framework.
-    // Offer filters are tied to the role the filtered resources
-    // were allocated to.
-    hashmap<std::string, hashmap<SlaveID, hashset<OfferFilter*>>> offerFilters;
+    // Active inverse offer filters for the framework. Offer filters
+    // are kept in the allocator's `offerFilters` index.
     hashmap<SlaveID, hashset<InverseOfferFilter*>> inverseOfferFilters;
 
     bool active;
   };
 
-  double _event_queue_dispatches()
-  {
-    return static_cast<double>(eventCount<process::DispatchEvent>());
-  }
-
   double _resources_total(
       const std::string& resource);
 
   double _resources_offered_or_allocated(
       const std::string& resource);
 
+  double _quota_available_headroom(
+      const std::string& resource);
+
   double _quota_allocated(
       const std::string& role,
       const std::string& resource);
@@ -352,6 +458,31 @@ protected:
   double _offer_filters_active(
       const std::string& role);
 
+  double _offer_filters_active_total();
+
+  // HTTP handlers.
+
+  // /hierarchical-allocator(N)/profile
+  process::Future<process::http::Response> profile(
+      const process::http::Request& request,
+      const Option<process::http::authentication::Principal>&);
+
+  static std::string profileHelp();
+
+  // Active offer filters of all frameworks. Offer filters are tied
+  // to the role the filtered resources were allocated to.
+  OfferFilterIndex offerFilters;
+
+  // Timer for the earliest pending offer filter expiration, if armed.
+  Option<process::Timer> offerFilterExpiryTimer;
+
+  // Average latency of an offer filter lookup during the most
+  // recent allocation run, in microseconds.
+  double offerFilterLookupLatency;
+
+  // Profiles of the most recent allocation runs.
+  AllocationProfiler profiler;
+
   hashmap<FrameworkID, Framework> frameworks;
 
   class Slave
@@ -369,12 +500,8 @@ protected:
         total(_total),
         allocated(_allocated)
     {
-      // In order to subtract from the total,
-      // we strip the allocation information.
-      Resources allocated_ = allocated;
-      allocated_.unallocate();
-
-      available = total - allocated_;
+      updateReservations();
+      updateAvailable();
     }
 
     Resources getTotal() const { return total; }
@@ -383,9 +510,49 @@ protected:
 
     Resources getAvailable() const { return available; }
 
+    // The non-shared available resources which are unreserved.
+    Resources getAvailableUnreserved() const { return availableUnreserved; }
+
+    // The non-shared available resources reserved to the given role.
+    // Like `Resources::reserved(role)`, this does not include the
+    // resources reserved to the ancestors of the role.
+    Resources getAvailableReserved(const std::string& role) const
+    {
+      return availableReservations.get(role).getOrElse(Resources());
+    }
+
+    // The non-shared available resources allocatable to the given role,
+    // i.e., `getAvailable().nonShared().allocatableTo(role)`.
+    Resources getAvailableAllocatableTo(const std::string& role) const
+    {
+      Resources result = availableUnreserved;
+
+      foreachpair (const std::string& reservationRole,
+                   const Resources& reserved,
+                   availableReservations) {
+        if (role == reservationRole ||
+            mesos::roles::isStrictSubroleOf(role, reservationRole)) {
+          result += reserved;
+        }
+      }
+
+      return result;
+    }
+
+    // The scalar quantities of the reservations in the total resources,
+    // keyed by reservation role, as accounted for in the allocator's
+    // `reservationScalarQuantities`. Only roles with non-empty
+    // quantities are included.
+    const hashmap<std::string, ResourceQuantities>&
+      getReservationScalarQuantities() const
+    {
+      return reservationScalarQuantities;
+    }
+
     void updateTotal(const Resources& newTotal) {
       total = newTotal;
 
+      updateReservations();
       updateAvailable();
     }
 
@@ -449,7 +616,26 @@ protected:
     // to send out `InverseOffers`.
     Option<Maintenance> maintenance;
 
+    // The scalar quantities of the available revocable resources, as
+    // currently accounted for in `totalAvailableRevocableScalarQuantities`.
+    ResourceQuantities availableRevocableScalarQuantities;
+
   private:
+    void updateReservations() {
+      reservationScalarQuantities.clear();
+
+      foreachpair (const std::string& role,
+                   const Resources& reserved,
+                   total.reservations()) {
+        const ResourceQuantities quantities =
+          ResourceQuantities::fromScalarResources(reserved);
+
+        if (!quantities.empty()) {
+          reservationScalarQuantities.put(role, quantities);
+        }
+      }
+    }
+
     void updateAvailable() {
       // In order to subtract from the total,
       // we strip the allocation information.
@@ -457,6 +643,11 @@ protected:
       allocated_.unallocate();
 
       available = total - allocated_;
+
+      Resources nonShared = available.nonShared();
+
+      availableUnreserved = nonShared.unreserved();
+      availableReservations = nonShared.reservations();
     }
 
     // Total amount of regular *and* oversubscribed resources.
@@ -483,6 +674,19 @@ protected:
     // Note that it's possible for the slave to be over-allocated!
     // In this case, allocated > total.
     Resources available;
+
+    // An index of the non-shared available resources by reservation
+    // role. The allocation loops look up the resources allocatable to
+    // a role on each agent, and filtering the reservations out of the
+    // agent's available resources for each role (and framework) is
+    // expensive for agents with many reservations or persistent volumes.
+    Resources availableUnreserved;
+    hashmap<std::string, Resources> availableReservations;
+
+    // See `getReservationScalarQuantities()`. These only change along
+    // with the total resources, so they are computed once rather than
+    // whenever the agent's reservations are tracked or untracked.
+    hashmap<std::string, ResourceQuantities> reservationScalarQuantities;
   };
 
   hashmap<SlaveID, Slave> slaves;
@@ -492,6 +696,10 @@ protected:
   // processed, the set of candidates is cleared.
   hashset<SlaveID> allocationCandidates;
 
+  // Agents indexed by the shape of their available resources, used to
+  // skip the agents without allocatable resources during allocation.
+  AgentShapeIndex agentShapes;
+
   // Future for the dispatched allocation that becomes
   // ready after the allocation run is complete.
   Option<process::Future<Nothing>> allocation;
@@ -511,22 +719,39 @@ protected:
   // that contain no meta-data.
   //
   // Only roles with non-empty reservations will be stored in the map.
-  hashmap<std::string, Resources> reservationScalarQuantities;
+  hashmap<std::string, ResourceQuantities> reservationScalarQuantities;
 
-  // Slaves to send offers for.
-  Option<hashset<std::string>> whitelist;
-
-  // Resources (by name) that will be excluded from a role's fair share.
-  Option<std::set<std::string>> fairnessExcludeResourceNames;
+  // Aggregated allocated reservations tied to a particular role,
+  // keyed by the role they are allocated to (which might be a
+  // subrole of the reservation role). Like the above, these are
+  // stripped scalar quantities, and only roles with non-empty
+  // allocated reservations are stored in the map.
+  //
+  // These are used for quota accounting, instead of filtering the
+  // reservations out of the allocations in the sorters.
+  hashmap<std::string, ResourceQuantities>
+    allocatedReservationScalarQuantities;
+
+  // Aggregates which are maintained incrementally as agents are added,
+  // removed or updated, and as resources are allocated and recovered,
+  // so that the available quota headroom can be computed at the start
+  // of an allocation run without iterating over all roles and agents.
+  // See `getAvailableHeadroom()`.
+  //
+  // The scalar quantities allocated to all roles in `roleSorter`.
+  ResourceQuantities totalAllocatedScalarQuantities;
 
-  // Filter GPU resources based on the `GPU_RESOURCES` framework capability.
-  bool filterGpuResources;
+  // The sums of `reservationScalarQuantities` and
+  // `allocatedReservationScalarQuantities`.
+  ResourceQuantities totalReservationScalarQuantities;
+  ResourceQuantities totalAllocatedReservationScalarQuantities;
 
-  // The master's domain, if any.
-  Option<DomainInfo> domain;
+  // The scalar quantities of the available revocable resources on all
+  // agents, see `Slave::availableRevocableScalarQuantities`.
+  ResourceQuantities totalAvailableRevocableScalarQuantities;
 
-  // The minimum allocatable resources, if any.
-  Option<std::vector<Resources>> minAllocatableResources;
+  // Slaves to send offers for.
+  Option<hashset<std::string>> whitelist;
 
   // There are two stages of allocation:
   //
@@ -626,16 +851,45 @@ private:
   //   (2) Simplify the quota enforcement logic -- the allocator
   //       would no longer need to track reservations separately.
   void trackReservations(
-      const hashmap<std::string, Resources>& reservations);
+      const hashmap<std::string, ResourceQuantities>& reservations);
 
   void untrackReservations(
-      const hashmap<std::string, Resources>& reservations);
+      const hashmap<std::string, ResourceQuantities>& reservations);
+
+  // Helpers to track the reservations in the resources allocated
+  // to a role, see `allocatedReservationScalarQuantities`.
+  void trackAllocatedReservations(
+      const std::string& role,
+      const Resources& allocated);
+
+  void untrackAllocatedReservations(
+      const std::string& role,
+      const Resources& allocated);
 
   // Helper to update the agent's total resources maintained in the allocator
   // and the role and quota sorters (whose total resources match the agent's
   // total resources). Returns true iff the stored agent total was changed.
   bool updateSlaveTotal(const SlaveID& slaveId, const Resources& total);
 
+  // Helpers to update the state derived from the agent's available
+  // resources, i.e., its entry in `agentShapes` and its contribution to
+  // `totalAvailableRevocableScalarQuantities`. `trackSlaveAvailable()`
+  // must be called after the agent is added or its total or allocated
+  // resources have changed, `untrackSlaveAvailable()` before the agent
+  // is removed.
+  void trackSlaveAvailable(const SlaveID& slaveId);
+  void untrackSlaveAvailable(const SlaveID& slaveId);
+
+  // Returns the available quota headroom, i.e., the unallocated
+  // unreserved non-revocable scalar resource quantities, using the
+  // incrementally maintained aggregates below.
+  ResourceQuantities getAvailableHeadroom() const;
+
+  // Returns the available quota headroom by aggregating over all roles
+  // and agents. This is used to validate the incrementally maintained
+  // headroom if `options.validateQuotaHeadroom` is set.
+  ResourceQuantities computeAvailableHeadroom() const;
+
   // Helper that returns true if the given agent is located in a
   // different region than the master. This can only be the case if
   // the agent and the master are both configured with a fault domain.
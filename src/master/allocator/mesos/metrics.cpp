@@ -16,10 +16,15 @@
 
 #include "master/allocator/mesos/metrics.hpp"
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
 
 #include <mesos/quota/quota.hpp>
 
+#include <process/event.hpp>
+
 #include <process/metrics/pull_gauge.hpp>
 #include <process/metrics/metrics.hpp>
 
@@ -29,6 +34,8 @@
 
 using std::string;
 
+using process::DispatchEvent;
+
 using process::metrics::PullGauge;
 
 namespace mesos {
@@ -37,25 +44,77 @@ namespace master {
 namespace allocator {
 namespace internal {
 
-Metrics::Metrics(const HierarchicalAllocatorProcess& _allocator)
-  : allocator(_allocator.self()),
-    event_queue_dispatches(
+// Returns a function which samples the given published value. The
+// function keeps the published values alive.
+static std::function<double()> sample(
+    const std::shared_ptr<Metrics::Published>& published,
+    std::atomic<double>* value)
+{
+  std::shared_ptr<std::atomic<double>> shared(published, value);
+
+  return [shared]() {
+    return shared->load(std::memory_order_relaxed);
+  };
+}
+
+
+// Returns a function which samples the number of dispatches queued for
+// the allocator.
+static std::function<double()> dispatches(
+    const HierarchicalAllocatorProcess& allocator)
+{
+  std::function<size_t()> counter = allocator.eventCounter<DispatchEvent>();
+
+  return [counter]() {
+    return static_cast<double>(counter());
+  };
+}
+
+
+Metrics::Published::Published()
+  : offer_filter_lookup_latency(0.0)
+{
+  for (std::atomic<double>& phase : allocation_run_phases) {
+    phase.store(0.0, std::memory_order_relaxed);
+  }
+}
+
+
+Metrics::Metrics(HierarchicalAllocatorProcess& _allocator)
+  : allocator(&_allocator),
+    published(new Published()),
+    publisher(_allocator),
+    event_queue_dispatches(PullGauge::sampled(
         "allocator/mesos/event_queue_dispatches",
-        process::defer(
-            allocator, &HierarchicalAllocatorProcess::_event_queue_dispatches)),
-    event_queue_dispatches_(
+        dispatches(_allocator))),
+    event_queue_dispatches_(PullGauge::sampled(
         "allocator/event_queue_dispatches",
-        process::defer(
-            allocator, &HierarchicalAllocatorProcess::_event_queue_dispatches)),
+        dispatches(_allocator))),
     allocation_runs("allocator/mesos/allocation_runs"),
-    allocation_run("allocator/mesos/allocation_run", Hours(1)),
-    allocation_run_latency("allocator/mesos/allocation_run_latency", Hours(1))
+    allocation_run(
+        "allocator/mesos/allocation_run",
+        Hours(1),
+        process::metrics::Percentiles::ESTIMATED),
+    allocation_run_latency(
+        "allocator/mesos/allocation_run_latency",
+        Hours(1),
+        process::metrics::Percentiles::ESTIMATED),
+    offer_filters_active_total(publisher.gauge(
+        "allocator/mesos/offer_filters/active",
+        [this]() { return allocator->_offer_filters_active_total(); })),
+    offer_filter_lookups("allocator/mesos/offer_filters/lookups"),
+    offer_filter_lookup_latency(PullGauge::sampled(
+        "allocator/mesos/offer_filters/lookup_latency_us",
+        sample(published, &published->offer_filter_lookup_latency)))
 {
   process::metrics::add(event_queue_dispatches);
   process::metrics::add(event_queue_dispatches_);
   process::metrics::add(allocation_runs);
   process::metrics::add(allocation_run);
   process::metrics::add(allocation_run_latency);
+  process::metrics::add(offer_filters_active_total);
+  process::metrics::add(offer_filter_lookups);
+  process::metrics::add(offer_filter_lookup_latency);
 
   // Create and install gauges for the total and allocated
   // amount of standard scalar resources.
@@ -67,23 +126,58 @@ Metrics::Metrics(const HierarchicalAllocatorProcess& _allocator)
   string resources[] = {"cpus", "mem", "disk"};
 
   foreach (const string& resource, resources) {
-    PullGauge total(
+    PullGauge total = publisher.gauge(
         "allocator/mesos/resources/" + resource + "/total",
-        defer(allocator,
-              &HierarchicalAllocatorProcess::_resources_total,
-              resource));
+        [this, resource]() {
+          return allocator->_resources_total(resource);
+        });
 
-    PullGauge offered_or_allocated(
+    PullGauge offered_or_allocated = publisher.gauge(
         "allocator/mesos/resources/" + resource + "/offered_or_allocated",
-        defer(allocator,
-              &HierarchicalAllocatorProcess::_resources_offered_or_allocated,
-              resource));
+        [this, resource]() {
+          return allocator->_resources_offered_or_allocated(resource);
+        });
+
+    PullGauge available_headroom = publisher.gauge(
+        "allocator/mesos/quota/headroom/" + resource + "/available",
+        [this, resource]() {
+          return allocator->_quota_available_headroom(resource);
+        });
+
+    // Exposed as families labeled by the resource in OpenMetrics.
+    total.setLabels(
+        "allocator/mesos/resources/total", {{"resource", resource}});
+
+    offered_or_allocated.setLabels(
+        "allocator/mesos/resources/offered_or_allocated",
+        {{"resource", resource}});
+
+    available_headroom.setLabels(
+        "allocator/mesos/quota/headroom/available", {{"resource", resource}});
 
     resources_total.push_back(total);
     resources_offered_or_allocated.push_back(offered_or_allocated);
+    quota_available_headroom.push_back(available_headroom);
 
     process::metrics::add(total);
     process::metrics::add(offered_or_allocated);
+    process::metrics::add(available_headroom);
+  }
+
+  // Create and install gauges for the time spent in each phase
+  // of the last allocation run.
+  for (int i = 0; i < AllocationProfiler::PHASE_COUNT; i++) {
+    const AllocationProfiler::Phase phase =
+      static_cast<AllocationProfiler::Phase>(i);
+
+    PullGauge gauge = PullGauge::sampled(
+        "allocator/mesos/allocation_run/" +
+          AllocationProfiler::name(phase) + "_ms",
+        sample(published, &published->allocation_run_phases[phase]));
+
+    allocation_run_phases.push_back(gauge);
+
+    process::metrics::add(gauge);
   }
 }
 
@@ -95,6 +189,9 @@ Metrics::~Metrics()
   process::metrics::remove(allocation_runs);
   process::metrics::remove(allocation_run);
   process::metrics::remove(allocation_run_latency);
+  process::metrics::remove(offer_filters_active_total);
+  process::metrics::remove(offer_filter_lookups);
+  process::metrics::remove(offer_filter_lookup_latency);
 
   foreach (const PullGauge& gauge, resources_total) {
     process::metrics::remove(gauge);
@@ -104,6 +201,14 @@ Metrics::~Metrics()
     process::metrics::remove(gauge);
   }
 
+  foreach (const PullGauge& gauge, quota_available_headroom) {
+    process::metrics::remove(gauge);
+  }
+
+  foreach (const PullGauge& gauge, allocation_run_phases) {
+    process::metrics::remove(gauge);
+  }
+
   foreachkey (const string& role, quota_allocated) {
     foreachvalue (const PullGauge& gauge, quota_allocated[role]) {
       process::metrics::remove(gauge);
@@ -133,22 +238,33 @@ void Metrics::setQuota(const string& role, const Quota& quota)
     CHECK_EQ(Value::SCALAR, resource.type());
     double value = resource.scalar().value();
 
-    PullGauge guarantee = PullGauge(
+    const string name = resource.name();
+
+    PullGauge guarantee = PullGauge::sampled(
         "allocator/mesos/quota"
         "/roles/" + role +
-        "/resources/" + resource.name() +
+        "/resources/" + name +
         "/guarantee",
-        process::defer([value]() { return value; }));
+        [value]() { return value; });
 
-    PullGauge offered_or_allocated(
+    PullGauge offered_or_allocated = publisher.gauge(
         "allocator/mesos/quota"
         "/roles/" + role +
-        "/resources/" + resource.name() +
+        "/resources/" + name +
         "/offered_or_allocated",
-        defer(allocator,
-              &HierarchicalAllocatorProcess::_quota_allocated,
-              role,
-              resource.name()));
+        [this, role, name]() {
+          return allocator->_quota_allocated(role, name);
+        });
+
+    // Exposed as families labeled by the role and the resource in
+    // OpenMetrics.
+    guarantee.setLabels(
+        "allocator/mesos/quota/roles/resources/guarantee",
+        {{"role", role}, {"resource", name}});
+
+    offered_or_allocated.setLabels(
+        "allocator/mesos/quota/roles/resources/offered_or_allocated",
+        {{"role", role}, {"resource", name}});
 
     guarantees.put(resource.name(), guarantee);
     allocated.put(resource.name(), offered_or_allocated);
@@ -168,6 +284,7 @@ void Metrics::removeQuota(const string& role)
   CHECK(quota_guarantee.contains(role));
 
   foreachvalue (const PullGauge& gauge, quota_allocated[role]) {
+    publisher.remove(gauge);
     process::metrics::remove(gauge);
   }
 
@@ -180,15 +297,30 @@ void Metrics::removeQuota(const string& role)
 }
 
 
+void Metrics::publish(
+    double offerFilterLookupLatency,
+    const AllocationProfiler::Run& run)
+{
+  published->offer_filter_lookup_latency.store(
+      offerFilterLookupLatency, std::memory_order_relaxed);
+
+  for (int phase = 0; phase < AllocationProfiler::PHASE_COUNT; phase++) {
+    published->allocation_run_phases[phase].store(
+        run.phases[phase].ms(), std::memory_order_relaxed);
+  }
+}
+
+
 void Metrics::addRole(const string& role)
 {
   CHECK(!offer_filters_active.contains(role));
 
-  PullGauge gauge(
+  PullGauge gauge = publisher.gauge(
       "allocator/mesos/offer_filters/roles/" + role + "/active",
-      defer(allocator,
-            &HierarchicalAllocatorProcess::_offer_filters_active,
-            role));
+      [this, role]() { return allocator->_offer_filters_active(role); });
+
+  gauge.setLabels(
+      "allocator/mesos/offer_filters/roles/active", {{"role", role}});
 
   offer_filters_active.put(role, gauge);
 
@@ -204,6 +336,7 @@ void Metrics::removeRole(const string& role)
 
   offer_filters_active.erase(role);
 
+  publisher.remove(gauge.get());
   process::metrics::remove(gauge.get());
 }
 
@@ -17,19 +17,23 @@
 #ifndef __MASTER_ALLOCATOR_MESOS_METRICS_HPP__
 #define __MASTER_ALLOCATOR_MESOS_METRICS_HPP__
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <mesos/quota/quota.hpp>
 
 #include <process/metrics/counter.hpp>
+#include <process/metrics/publisher.hpp>
 #include <process/metrics/pull_gauge.hpp>
 #include <process/metrics/timer.hpp>
 
-#include <process/pid.hpp>
-
 #include <stout/hashmap.hpp>
 
+#include "master/allocator/mesos/profiler.hpp"
+
 namespace mesos {
 namespace internal {
 namespace master {
@@ -43,7 +47,7 @@ class HierarchicalAllocatorProcess;
 // with the following prefix: `allocator/mesos/`.
 struct Metrics
 {
-  explicit Metrics(const HierarchicalAllocatorProcess& allocator);
+  explicit Metrics(HierarchicalAllocatorProcess& allocator);
 
   ~Metrics();
 
@@ -53,7 +57,31 @@ struct Metrics
   void addRole(const std::string& role);
   void removeRole(const std::string& role);
 
-  const process::PID<HierarchicalAllocatorProcess> allocator;
+  // Publishes the values of the gauges measuring the last allocation
+  // run. Called at the end of each allocation run.
+  void publish(
+      double offerFilterLookupLatency,
+      const AllocationProfiler::Run& run);
+
+  HierarchicalAllocatorProcess* const allocator;
+
+  // The values published for the sampled gauges. These are shared
+  // with the gauges since the metrics process may sample them until
+  // their removal completes.
+  struct Published
+  {
+    Published();
+
+    std::atomic<double> offer_filter_lookup_latency;
+    std::array<std::atomic<double>, AllocationProfiler::PHASE_COUNT>
+      allocation_run_phases;
+  };
+
+  const std::shared_ptr<Published> published;
+
+  // Publishes the values of the gauges computed from the allocator's
+  // state, once per burst of events served by the allocator.
+  process::metrics::Publisher publisher;
 
   // Number of dispatch events currently waiting in the allocator process.
   process::metrics::PullGauge event_queue_dispatches;
@@ -78,6 +106,9 @@ struct Metrics
   // PullGauges for the allocated amount of each resource in the cluster.
   std::vector<process::metrics::PullGauge> resources_offered_or_allocated;
 
+  // PullGauges for the available quota headroom of each resource.
+  std::vector<process::metrics::PullGauge> quota_available_headroom;
+
   // PullGauges for the per-role quota allocation for each resource.
   hashmap<std::string, hashmap<std::string, process::metrics::PullGauge>>
     quota_allocated;
@@ -88,6 +119,18 @@ struct Metrics
 
   // PullGauges for the per-role count of active offer filters.
   hashmap<std::string, process::metrics::PullGauge> offer_filters_active;
+
+  // Total number of active offer filters.
+  process::metrics::PullGauge offer_filters_active_total;
+
+  // Number of offer filter lookups performed by the allocation algorithm.
+  process::metrics::Counter offer_filter_lookups;
+
+  // Average latency of an offer filter lookup in the last allocation run.
+  process::metrics::PullGauge offer_filter_lookup_latency;
+
+  // PullGauges for the time spent in each phase of the last allocation run.
+  std::vector<process::metrics::PullGauge> allocation_run_phases;
 };
 
 } // namespace internal {
@@ -0,0 +1,347 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "master/allocator/mesos/offer_filter.hpp"
+
+#include <iterator>
+
+#include <glog/logging.h>
+
+#include <stout/foreach.hpp>
+#include <stout/stopwatch.hpp>
+
+using std::pair;
+using std::string;
+using std::vector;
+
+using process::Time;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace internal {
+
+template <typename Predicate>
+void OfferFilterIndex::erase(
+    RoleFilters* roleFilters,
+    RoleFilters::iterator agentFilters,
+    Predicate predicate)
+{
+  const string& role = agentFilters->first;
+
+  size_t erased = 0;
+
+  // NOTE: We do not use `std::remove_if` here, since the removed
+  // filters' expiries need to be erased as well.
+  for (auto filter = agentFilters->second.begin();
+       filter != agentFilters->second.end();) {
+    if (predicate(*filter)) {
+      expiries.erase(filter->expiry);
+      filter = agentFilters->second.erase(filter);
+      erased++;
+    } else {
+      ++filter;
+    }
+  }
+
+  decrement(role, erased);
+
+  if (agentFilters->second.empty()) {
+    roleFilters->erase(agentFilters);
+  }
+}
+
+
+void OfferFilterIndex::erase(Filters::iterator keyFilters)
+{
+  for (auto roleFilters = keyFilters->second.begin();
+       roleFilters != keyFilters->second.end();) {
+    // Advance first, since erasing the last filter of the role
+    // also erases the role.
+    auto next = std::next(roleFilters);
+
+    erase(&keyFilters->second, roleFilters, [](const Filter&) {
+      return true;
+    });
+
+    roleFilters = next;
+  }
+
+  unlink(keyFilters->first);
+
+  filters.erase(keyFilters);
+}
+
+
+void OfferFilterIndex::unlink(const Key& key)
+{
+  const SlaveID& slaveId = key.first;
+  const FrameworkID& frameworkId = key.second;
+
+  auto frameworks = agentFrameworks.find(slaveId);
+  CHECK(frameworks != agentFrameworks.end());
+
+  frameworks->second.erase(frameworkId);
+  if (frameworks->second.empty()) {
+    agentFrameworks.erase(frameworks);
+  }
+
+  auto agents = frameworkAgents.find(frameworkId);
+  CHECK(agents != frameworkAgents.end());
+
+  agents->second.erase(slaveId);
+  if (agents->second.empty()) {
+    frameworkAgents.erase(agents);
+  }
+}
+
+
+void OfferFilterIndex::add(
+    const FrameworkID& frameworkId,
+    const string& role,
+    const SlaveID& slaveId,
+    const Resources& resources,
+    const Time& expiry)
+{
+  const Key key(slaveId, frameworkId);
+
+  RoleFilters& roleFilters = filters[key];
+
+  agentFrameworks[slaveId].insert(frameworkId);
+  frameworkAgents[frameworkId].insert(slaveId);
+
+  // Drop the filters that are dominated by the new one.
+  auto agentFilters = roleFilters.find(role);
+  if (agentFilters != roleFilters.end()) {
+    erase(&roleFilters, agentFilters, [&](const Filter& filter) {
+      return filter.expiry->first <= expiry &&
+             resources.contains(filter.resources);
+    });
+  }
+
+  roleFilters[role].push_back(
+      Filter{resources, expiries.emplace(expiry, Expiry{key, role})});
+
+  count++;
+  roleCounts[role]++;
+}
+
+
+bool OfferFilterIndex::filtered(
+    const FrameworkID& frameworkId,
+    const string& role,
+    const SlaveID& slaveId,
+    const Resources& resources) const
+{
+  const bool sampled =
+    lookupCount.fetch_add(1, std::memory_order_relaxed) % LOOKUP_SAMPLING == 0;
+
+  Stopwatch stopwatch;
+  if (sampled) {
+    stopwatch.start();
+  }
+
+  auto lookup = [&]() {
+    // Since this is a performance-sensitive piece of code,
+    // we use find to avoid the doing any redundant lookups.
+    auto roleFilters = filters.find(Key(slaveId, frameworkId));
+    if (roleFilters == filters.end()) {
+      return false;
+    }
+
+    auto agentFilters = roleFilters->second.find(role);
+    if (agentFilters == roleFilters->second.end()) {
+      return false;
+    }
+
+    // TODO(jieyu): Consider separating the superset check for regular
+    // and revocable resources. For example, frameworks might want
+    // more revocable resources only or non-revocable resources only,
+    // but currently the filter only expires if there is more of both
+    // revocable and non-revocable resources.
+    foreach (const Filter& filter, agentFilters->second) {
+      if (filter.resources.contains(resources)) {
+        return true; // Refused resources are superset.
+      }
+    }
+
+    return false;
+  };
+
+  const bool result = lookup();
+
+  if (result) {
+    hitCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (sampled) {
+    lookupNanoseconds.fetch_add(
+        static_cast<uint64_t>(stopwatch.elapsed().ns()) * LOOKUP_SAMPLING,
+        std::memory_order_relaxed);
+  }
+
+  return result;
+}
+
+
+void OfferFilterIndex::remove(const FrameworkID& frameworkId)
+{
+  auto agents = frameworkAgents.find(frameworkId);
+  if (agents == frameworkAgents.end()) {
+    return;
+  }
+
+  // Copy the agents, since erasing their filters updates the index.
+  const hashset<SlaveID> slaveIds = agents->second;
+
+  foreach (const SlaveID& slaveId, slaveIds) {
+    auto roleFilters = filters.find(Key(slaveId, frameworkId));
+    CHECK(roleFilters != filters.end());
+
+    erase(roleFilters);
+  }
+}
+
+
+void OfferFilterIndex::remove(
+    const FrameworkID& frameworkId,
+    const string& role)
+{
+  auto agents = frameworkAgents.find(frameworkId);
+  if (agents == frameworkAgents.end()) {
+    return;
+  }
+
+  // Copy the agents, since erasing their filters updates the index.
+  const hashset<SlaveID> slaveIds = agents->second;
+
+  foreach (const SlaveID& slaveId, slaveIds) {
+    auto roleFilters = filters.find(Key(slaveId, frameworkId));
+    CHECK(roleFilters != filters.end());
+
+    auto agentFilters = roleFilters->second.find(role);
+    if (agentFilters == roleFilters->second.end()) {
+      continue;
+    }
+
+    erase(&roleFilters->second, agentFilters, [](const Filter&) {
+      return true;
+    });
+
+    if (roleFilters->second.empty()) {
+      unlink(roleFilters->first);
+      filters.erase(roleFilters);
+    }
+  }
+}
+
+
+vector<pair<FrameworkID, string>> OfferFilterIndex::remove(
+    const SlaveID& slaveId)
+{
+  vector<pair<FrameworkID, string>> removed;
+
+  auto frameworks = agentFrameworks.find(slaveId);
+  if (frameworks == agentFrameworks.end()) {
+    return removed;
+  }
+
+  // Copy the frameworks, since erasing their filters updates the index.
+  const hashset<FrameworkID> frameworkIds = frameworks->second;
+
+  foreach (const FrameworkID& frameworkId, frameworkIds) {
+    auto roleFilters = filters.find(Key(slaveId, frameworkId));
+    CHECK(roleFilters != filters.end());
+
+    foreachkey (const string& role, roleFilters->second) {
+      removed.emplace_back(frameworkId, role);
+    }
+
+    erase(roleFilters);
+  }
+
+  return removed;
+}
+
+
+void OfferFilterIndex::expire(const Time& now)
+{
+  // Every entry belongs to a filter, so each iteration removes
+  // (at least) the filter of the earliest entry.
+  while (!expiries.empty() && expiries.begin()->first <= now) {
+    const Expiry expiry = expiries.begin()->second;
+
+    auto roleFilters = filters.find(expiry.key);
+    CHECK(roleFilters != filters.end());
+
+    auto agentFilters = roleFilters->second.find(expiry.role);
+    CHECK(agentFilters != roleFilters->second.end());
+
+    erase(&roleFilters->second, agentFilters, [&](const Filter& filter) {
+      return filter.expiry->first <= now;
+    });
+
+    if (roleFilters->second.empty()) {
+      unlink(roleFilters->first);
+      filters.erase(roleFilters);
+    }
+  }
+}
+
+
+Option<Time> OfferFilterIndex::nextExpiry() const
+{
+  if (expiries.empty()) {
+    return None();
+  }
+
+  return expiries.begin()->first;
+}
+
+
+size_t OfferFilterIndex::size(const string& role) const
+{
+  auto roleCount = roleCounts.find(role);
+  return roleCount == roleCounts.end() ? 0 : roleCount->second;
+}
+
+
+void OfferFilterIndex::decrement(const string& role, size_t n)
+{
+  if (n == 0) {
+    return;
+  }
+
+  CHECK_GE(count, n);
+  count -= n;
+
+  auto roleCount = roleCounts.find(role);
+  CHECK(roleCount != roleCounts.end());
+  CHECK_GE(roleCount->second, n);
+
+  roleCount->second -= n;
+
+  if (roleCount->second == 0) {
+    roleCounts.erase(roleCount);
+  }
+}
+
+} // namespace internal {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
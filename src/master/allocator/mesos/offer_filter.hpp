@@ -0,0 +1,212 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MASTER_ALLOCATOR_MESOS_OFFER_FILTER_HPP__
+#define __MASTER_ALLOCATOR_MESOS_OFFER_FILTER_HPP__
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include <mesos/mesos.hpp>
+#include <mesos/resources.hpp>
+#include <mesos/type_utils.hpp>
+
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/option.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace internal {
+
+// Index of the "refused resources" offer filters installed by
+// frameworks when declining offers. It answers whether a set of
+// resources on an agent is filtered for a role of a framework, and
+// keeps track of when each filter expires.
+//
+// Filters are indexed by (agent, framework) and then by role, and the
+// filters for the same (agent, framework, role) are kept in a small
+// vector. A new filter replaces any existing filter it dominates,
+// i.e., one whose refused resources are a subset of the new refused
+// resources and which expires no later than the new filter. This does
+// not change which resources are filtered at any point in time, but
+// it keeps the number of filters per agent small for frameworks that
+// repeatedly decline the same agent, which would otherwise accumulate
+// one filter per declined offer.
+//
+// Expiration is driven by the caller: `nextExpiry()` returns the
+// earliest time at which a filter expires and `expire()` removes all
+// filters that expired by the given time. This allows the allocator
+// to keep a single outstanding timer rather than one per filter. Each
+// filter owns its entry in the expiration order, which is removed
+// along with the filter.
+//
+// NOTE: `filtered()` may be called concurrently from multiple threads
+// as long as no mutating method is called at the same time.
+class OfferFilterIndex
+{
+public:
+  OfferFilterIndex()
+    : count(0), lookupCount(0), hitCount(0), lookupNanoseconds(0) {}
+
+  // Installs a filter refusing (subsets of) `resources` on the agent
+  // for the role of the framework until `expiry`.
+  void add(
+      const FrameworkID& frameworkId,
+      const std::string& role,
+      const SlaveID& slaveId,
+      const Resources& resources,
+      const process::Time& expiry);
+
+  // Returns true if `resources` are contained in any of the filters
+  // installed for the role of the framework on the agent.
+  bool filtered(
+      const FrameworkID& frameworkId,
+      const std::string& role,
+      const SlaveID& slaveId,
+      const Resources& resources) const;
+
+  // Removes all filters of the framework.
+  void remove(const FrameworkID& frameworkId);
+
+  // Removes all filters of the framework for the role.
+  void remove(const FrameworkID& frameworkId, const std::string& role);
+
+  // Removes all filters on the agent. Returns the (framework, role)
+  // pairs for which at least one filter was removed.
+  std::vector<std::pair<FrameworkID, std::string>> remove(
+      const SlaveID& slaveId);
+
+  // Removes all filters which expire at or before `now`.
+  void expire(const process::Time& now);
+
+  // Returns the earliest time at which a filter expires, if any.
+  Option<process::Time> nextExpiry() const;
+
+  // Returns the number of active filters.
+  size_t size() const { return count; }
+
+  // Returns the number of active filters for the role.
+  size_t size(const std::string& role) const;
+
+  // Returns the total number of calls to `filtered()`.
+  uint64_t lookups() const { return lookupCount.load(); }
+
+  // Returns the total number of calls to `filtered()` which
+  // returned true.
+  uint64_t hits() const { return hitCount.load(); }
+
+  // Returns an estimate of the total time spent in `filtered()`,
+  // extrapolated from the sampled calls (see `LOOKUP_SAMPLING`).
+  Duration lookupTime() const
+  {
+    return Nanoseconds(static_cast<int64_t>(lookupNanoseconds.load()));
+  }
+
+private:
+  // Only one in this many calls to `filtered()` gets timed, since
+  // reading the clock for every call would slow down the allocation.
+  static constexpr uint64_t LOOKUP_SAMPLING = 64;
+
+  // An (agent, framework) pair.
+  typedef std::pair<SlaveID, FrameworkID> Key;
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const
+    {
+      size_t seed = 0;
+      boost::hash_combine(seed, std::hash<SlaveID>()(key.first));
+      boost::hash_combine(seed, std::hash<FrameworkID>()(key.second));
+      return seed;
+    }
+  };
+
+  struct Expiry
+  {
+    Key key;
+    std::string role;
+  };
+
+  // Filters ordered by their expiry.
+  typedef std::multimap<process::Time, Expiry> Expiries;
+
+  struct Filter
+  {
+    Resources resources;
+    Expiries::iterator expiry;
+  };
+
+  typedef hashmap<std::string, std::vector<Filter>> RoleFilters;
+
+  typedef hashmap<Key, RoleFilters, KeyHash> Filters;
+
+  // Removes the filters of the role `agentFilters` in `roleFilters`
+  // that satisfy `predicate`, along with their expiries, and updates
+  // the counters for the role accordingly. Removes the role from
+  // `roleFilters` if it has no filters left.
+  template <typename Predicate>
+  void erase(
+      RoleFilters* roleFilters,
+      RoleFilters::iterator agentFilters,
+      Predicate predicate);
+
+  // Removes all filters for the (agent, framework) pair, along with
+  // their expiries, and the pair from the agent and framework indices.
+  void erase(Filters::iterator filters);
+
+  // Removes the (agent, framework) pair from the agent and framework
+  // indices.
+  void unlink(const Key& key);
+
+  void decrement(const std::string& role, size_t n);
+
+  Filters filters;
+
+  // The frameworks with filters on each agent, and vice versa.
+  hashmap<SlaveID, hashset<FrameworkID>> agentFrameworks;
+  hashmap<FrameworkID, hashset<SlaveID>> frameworkAgents;
+
+  Expiries expiries;
+
+  // Number of active filters, overall and per role.
+  size_t count;
+  hashmap<std::string, size_t> roleCounts;
+
+  // Lookup statistics; these are updated from `filtered()`, which may
+  // be called concurrently by the allocation shards.
+  mutable std::atomic<uint64_t> lookupCount;
+  mutable std::atomic<uint64_t> hitCount;
+  mutable std::atomic<uint64_t> lookupNanoseconds;
+};
+
+} // namespace internal {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_OFFER_FILTER_HPP__
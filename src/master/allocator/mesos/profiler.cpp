@@ -0,0 +1,154 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "master/allocator/mesos/profiler.hpp"
+
+#include <glog/logging.h>
+
+#include <process/clock.hpp>
+
+#include <stout/check.hpp>
+#include <stout/unreachable.hpp>
+
+using std::string;
+
+using process::Clock;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace internal {
+
+string AllocationProfiler::name(Phase phase)
+{
+  switch (phase) {
+    case SELECT_AGENTS:    return "select_agents";
+    case QUOTA_HEADROOM:   return "quota_headroom";
+    case QUOTA_ALLOCATION: return "quota_allocation";
+    case ALLOCATION:       return "allocation";
+    case OFFER_CALLBACKS:  return "offer_callbacks";
+    case DEALLOCATION:     return "deallocation";
+    case SORT:             return "sort";
+    case SHRINK:           return "shrink";
+    case FILTER:           return "filter";
+    case PHASE_COUNT:      break;
+  }
+
+  UNREACHABLE();
+}
+
+
+void AllocationProfiler::start()
+{
+  CHECK_NONE(running);
+
+  running = Run();
+  running->start = Clock::now();
+
+  runStopwatch.start();
+  phaseStopwatch.start();
+}
+
+
+void AllocationProfiler::stop()
+{
+  CHECK_SOME(running);
+
+  running->duration = runStopwatch.elapsed();
+
+  runs.push_back(running.get());
+  running = None();
+}
+
+
+void AllocationProfiler::finish(Phase phase)
+{
+  CHECK_LT(phase, SORT) << "Not a top-level phase: " << name(phase);
+
+  if (running.isSome()) {
+    running->phases[phase] += phaseStopwatch.elapsed();
+  }
+
+  phaseStopwatch.start();
+}
+
+
+void AllocationProfiler::record(Phase phase, const Duration& duration)
+{
+  CHECK_LT(phase, PHASE_COUNT);
+
+  if (running.isSome()) {
+    running->phases[phase] += duration;
+  }
+}
+
+
+AllocationProfiler::Run& AllocationProfiler::current()
+{
+  CHECK_SOME(running);
+  return running.get();
+}
+
+
+Option<AllocationProfiler::Run> AllocationProfiler::last() const
+{
+  if (runs.empty()) {
+    return None();
+  }
+
+  return runs.back();
+}
+
+
+JSON::Object AllocationProfiler::json(size_t limit) const
+{
+  JSON::Array array;
+
+  for (auto run = runs.rbegin();
+       run != runs.rend() && array.values.size() < limit;
+       ++run) {
+    JSON::Object phases;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+      phases.values[name(static_cast<Phase>(phase)) + "_ms"] =
+        run->phases[phase].ms();
+    }
+
+    JSON::Object object;
+    object.values["start"] = run->start.secs();
+    object.values["duration_ms"] = run->duration.ms();
+    object.values["phases"] = phases;
+    object.values["agents"] = run->agents;
+    object.values["roles"] = run->roles;
+    object.values["frameworks"] = run->frameworks;
+    object.values["filtered"] = run->filtered;
+    object.values["offers"] = run->offers;
+    object.values["inverse_offers"] = run->inverseOffers;
+
+    array.values.push_back(object);
+  }
+
+  JSON::Object result;
+  result.values["allocation_runs"] = array;
+
+  return result;
+}
+
+} // namespace internal {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
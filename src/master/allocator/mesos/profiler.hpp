@@ -0,0 +1,145 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MASTER_ALLOCATOR_MESOS_PROFILER_HPP__
+#define __MASTER_ALLOCATOR_MESOS_PROFILER_HPP__
+
+#include <array>
+#include <string>
+
+#include <boost/circular_buffer.hpp>
+
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/json.hpp>
+#include <stout/option.hpp>
+#include <stout/stopwatch.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace internal {
+
+// Records where the time of each allocation run goes, broken down
+// into phases, and keeps the profiles of the most recent runs.
+//
+// A run is profiled between `start()` and `stop()`. The top-level
+// phases are recorded in the order in which they run by calling
+// `finish()` at the end of each of them. The nested phases (e.g.,
+// sorting) happen within the top-level phases and are recorded by
+// adding up the time of each occurrence via `record()`.
+class AllocationProfiler
+{
+public:
+  enum Phase
+  {
+    // Top-level phases.
+    SELECT_AGENTS,
+    QUOTA_HEADROOM,
+    QUOTA_ALLOCATION,
+    ALLOCATION,
+    OFFER_CALLBACKS,
+    DEALLOCATION,
+
+    // Nested phases.
+    SORT,
+    SHRINK,
+    FILTER,
+
+    // Must be last.
+    PHASE_COUNT
+  };
+
+  // Returns the name of the phase as used in metrics and endpoints.
+  static std::string name(Phase phase);
+
+  struct Run
+  {
+    Run() : agents(0), roles(0), frameworks(0), filtered(0), offers(0),
+            inverseOffers(0)
+    {
+      phases.fill(Duration::zero());
+    }
+
+    process::Time start;
+    Duration duration;
+
+    std::array<Duration, PHASE_COUNT> phases;
+
+    // Number of agents considered for allocation.
+    size_t agents;
+
+    // Number of roles visited, summed over all agents.
+    size_t roles;
+
+    // Number of frameworks visited, summed over all agents and roles.
+    size_t frameworks;
+
+    // Number of times resources were withheld due to an offer filter.
+    size_t filtered;
+
+    // Number of offer and inverse offer callbacks. Unless offers are
+    // pipelined (in which case a framework may be sent multiple batches
+    // of offers in a run), this is the number of frameworks which were
+    // sent offers and inverse offers.
+    size_t offers;
+    size_t inverseOffers;
+  };
+
+  explicit AllocationProfiler(size_t capacity) : runs(capacity) {}
+
+  // Starts profiling a new allocation run.
+  void start();
+
+  // Finishes profiling the current allocation run.
+  void stop();
+
+  // Records the time since the end of the previous top-level phase
+  // (or since `start()`) as spent in the given top-level phase.
+  void finish(Phase phase);
+
+  // Adds time spent in the given nested phase.
+  void record(Phase phase, const Duration& duration);
+
+  // Returns the profile of the current allocation run.
+  Run& current();
+
+  // Returns the profile of the most recent completed allocation run.
+  Option<Run> last() const;
+
+  // Returns the JSON representation of the most recent `limit`
+  // completed allocation runs, most recent first.
+  JSON::Object json(size_t limit) const;
+
+private:
+  Option<Run> running;
+
+  // Measure the current allocation run and its current top-level phase.
+  Stopwatch runStopwatch;
+  Stopwatch phaseStopwatch;
+
+  boost::circular_buffer<Run> runs;
+};
+
+} // namespace internal {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_PROFILER_HPP__
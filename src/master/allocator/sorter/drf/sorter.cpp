@@ -273,18 +273,19 @@ void DRFSorter::activate(const string& clientPath)
     client->kind = Node::ACTIVE_LEAF;
 
     // `client` has been activated, so move it to the beginning of its
-    // parent's list of children. We mark the tree dirty, so that the
-    // client's share is updated correctly and it is sorted properly.
-    //
-    // TODO(neilc): We could instead calculate share here and insert
-    // the client into the appropriate place here, which would avoid
-    // dirtying the whole tree.
+    // parent's list of children. The share of an inactive leaf is not
+    // kept up to date, so we recalculate it here and move the client
+    // into its sorted position. Activation does not change any
+    // allocation, so no other node is affected.
     CHECK_NOTNULL(client->parent);
 
     client->parent->removeChild(client);
     client->parent->addChild(client);
 
-    dirty = true;
+    if (!dirty) {
+      client->share = calculateShare(client);
+      client->parent->repositionChild(client);
+    }
   }
 }
 
@@ -320,7 +321,8 @@ void DRFSorter::allocated(
     const SlaveID& slaveId,
     const Resources& resources)
 {
-  Node* current = CHECK_NOTNULL(find(clientPath));
+  Node* client = CHECK_NOTNULL(find(clientPath));
+  Node* current = client;
 
   // NOTE: We don't currently update the `allocation` for the root
   // node. This is debatable, but the current implementation doesn't
@@ -330,8 +332,9 @@ void DRFSorter::allocated(
     current = CHECK_NOTNULL(current->parent);
   }
 
-  // TODO(neilc): Avoid dirtying the tree in some circumstances.
-  dirty = true;
+  // Only the shares along the path from `client` to the root have
+  // changed, so there is no need to resort the whole tree.
+  updateShares(client);
 }
 
 
@@ -342,10 +345,11 @@ void DRFSorter::update(
     const Resources& newAllocation)
 {
   // TODO(bmahler): Check if the quantities of resources between the old and new
-  // allocations are the same. If not, we need to re-calculate the shares, as is
-  // being currently done, for safety.
+  // allocations are the same. If not, we need to re-calculate the shares along
+  // the path to the client, as is being currently done, for safety.
 
-  Node* current = CHECK_NOTNULL(find(clientPath));
+  Node* client = CHECK_NOTNULL(find(clientPath));
+  Node* current = client;
 
   // NOTE: We don't currently update the `allocation` for the root
   // node. This is debatable, but the current implementation doesn't
@@ -355,8 +359,8 @@ void DRFSorter::update(
     current = CHECK_NOTNULL(current->parent);
   }
 
-  // Just assume the total has changed, per the TODO above.
-  dirty = true;
+  // Just assume the allocated quantities have changed, per the TODO above.
+  updateShares(client);
 }
 
 
@@ -365,7 +369,8 @@ void DRFSorter::unallocated(
     const SlaveID& slaveId,
     const Resources& resources)
 {
-  Node* current = CHECK_NOTNULL(find(clientPath));
+  Node* client = CHECK_NOTNULL(find(clientPath));
+  Node* current = client;
 
   // NOTE: We don't currently update the `allocation` for the root
   // node. This is debatable, but the current implementation doesn't
@@ -375,8 +380,7 @@ void DRFSorter::unallocated(
     current = CHECK_NOTNULL(current->parent);
   }
 
-  // TODO(neilc): Avoid dirtying the tree in some circumstances.
-  dirty = true;
+  updateShares(client);
 }
 
 
@@ -388,7 +392,7 @@ const hashmap<SlaveID, Resources>& DRFSorter::allocation(
 }
 
 
-const Resources& DRFSorter::allocationScalarQuantities(
+const ResourceQuantities& DRFSorter::allocationScalarQuantities(
     const string& clientPath) const
 {
   const Node* client = CHECK_NOTNULL(find(clientPath));
@@ -436,7 +440,7 @@ Resources DRFSorter::allocation(
 }
 
 
-const Resources& DRFSorter::totalScalarQuantities() const
+const ResourceQuantities& DRFSorter::totalScalarQuantities() const
 {
   return total_.scalarQuantities;
 }
@@ -454,14 +458,8 @@ void DRFSorter::add(const SlaveID& slaveId, const Resources& resources)
 
     total_.resources[slaveId] += resources;
 
-    const Resources scalarQuantities =
-      (resources.nonShared() + newShared).createStrippedScalarQuantity();
-
-    total_.scalarQuantities += scalarQuantities;
-
-    foreach (const Resource& resource, scalarQuantities) {
-      total_.totals[resource.name()] += resource.scalar();
-    }
+    total_.scalarQuantities += ResourceQuantities::fromScalarResources(
+        resources.nonShared() + newShared);
 
     // We have to recalculate all shares when the total resources
     // change, but we put it off until `sort` is called so that if
@@ -488,12 +486,9 @@ void DRFSorter::remove(const SlaveID& slaveId, const Resources& resources)
         return !total_.resources[slaveId].contains(resource);
       });
 
-    const Resources scalarQuantities =
-      (resources.nonShared() + absentShared).createStrippedScalarQuantity();
-
-    foreach (const Resource& resource, scalarQuantities) {
-      total_.totals[resource.name()] -= resource.scalar();
-    }
+    const ResourceQuantities scalarQuantities =
+      ResourceQuantities::fromScalarResources(
+          resources.nonShared() + absentShared);
 
     CHECK(total_.scalarQuantities.contains(scalarQuantities));
     total_.scalarQuantities -= scalarQuantities;
@@ -597,19 +592,19 @@ double DRFSorter::calculateShare(const Node* node) const
   // currently does not take into account resources that are not
   // scalars.
 
-  foreachpair (const string& resourceName,
-               const Value::Scalar& scalar,
-               total_.totals) {
+  foreach (const auto& total, total_.scalarQuantities) {
+    const string& resourceName = total.first;
+    const Value::Scalar& scalar = total.second;
+
     // Filter out the resources excluded from fair sharing.
     if (fairnessExcludeResourceNames.isSome() &&
         fairnessExcludeResourceNames->count(resourceName) > 0) {
       continue;
     }
 
-    if (scalar.value() > 0.0 &&
-        node->allocation.totals.contains(resourceName)) {
+    if (scalar.value() > 0.0) {
       const double allocation =
-        node->allocation.totals.at(resourceName).value();
+        node->allocation.scalarQuantities.get(resourceName).value();
 
       share = std::max(share, allocation / scalar.value());
     }
@@ -619,6 +614,29 @@ double DRFSorter::calculateShare(const Node* node) const
 }
 
 
+void DRFSorter::updateShares(Node* node)
+{
+  // If the tree is dirty, all shares are recalculated and all nodes
+  // are resorted during the next `sort()`.
+  if (dirty) {
+    return;
+  }
+
+  while (node != root) {
+    Node* parent = CHECK_NOTNULL(node->parent);
+
+    // Inactive leaves are not sorted, so their shares are only
+    // calculated once they are activated.
+    if (node->kind != Node::INACTIVE_LEAF) {
+      node->share = calculateShare(node);
+      parent->repositionChild(node);
+    }
+
+    node = parent;
+  }
+}
+
+
 double DRFSorter::findWeight(const Node* node) const
 {
   Option<double> weight = weights.get(node->path);
@@ -18,6 +18,7 @@
 #define __MASTER_ALLOCATOR_SORTER_DRF_SORTER_HPP__
 
 #include <algorithm>
+#include <iterator>
 #include <set>
 #include <string>
 #include <vector>
@@ -30,6 +31,8 @@
 #include <stout/hashmap.hpp>
 #include <stout/option.hpp>
 
+#include "common/resource_quantities.hpp"
+
 #include "master/allocator/sorter/drf/metrics.hpp"
 
 #include "master/allocator/sorter/sorter.hpp"
@@ -83,7 +86,7 @@ public:
   virtual const hashmap<SlaveID, Resources>& allocation(
       const std::string& clientPath) const;
 
-  virtual const Resources& allocationScalarQuantities(
+  virtual const ResourceQuantities& allocationScalarQuantities(
       const std::string& clientPath) const;
 
   virtual hashmap<std::string, Resources> allocation(
@@ -93,7 +96,7 @@ public:
       const std::string& clientPath,
       const SlaveID& slaveId) const;
 
-  virtual const Resources& totalScalarQuantities() const;
+  virtual const ResourceQuantities& totalScalarQuantities() const;
 
   virtual void add(const SlaveID& slaveId, const Resources& resources);
 
@@ -112,6 +115,14 @@ private:
   // Returns the dominant resource share for the node.
   double calculateShare(const Node* node) const;
 
+  // Recalculates the shares of `node` and all of its ancestors and
+  // moves each of them into its sorted position among its siblings.
+  // This is used after an allocation change to a single client, which
+  // only affects the shares along the path from that client to the
+  // root. It is a no-op when the tree is dirty, since `sort()` will
+  // recalculate all shares anyway.
+  void updateShares(Node* node);
+
   // Returns the weight associated with the node. If no weight has
   // been configured for the node's path, the default weight (1.0) is
   // returned.
@@ -126,6 +137,9 @@ private:
   Option<std::set<std::string>> fairnessExcludeResourceNames;
 
   // If true, sort() will recalculate all shares and resort the tree.
+  // Changes that only affect a single client's allocation do not dirty
+  // the tree; instead the affected path is resorted incrementally (see
+  // `updateShares()`).
   bool dirty = false;
 
   // The root node in the sorter tree.
@@ -166,16 +180,10 @@ private:
     // Sharedness info is also stripped out when resource identities
     // are omitted because sharedness inherently refers to the
     // identities of resources and not quantities.
-    Resources scalarQuantities;
-
-    // We also store a map version of `scalarQuantities`, mapping
-    // the `Resource::name` to aggregated scalar. This improves the
-    // performance of calculating shares. See MESOS-4694.
     //
-    // TODO(bmahler): Ideally we do not store `scalarQuantities`
-    // redundantly here, investigate performance improvements to
-    // `Resources` to make this unnecessary.
-    hashmap<std::string, Value::Scalar> totals;
+    // NOTE: `ResourceQuantities` is a flat vector sorted by resource
+    // name, which makes calculating shares cheap. See MESOS-4694.
+    ResourceQuantities scalarQuantities;
   } total_;
 
   // Metrics are optionally exposed by the sorter.
@@ -308,7 +316,8 @@ struct DRFSorter::Node
     // If we're inserting an inactive leaf, place it at the end of the
     // `children` vector; otherwise, place it at the beginning. This
     // maintains ordering invariant (1) above. It is up to the caller
-    // to maintain invariant (2) -- e.g., by marking the tree dirty.
+    // to maintain invariant (2) -- e.g., by marking the tree dirty or
+    // by calling `repositionChild()`.
     if (child->kind == INACTIVE_LEAF) {
       children.push_back(child);
     } else {
@@ -316,6 +325,34 @@ struct DRFSorter::Node
     }
   }
 
+  // Moves `child` into its sorted position among the active leaves
+  // and internal nodes, restoring ordering invariant (2) above after
+  // the share or allocation count of `child` has changed. This
+  // assumes that all other active children are still sorted.
+  void repositionChild(Node* child)
+  {
+    CHECK_NE(INACTIVE_LEAF, child->kind);
+
+    auto active = std::partition_point(
+        children.begin(),
+        children.end(),
+        [](const Node* node) { return node->kind != INACTIVE_LEAF; });
+
+    auto it = std::find(children.begin(), active, child);
+    CHECK(it != active);
+
+    // Either the child has to move towards the front of the vector...
+    auto position = std::upper_bound(children.begin(), it, child, compareDRF);
+    if (position != it) {
+      std::rotate(position, it, std::next(it));
+      return;
+    }
+
+    // ... or towards the end of the active children (if at all).
+    position = std::lower_bound(std::next(it), active, child, compareDRF);
+    std::rotate(it, std::next(it), position);
+  }
+
   // Allocation for a node.
   struct Allocation
   {
@@ -330,15 +367,9 @@ struct DRFSorter::Node
             return !resources[slaveId].contains(resource);
         });
 
-      const Resources quantitiesToAdd =
-        (toAdd.nonShared() + sharedToAdd).createStrippedScalarQuantity();
-
       resources[slaveId] += toAdd;
-      scalarQuantities += quantitiesToAdd;
-
-      foreach (const Resource& resource, quantitiesToAdd) {
-        totals[resource.name()] += resource.scalar();
-      }
+      scalarQuantities += ResourceQuantities::fromScalarResources(
+          toAdd.nonShared() + sharedToAdd);
 
       count++;
     }
@@ -359,12 +390,9 @@ struct DRFSorter::Node
             return !resources[slaveId].contains(resource);
         });
 
-      const Resources quantitiesToRemove =
-        (toRemove.nonShared() + sharedToRemove).createStrippedScalarQuantity();
-
-      foreach (const Resource& resource, quantitiesToRemove) {
-        totals[resource.name()] -= resource.scalar();
-      }
+      const ResourceQuantities quantitiesToRemove =
+        ResourceQuantities::fromScalarResources(
+            toRemove.nonShared() + sharedToRemove);
 
       CHECK(scalarQuantities.contains(quantitiesToRemove))
         << scalarQuantities << " does not contain " << quantitiesToRemove;
@@ -381,10 +409,10 @@ struct DRFSorter::Node
         const Resources& oldAllocation,
         const Resources& newAllocation)
     {
-      const Resources oldAllocationQuantity =
-        oldAllocation.createStrippedScalarQuantity();
-      const Resources newAllocationQuantity =
-        newAllocation.createStrippedScalarQuantity();
+      const ResourceQuantities oldAllocationQuantity =
+        ResourceQuantities::fromScalarResources(oldAllocation);
+      const ResourceQuantities newAllocationQuantity =
+        ResourceQuantities::fromScalarResources(newAllocation);
 
       CHECK(resources.contains(slaveId));
       CHECK(resources[slaveId].contains(oldAllocation))
@@ -399,14 +427,6 @@ struct DRFSorter::Node
 
       scalarQuantities -= oldAllocationQuantity;
       scalarQuantities += newAllocationQuantity;
-
-      foreach (const Resource& resource, oldAllocationQuantity) {
-        totals[resource.name()] -= resource.scalar();
-      }
-
-      foreach (const Resource& resource, newAllocationQuantity) {
-        totals[resource.name()] += resource.scalar();
-      }
     }
 
     // We store the number of times this client has been chosen for
@@ -427,16 +447,7 @@ struct DRFSorter::Node
     // Similarly, we aggregate scalars across slaves and omit information
     // about dynamic reservations, persistent volumes and sharedness of
     // the corresponding resource. See notes above.
-    Resources scalarQuantities;
-
-    // We also store a map version of `scalarQuantities`, mapping
-    // the `Resource::name` to aggregated scalar. This improves the
-    // performance of calculating shares. See MESOS-4694.
-    //
-    // TODO(bmahler): Ideally we do not store `scalarQuantities`
-    // redundantly here, investigate performance improvements to
-    // `Resources` to make this unnecessary.
-    hashmap<std::string, Value::Scalar> totals;
+    ResourceQuantities scalarQuantities;
   } allocation;
 
   // Compares two nodes according to DRF share.
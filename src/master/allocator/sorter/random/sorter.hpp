@@ -31,6 +31,8 @@
 #include <stout/hashmap.hpp>
 #include <stout/option.hpp>
 
+#include "common/resource_quantities.hpp"
+
 #include "master/allocator/sorter/sorter.hpp"
 
 
@@ -82,7 +84,7 @@ public:
   virtual const hashmap<SlaveID, Resources>& allocation(
       const std::string& clientPath) const;
 
-  virtual const Resources& allocationScalarQuantities(
+  virtual const ResourceQuantities& allocationScalarQuantities(
       const std::string& clientPath) const;
 
   virtual hashmap<std::string, Resources> allocation(
@@ -92,7 +94,7 @@ public:
       const std::string& clientPath,
       const SlaveID& slaveId) const;
 
-  virtual const Resources& totalScalarQuantities() const;
+  virtual const ResourceQuantities& totalScalarQuantities() const;
 
   virtual void add(const SlaveID& slaveId, const Resources& resources);
 
@@ -164,16 +166,10 @@ private:
     // Sharedness info is also stripped out when resource identities
     // are omitted because sharedness inherently refers to the
     // identities of resources and not quantities.
-    Resources scalarQuantities;
-
-    // We also store a map version of `scalarQuantities`, mapping
-    // the `Resource::name` to aggregated scalar. This improves the
-    // performance of calculating shares. See MESOS-4694.
     //
-    // TODO(bmahler): Ideally we do not store `scalarQuantities`
-    // redundantly here, investigate performance improvements to
-    // `Resources` to make this unnecessary.
-    hashmap<std::string, Value::Scalar> totals;
+    // NOTE: `ResourceQuantities` is a flat vector sorted by resource
+    // name, which makes calculating shares cheap. See MESOS-4694.
+    ResourceQuantities scalarQuantities;
   } total_;
 };
 
@@ -317,15 +313,9 @@ struct RandomSorter::Node
             return !resources[slaveId].contains(resource);
         });
 
-      const Resources quantitiesToAdd =
-        (toAdd.nonShared() + sharedToAdd).createStrippedScalarQuantity();
-
       resources[slaveId] += toAdd;
-      scalarQuantities += quantitiesToAdd;
-
-      foreach (const Resource& resource, quantitiesToAdd) {
-        totals[resource.name()] += resource.scalar();
-      }
+      scalarQuantities += ResourceQuantities::fromScalarResources(
+          toAdd.nonShared() + sharedToAdd);
     }
 
     void subtract(const SlaveID& slaveId, const Resources& toRemove)
@@ -344,12 +334,9 @@ struct RandomSorter::Node
             return !resources[slaveId].contains(resource);
         });
 
-      const Resources quantitiesToRemove =
-        (toRemove.nonShared() + sharedToRemove).createStrippedScalarQuantity();
-
-      foreach (const Resource& resource, quantitiesToRemove) {
-        totals[resource.name()] -= resource.scalar();
-      }
+      const ResourceQuantities quantitiesToRemove =
+        ResourceQuantities::fromScalarResources(
+            toRemove.nonShared() + sharedToRemove);
 
       CHECK(scalarQuantities.contains(quantitiesToRemove))
         << scalarQuantities << " does not contain " << quantitiesToRemove;
@@ -366,10 +353,10 @@ struct RandomSorter::Node
         const Resources& oldAllocation,
         const Resources& newAllocation)
     {
-      const Resources oldAllocationQuantity =
-        oldAllocation.createStrippedScalarQuantity();
-      const Resources newAllocationQuantity =
-        newAllocation.createStrippedScalarQuantity();
+      const ResourceQuantities oldAllocationQuantity =
+        ResourceQuantities::fromScalarResources(oldAllocation);
+      const ResourceQuantities newAllocationQuantity =
+        ResourceQuantities::fromScalarResources(newAllocation);
 
       CHECK(resources.contains(slaveId));
       CHECK(resources[slaveId].contains(oldAllocation))
@@ -384,14 +371,6 @@ struct RandomSorter::Node
 
       scalarQuantities -= oldAllocationQuantity;
       scalarQuantities += newAllocationQuantity;
-
-      foreach (const Resource& resource, oldAllocationQuantity) {
-        totals[resource.name()] -= resource.scalar();
-      }
-
-      foreach (const Resource& resource, newAllocationQuantity) {
-        totals[resource.name()] += resource.scalar();
-      }
     }
 
     // We maintain multiple copies of each shared resource allocated
@@ -403,16 +382,7 @@ struct RandomSorter::Node
     // Similarly, we aggregate scalars across slaves and omit information
     // about dynamic reservations, persistent volumes and sharedness of
     // the corresponding resource. See notes above.
-    Resources scalarQuantities;
-
-    // We also store a map version of `scalarQuantities`, mapping
-    // the `Resource::name` to aggregated scalar. This improves the
-    // performance of calculating shares. See MESOS-4694.
-    //
-    // TODO(bmahler): Ideally we do not store `scalarQuantities`
-    // redundantly here, investigate performance improvements to
-    // `Resources` to make this unnecessary.
-    hashmap<std::string, Value::Scalar> totals;
+    ResourceQuantities scalarQuantities;
   } allocation;
 };
 
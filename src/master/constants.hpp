@@ -51,6 +51,11 @@ constexpr Bytes MIN_MEM = Megabytes(32);
 // scheduler.
 constexpr Duration DEFAULT_HEARTBEAT_INTERVAL = Seconds(15);
 
+// Interval after which the master recreates the object approvers of
+// the subscribers to its events, so that changes of the permissions
+// take effect.
+constexpr Duration SUBSCRIBER_APPROVERS_TTL = Seconds(15);
+
 // Amount of time within which a slave PING should be received.
 // NOTE: The slave uses these PING constants to determine when
 // the master has stopped sending pings. If these are made
@@ -94,6 +99,10 @@ constexpr size_t DEFAULT_MAX_COMPLETED_TASKS_PER_FRAMEWORK = 1000;
 // to store in the cache.
 constexpr size_t DEFAULT_MAX_UNREACHABLE_TASKS_PER_FRAMEWORK = 1000;
 
+// Maximum number of allocation runs to keep the profile of in the
+// allocator, see the allocator's `/profile` endpoint.
+constexpr size_t MAX_ALLOCATION_RUN_PROFILES = 100;
+
 // Time interval to check for updated watchers list.
 constexpr Duration WHITELIST_WATCH_INTERVAL = Seconds(5);
 
@@ -114,6 +114,39 @@ mesos::internal::master::Flags::Flags()
       "after which the operation is considered a failure.",
       Seconds(20));
 
+  add(&Flags::registry_max_deltas,
+      "registry_max_deltas",
+      "Maximum number of updates of the registry which are stored as\n"
+      "deltas, i.e., only the operations of the update (like admitting\n"
+      "an agent) get stored, before the full registry is stored again.\n"
+      "Storing deltas avoids storing the full registry (which grows with\n"
+      "the number of agents) for every update. Updates with operations\n"
+      "which can not be stored as deltas (e.g., quota or maintenance\n"
+      "updates) always store the full registry, as does the recovery of\n"
+      "the registry. If 0, the full registry is stored for every update.\n"
+      "Requires `--registry=replicated_log`, which ensures that a master\n"
+      "which is no longer leading can not store deltas.\n"
+      "NOTE: Masters which do not support this flag ignore the deltas,\n"
+      "so this must be disabled, and the master failed over, before\n"
+      "downgrading.",
+      0);
+
+  add(&Flags::registry_shards,
+      "registry_shards",
+      "Number of shards in which the agents in the registry are stored.\n"
+      "Each agent is stored in one of the shards (based on its ID), and\n"
+      "when storing the registry, only the shards with agents which were\n"
+      "updated get stored, along with the rest of the registry (e.g.,\n"
+      "quota, weights and maintenance). This bounds the size of the\n"
+      "values in the registry's storage and how much gets stored for an\n"
+      "update of the registry. If 0, the registry is stored as a single\n"
+      "value. The registry gets resharded when it is recovered with a\n"
+      "different number of shards.\n"
+      "NOTE: Masters which do not support this flag can not recover a\n"
+      "sharded registry, so this must be disabled, and the master failed\n"
+      "over, before downgrading.",
+      0);
+
   add(&Flags::log_auto_initialize,
       "log_auto_initialize",
       "Whether to automatically initialize the replicated log used for the\n"
@@ -196,6 +229,29 @@ mesos::internal::master::Flags::Flags()
       " (batch) allocations (e.g., 500ms, 1sec, etc).",
       DEFAULT_ALLOCATION_INTERVAL);
 
+  add(&Flags::allocation_shards,
+      "allocation_shards",
+      "Number of shards the agents are partitioned into when the allocator\n"
+      "computes offers. Offers for each shard are computed on a separate\n"
+      "thread against a snapshot of the allocator's sort order and quota\n"
+      "headroom, and are then committed in a deterministic order. A value\n"
+      "of 1 computes all offers sequentially on the allocator actor.",
+      1,
+      [](size_t value) -> Option<Error> {
+        if (value < 1) {
+          return Error("Expected `--allocation_shards` to be at least 1");
+        }
+        return None();
+      });
+
+  add(&Flags::validate_quota_headroom,
+      "validate_quota_headroom",
+      "Whether the allocator validates the quota headroom it maintains\n"
+      "incrementally against a full recomputation at the start of each\n"
+      "allocation run, aborting the master on a mismatch. This is expensive\n"
+      "and meant for debugging only.",
+      false);
+
   add(&Flags::cluster,
       "cluster",
       "Human readable name for the cluster, displayed in the webui.");
@@ -378,6 +434,22 @@ mesos::internal::master::Flags::Flags()
       "or frameworks that accidentally drop offers.\n"
       "If not set, offers do not timeout.");
 
+  add(&Flags::offer_batch_size,
+      "offer_batch_size",
+      "If set, offers are dispatched to the master in a pipelined fashion:\n"
+      "the allocator sends offers as soon as it has computed this many of\n"
+      "them (rather than at the end of each allocation cycle), and the\n"
+      "master creates and sends at most this many offers at a time before\n"
+      "processing other pending events. This bounds the latency of other\n"
+      "master operations during large allocation cycles. If not set, all\n"
+      "offers of an allocation cycle are sent at once.",
+      [](const Option<size_t>& value) -> Option<Error> {
+        if (value.isSome() && value.get() < 1) {
+          return Error("Expected `--offer_batch_size` to be at least 1");
+        }
+        return None();
+      });
+
   // This help message for --modules flag is the same for
   // {master,slave,sched,tests}/flags.[ch]pp and should always be kept in
   // sync.
@@ -527,6 +599,25 @@ mesos::internal::master::Flags::Flags()
         return None();
       });
 
+  add(&Flags::max_agent_reregistrations,
+      "max_agent_reregistrations",
+      "Maximum number of agent re-registrations which are in progress at\n"
+      "the same time, i.e., which are being decoded and validated (which\n"
+      "happens in parallel, off the master's event queue) or which wait for\n"
+      "authorization or the registry. Further re-registration attempts get\n"
+      "dropped (and counted in `master/dropped_messages`), and the agents\n"
+      "retry them with backoff. This bounds the work queued up in the master\n"
+      "after a failover, so that it keeps processing other events (e.g.,\n"
+      "offers) while the agents reregister. If not set, all re-registration\n"
+      "attempts are admitted.",
+      [](const Option<size_t>& value) -> Option<Error> {
+        if (value.isSome() && value.get() < 1) {
+          return Error(
+              "Expected `--max_agent_reregistrations` to be at least 1");
+        }
+        return None();
+      });
+
   add(&Flags::authorizers,
       "authorizers",
       "Authorizer implementation to use when authorizing actions that\n"
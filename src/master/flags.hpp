@@ -54,6 +54,8 @@ public:
   bool registry_strict;
   Duration registry_fetch_timeout;
   Duration registry_store_timeout;
+  size_t registry_max_deltas;
+  size_t registry_shards;
   bool log_auto_initialize;
   Duration agent_reregister_timeout;
   std::string recovery_agent_removal_limit;
@@ -63,6 +65,8 @@ public:
   std::string role_sorter;
   std::string framework_sorter;
   Duration allocation_interval;
+  size_t allocation_shards;
+  bool validate_quota_headroom;
   Option<std::string> cluster;
   Option<std::string> roles;
   Option<std::string> weights;
@@ -75,6 +79,7 @@ public:
   Option<ACLs> acls;
   Option<Firewall> firewall_rules;
   Option<RateLimits> rate_limits;
+  Option<size_t> offer_batch_size;
   Option<Duration> offer_timeout;
   Option<Modules> modules;
   Option<std::string> modulesDir;
@@ -86,6 +91,7 @@ public:
   Option<std::string> hooks;
   Duration agent_ping_timeout;
   size_t max_agent_ping_timeouts;
+  Option<size_t> max_agent_reregistrations;
   std::string authorizers;
   std::string http_authenticators;
   Option<std::string> http_framework_authenticators;
@@ -36,6 +36,7 @@
 
 #include <mesos/v1/master/master.hpp>
 
+#include <process/async.hpp>
 #include <process/collect.hpp>
 #include <process/defer.hpp>
 #include <process/help.hpp>
@@ -96,7 +97,9 @@ using process::Failure;
 using process::Future;
 using process::HELP;
 using process::Logging;
+using process::Shared;
 using process::TLDR;
+using process::Time;
 
 using process::http::Accepted;
 using process::http::BadRequest;
@@ -120,6 +123,7 @@ using std::copy_if;
 using std::list;
 using std::map;
 using std::set;
+using std::shared_ptr;
 using std::string;
 using std::tie;
 using std::tuple;
@@ -230,8 +234,89 @@ struct Full : Representation<T>
 };
 
 
+// The snapshot of a framework, which is shared by the snapshots of the
+// state (see `Master::Http::StateSnapshot`) until the framework changes.
+struct FrameworkState
+{
+  // The framework as exposed by the v1 API, including its offers.
+  mesos::master::Response::GetFrameworks::Framework framework;
+  bool completed;
+
+  // The parts of the framework which only the v0 endpoints expose,
+  // where the resources are not converted to the endpoint format.
+  Option<string> pid;
+  Resources totalUsedResources;
+  Resources totalOfferedResources;
+
+  vector<TaskInfo> pendingTasks;
+  vector<Task> tasks;
+  vector<Task> unreachableTasks;
+  vector<Shared<Task>> completedTasks;
+
+  vector<mesos::master::Response::GetExecutors::Executor> executors;
+};
+
+
+// The snapshot of an agent, which is shared by the snapshots of the
+// state (see `Master::Http::StateSnapshot`) until the agent changes.
+struct AgentState
+{
+  // The agent as exposed by the v1 API.
+  mesos::master::Response::GetAgents::Agent agent;
+
+  // The resources of the agent as the v0 endpoints expose them.
+  Resources totalResources;
+  Resources usedResources;
+  Resources offeredResources;
+};
+
+
+struct Master::Http::StateSnapshot
+{
+  // The registered frameworks followed by the completed frameworks.
+  vector<Shared<FrameworkState>> frameworks;
+
+  vector<Shared<AgentState>> agents;
+  vector<SlaveInfo> recoveredAgents;
+  size_t unreachableAgents;
+
+  Option<MasterInfo> leader;
+  Option<Time> electedTime;
+};
+
+
+// Builds the response via the given function and serializes it on a
+// separate process, i.e., without blocking the master actor.
+template <typename F>
+static Future<Response> respond(ContentType contentType, F&& f)
+{
+  return process::async([contentType, f]() -> Response {
+    return OK(serialize(contentType, evolve(f())), stringify(contentType));
+  });
+}
+
+
+// Like above, but for the JSON written by the given function for the
+// v0 endpoints.
+template <typename F>
+static Future<Response> respond(const Option<string>& jsonp, F&& f)
+{
+  return process::async([jsonp, f]() -> Response {
+    return OK(jsonify(f), jsonp);
+  });
+}
+
+
+static double secs(const TimeInfo& time)
+{
+  return Nanoseconds(time.nanoseconds()).secs();
+}
+
+
 // Forward declaration for `FullFrameworkWriter`.
-static void json(JSON::ObjectWriter* writer, const Summary<Framework>& summary);
+static void json(
+    JSON::ObjectWriter* writer,
+    const Summary<FrameworkState>& summary);
 
 
 // Filtered representation of Full<Framework>.
@@ -240,35 +325,41 @@ static void json(JSON::ObjectWriter* writer, const Summary<Framework>& summary);
 struct FullFrameworkWriter {
   FullFrameworkWriter(
       const Owned<ObjectApprovers>& approvers,
-      const Framework* framework)
+      const FrameworkState& framework)
     : approvers_(approvers),
-      framework_(framework) {}
+      framework_(framework),
+      info_(framework.framework.framework_info()) {}
 
   void operator()(JSON::ObjectWriter* writer) const
   {
-    json(writer, Summary<Framework>(*framework_));
+    json(writer, Summary<FrameworkState>(framework_));
 
     // Add additional fields to those generated by the
-    // `Summary<Framework>` overload.
-    writer->field("user", framework_->info.user());
-    writer->field("failover_timeout", framework_->info.failover_timeout());
-    writer->field("checkpoint", framework_->info.checkpoint());
-    writer->field("registered_time", framework_->registeredTime.secs());
-    writer->field("unregistered_time", framework_->unregisteredTime.secs());
-
-    if (framework_->info.has_principal()) {
-      writer->field("principal", framework_->info.principal());
+    // `Summary<FrameworkState>` overload.
+    writer->field("user", info_.user());
+    writer->field("failover_timeout", info_.failover_timeout());
+    writer->field("checkpoint", info_.checkpoint());
+    writer->field(
+        "registered_time", secs(framework_.framework.registered_time()));
+    writer->field(
+        "unregistered_time", secs(framework_.framework.unregistered_time()));
+
+    if (info_.has_principal()) {
+      writer->field("principal", info_.principal());
     }
 
     // TODO(bmahler): Consider deprecating this in favor of the split
-    // used and offered resources added in `Summary<Framework>`.
+    // used and offered resources added in `Summary<FrameworkState>`.
     writer->field(
         "resources",
-        framework_->totalUsedResources + framework_->totalOfferedResources);
+        framework_.totalUsedResources + framework_.totalOfferedResources);
 
     // TODO(benh): Consider making reregisteredTime an Option.
-    if (framework_->registeredTime != framework_->reregisteredTime) {
-      writer->field("reregistered_time", framework_->reregisteredTime.secs());
+    if (framework_.framework.registered_time().nanoseconds() !=
+          framework_.framework.reregistered_time().nanoseconds()) {
+      writer->field(
+          "reregistered_time",
+          secs(framework_.framework.reregistered_time()));
     }
 
     // For multi-role frameworks the `role` field will be unset.
@@ -276,24 +367,25 @@ struct FullFrameworkWriter {
     // would make tooling simpler (only need to look for `roles`).
     // However, we opted to just mirror the protobuf akin to how
     // generic protobuf -> JSON translation works.
-    if (framework_->capabilities.multiRole) {
-      writer->field("roles", framework_->info.roles());
+    if (protobuf::frameworkHasCapability(
+            info_, FrameworkInfo::Capability::MULTI_ROLE)) {
+      writer->field("roles", info_.roles());
     } else {
-      writer->field("role", framework_->info.role());
+      writer->field("role", info_.role());
     }
 
     // Model all of the tasks associated with a framework.
     writer->field("tasks", [this](JSON::ArrayWriter* writer) {
-      foreachvalue (const TaskInfo& taskInfo, framework_->pendingTasks) {
+      foreach (const TaskInfo& taskInfo, framework_.pendingTasks) {
         // Skip unauthorized tasks.
-        if (!approvers_->approved<VIEW_TASK>(taskInfo, framework_->info)) {
+        if (!approvers_->approved<VIEW_TASK>(taskInfo, info_)) {
           continue;
         }
 
         writer->element([this, &taskInfo](JSON::ObjectWriter* writer) {
           writer->field("id", taskInfo.task_id().value());
           writer->field("name", taskInfo.name());
-          writer->field("framework_id", framework_->id().value());
+          writer->field("framework_id", info_.id().value());
 
           writer->field(
               "executor_id",
@@ -325,31 +417,31 @@ struct FullFrameworkWriter {
         });
       }
 
-      foreachvalue (Task* task, framework_->tasks) {
+      foreach (const Task& task, framework_.tasks) {
         // Skip unauthorized tasks.
-        if (!approvers_->approved<VIEW_TASK>(*task, framework_->info)) {
+        if (!approvers_->approved<VIEW_TASK>(task, info_)) {
           continue;
         }
 
-        writer->element(*task);
+        writer->element(task);
       }
     });
 
     writer->field("unreachable_tasks", [this](JSON::ArrayWriter* writer) {
-      foreachvalue (const Owned<Task>& task, framework_->unreachableTasks) {
+      foreach (const Task& task, framework_.unreachableTasks) {
         // Skip unauthorized tasks.
-        if (!approvers_->approved<VIEW_TASK>(*task, framework_->info)) {
+        if (!approvers_->approved<VIEW_TASK>(task, info_)) {
           continue;
         }
 
-        writer->element(*task);
+        writer->element(task);
       }
     });
 
     writer->field("completed_tasks", [this](JSON::ArrayWriter* writer) {
-      foreach (const Owned<Task>& task, framework_->completedTasks) {
+      foreach (const Shared<Task>& task, framework_.completedTasks) {
         // Skip unauthorized tasks.
-        if (!approvers_->approved<VIEW_TASK>(*task, framework_->info)) {
+        if (!approvers_->approved<VIEW_TASK>(*task, info_)) {
           continue;
         }
 
@@ -359,66 +451,63 @@ struct FullFrameworkWriter {
 
     // Model all of the offers associated with a framework.
     writer->field("offers", [this](JSON::ArrayWriter* writer) {
-      foreach (Offer* offer, framework_->offers) {
-        writer->element(*offer);
+      foreach (const Offer& offer, framework_.framework.offers()) {
+        writer->element(offer);
       }
     });
 
     // Model all of the executors of a framework.
     writer->field("executors", [this](JSON::ArrayWriter* writer) {
-      foreachpair (
-          const SlaveID& slaveId,
-          const auto& executorsMap,
-          framework_->executors) {
-        foreachvalue (const ExecutorInfo& executor, executorsMap) {
-          writer->element([this,
-                           &executor,
-                           &slaveId](JSON::ObjectWriter* writer) {
-            // Skip unauthorized executors.
-            if (!approvers_->approved<VIEW_EXECUTOR>(
-                    executor, framework_->info)) {
-              return;
-            }
+      foreach (
+          const mesos::master::Response::GetExecutors::Executor& executor,
+          framework_.executors) {
+        writer->element([this, &executor](JSON::ObjectWriter* writer) {
+          // Skip unauthorized executors.
+          if (!approvers_->approved<VIEW_EXECUTOR>(
+                  executor.executor_info(), info_)) {
+            return;
+          }
 
-            json(writer, executor);
-            writer->field("slave_id", slaveId.value());
-          });
-        }
+          json(writer, executor.executor_info());
+          writer->field("slave_id", executor.slave_id().value());
+        });
       }
     });
 
     // Model all of the labels associated with a framework.
-    if (framework_->info.has_labels()) {
-      writer->field("labels", framework_->info.labels());
+    if (info_.has_labels()) {
+      writer->field("labels", info_.labels());
     }
   }
 
   const Owned<ObjectApprovers>& approvers_;
-  const Framework* framework_;
+  const FrameworkState& framework_;
+  const FrameworkInfo& info_;
 };
 
 
 struct SlaveWriter
 {
   SlaveWriter(
-      const Slave& slave,
+      const AgentState& slave,
       const Owned<ObjectApprovers>& approvers)
     : slave_(slave), approvers_(approvers) {}
 
   void operator()(JSON::ObjectWriter* writer) const
   {
-    json(writer, slave_.info);
+    json(writer, slave_.agent.agent_info());
 
-    writer->field("pid", string(slave_.pid));
-    writer->field("registered_time", slave_.registeredTime.secs());
+    writer->field("pid", slave_.agent.pid());
+    writer->field("registered_time", secs(slave_.agent.registered_time()));
 
-    if (slave_.reregisteredTime.isSome()) {
-      writer->field("reregistered_time", slave_.reregisteredTime->secs());
+    if (slave_.agent.has_reregistered_time()) {
+      writer->field(
+          "reregistered_time", secs(slave_.agent.reregistered_time()));
     }
 
     const Resources& totalResources = slave_.totalResources;
     writer->field("resources", totalResources);
-    writer->field("used_resources", Resources::sum(slave_.usedResources));
+    writer->field("used_resources", slave_.usedResources);
     writer->field("offered_resources", slave_.offeredResources);
     writer->field(
         "reserved_resources",
@@ -435,12 +524,12 @@ struct SlaveWriter
         });
     writer->field("unreserved_resources", totalResources.unreserved());
 
-    writer->field("active", slave_.active);
-    writer->field("version", slave_.version);
-    writer->field("capabilities", slave_.capabilities.toRepeatedPtrField());
+    writer->field("active", slave_.agent.active());
+    writer->field("version", slave_.agent.version());
+    writer->field("capabilities", slave_.agent.capabilities());
   }
 
-  const Slave& slave_;
+  const AgentState& slave_;
   const Owned<ObjectApprovers>& approvers_;
 };
 
@@ -448,29 +537,29 @@ struct SlaveWriter
 struct SlavesWriter
 {
   SlavesWriter(
-      const Master::Slaves& slaves,
+      const Master::Http::StateSnapshot& snapshot,
       const Owned<ObjectApprovers>& approvers,
       const IDAcceptor<SlaveID>& selectSlaveId)
-    : slaves_(slaves),
+    : snapshot_(snapshot),
       approvers_(approvers),
       selectSlaveId_(selectSlaveId) {}
 
   void operator()(JSON::ObjectWriter* writer) const
   {
     writer->field("slaves", [this](JSON::ArrayWriter* writer) {
-      foreachvalue (const Slave* slave, slaves_.registered) {
-        if (!selectSlaveId_.accept(slave->id)) {
+      foreach (const Shared<AgentState>& slave, snapshot_.agents) {
+        if (!selectSlaveId_.accept(slave->agent.agent_info().id())) {
           continue;
         }
 
         writer->element([this, &slave](JSON::ObjectWriter* writer) {
-          writeSlave(slave, writer);
+          writeSlave(*slave, writer);
         });
       }
     });
 
     writer->field("recovered_slaves", [this](JSON::ArrayWriter* writer) {
-      foreachvalue (const SlaveInfo& slaveInfo, slaves_.recovered) {
+      foreach (const SlaveInfo& slaveInfo, snapshot_.recoveredAgents) {
         if (!selectSlaveId_.accept(slaveInfo.id())) {
           continue;
         }
@@ -482,9 +571,9 @@ struct SlavesWriter
     });
   }
 
-  void writeSlave(const Slave* slave, JSON::ObjectWriter* writer) const
+  void writeSlave(const AgentState& slave, JSON::ObjectWriter* writer) const
   {
-    SlaveWriter(*slave, approvers_)(writer);
+    SlaveWriter(slave, approvers_)(writer);
 
     // Add the complete protobuf->JSON for all used, reserved,
     // and offered resources. The other endpoints summarize
@@ -493,7 +582,7 @@ struct SlavesWriter
     // information is necessary so that operators can use the
     // `/unreserve` and `/destroy-volumes` endpoints.
 
-    hashmap<string, Resources> reserved = slave->totalResources.reservations();
+    hashmap<string, Resources> reserved = slave.totalResources.reservations();
 
     writer->field(
         "reserved_resources_full",
@@ -515,7 +604,7 @@ struct SlavesWriter
           }
         });
 
-    Resources unreservedResources = slave->totalResources.unreserved();
+    Resources unreservedResources = slave.totalResources.unreserved();
 
     writer->field(
         "unreserved_resources_full",
@@ -528,7 +617,7 @@ struct SlavesWriter
           }
         });
 
-    Resources usedResources = Resources::sum(slave->usedResources);
+    const Resources& usedResources = slave.usedResources;
 
     writer->field(
         "used_resources_full",
@@ -541,7 +630,7 @@ struct SlavesWriter
           }
         });
 
-    const Resources& offeredResources = slave->offeredResources;
+    const Resources& offeredResources = slave.offeredResources;
 
     writer->field(
         "offered_resources_full",
@@ -555,33 +644,36 @@ struct SlavesWriter
         });
   }
 
-  const Master::Slaves& slaves_;
+  const Master::Http::StateSnapshot& snapshot_;
   const Owned<ObjectApprovers>& approvers_;
   const IDAcceptor<SlaveID>& selectSlaveId_;
 };
 
 
-static void json(JSON::ObjectWriter* writer, const Summary<Framework>& summary)
+static void json(
+    JSON::ObjectWriter* writer,
+    const Summary<FrameworkState>& summary)
 {
-  const Framework& framework = summary;
+  const FrameworkState& framework = summary;
+  const FrameworkInfo& info = framework.framework.framework_info();
 
-  writer->field("id", framework.id().value());
-  writer->field("name", framework.info.name());
+  writer->field("id", info.id().value());
+  writer->field("name", info.name());
 
   // Omit pid for http frameworks.
   if (framework.pid.isSome()) {
-    writer->field("pid", string(framework.pid.get()));
+    writer->field("pid", framework.pid.get());
   }
 
   // TODO(bmahler): Use these in the webui.
   writer->field("used_resources", framework.totalUsedResources);
   writer->field("offered_resources", framework.totalOfferedResources);
-  writer->field("capabilities", framework.info.capabilities());
-  writer->field("hostname", framework.info.hostname());
-  writer->field("webui_url", framework.info.webui_url());
-  writer->field("active", framework.active());
-  writer->field("connected", framework.connected());
-  writer->field("recovered", framework.recovered());
+  writer->field("capabilities", info.capabilities());
+  writer->field("hostname", info.hostname());
+  writer->field("webui_url", info.webui_url());
+  writer->field("active", framework.framework.active());
+  writer->field("connected", framework.framework.connected());
+  writer->field("recovered", framework.framework.recovered());
 }
 
 
@@ -840,7 +932,7 @@ Future<Response> Master::Http::subscribe(
           mesos::master::Event event;
           event.set_type(mesos::master::Event::SUBSCRIBED);
           *event.mutable_subscribed()->mutable_get_state() =
-            _getState(approvers);
+            _getState(*snapshot(), approvers);
 
           event.mutable_subscribed()->set_heartbeat_interval_seconds(
               DEFAULT_HEARTBEAT_INTERVAL.secs());
@@ -853,7 +945,7 @@ Future<Response> Master::Http::subscribe(
 
           // Master::subscribe will start the heartbeater process, which should
           // only happen after `SUBSCRIBED` event is sent.
-          master->subscribe(http, principal);
+          master->subscribe(http, principal, call.subscribe(), approvers);
 
           return ok;
         }));
@@ -1677,56 +1769,56 @@ Future<Response> Master::Http::frameworks(
       {VIEW_FRAMEWORK, VIEW_TASK, VIEW_EXECUTOR})
     .then(defer(
         master->self(),
-        [this, request](const Owned<ObjectApprovers>& approvers) -> Response {
+        [this, request](const Owned<ObjectApprovers>& approvers)
+            -> Future<Response> {
+          reading();
+
+          Shared<StateSnapshot> snapshot = this->snapshot();
+
           IDAcceptor<FrameworkID> selectFrameworkId(
               request.url.query.get("framework_id"));
-          // This lambda is consumed before the outer lambda
-          // returns, hence capture by reference is fine here.
-          auto frameworks = [this, &approvers, &selectFrameworkId](
-              JSON::ObjectWriter* writer) {
-            // Model all of the frameworks.
-            writer->field(
-                "frameworks",
-                [this, &approvers, &selectFrameworkId](
-                    JSON::ArrayWriter* writer) {
-                  foreachvalue (
-                      Framework* framework, master->frameworks.registered) {
-                    // Skip unauthorized frameworks or frameworks
-                    // without a matching ID.
-                    if (!selectFrameworkId.accept(framework->id()) ||
-                        !approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-                      continue;
-                    }
 
-                    writer->element(FullFrameworkWriter(approvers, framework));
-                  }
-                });
+          // Writes the registered or the completed frameworks.
+          auto frameworks = [snapshot, approvers, selectFrameworkId](
+              bool completed, JSON::ArrayWriter* writer) {
+            foreach (const Shared<FrameworkState>& framework,
+                     snapshot->frameworks) {
+              const FrameworkInfo& info = framework->framework.framework_info();
+
+              // Skip unauthorized frameworks or frameworks
+              // without a matching ID.
+              if (framework->completed != completed ||
+                  !selectFrameworkId.accept(info.id()) ||
+                  !approvers->approved<VIEW_FRAMEWORK>(info)) {
+                continue;
+              }
 
-            // Model all of the completed frameworks.
-            writer->field(
-                "completed_frameworks",
-                [this, &approvers, &selectFrameworkId](
-                    JSON::ArrayWriter* writer) {
-                  foreachvalue (const Owned<Framework>& framework,
-                                master->frameworks.completed) {
-                    // Skip unauthorized frameworks or frameworks
-                    // without a matching ID.
-                    if (!selectFrameworkId.accept(framework->id()) ||
-                        !approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-                      continue;
-                    }
+              writer->element(FullFrameworkWriter(approvers, *framework));
+            }
+          };
 
-                    writer->element(
-                        FullFrameworkWriter(approvers, framework.get()));
-                  }
-                });
+          return respond(
+              request.url.query.get("jsonp"),
+              [frameworks](JSON::ObjectWriter* writer) {
+                // Model all of the frameworks.
+                writer->field(
+                    "frameworks",
+                    [&frameworks](JSON::ArrayWriter* writer) {
+                      frameworks(false, writer);
+                    });
 
-            // Unregistered frameworks are no longer possible. We emit an
-            // empty array for the sake of backward compatibility.
-            writer->field("unregistered_frameworks", [](JSON::ArrayWriter*) {});
-          };
+                // Model all of the completed frameworks.
+                writer->field(
+                    "completed_frameworks",
+                    [&frameworks](JSON::ArrayWriter* writer) {
+                      frameworks(true, writer);
+                    });
 
-          return OK(jsonify(frameworks), request.url.query.get("jsonp"));
+                // Unregistered frameworks are no longer possible. We emit
+                // an empty array for the sake of backward compatibility.
+                writer->field(
+                    "unregistered_frameworks", [](JSON::ArrayWriter*) {});
+              });
         }));
 }
 
@@ -1795,158 +1887,379 @@ Future<Response> Master::Http::getFrameworks(
     .then(defer(
         master->self(),
         [=](const Owned<ObjectApprovers>& approvers) -> Future<Response> {
-          mesos::master::Response response;
-          response.set_type(mesos::master::Response::GET_FRAMEWORKS);
-          *response.mutable_get_frameworks() = _getFrameworks(approvers);
+          reading();
 
-          return OK(
-              serialize(contentType, evolve(response)), stringify(contentType));
+          Shared<StateSnapshot> snapshot = this->snapshot();
+
+          return respond(contentType, [snapshot, approvers]() {
+            mesos::master::Response response;
+            response.set_type(mesos::master::Response::GET_FRAMEWORKS);
+            *response.mutable_get_frameworks() =
+              _getFrameworks(*snapshot, approvers);
+            return response;
+          });
         }));
 }
 
 
-mesos::master::Response::GetFrameworks Master::Http::_getFrameworks(
-    const Owned<ObjectApprovers>& approvers) const
+Future<Response> Master::Http::getExecutors(
+    const mesos::master::Call& call,
+    const Option<Principal>& principal,
+    ContentType contentType) const
 {
-  mesos::master::Response::GetFrameworks getFrameworks;
-  foreachvalue (const Framework* framework,
-                master->frameworks.registered) {
-    // Skip unauthorized frameworks.
-    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-      continue;
-    }
-
-    *getFrameworks.add_frameworks() = model(*framework);
-  }
+  CHECK_EQ(mesos::master::Call::GET_EXECUTORS, call.type());
 
-  foreachvalue (const Owned<Framework>& framework,
-                master->frameworks.completed) {
-    // Skip unauthorized frameworks.
-    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-      continue;
-    }
+  return ObjectApprovers::create(
+      master->authorizer,
+      principal,
+      {VIEW_FRAMEWORK, VIEW_EXECUTOR})
+    .then(defer(
+        master->self(),
+        [=](const Owned<ObjectApprovers>& approvers) -> Future<Response> {
+          reading();
 
-    *getFrameworks.add_completed_frameworks() = model(*framework);
-  }
+          Shared<StateSnapshot> snapshot = this->snapshot();
 
-  return getFrameworks;
+          return respond(contentType, [snapshot, approvers]() {
+            mesos::master::Response response;
+            response.set_type(mesos::master::Response::GET_EXECUTORS);
+            *response.mutable_get_executors() =
+              _getExecutors(*snapshot, approvers);
+            return response;
+          });
+        }));
 }
 
 
-Future<Response> Master::Http::getExecutors(
+Future<Response> Master::Http::getState(
     const mesos::master::Call& call,
     const Option<Principal>& principal,
     ContentType contentType) const
 {
-  CHECK_EQ(mesos::master::Call::GET_EXECUTORS, call.type());
+  CHECK_EQ(mesos::master::Call::GET_STATE, call.type());
 
   return ObjectApprovers::create(
       master->authorizer,
       principal,
-      {VIEW_FRAMEWORK, VIEW_EXECUTOR})
+      {VIEW_FRAMEWORK, VIEW_TASK, VIEW_EXECUTOR, VIEW_ROLE})
     .then(defer(
         master->self(),
-        [=](const Owned<ObjectApprovers>& approvers) -> Response {
-          mesos::master::Response response;
-          response.set_type(mesos::master::Response::GET_EXECUTORS);
+        [=](const Owned<ObjectApprovers>& approvers) -> Future<Response> {
+          reading();
 
-          *response.mutable_get_executors() = _getExecutors(approvers);
+          Shared<StateSnapshot> snapshot = this->snapshot();
 
-          return OK(
-              serialize(contentType, evolve(response)), stringify(contentType));
+          return respond(contentType, [snapshot, approvers]() {
+            mesos::master::Response response;
+            response.set_type(mesos::master::Response::GET_STATE);
+            *response.mutable_get_state() = _getState(*snapshot, approvers);
+            return response;
+          });
         }));
 }
 
 
-mesos::master::Response::GetExecutors Master::Http::_getExecutors(
-      const Owned<ObjectApprovers>& approvers) const
+// Returns the snapshot of the framework, taking it first if the
+// framework changed since the last snapshot was taken.
+static Shared<FrameworkState> frameworkSnapshot(
+    Framework* framework,
+    bool completed)
 {
-  // Construct framework list with both active and completed frameworks.
-  vector<const Framework*> frameworks;
-  foreachvalue (Framework* framework, master->frameworks.registered) {
-    // Skip unauthorized frameworks.
-    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-      continue;
+  if (framework->snapshot.get() != nullptr &&
+      framework->snapshot->completed == completed) {
+    return framework->snapshot;
+  }
+
+  FrameworkState* state = new FrameworkState();
+  state->framework = model(*framework);
+  state->completed = completed;
+
+  if (framework->pid.isSome()) {
+    state->pid = string(framework->pid.get());
+  }
+
+  state->totalUsedResources = framework->totalUsedResources;
+  state->totalOfferedResources = framework->totalOfferedResources;
+
+  foreachvalue (const TaskInfo& taskInfo, framework->pendingTasks) {
+    state->pendingTasks.push_back(taskInfo);
+  }
+
+  foreachvalue (const Task* task, framework->tasks) {
+    state->tasks.push_back(*CHECK_NOTNULL(task));
+  }
+
+  foreachvalue (const Owned<Task>& task, framework->unreachableTasks) {
+    state->unreachableTasks.push_back(*task);
+  }
+
+  state->completedTasks.assign(
+      framework->completedTasks.begin(), framework->completedTasks.end());
+
+  foreachpair (const SlaveID& slaveId,
+               const auto& executorsMap,
+               framework->executors) {
+    foreachvalue (const ExecutorInfo& executorInfo, executorsMap) {
+      mesos::master::Response::GetExecutors::Executor executor;
+      executor.mutable_executor_info()->CopyFrom(executorInfo);
+      executor.mutable_slave_id()->CopyFrom(slaveId);
+
+      state->executors.push_back(std::move(executor));
     }
+  }
+
+  framework->snapshot = Shared<FrameworkState>(state);
+
+  return framework->snapshot;
+}
+
+
+// Returns the snapshot of the agent, taking it first if the agent
+// changed since the last snapshot was taken.
+static Shared<AgentState> agentSnapshot(Slave* slave)
+{
+  if (slave->snapshot.get() != nullptr) {
+    return slave->snapshot;
+  }
+
+  AgentState* state = new AgentState();
+  state->agent = protobuf::master::event::createAgentResponse(*slave);
+  state->totalResources = slave->totalResources;
+  state->usedResources = Resources::sum(slave->usedResources);
+  state->offeredResources = slave->offeredResources;
+
+  slave->snapshot = Shared<AgentState>(state);
 
-    frameworks.push_back(framework);
+  return slave->snapshot;
+}
+
+
+Shared<Master::Http::StateSnapshot> Master::Http::snapshot() const
+{
+  if (published.isSome()) {
+    return published.get();
+  }
+
+  // Only the frameworks and agents which changed since the last
+  // snapshot are copied, the others are shared with the last snapshot.
+  StateSnapshot* snapshot = new StateSnapshot();
+
+  snapshot->frameworks.reserve(
+      master->frameworks.registered.size() +
+      master->frameworks.completed.size());
+
+  foreachvalue (Framework* framework, master->frameworks.registered) {
+    snapshot->frameworks.push_back(frameworkSnapshot(framework, false));
   }
 
   foreachvalue (const Owned<Framework>& framework,
                 master->frameworks.completed) {
+    snapshot->frameworks.push_back(frameworkSnapshot(framework.get(), true));
+  }
+
+  snapshot->agents.reserve(master->slaves.registered.size());
+
+  foreachvalue (Slave* slave, master->slaves.registered) {
+    snapshot->agents.push_back(agentSnapshot(slave));
+  }
+
+  foreachvalue (const SlaveInfo& slaveInfo, master->slaves.recovered) {
+    snapshot->recoveredAgents.push_back(slaveInfo);
+  }
+
+  snapshot->unreachableAgents = master->slaves.unreachable.size();
+
+  snapshot->leader = master->leader;
+  snapshot->electedTime = master->electedTime;
+
+  published = Shared<StateSnapshot>(snapshot);
+
+  return published.get();
+}
+
+
+void Master::Http::reading() const
+{
+  readOnly = true;
+}
+
+
+void Master::Http::served() const
+{
+  if (!readOnly) {
+    published = None();
+  }
+
+  readOnly = false;
+}
+
+
+mesos::master::Response::GetAgents Master::Http::_getAgents(
+    const StateSnapshot& snapshot,
+    const Owned<ObjectApprovers>& approvers)
+{
+  // Filters the given resources by the roles the approvers permit
+  // to view, see `createAgentResponse`.
+  auto filter = [&approvers](
+      google::protobuf::RepeatedPtrField<Resource>* resources) {
+    google::protobuf::RepeatedPtrField<Resource> approved;
+
+    foreach (Resource& resource, *resources) {
+      if (approvers->approved<VIEW_ROLE>(resource)) {
+        approved.Add()->Swap(&resource);
+      }
+    }
+
+    resources->Swap(&approved);
+  };
+
+  mesos::master::Response::GetAgents getAgents;
+
+  foreach (const Shared<AgentState>& state, snapshot.agents) {
+    mesos::master::Response::GetAgents::Agent* agent = getAgents.add_agents();
+    agent->CopyFrom(state->agent);
+
+    filter(agent->mutable_agent_info()->mutable_resources());
+    filter(agent->mutable_total_resources());
+    filter(agent->mutable_allocated_resources());
+    filter(agent->mutable_offered_resources());
+  }
+
+  foreach (const SlaveInfo& slaveInfo, snapshot.recoveredAgents) {
+    SlaveInfo* agent = getAgents.add_recovered_agents();
+    agent->CopyFrom(slaveInfo);
+
+    filter(agent->mutable_resources());
+  }
+
+  return getAgents;
+}
+
+
+mesos::master::Response::GetTasks Master::Http::_getTasks(
+    const StateSnapshot& snapshot,
+    const Owned<ObjectApprovers>& approvers)
+{
+  mesos::master::Response::GetTasks getTasks;
+
+  foreach (const Shared<FrameworkState>& framework, snapshot.frameworks) {
+    const FrameworkInfo& frameworkInfo = framework->framework.framework_info();
+
     // Skip unauthorized frameworks.
-    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
+    if (!approvers->approved<VIEW_FRAMEWORK>(frameworkInfo)) {
       continue;
     }
 
-    frameworks.push_back(framework.get());
-  }
+    // Pending tasks.
+    foreach (const TaskInfo& taskInfo, framework->pendingTasks) {
+      // Skip unauthorized tasks.
+      if (!approvers->approved<VIEW_TASK>(taskInfo, frameworkInfo)) {
+        continue;
+      }
 
-  mesos::master::Response::GetExecutors getExecutors;
+      *getTasks.add_pending_tasks() =
+        protobuf::createTask(taskInfo, TASK_STAGING, frameworkInfo.id());
+    }
 
-  foreach (const Framework* framework, frameworks) {
-    foreachpair (const SlaveID& slaveId,
-                 const auto& executorsMap,
-                 framework->executors) {
-      foreachvalue (const ExecutorInfo& executorInfo, executorsMap) {
-        // Skip unauthorized executors.
-        if (!approvers->approved<VIEW_EXECUTOR>(
-                executorInfo, framework->info)) {
-          continue;
-        }
+    // Active tasks.
+    foreach (const Task& task, framework->tasks) {
+      // Skip unauthorized tasks.
+      if (!approvers->approved<VIEW_TASK>(task, frameworkInfo)) {
+        continue;
+      }
+
+      getTasks.add_tasks()->CopyFrom(task);
+    }
+
+    // Unreachable tasks.
+    foreach (const Task& task, framework->unreachableTasks) {
+      // Skip unauthorized tasks.
+      if (!approvers->approved<VIEW_TASK>(task, frameworkInfo)) {
+        continue;
+      }
 
-        mesos::master::Response::GetExecutors::Executor* executor =
-          getExecutors.add_executors();
+      getTasks.add_unreachable_tasks()->CopyFrom(task);
+    }
 
-        executor->mutable_executor_info()->CopyFrom(executorInfo);
-        executor->mutable_slave_id()->CopyFrom(slaveId);
+    // Completed tasks.
+    foreach (const Shared<Task>& task, framework->completedTasks) {
+      // Skip unauthorized tasks.
+      if (!approvers->approved<VIEW_TASK>(*task, frameworkInfo)) {
+        continue;
       }
+
+      getTasks.add_completed_tasks()->CopyFrom(*task);
     }
   }
 
-  return getExecutors;
+  return getTasks;
 }
 
 
-Future<Response> Master::Http::getState(
-    const mesos::master::Call& call,
-    const Option<Principal>& principal,
-    ContentType contentType) const
+mesos::master::Response::GetFrameworks Master::Http::_getFrameworks(
+    const StateSnapshot& snapshot,
+    const Owned<ObjectApprovers>& approvers)
 {
-  CHECK_EQ(mesos::master::Call::GET_STATE, call.type());
+  mesos::master::Response::GetFrameworks getFrameworks;
 
-  return ObjectApprovers::create(
-      master->authorizer,
-      principal,
-      {VIEW_FRAMEWORK, VIEW_TASK, VIEW_EXECUTOR, VIEW_ROLE})
-    .then(defer(
-        master->self(),
-        [=](const Owned<ObjectApprovers>& approvers) -> Response {
-          mesos::master::Response response;
-          response.set_type(mesos::master::Response::GET_STATE);
+  foreach (const Shared<FrameworkState>& framework, snapshot.frameworks) {
+    // Skip unauthorized frameworks.
+    if (!approvers->approved<VIEW_FRAMEWORK>(
+            framework->framework.framework_info())) {
+      continue;
+    }
 
-          *response.mutable_get_state() = _getState(approvers);
+    if (framework->completed) {
+      *getFrameworks.add_completed_frameworks() = framework->framework;
+    } else {
+      *getFrameworks.add_frameworks() = framework->framework;
+    }
+  }
 
-          return OK(
-              serialize(contentType, evolve(response)), stringify(contentType));
-        }));
+  return getFrameworks;
 }
 
 
-mesos::master::Response::GetState Master::Http::_getState(
-    const Owned<ObjectApprovers>& approvers) const
+mesos::master::Response::GetExecutors Master::Http::_getExecutors(
+    const StateSnapshot& snapshot,
+    const Owned<ObjectApprovers>& approvers)
 {
-  // NOTE: This function must be blocking instead of returning a
-  // `Future`. This is because `subscribe()` needs to atomically
-  // add subscriber to `subscribers` map and send the captured state
-  // in `SUBSCRIBED` without being interleaved by any other events.
+  mesos::master::Response::GetExecutors getExecutors;
+
+  foreach (const Shared<FrameworkState>& framework, snapshot.frameworks) {
+    const FrameworkInfo& frameworkInfo = framework->framework.framework_info();
+
+    // Skip unauthorized frameworks.
+    if (!approvers->approved<VIEW_FRAMEWORK>(frameworkInfo)) {
+      continue;
+    }
+
+    foreach (const mesos::master::Response::GetExecutors::Executor& executor,
+             framework->executors) {
+      // Skip unauthorized executors.
+      if (!approvers->approved<VIEW_EXECUTOR>(
+              executor.executor_info(), frameworkInfo)) {
+        continue;
+      }
+
+      *getExecutors.add_executors() = executor;
+    }
+  }
 
+  return getExecutors;
+}
+
+
+mesos::master::Response::GetState Master::Http::_getState(
+    const StateSnapshot& snapshot,
+    const Owned<ObjectApprovers>& approvers)
+{
   mesos::master::Response::GetState getState;
 
-  *getState.mutable_get_tasks() = _getTasks(approvers);
-  *getState.mutable_get_executors() = _getExecutors(approvers);
-  *getState.mutable_get_frameworks() = _getFrameworks(approvers);
-  *getState.mutable_get_agents() = _getAgents(approvers);
+  *getState.mutable_get_tasks() = _getTasks(snapshot, approvers);
+  *getState.mutable_get_executors() = _getExecutors(snapshot, approvers);
+  *getState.mutable_get_frameworks() = _getFrameworks(snapshot, approvers);
+  *getState.mutable_get_agents() = _getAgents(snapshot, approvers);
 
   return getState;
 }
@@ -2528,12 +2841,18 @@ Future<Response> Master::Http::slaves(
     .then(defer(
         master->self(),
         [this, slaveId, jsonp](const Owned<ObjectApprovers>& approvers)
-            -> Response {
+            -> Future<Response> {
+          reading();
+
+          Shared<StateSnapshot> snapshot = this->snapshot();
+
           IDAcceptor<SlaveID> selectSlaveId(slaveId);
 
-          return OK(
-              jsonify(SlavesWriter(master->slaves, approvers, selectSlaveId)),
-              jsonp);
+          return respond(
+              jsonp,
+              [snapshot, approvers, selectSlaveId](JSON::ObjectWriter* writer) {
+                SlavesWriter(*snapshot, approvers, selectSlaveId)(writer);
+              });
         }));
 }
 
@@ -2548,39 +2867,18 @@ Future<Response> Master::Http::getAgents(
   return ObjectApprovers::create(master->authorizer, principal, {VIEW_ROLE})
     .then(defer(
         master->self(),
-        [=](const Owned<ObjectApprovers>& approvers) -> Response {
-          mesos::master::Response response;
-          response.set_type(mesos::master::Response::GET_AGENTS);
-          *response.mutable_get_agents() = _getAgents(approvers);
-
-          return OK(
-              serialize(contentType, evolve(response)), stringify(contentType));
-    }));
-}
+        [=](const Owned<ObjectApprovers>& approvers) -> Future<Response> {
+          reading();
 
+          Shared<StateSnapshot> snapshot = this->snapshot();
 
-mesos::master::Response::GetAgents Master::Http::_getAgents(
-    const Owned<ObjectApprovers>& approvers) const
-{
-  mesos::master::Response::GetAgents getAgents;
-  foreachvalue (const Slave* slave, master->slaves.registered) {
-    mesos::master::Response::GetAgents::Agent* agent = getAgents.add_agents();
-    *agent =
-        protobuf::master::event::createAgentResponse(*slave, approvers);
-  }
-
-  foreachvalue (const SlaveInfo& slaveInfo, master->slaves.recovered) {
-    SlaveInfo* agent = getAgents.add_recovered_agents();
-    agent->CopyFrom(slaveInfo);
-    agent->clear_resources();
-    foreach (const Resource& resource, slaveInfo.resources()) {
-      if (approvers->approved<VIEW_ROLE>(resource)) {
-        agent->add_resources()->CopyFrom(resource);
-      }
-    }
-  }
-
-  return getAgents;
+          return respond(contentType, [snapshot, approvers]() {
+            mesos::master::Response response;
+            response.set_type(mesos::master::Response::GET_AGENTS);
+            *response.mutable_get_agents() = _getAgents(*snapshot, approvers);
+            return response;
+          });
+    }));
 }
 
 
@@ -2833,10 +3131,29 @@ Future<Response> Master::Http::state(
       {VIEW_ROLE, VIEW_FRAMEWORK, VIEW_TASK, VIEW_EXECUTOR, VIEW_FLAGS})
     .then(defer(
         master->self(),
-        [this, request](const Owned<ObjectApprovers>& approvers) -> Response {
-          // This lambda is consumed before the outer lambda
-          // returns, hence capture by reference is fine here.
-          auto state = [this, &approvers](JSON::ObjectWriter* writer) {
+        [this, request](const Owned<ObjectApprovers>& approvers)
+            -> Future<Response> {
+          reading();
+
+          Shared<StateSnapshot> snapshot = this->snapshot();
+
+          const Time startTime = master->startTime;
+          const MasterInfo info = master->info();
+          const string pid = master->self();
+
+          Option<string> cluster;
+          Option<string> logDir;
+          Option<string> externalLogFile;
+          Option<JSON::Object> flags;
+
+          if (approvers->approved<VIEW_FLAGS>()) {
+            cluster = master->flags.cluster;
+            logDir = master->flags.log_dir;
+            externalLogFile = master->flags.external_log_file;
+            flags = __flags().values["flags"].as<JSON::Object>();
+          }
+
+          auto state = [=](JSON::ObjectWriter* writer) {
             writer->field("version", MESOS_VERSION);
 
             if (build::GIT_SHA.isSome()) {
@@ -2854,110 +3171,103 @@ Future<Response> Master::Http::state(
             writer->field("build_date", build::DATE);
             writer->field("build_time", build::TIME);
             writer->field("build_user", build::USER);
-            writer->field("start_time", master->startTime.secs());
+            writer->field("start_time", startTime.secs());
 
-            if (master->electedTime.isSome()) {
-              writer->field("elected_time", master->electedTime->secs());
+            if (snapshot->electedTime.isSome()) {
+              writer->field("elected_time", snapshot->electedTime->secs());
             }
 
-            writer->field("id", master->info().id());
-            writer->field("pid", string(master->self()));
-            writer->field("hostname", master->info().hostname());
-            writer->field("capabilities", master->info().capabilities());
-            writer->field("activated_slaves", master->_slaves_active());
-            writer->field("deactivated_slaves", master->_slaves_inactive());
-            writer->field("unreachable_slaves", master->_slaves_unreachable());
+            double activeAgents = 0.0;
+            foreach (const Shared<AgentState>& slave, snapshot->agents) {
+              if (slave->agent.active()) {
+                activeAgents++;
+              }
+            }
 
-            if (master->info().has_domain()) {
-              writer->field("domain", master->info().domain());
+            writer->field("id", info.id());
+            writer->field("pid", pid);
+            writer->field("hostname", info.hostname());
+            writer->field("capabilities", info.capabilities());
+            writer->field("activated_slaves", activeAgents);
+            writer->field(
+                "deactivated_slaves",
+                static_cast<double>(snapshot->agents.size()) - activeAgents);
+            writer->field(
+                "unreachable_slaves",
+                static_cast<double>(snapshot->unreachableAgents));
+
+            if (info.has_domain()) {
+              writer->field("domain", info.domain());
             }
 
             // TODO(haosdent): Deprecated this in favor of `leader_info` below.
-            if (master->leader.isSome()) {
-              writer->field("leader", master->leader->pid());
+            if (snapshot->leader.isSome()) {
+              writer->field("leader", snapshot->leader->pid());
             }
 
-            if (master->leader.isSome()) {
-              writer->field("leader_info", [this](JSON::ObjectWriter* writer) {
-                json(writer, master->leader.get());
+            if (snapshot->leader.isSome()) {
+              writer->field("leader_info", [&](JSON::ObjectWriter* writer) {
+                json(writer, snapshot->leader.get());
               });
             }
 
-            if (approvers->approved<VIEW_FLAGS>()) {
-              if (master->flags.cluster.isSome()) {
-                writer->field("cluster", master->flags.cluster.get());
-              }
+            if (cluster.isSome()) {
+              writer->field("cluster", cluster.get());
+            }
 
-              if (master->flags.log_dir.isSome()) {
-                writer->field("log_dir", master->flags.log_dir.get());
-              }
+            if (logDir.isSome()) {
+              writer->field("log_dir", logDir.get());
+            }
 
-              if (master->flags.external_log_file.isSome()) {
-                writer->field("external_log_file",
-                              master->flags.external_log_file.get());
-              }
+            if (externalLogFile.isSome()) {
+              writer->field("external_log_file", externalLogFile.get());
+            }
 
-              writer->field("flags", [this](JSON::ObjectWriter* writer) {
-                  foreachvalue (const flags::Flag& flag, master->flags) {
-                    Option<string> value = flag.stringify(master->flags);
-                    if (value.isSome()) {
-                      writer->field(flag.effective_name().value, value.get());
-                    }
-                  }
-                });
+            if (flags.isSome()) {
+              writer->field("flags", flags.get());
             }
 
             // Model all of the registered slaves.
-            writer->field(
-                "slaves",
-                [this, &approvers](JSON::ArrayWriter* writer) {
-                  foreachvalue (Slave* slave, master->slaves.registered) {
-                    writer->element(SlaveWriter(*slave, approvers));
-                  }
-                });
+            writer->field("slaves", [&](JSON::ArrayWriter* writer) {
+              foreach (const Shared<AgentState>& slave, snapshot->agents) {
+                writer->element(SlaveWriter(*slave, approvers));
+              }
+            });
 
             // Model all of the recovered slaves.
-            writer->field(
-                "recovered_slaves",
-                [this](JSON::ArrayWriter* writer) {
-                  foreachvalue (
-                      const SlaveInfo& slaveInfo, master->slaves.recovered) {
-                    writer->element([&slaveInfo](JSON::ObjectWriter* writer) {
-                      json(writer, slaveInfo);
-                    });
-                  }
+            writer->field("recovered_slaves", [&](JSON::ArrayWriter* writer) {
+              foreach (const SlaveInfo& slaveInfo, snapshot->recoveredAgents) {
+                writer->element([&slaveInfo](JSON::ObjectWriter* writer) {
+                  json(writer, slaveInfo);
                 });
+              }
+            });
+
+            // Writes the registered or the completed frameworks.
+            auto frameworks = [&](bool completed, JSON::ArrayWriter* writer) {
+              foreach (const Shared<FrameworkState>& framework,
+                       snapshot->frameworks) {
+                // Skip unauthorized frameworks.
+                if (framework->completed != completed ||
+                    !approvers->approved<VIEW_FRAMEWORK>(
+                        framework->framework.framework_info())) {
+                  continue;
+                }
 
-            // Model all of the frameworks.
-            writer->field(
-                "frameworks",
-                [this, &approvers](JSON::ArrayWriter* writer) {
-                  foreachvalue (
-                      Framework* framework, master->frameworks.registered) {
-                    // Skip unauthorized frameworks.
-                    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-                      continue;
-                    }
+                writer->element(FullFrameworkWriter(approvers, *framework));
+              }
+            };
 
-                    writer->element(FullFrameworkWriter(approvers, framework));
-                  }
-                });
+            // Model all of the frameworks.
+            writer->field("frameworks", [&](JSON::ArrayWriter* writer) {
+              frameworks(false, writer);
+            });
 
             // Model all of the completed frameworks.
             writer->field(
                 "completed_frameworks",
-                [this, &approvers](JSON::ArrayWriter* writer) {
-                  foreachvalue (
-                      const Owned<Framework>& framework,
-                      master->frameworks.completed) {
-                    // Skip unauthorized frameworks.
-                    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-                      continue;
-                    }
-
-                    writer->element(
-                        FullFrameworkWriter(approvers, framework.get()));
-                  }
+                [&](JSON::ArrayWriter* writer) {
+                  frameworks(true, writer);
                 });
 
             // Orphan tasks are no longer possible. We emit an empty array
@@ -2969,7 +3279,7 @@ Future<Response> Master::Http::state(
             writer->field("unregistered_frameworks", [](JSON::ArrayWriter*) {});
           };
 
-          return OK(jsonify(state), request.url.query.get("jsonp"));
+          return respond(request.url.query.get("jsonp"), state);
         }));
 }
 
@@ -3031,27 +3341,33 @@ Future<Response> Master::Http::readFile(
 class SlaveFrameworkMapping
 {
 public:
-  SlaveFrameworkMapping(const hashmap<FrameworkID, Framework*>& frameworks)
+  SlaveFrameworkMapping(const vector<Shared<FrameworkState>>& frameworks)
   {
-    foreachpair (const FrameworkID& frameworkId,
-                 const Framework* framework,
-                 frameworks) {
-      foreachvalue (const TaskInfo& taskInfo, framework->pendingTasks) {
+    foreach (const Shared<FrameworkState>& framework, frameworks) {
+      // Only the registered frameworks are mapped.
+      if (framework->completed) {
+        continue;
+      }
+
+      const FrameworkID& frameworkId =
+        framework->framework.framework_info().id();
+
+      foreach (const TaskInfo& taskInfo, framework->pendingTasks) {
         frameworksToSlaves[frameworkId].insert(taskInfo.slave_id());
         slavesToFrameworks[taskInfo.slave_id()].insert(frameworkId);
       }
 
-      foreachvalue (const Task* task, framework->tasks) {
-        frameworksToSlaves[frameworkId].insert(task->slave_id());
-        slavesToFrameworks[task->slave_id()].insert(frameworkId);
+      foreach (const Task& task, framework->tasks) {
+        frameworksToSlaves[frameworkId].insert(task.slave_id());
+        slavesToFrameworks[task.slave_id()].insert(frameworkId);
       }
 
-      foreachvalue (const Owned<Task>& task, framework->unreachableTasks) {
-        frameworksToSlaves[frameworkId].insert(task->slave_id());
-        slavesToFrameworks[task->slave_id()].insert(frameworkId);
+      foreach (const Task& task, framework->unreachableTasks) {
+        frameworksToSlaves[frameworkId].insert(task.slave_id());
+        slavesToFrameworks[task.slave_id()].insert(frameworkId);
       }
 
-      foreach (const Owned<Task>& task, framework->completedTasks) {
+      foreach (const Shared<Task>& task, framework->completedTasks) {
         frameworksToSlaves[frameworkId].insert(task->slave_id());
         slavesToFrameworks[task->slave_id()].insert(frameworkId);
       }
@@ -3152,27 +3468,33 @@ const TaskStateSummary TaskStateSummary::EMPTY;
 class TaskStateSummaries
 {
 public:
-  TaskStateSummaries(const hashmap<FrameworkID, Framework*>& frameworks)
+  TaskStateSummaries(const vector<Shared<FrameworkState>>& frameworks)
   {
-    foreachpair (const FrameworkID& frameworkId,
-                 const Framework* framework,
-                 frameworks) {
-      foreachvalue (const TaskInfo& taskInfo, framework->pendingTasks) {
+    foreach (const Shared<FrameworkState>& framework, frameworks) {
+      // Only the registered frameworks are summarized.
+      if (framework->completed) {
+        continue;
+      }
+
+      const FrameworkID& frameworkId =
+        framework->framework.framework_info().id();
+
+      foreach (const TaskInfo& taskInfo, framework->pendingTasks) {
         frameworkTaskSummaries[frameworkId].staging++;
         slaveTaskSummaries[taskInfo.slave_id()].staging++;
       }
 
-      foreachvalue (const Task* task, framework->tasks) {
-        frameworkTaskSummaries[frameworkId].count(*task);
-        slaveTaskSummaries[task->slave_id()].count(*task);
+      foreach (const Task& task, framework->tasks) {
+        frameworkTaskSummaries[frameworkId].count(task);
+        slaveTaskSummaries[task.slave_id()].count(task);
       }
 
-      foreachvalue (const Owned<Task>& task, framework->unreachableTasks) {
-        frameworkTaskSummaries[frameworkId].count(*task);
-        slaveTaskSummaries[task->slave_id()].count(*task);
+      foreach (const Task& task, framework->unreachableTasks) {
+        frameworkTaskSummaries[frameworkId].count(task);
+        slaveTaskSummaries[task.slave_id()].count(task);
       }
 
-      foreach (const Owned<Task>& task, framework->completedTasks) {
+      foreach (const Shared<Task>& task, framework->completedTasks) {
         frameworkTaskSummaries[frameworkId].count(*task);
         slaveTaskSummaries[task->slave_id()].count(*task);
       }
@@ -3251,12 +3573,20 @@ Future<Response> Master::Http::stateSummary(
       {VIEW_ROLE, VIEW_FRAMEWORK})
     .then(defer(
         master->self(),
-        [this, request](const Owned<ObjectApprovers>& approvers) -> Response {
-          auto stateSummary = [this, &approvers](JSON::ObjectWriter* writer) {
-            writer->field("hostname", master->info().hostname());
+        [this, request](const Owned<ObjectApprovers>& approvers)
+            -> Future<Response> {
+          reading();
+
+          Shared<StateSnapshot> snapshot = this->snapshot();
+
+          const string hostname = master->info().hostname();
+          const Option<string> cluster = master->flags.cluster;
 
-            if (master->flags.cluster.isSome()) {
-              writer->field("cluster", master->flags.cluster.get());
+          auto stateSummary = [=](JSON::ObjectWriter* writer) {
+            writer->field("hostname", hostname);
+
+            if (cluster.isSome()) {
+              writer->field("cluster", cluster.get());
             }
 
             // We use the tasks in the 'Frameworks' struct to compute summaries
@@ -3268,21 +3598,19 @@ Future<Response> Master::Http::stateSummary(
             // recent completed / failed tasks.
 
             // Generate mappings from 'slave' to 'framework' and reverse.
-            SlaveFrameworkMapping slaveFrameworkMapping(
-                master->frameworks.registered);
+            SlaveFrameworkMapping slaveFrameworkMapping(snapshot->frameworks);
 
             // Generate 'TaskState' summaries for all framework and slave ids.
-            TaskStateSummaries taskStateSummaries(
-                master->frameworks.registered);
+            TaskStateSummaries taskStateSummaries(snapshot->frameworks);
 
             // Model all of the slaves.
             writer->field(
                 "slaves",
-                [this,
+                [&snapshot,
                  &slaveFrameworkMapping,
                  &taskStateSummaries,
                  &approvers](JSON::ArrayWriter* writer) {
-                  foreachvalue (Slave* slave, master->slaves.registered) {
+                  foreach (const Shared<AgentState>& slave, snapshot->agents) {
                     writer->element(
                         [&slave,
                          &slaveFrameworkMapping,
@@ -3291,9 +3619,12 @@ Future<Response> Master::Http::stateSummary(
                           SlaveWriter slaveWriter(*slave, approvers);
                           slaveWriter(writer);
 
+                          const SlaveID& slaveId =
+                            slave->agent.agent_info().id();
+
                           // Add the 'TaskState' summary for this slave.
                           const TaskStateSummary& summary =
-                              taskStateSummaries.slave(slave->id);
+                              taskStateSummaries.slave(slaveId);
 
                           // Certain per-agent status totals will always be zero
                           // (e.g., TASK_ERROR, TASK_UNREACHABLE). We report
@@ -3317,7 +3648,7 @@ Future<Response> Master::Http::stateSummary(
                           // Add the ids of all the frameworks running on this
                           // slave.
                           const hashset<FrameworkID>& frameworks =
-                              slaveFrameworkMapping.frameworks(slave->id);
+                              slaveFrameworkMapping.frameworks(slaveId);
 
                           writer->field(
                               "framework_ids",
@@ -3335,28 +3666,31 @@ Future<Response> Master::Http::stateSummary(
             // Model all of the frameworks.
             writer->field(
                 "frameworks",
-                [this,
+                [&snapshot,
                  &slaveFrameworkMapping,
                  &taskStateSummaries,
                  &approvers](JSON::ArrayWriter* writer) {
-                  foreachpair (const FrameworkID& frameworkId,
-                               Framework* framework,
-                               master->frameworks.registered) {
-                    // Skip unauthorized frameworks.
-                    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
+                  foreach (const Shared<FrameworkState>& framework,
+                           snapshot->frameworks) {
+                    const FrameworkInfo& info =
+                      framework->framework.framework_info();
+
+                    // Skip completed and unauthorized frameworks.
+                    if (framework->completed ||
+                        !approvers->approved<VIEW_FRAMEWORK>(info)) {
                       continue;
                     }
 
                     writer->element(
-                        [&frameworkId,
-                         &framework,
+                        [&framework,
+                         &info,
                          &slaveFrameworkMapping,
                          &taskStateSummaries](JSON::ObjectWriter* writer) {
-                          json(writer, Summary<Framework>(*framework));
+                          json(writer, Summary<FrameworkState>(*framework));
 
                           // Add the 'TaskState' summary for this framework.
                           const TaskStateSummary& summary =
-                              taskStateSummaries.framework(frameworkId);
+                              taskStateSummaries.framework(info.id());
 
                           // TODO(neilc): Update for TASK_GONE and
                           // TASK_GONE_BY_OPERATOR.
@@ -3376,7 +3710,7 @@ Future<Response> Master::Http::stateSummary(
                           // Add the ids of all the slaves running
                           // this framework.
                           const hashset<SlaveID>& slaves =
-                              slaveFrameworkMapping.slaves(frameworkId);
+                              slaveFrameworkMapping.slaves(info.id());
 
                           writer->field(
                               "slave_ids",
@@ -3390,7 +3724,7 @@ Future<Response> Master::Http::stateSummary(
                 });
           };
 
-          return OK(jsonify(stateSummary), request.url.query.get("jsonp"));
+          return respond(request.url.query.get("jsonp"), stateSummary);
         }));
 }
 
@@ -3986,96 +4320,87 @@ Future<Response> Master::Http::tasks(
       {VIEW_FRAMEWORK, VIEW_TASK})
     .then(defer(
         master->self(),
-        [=](const Owned<ObjectApprovers>& approvers) -> Response {
-          IDAcceptor<FrameworkID> selectFrameworkId(frameworkId);
-          IDAcceptor<TaskID> selectTaskId(taskId);
-
-          // Construct framework list with both active and completed frameworks.
-          vector<const Framework*> frameworks;
-          foreachvalue (Framework* framework, master->frameworks.registered) {
-            // Skip unauthorized frameworks or frameworks without matching
-            // framework ID.
-            if (!selectFrameworkId.accept(framework->id()) ||
-                !approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-              continue;
-            }
+        [=](const Owned<ObjectApprovers>& approvers) -> Future<Response> {
+          reading();
 
-            frameworks.push_back(framework);
-          }
+          Shared<StateSnapshot> snapshot = this->snapshot();
 
-          foreachvalue (const Owned<Framework>& framework,
-                        master->frameworks.completed) {
-            // Skip unauthorized frameworks or frameworks without matching
-            // framework ID.
-            if (!selectFrameworkId.accept(framework->id()) ||
-                !approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-             continue;
-            }
+          const Option<string> jsonp = request.url.query.get("jsonp");
 
-            frameworks.push_back(framework.get());
-          }
+          return process::async([=]() -> Response {
+            IDAcceptor<FrameworkID> selectFrameworkId(frameworkId);
+            IDAcceptor<TaskID> selectTaskId(taskId);
 
-          // Construct task list with both running,
-          // completed and unreachable tasks.
-          vector<const Task*> tasks;
-          foreach (const Framework* framework, frameworks) {
-            foreachvalue (Task* task, framework->tasks) {
-              CHECK_NOTNULL(task);
-              // Skip unauthorized tasks or tasks without matching task ID.
-              if (!selectTaskId.accept(task->task_id()) ||
-                  !approvers->approved<VIEW_TASK>(*task, framework->info)) {
+            // Construct task list with both running,
+            // completed and unreachable tasks.
+            vector<const Task*> tasks;
+            foreach (const Shared<FrameworkState>& framework,
+                     snapshot->frameworks) {
+              const FrameworkInfo& info = framework->framework.framework_info();
+
+              // Skip unauthorized frameworks or frameworks without matching
+              // framework ID.
+              if (!selectFrameworkId.accept(info.id()) ||
+                  !approvers->approved<VIEW_FRAMEWORK>(info)) {
                 continue;
               }
 
-              tasks.push_back(task);
-            }
+              foreach (const Task& task, framework->tasks) {
+                // Skip unauthorized tasks or tasks without matching task ID.
+                if (!selectTaskId.accept(task.task_id()) ||
+                    !approvers->approved<VIEW_TASK>(task, info)) {
+                  continue;
+                }
 
-            foreachvalue (
-                const Owned<Task>& task,
-                framework->unreachableTasks) {
-              // Skip unauthorized tasks or tasks without matching task ID.
-              if (!selectTaskId.accept(task->task_id()) ||
-                  !approvers->approved<VIEW_TASK>(*task, framework->info)) {
-                continue;
+                tasks.push_back(&task);
               }
 
-              tasks.push_back(task.get());
-            }
+              foreach (const Task& task, framework->unreachableTasks) {
+                // Skip unauthorized tasks or tasks without matching task ID.
+                if (!selectTaskId.accept(task.task_id()) ||
+                    !approvers->approved<VIEW_TASK>(task, info)) {
+                  continue;
+                }
 
-            foreach (const Owned<Task>& task, framework->completedTasks) {
-              // Skip unauthorized tasks or tasks without matching task ID.
-              if (!selectTaskId.accept(task->task_id()) ||
-                  !approvers->approved<VIEW_TASK>(*task, framework->info)) {
-                continue;
+                tasks.push_back(&task);
               }
 
-              tasks.push_back(task.get());
+              foreach (const Shared<Task>& task, framework->completedTasks) {
+                // Skip unauthorized tasks or tasks without matching task ID.
+                if (!selectTaskId.accept(task->task_id()) ||
+                    !approvers->approved<VIEW_TASK>(*task, info)) {
+                  continue;
+                }
+
+                tasks.push_back(task.get());
+              }
             }
-          }
 
-          // Sort tasks by task status timestamp. Default order is descending.
-          // The earliest timestamp is chosen for comparison when
-          // multiple are present.
-          if (_order == "asc") {
-            sort(tasks.begin(), tasks.end(), TaskComparator::ascending);
-          } else {
-            sort(tasks.begin(), tasks.end(), TaskComparator::descending);
-          }
+            // Sort tasks by task status timestamp. Default order is
+            // descending. The earliest timestamp is chosen for comparison
+            // when multiple are present.
+            if (_order == "asc") {
+              sort(tasks.begin(), tasks.end(), TaskComparator::ascending);
+            } else {
+              sort(tasks.begin(), tasks.end(), TaskComparator::descending);
+            }
 
-          auto tasksWriter =
-            [&tasks, limit, offset](JSON::ObjectWriter* writer) {
-              writer->field(
-                  "tasks",
-                  [&tasks, limit, offset](JSON::ArrayWriter* writer) {
-                    // Collect 'limit' number of tasks starting from 'offset'.
-                    size_t end = std::min(offset + limit, tasks.size());
-                    for (size_t i = offset; i < end; i++) {
-                      writer->element(*tasks[i]);
-                    }
-                  });
-          };
+            auto tasksWriter =
+              [&tasks, limit, offset](JSON::ObjectWriter* writer) {
+                writer->field(
+                    "tasks",
+                    [&tasks, limit, offset](JSON::ArrayWriter* writer) {
+                      // Collect 'limit' number of tasks starting from
+                      // 'offset'.
+                      size_t end = std::min(offset + limit, tasks.size());
+                      for (size_t i = offset; i < end; i++) {
+                        writer->element(*tasks[i]);
+                      }
+                    });
+            };
 
-          return OK(jsonify(tasksWriter), request.url.query.get("jsonp"));
+            return OK(jsonify(tasksWriter), jsonp);
+          });
   }));
 }
 
@@ -4093,93 +4418,21 @@ Future<Response> Master::Http::getTasks(
       {VIEW_FRAMEWORK, VIEW_TASK})
     .then(defer(
         master->self(),
-        [=](const Owned<ObjectApprovers>& approvers) -> Response {
-          mesos::master::Response response;
-          response.set_type(mesos::master::Response::GET_TASKS);
+        [=](const Owned<ObjectApprovers>& approvers) -> Future<Response> {
+          reading();
 
-          *response.mutable_get_tasks() = _getTasks(approvers);
+          Shared<StateSnapshot> snapshot = this->snapshot();
 
-          return OK(
-              serialize(contentType, evolve(response)), stringify(contentType));
+          return respond(contentType, [snapshot, approvers]() {
+            mesos::master::Response response;
+            response.set_type(mesos::master::Response::GET_TASKS);
+            *response.mutable_get_tasks() = _getTasks(*snapshot, approvers);
+            return response;
+          });
   }));
 }
 
 
-mesos::master::Response::GetTasks Master::Http::_getTasks(
-    const Owned<ObjectApprovers>& approvers) const
-{
-  // Construct framework list with both active and completed frameworks.
-  vector<const Framework*> frameworks;
-  foreachvalue (Framework* framework, master->frameworks.registered) {
-    // Skip unauthorized frameworks.
-    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-      continue;
-    }
-
-    frameworks.push_back(framework);
-  }
-
-  foreachvalue (const Owned<Framework>& framework,
-                master->frameworks.completed) {
-    // Skip unauthorized frameworks.
-    if (!approvers->approved<VIEW_FRAMEWORK>(framework->info)) {
-      continue;
-    }
-
-    frameworks.push_back(framework.get());
-  }
-
-  mesos::master::Response::GetTasks getTasks;
-
-  vector<const Task*> tasks;
-  foreach (const Framework* framework, frameworks) {
-    // Pending tasks.
-    foreachvalue (const TaskInfo& taskInfo, framework->pendingTasks) {
-      // Skip unauthorized tasks.
-      if (!approvers->approved<VIEW_TASK>(taskInfo, framework->info)) {
-        continue;
-      }
-
-      *getTasks.add_pending_tasks() =
-        protobuf::createTask(taskInfo, TASK_STAGING, framework->id());
-    }
-
-    // Active tasks.
-    foreachvalue (Task* task, framework->tasks) {
-      CHECK_NOTNULL(task);
-      // Skip unauthorized tasks.
-      if (!approvers->approved<VIEW_TASK>(*task, framework->info)) {
-        continue;
-      }
-
-      getTasks.add_tasks()->CopyFrom(*task);
-    }
-
-    // Unreachable tasks.
-    foreachvalue (const Owned<Task>& task, framework->unreachableTasks) {
-      // Skip unauthorized tasks.
-      if (!approvers->approved<VIEW_TASK>(*task, framework->info)) {
-        continue;
-      }
-
-      getTasks.add_unreachable_tasks()->CopyFrom(*task);
-    }
-
-    // Completed tasks.
-    foreach (const Owned<Task>& task, framework->completedTasks) {
-      // Skip unauthorized tasks.
-      if (!approvers->approved<VIEW_TASK>(*task, framework->info)) {
-        continue;
-      }
-
-      getTasks.add_completed_tasks()->CopyFrom(*task);
-    }
-  }
-
-  return getTasks;
-}
-
-
 // /master/maintenance/schedule endpoint help.
 string Master::Http::MAINTENANCE_SCHEDULE_HELP()
 {
@@ -348,6 +348,16 @@ int main(int argc, char** argv)
   Log* log = nullptr;
 #endif // __WINDOWS__
 
+  // The registry deltas are stored in variables of their own, i.e.,
+  // storing them does not check the version of the registry. Only the
+  // replicated log fences off the stores of a deposed leading master.
+  if (flags.registry_max_deltas > 0 &&
+      flags.registry != "replicated_log" &&
+      flags.registry != "log_storage") {
+    EXIT(EXIT_FAILURE)
+      << "--registry_max_deltas requires --registry=replicated_log";
+  }
+
   if (flags.registry == "in_memory") {
     storage = new InMemoryStorage();
 #ifndef __WINDOWS__
@@ -43,6 +43,7 @@
 
 #include <mesos/scheduler/scheduler.hpp>
 
+#include <process/async.hpp>
 #include <process/check.hpp>
 #include <process/collect.hpp>
 #include <process/defer.hpp>
@@ -804,15 +805,24 @@ void Master::initialize()
     }
   }
 
+  mesos::allocator::Options options;
+
+  options.allocationInterval = flags.allocation_interval;
+  options.fairnessExcludeResourceNames =
+    flags.fair_sharing_excluded_resource_names;
+  options.filterGpuResources = flags.filter_gpu_resources;
+  options.domain = flags.domain;
+  options.minAllocatableResources = CHECK_NOTERROR(minAllocatableResources);
+  options.allocationShards = flags.allocation_shards;
+  options.offerBatchSize = flags.offer_batch_size;
+  options.validateQuotaHeadroom = flags.validate_quota_headroom;
+  options.authenticationRealm = READONLY_HTTP_AUTHENTICATION_REALM;
+
   // Initialize the allocator.
   allocator->initialize(
-      flags.allocation_interval,
+      options,
       defer(self(), &Master::offer, lambda::_1, lambda::_2),
-      defer(self(), &Master::inverseOffer, lambda::_1, lambda::_2),
-      flags.fair_sharing_excluded_resource_names,
-      flags.filter_gpu_resources,
-      flags.domain,
-      CHECK_NOTERROR(minAllocatableResources));
+      defer(self(), &Master::inverseOffer, lambda::_1, lambda::_2));
 
   // Parse the whitelist. Passing Allocator::updateWhitelist()
   // callback is safe because we shut down the whitelistWatcher in
@@ -833,6 +843,10 @@ void Master::initialize()
 
   startTime = Clock::now();
 
+  // Publish the start time for the uptime, the other gauges get
+  // published once the master serves its first events.
+  metrics->publisher.publish();
+
   install<scheduler::Call>(&Master::receive);
 
   // Install handler functions for certain messages.
@@ -881,8 +895,11 @@ void Master::initialize()
   install<RegisterSlaveMessage>(
       &Master::registerSlave);
 
-  install<ReregisterSlaveMessage>(
-      &Master::reregisterSlave);
+  // Re-registration messages get decoded off the master's actor, see
+  // `receiveReregisterSlave`.
+  install(
+      ReregisterSlaveMessage().GetTypeName(),
+      &Master::receiveReregisterSlave);
 
   install<UnregisterSlaveMessage>(
       &Master::unregisterSlave,
@@ -1234,6 +1251,7 @@ void Master::finalize()
     // Remove pending tasks from the framework. Don't bother
     // recovering the resources in the allocator.
     framework->pendingTasks.clear();
+    framework->changed();
 
     // No tasks/executors/offers should remain since the slaves
     // have been removed.
@@ -2765,6 +2783,7 @@ void Master::_subscribe(
 
     updateFramework(framework, frameworkInfo, suppressedRoles);
     framework->reregisteredTime = Clock::now();
+    framework->changed();
 
     // Always failover the old framework connection. See MESOS-4712 for details.
     failoverFramework(framework, http);
@@ -3109,6 +3128,7 @@ void Master::_subscribe(
     updateFramework(framework, frameworkInfo, suppressedRoles);
 
     framework->reregisteredTime = Clock::now();
+    framework->changed();
 
     if (force) {
       // TODO(vinod): Now that the scheduler pid is unique we don't
@@ -3163,6 +3183,7 @@ void Master::_subscribe(
       // the allocator has the correct view of the framework's share.
       if (!framework->active()) {
         framework->state = Framework::State::ACTIVE;
+        framework->changed();
         allocator->activateFramework(framework->id());
       }
 
@@ -3280,6 +3301,7 @@ void Master::disconnect(Framework* framework)
   LOG(INFO) << "Disconnecting framework " << *framework;
 
   framework->state = Framework::State::DISCONNECTED;
+  framework->changed();
 
   if (framework->pid.isSome()) {
     // Remove the framework from authenticated. This is safe because
@@ -3303,6 +3325,7 @@ void Master::deactivate(Framework* framework, bool rescind)
   LOG(INFO) << "Deactivating framework " << *framework;
 
   framework->state = Framework::State::INACTIVE;
+  framework->changed();
 
   // Tell the allocator to stop allocating resources to this framework.
   allocator->deactivateFramework(framework->id());
@@ -3359,6 +3382,7 @@ void Master::deactivate(Slave* slave)
   LOG(INFO) << "Deactivating agent " << *slave;
 
   slave->active = false;
+  slave->changed();
 
   allocator->deactivateSlave(slave->id);
 
@@ -4521,6 +4545,7 @@ void Master::accept(
           // a TASK_ERROR after a TASK_KILLED (see _accept())!
           if (!framework->pendingTasks.contains(task.task_id())) {
             framework->pendingTasks[task.task_id()] = task;
+            framework->changed();
           }
 
           // Add to the slave's list of pending tasks.
@@ -4710,6 +4735,7 @@ void Master::_accept(
       foreach (const TaskInfo& task, tasks) {
         // Remove the task from being pending.
         framework->pendingTasks.erase(task.task_id());
+        framework->changed();
         if (slave != nullptr) {
           slave->pendingTasks[framework->id()].erase(task.task_id());
           if (slave->pendingTasks[framework->id()].empty()) {
@@ -5290,6 +5316,7 @@ void Master::_accept(
 
           bool pending = framework->pendingTasks.contains(task.task_id());
           framework->pendingTasks.erase(task.task_id());
+          framework->changed();
           slave->pendingTasks[framework->id()].erase(task.task_id());
           if (slave->pendingTasks[framework->id()].empty()) {
             slave->pendingTasks.erase(framework->id());
@@ -5486,6 +5513,7 @@ void Master::_accept(
         foreach (const TaskInfo& task, taskGroup.tasks()) {
           bool pending = framework->pendingTasks.contains(task.task_id());
           framework->pendingTasks.erase(task.task_id());
+          framework->changed();
           slave->pendingTasks[framework->id()].erase(task.task_id());
           if (slave->pendingTasks[framework->id()].empty()) {
             slave->pendingTasks.erase(framework->id());
@@ -6052,6 +6080,7 @@ void Master::kill(Framework* framework, const scheduler::Call::Kill& kill)
   if (framework->pendingTasks.contains(taskId)) {
     // Remove from pending tasks.
     framework->pendingTasks.erase(taskId);
+    framework->changed();
 
     if (slaveId.isSome()) {
       Slave* slave = slaves.registered.get(slaveId.get());
@@ -6894,12 +6923,159 @@ void Master::__registerSlave(
 }
 
 
+// Decodes the re-registration message of an agent and prepares it for
+// `Master::reregisterSlave`, which only depends on the message itself.
+// The messages of agents with many tasks are large, so this is done in
+// parallel to the master's actor (see `Master::receiveReregisterSlave`).
+static Try<Owned<ReregisterSlaveMessage>> prepareReregistration(
+    const string& data)
+{
+  Owned<ReregisterSlaveMessage> message(new ReregisterSlaveMessage());
+  message->ParseFromString(data);
+
+  if (!message->IsInitialized()) {
+    return Error(
+        "Initialization errors: " + message->InitializationErrorString());
+  }
+
+  Option<Error> error =
+    validation::master::message::reregisterSlave(*message);
+
+  if (error.isSome()) {
+    return error.get();
+  }
+
+  // Update all resources passed by the agent to `POST_RESERVATION_REFINEMENT`
+  // format. We do this as early as possible so that we only use a single
+  // format inside master, and downgrade again if necessary when they leave the
+  // master (e.g. when writing to the registry).
+  upgradeResources(message.get());
+
+  // For agents without the MULTI_ROLE capability,
+  // we need to inject the allocation role inside
+  // the task and executor resources;
+  auto injectAllocationInfo = [](
+      RepeatedPtrField<Resource>* resources,
+      const FrameworkInfo& frameworkInfo) -> Option<Error>
+  {
+    set<string> roles = protobuf::framework::getRoles(frameworkInfo);
+
+    foreach (Resource& resource, *resources) {
+      if (!resource.has_allocation_info()) {
+        if (roles.size() != 1) {
+          return Error(
+              "Missing 'Resource.AllocationInfo' for resources allocated"
+              " to MULTI_ROLE framework '" + frameworkInfo.name() + "'");
+        }
+
+        resource.mutable_allocation_info()->set_role(*roles.begin());
+      }
+    }
+
+    return None();
+  };
+
+  // Adjust the agent's task and executor infos to ensure
+  // compatibility with old agents without certain capabilities.
+  protobuf::slave::Capabilities slaveCapabilities(
+      google::protobuf::convert(message->agent_capabilities()));
+
+  // If the agent is not multi-role capable, inject allocation info.
+  // NOTE: The validation above ensures that the frameworks of the tasks
+  // and executors are known.
+  if (!slaveCapabilities.multiRole) {
+    hashmap<FrameworkID, reference_wrapper<const FrameworkInfo>> frameworks;
+
+    foreach (const FrameworkInfo& framework, message->frameworks()) {
+      frameworks.emplace(framework.id(), framework);
+    }
+
+    foreach (Task& task, *message->mutable_tasks()) {
+      error = injectAllocationInfo(
+          task.mutable_resources(),
+          frameworks.at(task.framework_id()));
+
+      if (error.isSome()) {
+        return error.get();
+      }
+    }
+
+    foreach (ExecutorInfo& executor, *message->mutable_executor_infos()) {
+      error = injectAllocationInfo(
+          executor.mutable_resources(),
+          frameworks.at(executor.framework_id()));
+
+      if (error.isSome()) {
+        return error.get();
+      }
+    }
+  }
+
+  return message;
+}
+
+
+void Master::receiveReregisterSlave(const UPID& from, const string& data)
+{
+  ++metrics->messages_reregister_slave;
+
+  // Only authenticated agents get to use the resources for preparing
+  // re-registrations (see also the checks in `reregisterSlave`, which
+  // are needed in case the agent reauthenticates in the meantime).
+  if (authenticating.contains(from)) {
+    LOG(INFO) << "Queuing up re-registration request from " << from
+              << " because authentication is still in progress";
+
+    authenticating[from]
+      .onReady(defer(self(), &Self::receiveReregisterSlave, from, data));
+    return;
+  }
+
+  if (flags.authenticate_agents && !authenticated.contains(from)) {
+    LOG(WARNING) << "Refusing re-registration of agent at " << from
+                 << " because it is not authenticated";
+    return;
+  }
+
+  // Admission control: the agents retry re-registering with backoff, so
+  // we drop the messages rather than queueing them up in the master.
+  const size_t inProgress = slaves.preparing + slaves.reregistering.size();
+
+  if (flags.max_agent_reregistrations.isSome() &&
+      inProgress >= flags.max_agent_reregistrations.get()) {
+    VLOG(1) << "Dropping re-registration of agent at " << from
+            << " because " << inProgress << " re-registrations are"
+            << " already in progress";
+
+    ++metrics->dropped_messages;
+    return;
+  }
+
+  ++slaves.preparing;
+
+  process::async(&prepareReregistration, data)
+    .onAny(defer(self(), [this, from](
+        const Future<Try<Owned<ReregisterSlaveMessage>>>& message) {
+      CHECK_READY(message);
+
+      --slaves.preparing;
+
+      if (message->isError()) {
+        LOG(WARNING) << "Dropping re-registration of agent at " << from
+                     << " because it sent an invalid re-registration: "
+                     << message->error();
+        return;
+      }
+
+      reregisterSlave(from, std::move(*message->get()));
+    }));
+}
+
+
 void Master::reregisterSlave(
     const UPID& from,
     ReregisterSlaveMessage&& reregisterSlaveMessage)
 {
-  ++metrics->messages_reregister_slave;
-
   if (authenticating.contains(from)) {
     LOG(INFO) << "Queuing up re-registration request from " << from
               << " because authentication is still in progress";
@@ -6955,17 +7131,6 @@ void Master::reregisterSlave(
     return;
   }
 
-  Option<Error> error =
-    validation::master::message::reregisterSlave(reregisterSlaveMessage);
-
-  if (error.isSome()) {
-    LOG(WARNING) << "Dropping re-registration of agent at " << from
-                 << " because it sent an invalid re-registration: "
-                 << error->message;
-
-    return;
-  }
-
   LOG(INFO) << "Received reregister agent message from agent "
             << slaveInfo.id() << " at " << from << " ("
             << slaveInfo.hostname() << ")";
@@ -6974,12 +7139,6 @@ void Master::reregisterSlave(
   // and `erase()` in its destructor, to avoid the manual bookkeeping.
   slaves.reregistering.insert(slaveInfo.id());
 
-  // Update all resources passed by the agent to `POST_RESERVATION_REFINEMENT`
-  // format. We do this as early as possible so that we only use a single
-  // format inside master, and downgrade again if necessary when they leave the
-  // master (e.g. when writing to the registry).
-  upgradeResources(&reregisterSlaveMessage);
-
   // Note that the principal may be empty if authentication is not
   // required. Also it is passed along because it may be removed from
   // `authenticated` while the authorization is pending.
@@ -7270,62 +7429,12 @@ void Master::__reregisterSlave(
   VLOG(1) << "Re-admitted agent " << slaveInfo.id() << " at " << pid
           << " (" << slaveInfo.hostname() << ")";
 
-  // For agents without the MULTI_ROLE capability,
-  // we need to inject the allocation role inside
-  // the task and executor resources;
-  auto injectAllocationInfo = [](
-      RepeatedPtrField<Resource>* resources,
-      const FrameworkInfo& frameworkInfo)
-  {
-    set<string> roles = protobuf::framework::getRoles(frameworkInfo);
-
-    foreach (Resource& resource, *resources) {
-      if (!resource.has_allocation_info()) {
-        if (roles.size() != 1) {
-          LOG(FATAL) << "Missing 'Resource.AllocationInfo' for resources"
-                     << " allocated to MULTI_ROLE framework"
-                     << " '" << frameworkInfo.name() << "'";
-        }
-
-        resource.mutable_allocation_info()->set_role(*roles.begin());
-      }
-    }
-  };
-
+  // NOTE: The allocation info of the tasks and executors of agents
+  // without the MULTI_ROLE capability was injected when the message was
+  // prepared, see `prepareReregistration`.
   vector<SlaveInfo::Capability> agentCapabilities =
     google::protobuf::convert(reregisterSlaveMessage.agent_capabilities());
 
-  // Adjust the agent's task and executor infos to ensure
-  // compatibility with old agents without certain capabilities.
-  protobuf::slave::Capabilities slaveCapabilities(agentCapabilities);
-
-  // If the agent is not multi-role capable, inject allocation info.
-  if (!slaveCapabilities.multiRole) {
-    hashmap<FrameworkID, reference_wrapper<const FrameworkInfo>> frameworks;
-
-    foreach (const FrameworkInfo& framework,
-             reregisterSlaveMessage.frameworks()) {
-      frameworks.emplace(framework.id(), framework);
-    }
-
-    foreach (Task& task, *reregisterSlaveMessage.mutable_tasks()) {
-      CHECK(frameworks.contains(task.framework_id()));
-
-      injectAllocationInfo(
-          task.mutable_resources(),
-          frameworks.at(task.framework_id()));
-    }
-
-    foreach (ExecutorInfo& executor,
-             *reregisterSlaveMessage.mutable_executor_infos()) {
-      CHECK(frameworks.contains(executor.framework_id()));
-
-      injectAllocationInfo(
-          executor.mutable_resources(),
-          frameworks.at(executor.framework_id()));
-    }
-  }
-
   MachineID machineId;
   machineId.set_hostname(slaveInfo.hostname());
   machineId.set_ip(stringify(pid.address.ip));
@@ -7359,6 +7468,7 @@ void Master::__reregisterSlave(
       Framework* framework = getFramework(frameworkId);
       if (framework != nullptr) {
         framework->unreachableTasks.erase(task.task_id());
+        framework->changed();
       }
 
       const string message = slaves.unreachable.contains(slaveInfo.id())
@@ -7408,6 +7518,8 @@ void Master::__reregisterSlave(
                  slaves.unreachableTasks.at(slaveInfo.id()).get(frameworkId)) {
           framework->unreachableTasks.erase(taskId);
         }
+
+        framework->changed();
       }
     }
   }
@@ -7440,6 +7552,7 @@ void Master::__reregisterSlave(
       std::move(recoveredTasks));
 
   slave->reregisteredTime = Clock::now();
+  slave->changed();
 
   ++metrics->slave_reregistrations;
 
@@ -7557,6 +7670,7 @@ void Master::___reregisterSlave(
   // ignore duplicate exited events for disconnected slaves.
   // See: https://issues.apache.org/jira/browse/MESOS-675
   slave->pid = pid;
+  slave->changed();
   link(slave->pid);
 
   const string& version = reregisterSlaveMessage.version();
@@ -7601,6 +7715,7 @@ void Master::___reregisterSlave(
   }
 
   slave->reregisteredTime = Clock::now();
+  slave->changed();
 
   allocator->updateSlave(
     slave->id,
@@ -7631,6 +7746,7 @@ void Master::___reregisterSlave(
     dispatch(slave->observer, &SlaveObserver::reconnect);
 
     slave->active = true;
+    slave->changed();
     allocator->activateSlave(slave->id);
   }
 
@@ -7996,6 +8112,7 @@ void Master::updateSlave(UpdateSlaveMessage&& message)
   if (hasOversubscribed) {
     slave->totalResources -= slave->totalResources.revocable();
     slave->totalResources += message.oversubscribed_resources();
+    slave->changed();
 
     // TODO(bbannier): Track oversubscribed resources for resource
     // providers as well.
@@ -8112,6 +8229,7 @@ void Master::updateSlave(UpdateSlaveMessage&& message)
       }
 
       slave->totalResources += resourceProvider.total_resources();
+      slave->changed();
 
       allocator->addResourceProvider(
           slaveId, resourceProvider.total_resources(), usedByOperations);
@@ -8201,6 +8319,7 @@ void Master::updateSlave(UpdateSlaveMessage&& message)
       slave->totalResources += resourceProvider.total_resources();
 
       oldProvider.totalResources = resourceProvider.total_resources();
+      slave->changed();
 
       // Reconcile resource versions.
       oldProvider.resourceVersion = resourceProvider.resource_version_uuid();
@@ -8451,6 +8570,7 @@ void Master::forward(
     if (update.has_uuid()) {
       task->set_status_update_state(update.status().state());
       task->set_status_update_uuid(update.status().uuid());
+      framework->changed();
     }
   }
 
@@ -9306,10 +9426,21 @@ void Master::offer(
   // We keep track of the offer IDs so that we can log them.
   vector<OfferID> offerIds;
 
+  // When offers are pipelined, we create at most `--offer_batch_size`
+  // offers at a time and dispatch the remaining resources back to
+  // ourselves, so that other events get processed in between.
+  hashmap<string, hashmap<SlaveID, Resources>> remaining;
+
   foreachkey (const string& role, resources) {
     foreachpair (const SlaveID& slaveId,
                  const Resources& offered,
                  resources.at(role)) {
+      if (flags.offer_batch_size.isSome() &&
+          offerIds.size() >= flags.offer_batch_size.get()) {
+        remaining[role][slaveId] = offered;
+        continue;
+      }
+
       Slave* slave = slaves.registered.get(slaveId);
 
       if (slave == nullptr) {
@@ -9461,13 +9592,16 @@ void Master::offer(
     }
   }
 
-  if (message.offers().size() == 0) {
-    return;
-  }
+  if (message.offers().size() > 0) {
+    LOG(INFO) << "Sending offers " << offerIds
+              << " to framework " << *framework;
 
-  LOG(INFO) << "Sending offers " << offerIds << " to framework " << *framework;
+    framework->send(message);
+  }
 
-  framework->send(message);
+  if (!remaining.empty()) {
+    dispatch(self(), &Master::offer, frameworkId, remaining);
+  }
 }
 
 
@@ -9998,6 +10132,7 @@ Try<Nothing> Master::activateRecoveredFramework(
   // persisted across master failover.
   framework->registeredTime = Clock::now();
   framework->reregisteredTime = Clock::now();
+  framework->changed();
 
   // Update the framework's connection state.
   if (pid.isSome()) {
@@ -10011,6 +10146,7 @@ Try<Nothing> Master::activateRecoveredFramework(
 
   // Activate the framework.
   framework->state = Framework::State::ACTIVE;
+  framework->changed();
   allocator->activateFramework(framework->id());
 
   // Export framework metrics if a principal is specified in `FrameworkInfo`.
@@ -10161,6 +10297,7 @@ void Master::_failoverFramework(Framework* framework)
   // the allocator has the correct view of the framework's share.
   if (!framework->active()) {
     framework->state = Framework::State::ACTIVE;
+    framework->changed();
     allocator->activateFramework(framework->id());
   }
 
@@ -10214,6 +10351,7 @@ void Master::removeFramework(Framework* framework)
 
   // Remove the pending tasks from the framework.
   framework->pendingTasks.clear();
+  framework->changed();
 
   // Remove pointers to the framework's tasks in slaves and mark those
   // tasks as completed.
@@ -10293,6 +10431,7 @@ void Master::removeFramework(Framework* framework)
     // Move task from unreachable map to completed map.
     framework->addCompletedTask(std::move(*task));
     framework->unreachableTasks.erase(taskId);
+    framework->changed();
   }
 
   // Remove the framework's executors for correct resource accounting.
@@ -10322,6 +10461,7 @@ void Master::removeFramework(Framework* framework)
   }
 
   framework->unregisteredTime = Clock::now();
+  framework->changed();
 
   foreach (const string& role, framework->roles) {
     framework->untrackUnderRole(role);
@@ -10899,12 +11039,16 @@ void Master::updateTask(Task* task, const StatusUpdate& update)
   // MESOS-1746.
   task->mutable_statuses(task->statuses_size() - 1)->clear_data();
 
+  Framework* framework = getFramework(task->framework_id());
+  if (framework != nullptr) {
+    framework->changed();
+  }
+
   if (sendSubscribersUpdate && !subscribers.subscribed.empty()) {
     // If the framework has been removed, the task would have already
     // transitioned to `TASK_KILLED` by `removeFramework()`, thus
     // `sendSubscribersUpdate` shouldn't have been set to true.
     // TODO(chhsiao): This may be changed after MESOS-6608 is resolved.
-    Framework* framework = getFramework(task->framework_id());
     CHECK_NOTNULL(framework);
 
     subscribers.send(
@@ -10934,7 +11078,6 @@ void Master::updateTask(Task* task, const StatusUpdate& update)
 
     slave->recoverResources(task);
 
-    Framework* framework = getFramework(task->framework_id());
     if (framework != nullptr) {
       framework->recoverResources(task);
     }
@@ -11875,8 +12018,7 @@ void Master::Subscribers::send(
           << " event";
 
   // Create a single copy of the event for all subscribers to share.
-  Shared<mesos::master::Event> sharedEvent(
-      new mesos::master::Event(std::move(event)));
+  Shared<Event> sharedEvent(new Event(std::move(event)));
 
   // Create a single copy of `FrameworkInfo` and `Task` for all
   // subscribers to share.
@@ -11886,10 +12028,27 @@ void Master::Subscribers::send(
   Shared<Task> sharedTask(task.isSome() ? new Task(task.get()) : nullptr);
 
   foreachvalue (const Owned<Subscriber>& subscriber, subscribed) {
-    ObjectApprovers::create(
-        master->authorizer,
-        subscriber->principal,
-        {VIEW_ROLE, VIEW_FRAMEWORK, VIEW_TASK, VIEW_EXECUTOR})
+    if (!subscriber->accepts(sharedEvent->event, sharedFrameworkInfo)) {
+      continue;
+    }
+
+    // Recreate the approvers if they are outdated or could not be
+    // created. We only replace approvers which are no longer pending,
+    // since the events of pending approvers would otherwise be sent
+    // after the events of the new approvers.
+    if ((subscriber->approvers.isReady() &&
+         Clock::now() - subscriber->approved >= SUBSCRIBER_APPROVERS_TTL) ||
+        subscriber->approvers.isFailed() ||
+        subscriber->approvers.isDiscarded()) {
+      subscriber->approvers = ObjectApprovers::create(
+          master->authorizer,
+          subscriber->principal,
+          {VIEW_ROLE, VIEW_FRAMEWORK, VIEW_TASK, VIEW_EXECUTOR});
+
+      subscriber->approved = Clock::now();
+    }
+
+    subscriber->approvers
       .then(defer(
           master->self(),
           [=](const Owned<ObjectApprovers>& approvers) {
@@ -11905,12 +12064,100 @@ void Master::Subscribers::send(
 }
 
 
+const string& Master::Subscribers::Event::encode(ContentType contentType) const
+{
+  if (!encodings.count(contentType)) {
+    encodings[contentType] =
+      HttpConnection::encode<mesos::master::Event, v1::master::Event>(
+          contentType, event);
+  }
+
+  return encodings.at(contentType);
+}
+
+
+bool Master::Subscribers::Subscriber::accepts(
+    const mesos::master::Event& event,
+    const Shared<FrameworkInfo>& frameworkInfo) const
+{
+  if (!eventTypes.empty() && eventTypes.count(event.type()) == 0) {
+    return false;
+  }
+
+  // The framework of the event, if any.
+  const FrameworkInfo* framework = nullptr;
+
+  switch (event.type()) {
+    case mesos::master::Event::TASK_ADDED:
+    case mesos::master::Event::TASK_UPDATED:
+      framework = CHECK_NOTNULL(frameworkInfo.get());
+      break;
+    case mesos::master::Event::FRAMEWORK_ADDED:
+      framework = &event.framework_added().framework().framework_info();
+      break;
+    case mesos::master::Event::FRAMEWORK_UPDATED:
+      framework = &event.framework_updated().framework().framework_info();
+      break;
+    case mesos::master::Event::FRAMEWORK_REMOVED:
+      framework = &event.framework_removed().framework_info();
+      break;
+    case mesos::master::Event::AGENT_ADDED:
+    case mesos::master::Event::AGENT_REMOVED:
+    case mesos::master::Event::SUBSCRIBED:
+    case mesos::master::Event::HEARTBEAT:
+    case mesos::master::Event::UNKNOWN:
+      break;
+  }
+
+  if (framework == nullptr) {
+    return true;
+  }
+
+  if (!frameworkIds.empty() && !frameworkIds.contains(framework->id())) {
+    return false;
+  }
+
+  if (!roles.empty()) {
+    foreach (const string& role, protobuf::framework::getRoles(*framework)) {
+      if (roles.contains(role)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+
+// Returns whether the approvers permit to view the roles of all of
+// the given resources, i.e., whether an event with these resources
+// can be sent without filtering them.
+static bool approvedAll(
+    const Owned<ObjectApprovers>& approvers,
+    const google::protobuf::RepeatedPtrField<Resource>& resources)
+{
+  foreach (const Resource& resource, resources) {
+    if (!approvers->approved<VIEW_ROLE>(resource)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
 void Master::Subscribers::Subscriber::send(
-    const Shared<mesos::master::Event>& event,
+    const Shared<Event>& sharedEvent,
     const Owned<ObjectApprovers>& approvers,
     const Shared<FrameworkInfo>& frameworkInfo,
     const Shared<Task>& task)
 {
+  // The event is only copied if it needs to be filtered for this
+  // subscriber, otherwise the shared encoding gets sent.
+  const mesos::master::Event* event = &sharedEvent->event;
+
   switch (event->type()) {
     case mesos::master::Event::TASK_ADDED: {
       CHECK_NOTNULL(frameworkInfo.get());
@@ -11918,7 +12165,7 @@ void Master::Subscribers::Subscriber::send(
       if (approvers->approved<VIEW_TASK>(
               event->task_added().task(), *frameworkInfo) &&
           approvers->approved<VIEW_FRAMEWORK>(*frameworkInfo)) {
-        http.send<mesos::master::Event, v1::master::Event>(*event);
+        http.write(sharedEvent->encode(http.contentType));
       }
       break;
     }
@@ -11928,13 +12175,23 @@ void Master::Subscribers::Subscriber::send(
 
       if (approvers->approved<VIEW_TASK>(*task, *frameworkInfo) &&
           approvers->approved<VIEW_FRAMEWORK>(*frameworkInfo)) {
-        http.send<mesos::master::Event, v1::master::Event>(*event);
+        http.write(sharedEvent->encode(http.contentType));
       }
       break;
     }
     case mesos::master::Event::FRAMEWORK_ADDED: {
       if (approvers->approved<VIEW_FRAMEWORK>(
               event->framework_added().framework().framework_info())) {
+        if (approvedAll(
+                approvers,
+                event->framework_added().framework().allocated_resources()) &&
+            approvedAll(
+                approvers,
+                event->framework_added().framework().offered_resources())) {
+          http.write(sharedEvent->encode(http.contentType));
+          break;
+        }
+
         mesos::master::Event event_(*event);
         event_.mutable_framework_added()->mutable_framework()->
             mutable_allocated_resources()->Clear();
@@ -11966,6 +12223,16 @@ void Master::Subscribers::Subscriber::send(
     case mesos::master::Event::FRAMEWORK_UPDATED: {
       if (approvers->approved<VIEW_FRAMEWORK>(
               event->framework_updated().framework().framework_info())) {
+        if (approvedAll(
+                approvers,
+                event->framework_updated().framework().allocated_resources()) &&
+            approvedAll(
+                approvers,
+                event->framework_updated().framework().offered_resources())) {
+          http.write(sharedEvent->encode(http.contentType));
+          break;
+        }
+
         mesos::master::Event event_(*event);
         event_.mutable_framework_updated()->mutable_framework()->
           mutable_allocated_resources()->Clear();
@@ -11997,11 +12264,17 @@ void Master::Subscribers::Subscriber::send(
     case mesos::master::Event::FRAMEWORK_REMOVED: {
       if (approvers->approved<VIEW_FRAMEWORK>(
               event->framework_removed().framework_info())) {
-        http.send<mesos::master::Event, v1::master::Event>(*event);
+        http.write(sharedEvent->encode(http.contentType));
       }
       break;
     }
     case mesos::master::Event::AGENT_ADDED: {
+      if (approvedAll(
+              approvers, event->agent_added().agent().total_resources())) {
+        http.write(sharedEvent->encode(http.contentType));
+        break;
+      }
+
       mesos::master::Event event_(*event);
       event_.mutable_agent_added()->mutable_agent()->
         mutable_total_resources()->Clear();
@@ -12022,7 +12295,7 @@ void Master::Subscribers::Subscriber::send(
     case mesos::master::Event::SUBSCRIBED:
     case mesos::master::Event::HEARTBEAT:
     case mesos::master::Event::UNKNOWN:
-      http.send<mesos::master::Event, v1::master::Event>(*event);
+      http.write(sharedEvent->encode(http.contentType));
       break;
   }
 }
@@ -12044,7 +12317,9 @@ void Master::exited(const id::UUID& id)
 
 void Master::subscribe(
     const HttpConnection& http,
-    const Option<Principal>& principal)
+    const Option<Principal>& principal,
+    const mesos::master::Call::Subscribe& subscribe,
+    const Owned<ObjectApprovers>& approvers)
 {
   LOG(INFO) << "Added subscriber " << http.streamId
             << " to the list of active subscribers";
@@ -12058,7 +12333,7 @@ void Master::subscribe(
   subscribers.subscribed.put(
       http.streamId,
       Owned<Subscribers::Subscriber>(
-          new Subscribers::Subscriber{http, principal}));
+          new Subscribers::Subscriber{http, principal, subscribe, approvers}));
 }
 
 
@@ -12154,6 +12429,7 @@ void Slave::addTask(Task* task)
 
   if (!protobuf::isTerminalState(task->state())) {
     usedResources[frameworkId] += resources;
+    changed();
   }
 
   // Note that we use `Resources` for output as it's faster than
@@ -12181,6 +12457,8 @@ void Slave::recoverResources(Task* task)
   if (usedResources[frameworkId].empty()) {
     usedResources.erase(frameworkId);
   }
+
+  changed();
 }
 
 
@@ -12207,6 +12485,8 @@ void Slave::removeTask(Task* task)
     if (usedResources[frameworkId].empty()) {
       usedResources.erase(frameworkId);
     }
+
+    changed();
   }
 
   tasks[frameworkId].erase(taskId);
@@ -12247,6 +12527,8 @@ void Slave::addOperation(Operation* operation)
     CHECK(operation->has_framework_id());
 
     usedResources[operation->framework_id()] += consumed.get();
+
+    changed();
   }
 }
 
@@ -12277,6 +12559,8 @@ void Slave::recoverResources(Operation* operation)
   if (usedResources[frameworkId].empty()) {
     usedResources.erase(frameworkId);
   }
+
+  changed();
 }
 
 
@@ -12341,6 +12625,8 @@ void Slave::addOffer(Offer* offer)
 
   offers.insert(offer);
   offeredResources += offer->resources();
+
+  changed();
 }
 
 
@@ -12350,6 +12636,8 @@ void Slave::removeOffer(Offer* offer)
 
   offeredResources -= offer->resources();
   offers.erase(offer);
+
+  changed();
 }
 
 
@@ -12394,6 +12682,8 @@ void Slave::addExecutor(const FrameworkID& frameworkId,
 
   executors[frameworkId][executorInfo.executor_id()] = executorInfo;
   usedResources[frameworkId] += executorInfo.resources();
+
+  changed();
 }
 
 
@@ -12413,6 +12703,8 @@ void Slave::removeExecutor(const FrameworkID& frameworkId,
   if (executors[frameworkId].empty()) {
     executors.erase(frameworkId);
   }
+
+  changed();
 }
 
 
@@ -12442,6 +12734,8 @@ void Slave::apply(const vector<ResourceConversion>& conversions)
     provider.totalResources -= conversion.consumed;
     provider.totalResources += conversion.converted;
   }
+
+  changed();
 }
 
 
@@ -12474,6 +12768,8 @@ Try<Nothing> Slave::update(
 
   resourceVersion = _resourceVersion;
 
+  changed();
+
   return Nothing();
 }
 
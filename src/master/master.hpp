@@ -20,9 +20,11 @@
 #include <stdint.h>
 
 #include <list>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/circular_buffer.hpp>
@@ -44,11 +46,16 @@
 
 #include <mesos/scheduler/scheduler.hpp>
 
+#include <process/clock.hpp>
+#include <process/event.hpp>
+#include <process/future.hpp>
 #include <process/limiter.hpp>
 #include <process/http.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
 #include <process/protobuf.hpp>
+#include <process/shared.hpp>
+#include <process/time.hpp>
 #include <process/timer.hpp>
 
 #include <process/metrics/counter.hpp>
@@ -109,8 +116,10 @@ class Master;
 class Registrar;
 class SlaveObserver;
 
+struct AgentState;
 struct BoundedRateLimiter;
 struct Framework;
+struct FrameworkState;
 struct Role;
 
 
@@ -183,6 +192,10 @@ Slave(Master* const _master,
       const Resources& _checkpointedResources,
       const Option<UUID>& resourceVersion);
 
+  // Discards the snapshot of the agent, which must be done whenever
+  // the agent changes (see `snapshot` below).
+  void changed() { snapshot.reset(); }
+
   Master* const master;
   const SlaveID id;
   SlaveInfo info;
@@ -315,6 +328,10 @@ Slave(Master* const _master,
 
   hashmap<ResourceProviderID, ResourceProvider> resourceProviders;
 
+  // The snapshot of the agent, which is shared by the snapshots of the
+  // state taken until the agent changes (see `Master::Http::snapshot()`).
+  process::Shared<AgentState> snapshot;
+
 private:
   Slave(const Slave&);              // No copying.
   Slave& operator=(const Slave&); // No assigning.
@@ -343,11 +360,27 @@ struct HttpConnection
   // versioned event e.g., `v1::scheduler::Event` or `v1::master::Event`.
   template <typename Message, typename Event = v1::scheduler::Event>
   bool send(const Message& message)
+  {
+    return writer.write(encode<Message, Event>(contentType, message));
+  }
+
+  // Sends a message which has already been encoded for the content
+  // type of this connection (see `encode` below), e.g., to share the
+  // encoding of a message which gets sent to many connections.
+  bool write(const std::string& record)
+  {
+    return writer.write(record);
+  }
+
+  // Returns the given message evolved, serialized for the given
+  // content type and recordio framed.
+  template <typename Message, typename Event = v1::scheduler::Event>
+  static std::string encode(ContentType contentType, const Message& message)
   {
     ::recordio::Encoder<Event> encoder (lambda::bind(
         serialize, contentType, lambda::_1));
 
-    return writer.write(encoder.encode(evolve(message)));
+    return encoder.encode(evolve(message));
   }
 
   bool close()
@@ -494,6 +527,13 @@ public:
       const process::UPID& from,
       RegisterSlaveMessage&& registerSlaveMessage);
 
+  // Prepares the re-registration message in parallel (i.e., decodes
+  // and validates it) and then continues with `reregisterSlave`. This
+  // is subject to admission control, see `--max_agent_reregistrations`.
+  void receiveReregisterSlave(
+      const process::UPID& from,
+      const std::string& data);
+
   void reregisterSlave(
       const process::UPID& from,
       ReregisterSlaveMessage&& incomingMessage);
@@ -584,6 +624,23 @@ protected:
   void initialize() override;
   void finalize() override;
 
+  void serve(process::Event&& event) override
+  {
+    // The HTTP events are read-only since libprocess invokes the route
+    // handlers in later dispatches. Any other event is deemed to change
+    // the state unless it is marked as read-only (see `Http::reading()`).
+    if (event.is<process::HttpEvent>()) {
+      http.reading();
+    }
+
+    ProtobufProcess<Master>::serve(std::move(event));
+
+    http.served();
+
+    // Publish the gauges once the queued events have been served.
+    metrics->publisher.served();
+  }
+
   void consume(process::MessageEvent&& event) override;
   void consume(process::ExitedEvent&& event) override;
 
@@ -1089,7 +1146,9 @@ private:
   // Subscribes a client to the 'api/vX' endpoint.
   void subscribe(
       const HttpConnection& http,
-      const Option<process::http::authentication::Principal>& principal);
+      const Option<process::http::authentication::Principal>& principal,
+      const mesos::master::Call::Subscribe& subscribe,
+      const process::Owned<ObjectApprovers>& approvers);
 
   void teardown(Framework* framework);
 
@@ -1382,6 +1441,7 @@ private:
   {
   public:
     explicit Http(Master* _master) : master(_master),
+                                     readOnly(false),
                                      quotaHandler(_master),
                                      weightsHandler(_master) {}
 
@@ -1536,6 +1596,28 @@ private:
     static std::string QUOTA_HELP();
     static std::string WEIGHTS_HELP();
 
+    // An immutable snapshot of the state served by the read-only
+    // endpoints (`/state`, `/state-summary`, `/frameworks`, `/tasks`,
+    // `/slaves` and the `GET_STATE` call and the calls for its parts)
+    // without authorization filtering. A snapshot is published (i.e.,
+    // shared by all requests) until the state changes, and it shares
+    // the snapshots of the frameworks and agents which did not change
+    // with the previous snapshot (see `Framework::snapshot` and
+    // `Slave::snapshot`). The filtering and the serialization of the
+    // responses happen on other threads, so that large responses do
+    // not block the master.
+    struct StateSnapshot;
+
+    // Marks the event which the master is serving as read-only, i.e.,
+    // as not changing the state. Every other event is deemed to change
+    // the state (see `served()`), so only the events which are known
+    // not to change it may be marked.
+    void reading() const;
+
+    // Discards the published snapshot after the master served an event,
+    // unless the event was marked as read-only (see `Master::serve()`).
+    void served() const;
+
   private:
     JSON::Object __flags() const;
 
@@ -1646,9 +1728,6 @@ private:
         const Option<process::http::authentication::Principal>& principal,
         ContentType contentType) const;
 
-    mesos::master::Response::GetAgents _getAgents(
-        const process::Owned<ObjectApprovers>& approvers) const;
-
     process::Future<process::http::Response> getFlags(
         const mesos::master::Call& call,
         const Option<process::http::authentication::Principal>& principal,
@@ -1729,9 +1808,6 @@ private:
         const Option<process::http::authentication::Principal>& principal,
         ContentType contentType) const;
 
-    mesos::master::Response::GetTasks _getTasks(
-        const process::Owned<ObjectApprovers>& approvers) const;
-
     process::Future<process::http::Response> createVolumes(
         const mesos::master::Call& call,
         const Option<process::http::authentication::Principal>& principal,
@@ -1767,24 +1843,41 @@ private:
         const Option<process::http::authentication::Principal>& principal,
         ContentType contentType) const;
 
-    mesos::master::Response::GetFrameworks _getFrameworks(
-        const process::Owned<ObjectApprovers>& approvers) const;
-
     process::Future<process::http::Response> getExecutors(
         const mesos::master::Call& call,
         const Option<process::http::authentication::Principal>& principal,
         ContentType contentType) const;
 
-    mesos::master::Response::GetExecutors _getExecutors(
-        const process::Owned<ObjectApprovers>& approvers) const;
-
     process::Future<process::http::Response> getState(
         const mesos::master::Call& call,
         const Option<process::http::authentication::Principal>& principal,
         ContentType contentType) const;
 
-    mesos::master::Response::GetState _getState(
-        const process::Owned<ObjectApprovers>& approvers) const;
+    // Returns the published snapshot of the state, taking it first if
+    // the state changed since the last snapshot was taken.
+    process::Shared<StateSnapshot> snapshot() const;
+
+    // The responses of the calls above for the given snapshot. These do
+    // not access the master, so they can be called on any thread.
+    static mesos::master::Response::GetAgents _getAgents(
+        const StateSnapshot& snapshot,
+        const process::Owned<ObjectApprovers>& approvers);
+
+    static mesos::master::Response::GetTasks _getTasks(
+        const StateSnapshot& snapshot,
+        const process::Owned<ObjectApprovers>& approvers);
+
+    static mesos::master::Response::GetFrameworks _getFrameworks(
+        const StateSnapshot& snapshot,
+        const process::Owned<ObjectApprovers>& approvers);
+
+    static mesos::master::Response::GetExecutors _getExecutors(
+        const StateSnapshot& snapshot,
+        const process::Owned<ObjectApprovers>& approvers);
+
+    static mesos::master::Response::GetState _getState(
+        const StateSnapshot& snapshot,
+        const process::Owned<ObjectApprovers>& approvers);
 
     process::Future<process::http::Response> subscribe(
         const mesos::master::Call& call,
@@ -1816,6 +1909,11 @@ private:
 
     Master* master;
 
+    // The published snapshot, if the state did not change since it was
+    // taken, and whether the event being served is read-only.
+    mutable Option<process::Shared<StateSnapshot>> published;
+    mutable bool readOnly;
+
     // NOTE: The quota specific pieces of the Operator API are factored
     // out into this separate class.
     QuotaHandler quotaHandler;
@@ -1884,7 +1982,7 @@ private:
 
   struct Slaves
   {
-    Slaves() : removed(MAX_REMOVED_SLAVES) {}
+    Slaves() : preparing(0), removed(MAX_REMOVED_SLAVES) {}
 
     // Imposes a time limit for slaves that we recover from the
     // registry to reregister with the master.
@@ -1906,6 +2004,10 @@ private:
     hashset<process::UPID> registering;
     hashset<SlaveID> reregistering;
 
+    // The number of re-registration messages which are being prepared,
+    // i.e., which will be added to `reregistering` if they are valid.
+    size_t preparing;
+
     // Registered slaves are indexed by SlaveID and UPID. Note that
     // iteration is supported but is exposed as iteration over a
     // hashmap<SlaveID, Slave*> since it is tedious to convert
@@ -2057,18 +2159,49 @@ private:
   {
     Subscribers(Master* _master) : master(_master) {};
 
-    // Represents a client subscribed to the 'api/vX' endpoint.
+    // An event which gets sent to the subscribers. The event gets
+    // encoded (see `HttpConnection::encode`) when it is first sent to
+    // a subscriber with a given content type, and the encoding is then
+    // shared by all the subscribers with that content type.
     //
-    // TODO(anand): Add support for filtering. Some subscribers
-    // might only be interested in a subset of events.
+    // NOTE: This must only be accessed on the master actor.
+    struct Event
+    {
+      explicit Event(mesos::master::Event&& _event)
+        : event(std::move(_event)) {}
+
+      const std::string& encode(ContentType contentType) const;
+
+      const mesos::master::Event event;
+
+      mutable std::map<ContentType, std::string> encodings;
+    };
+
+    // Represents a client subscribed to the 'api/vX' endpoint.
     struct Subscriber
     {
       Subscriber(
           const HttpConnection& _http,
-          const Option<process::http::authentication::Principal> _principal)
+          const Option<process::http::authentication::Principal> _principal,
+          const mesos::master::Call::Subscribe& subscribe,
+          const process::Owned<ObjectApprovers>& _approvers)
         : http(_http),
-          principal(_principal)
+          principal(_principal),
+          approvers(_approvers),
+          approved(process::Clock::now())
       {
+        foreach (int type, subscribe.event_types()) {
+          eventTypes.insert(static_cast<mesos::master::Event::Type>(type));
+        }
+
+        foreach (const FrameworkID& frameworkId, subscribe.framework_ids()) {
+          frameworkIds.insert(frameworkId);
+        }
+
+        foreach (const std::string& role, subscribe.roles()) {
+          roles.insert(role);
+        }
+
         mesos::master::Event event;
         event.set_type(mesos::master::Event::HEARTBEAT);
 
@@ -2091,11 +2224,18 @@ private:
       // TODO(greggomann): Refactor this function into multiple event-specific
       // overloads. See MESOS-8475.
       void send(
-          const process::Shared<mesos::master::Event>& event,
+          const process::Shared<Event>& event,
           const process::Owned<ObjectApprovers>& approvers,
           const process::Shared<FrameworkInfo>& frameworkInfo,
           const process::Shared<Task>& task);
 
+      // Returns whether the event passes the filters of the
+      // subscription (see `Call::Subscribe`). The framework info
+      // must be given for task events.
+      bool accepts(
+          const mesos::master::Event& event,
+          const process::Shared<FrameworkInfo>& frameworkInfo) const;
+
       ~Subscriber()
       {
         // TODO(anand): Refactor `HttpConnection` to being a RAII class instead.
@@ -2112,6 +2252,18 @@ private:
       process::Owned<Heartbeater<mesos::master::Event, v1::master::Event>>
         heartbeater;
       const Option<process::http::authentication::Principal> principal;
+
+      // The filters of the subscription, empty if not filtering.
+      std::set<mesos::master::Event::Type> eventTypes;
+      hashset<FrameworkID> frameworkIds;
+      hashset<std::string> roles;
+
+      // The approvers are shared by all events and get recreated
+      // (see `Subscribers::send`) once they were created more than
+      // `SUBSCRIBER_APPROVERS_TTL` ago, so that changes of the
+      // permissions take effect.
+      process::Future<process::Owned<ObjectApprovers>> approvers;
+      process::Time approved;
     };
 
     // Sends the event to all subscribers connected to the 'api/vX' endpoint.
@@ -2178,11 +2330,6 @@ private:
   std::shared_ptr<Metrics> metrics;
 
   // PullGauge handlers.
-  double _uptime_secs()
-  {
-    return (process::Clock::now() - startTime).secs();
-  }
-
   double _elected()
   {
     return elected() ? 1 : 0;
@@ -2204,21 +2351,6 @@ private:
     return static_cast<double>(offers.size());
   }
 
-  double _event_queue_messages()
-  {
-    return static_cast<double>(eventCount<process::MessageEvent>());
-  }
-
-  double _event_queue_dispatches()
-  {
-    return static_cast<double>(eventCount<process::DispatchEvent>());
-  }
-
-  double _event_queue_http_requests()
-  {
-    return static_cast<double>(eventCount<process::HttpEvent>());
-  }
-
   double _tasks_staging();
   double _tasks_starting();
   double _tasks_running();
@@ -2331,6 +2463,8 @@ struct Framework
 
     tasks[task->task_id()] = task;
 
+    changed();
+
     // Unreachable tasks should be added via `addUnreachableTask`.
     CHECK(task->state() != TASK_UNREACHABLE)
       << "Task '" << task->task_id() << "' of framework " << id()
@@ -2392,6 +2526,8 @@ struct Framework
       usedResources.erase(task->slave_id());
     }
 
+    changed();
+
     // If we are no longer subscribed to the role to which these resources are
     // being returned to, and we have no more resources allocated to us for that
     // role, stop tracking the framework under the role.
@@ -2437,13 +2573,17 @@ struct Framework
     // means that there might be multiple completed tasks with the
     // same task ID. We should consider rejecting attempts to reuse
     // task IDs (MESOS-6779).
-    completedTasks.push_back(process::Owned<Task>(new Task(std::move(task))));
+    completedTasks.push_back(process::Shared<Task>(new Task(std::move(task))));
+
+    changed();
   }
 
   void addUnreachableTask(const Task& task)
   {
     // TODO(adam-mesos): Check if unreachable task already exists.
     unreachableTasks.set(task.task_id(), process::Owned<Task>(new Task(task)));
+
+    changed();
   }
 
   // Removes the task. `unreachable` indicates whether the task is removed due
@@ -2474,6 +2614,8 @@ struct Framework
     }
 
     tasks.erase(task->task_id());
+
+    changed();
   }
 
   void addOffer(Offer* offer)
@@ -2482,6 +2624,8 @@ struct Framework
     offers.insert(offer);
     totalOfferedResources += offer->resources();
     offeredResources[offer->slave_id()] += offer->resources();
+
+    changed();
   }
 
   void removeOffer(Offer* offer)
@@ -2496,6 +2640,8 @@ struct Framework
     }
 
     offers.erase(offer);
+
+    changed();
   }
 
   void addInverseOffer(InverseOffer* inverseOffer)
@@ -2503,6 +2649,8 @@ struct Framework
     CHECK(!inverseOffers.contains(inverseOffer))
       << "Duplicate inverse offer " << inverseOffer->id();
     inverseOffers.insert(inverseOffer);
+
+    changed();
   }
 
   void removeInverseOffer(InverseOffer* inverseOffer)
@@ -2511,6 +2659,8 @@ struct Framework
       << "Unknown inverse offer " << inverseOffer->id();
 
     inverseOffers.erase(inverseOffer);
+
+    changed();
   }
 
   bool hasExecutor(const SlaveID& slaveId,
@@ -2537,6 +2687,8 @@ struct Framework
     totalUsedResources += executorInfo.resources();
     usedResources[slaveId] += executorInfo.resources();
 
+    changed();
+
     // It's possible that we're not tracking the task's role for
     // this framework if the role is absent from the framework's
     // set of roles. In this case, we track the role's allocation
@@ -2589,6 +2741,8 @@ struct Framework
     if (executors[slaveId].empty()) {
       executors.erase(slaveId);
     }
+
+    changed();
   }
 
   void addOperation(Operation* operation)
@@ -2624,6 +2778,8 @@ struct Framework
       totalUsedResources += consumed.get();
       usedResources[slaveId] += consumed.get();
 
+      changed();
+
       // It's possible that we're not tracking the role from the
       // resources in the operation for this framework if the role is
       // absent from the framework's set of roles. In this case, we
@@ -2678,6 +2834,8 @@ struct Framework
       usedResources.erase(slaveId);
     }
 
+    changed();
+
     // If we are no longer subscribed to the role to which these
     // resources are being returned to, and we have no more resources
     // allocated to us for that role, stop tracking the framework
@@ -2726,6 +2884,8 @@ struct Framework
     // We only merge 'info' from the same framework 'id'.
     CHECK_EQ(info.id(), newInfo.id());
 
+    changed();
+
     // Save the old list of roles for later.
     std::set<std::string> oldRoles = roles;
 
@@ -2846,6 +3006,8 @@ struct Framework
 
     // TODO(benh): unlink(oldPid);
     pid = newPid;
+
+    changed();
   }
 
   void updateConnection(const HttpConnection& newHttp)
@@ -2865,6 +3027,8 @@ struct Framework
     CHECK_NONE(http);
 
     http = newHttp;
+
+    changed();
   }
 
   // Closes the HTTP connection and stops the heartbeat.
@@ -2917,6 +3081,10 @@ struct Framework
   void trackUnderRole(const std::string& role);
   void untrackUnderRole(const std::string& role);
 
+  // Discards the snapshot of the framework, which must be done
+  // whenever the framework changes (see `snapshot` below).
+  void changed() { snapshot.reset(); }
+
   Master* const master;
 
   FrameworkInfo info;
@@ -2950,8 +3118,10 @@ struct Framework
   // state and have had all their updates acknowledged. We only keep a
   // fixed-size cache to avoid consuming too much memory. We use
   // boost::circular_buffer rather than BoundedHashMap because there
-  // can be multiple completed tasks with the same task ID.
-  boost::circular_buffer<process::Owned<Task>> completedTasks;
+  // can be multiple completed tasks with the same task ID. Completed
+  // tasks are immutable, so they are shared with the snapshots of the
+  // state rather than copied (see `Master::Http::StateSnapshot`).
+  boost::circular_buffer<process::Shared<Task>> completedTasks;
 
   // When an agent is marked unreachable, tasks running on it are stored
   // here. We only keep a fixed-size cache to avoid consuming too much memory.
@@ -3013,6 +3183,11 @@ struct Framework
   Option<process::Owned<Heartbeater<scheduler::Event, v1::scheduler::Event>>>
     heartbeater;
 
+  // The snapshot of the framework, which is shared by the snapshots of
+  // the state taken until the framework changes (see
+  // `Master::Http::snapshot()`).
+  process::Shared<FrameworkState> snapshot;
+
 private:
   Framework(Master* const _master,
             const Flags& masterFlags,
@@ -14,8 +14,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <functional>
 #include <string>
 
+#include <process/clock.hpp>
+#include <process/event.hpp>
+
 #include <process/metrics/counter.hpp>
 #include <process/metrics/pull_gauge.hpp>
 #include <process/metrics/metrics.hpp>
@@ -34,61 +38,72 @@ namespace mesos {
 namespace internal {
 namespace master {
 
+// Returns a function which samples the given count of queued events.
+static std::function<double()> count(const std::function<size_t()>& counter)
+{
+  return [counter]() {
+    return static_cast<double>(counter());
+  };
+}
+
+
 // Message counters are named with "messages_" prefix so they can
 // be grouped together alphabetically in the output.
 // TODO(alexandra.sava): Add metrics for registered and removed slaves.
-Metrics::Metrics(const Master& master)
-  : uptime_secs(
+Metrics::Metrics(Master& master)
+  : publisher(master),
+    uptime_secs(publisher.gauge(
         "master/uptime_secs",
-        defer(master, &Master::_uptime_secs)),
-    elected(
+        [&master]() { return master.startTime.secs(); },
+        [](double start) { return process::Clock::now().secs() - start; })),
+    elected(publisher.gauge(
         "master/elected",
-        defer(master, &Master::_elected)),
-    slaves_connected(
+        [&master]() { return master._elected(); })),
+    slaves_connected(publisher.gauge(
         "master/slaves_connected",
-        defer(master, &Master::_slaves_connected)),
-    slaves_disconnected(
+        [&master]() { return master._slaves_connected(); })),
+    slaves_disconnected(publisher.gauge(
         "master/slaves_disconnected",
-        defer(master, &Master::_slaves_disconnected)),
-    slaves_active(
+        [&master]() { return master._slaves_disconnected(); })),
+    slaves_active(publisher.gauge(
         "master/slaves_active",
-        defer(master, &Master::_slaves_active)),
-    slaves_inactive(
+        [&master]() { return master._slaves_active(); })),
+    slaves_inactive(publisher.gauge(
         "master/slaves_inactive",
-        defer(master, &Master::_slaves_inactive)),
-    slaves_unreachable(
+        [&master]() { return master._slaves_inactive(); })),
+    slaves_unreachable(publisher.gauge(
         "master/slaves_unreachable",
-        defer(master, &Master::_slaves_unreachable)),
-    frameworks_connected(
+        [&master]() { return master._slaves_unreachable(); })),
+    frameworks_connected(publisher.gauge(
         "master/frameworks_connected",
-        defer(master, &Master::_frameworks_connected)),
-    frameworks_disconnected(
+        [&master]() { return master._frameworks_connected(); })),
+    frameworks_disconnected(publisher.gauge(
         "master/frameworks_disconnected",
-        defer(master, &Master::_frameworks_disconnected)),
-    frameworks_active(
+        [&master]() { return master._frameworks_disconnected(); })),
+    frameworks_active(publisher.gauge(
         "master/frameworks_active",
-        defer(master, &Master::_frameworks_active)),
-    frameworks_inactive(
+        [&master]() { return master._frameworks_active(); })),
+    frameworks_inactive(publisher.gauge(
         "master/frameworks_inactive",
-        defer(master, &Master::_frameworks_inactive)),
-    outstanding_offers(
+        [&master]() { return master._frameworks_inactive(); })),
+    outstanding_offers(publisher.gauge(
         "master/outstanding_offers",
-        defer(master, &Master::_outstanding_offers)),
-    tasks_staging(
+        [&master]() { return master._outstanding_offers(); })),
+    tasks_staging(publisher.gauge(
         "master/tasks_staging",
-        defer(master, &Master::_tasks_staging)),
-    tasks_starting(
+        [&master]() { return master._tasks_staging(); })),
+    tasks_starting(publisher.gauge(
         "master/tasks_starting",
-        defer(master, &Master::_tasks_starting)),
-    tasks_running(
+        [&master]() { return master._tasks_starting(); })),
+    tasks_running(publisher.gauge(
         "master/tasks_running",
-        defer(master, &Master::_tasks_running)),
-    tasks_unreachable(
+        [&master]() { return master._tasks_running(); })),
+    tasks_unreachable(publisher.gauge(
         "master/tasks_unreachable",
-        defer(master, &Master::_tasks_unreachable)),
-    tasks_killing(
+        [&master]() { return master._tasks_unreachable(); })),
+    tasks_killing(publisher.gauge(
         "master/tasks_killing",
-        defer(master, &Master::_tasks_killing)),
+        [&master]() { return master._tasks_killing(); })),
     tasks_finished(
         "master/tasks_finished"),
     tasks_failed(
@@ -175,15 +190,15 @@ Metrics::Metrics(const Master& master)
         "master/invalid_operation_status_update_acknowledgements"),
     recovery_slave_removals(
         "master/recovery_slave_removals"),
-    event_queue_messages(
+    event_queue_messages(PullGauge::sampled(
         "master/event_queue_messages",
-        defer(master, &Master::_event_queue_messages)),
-    event_queue_dispatches(
+        count(master.eventCounter<process::MessageEvent>()))),
+    event_queue_dispatches(PullGauge::sampled(
         "master/event_queue_dispatches",
-        defer(master, &Master::_event_queue_dispatches)),
-    event_queue_http_requests(
+        count(master.eventCounter<process::DispatchEvent>()))),
+    event_queue_http_requests(PullGauge::sampled(
         "master/event_queue_http_requests",
-        defer(master, &Master::_event_queue_http_requests)),
+        count(master.eventCounter<process::HttpEvent>()))),
     slave_registrations(
         "master/slave_registrations"),
     slave_reregistrations(
@@ -313,17 +328,23 @@ Metrics::Metrics(const Master& master)
   const string resources[] = {"cpus", "gpus", "mem", "disk"};
 
   foreach (const string& resource, resources) {
-    PullGauge total(
+    PullGauge total = publisher.gauge(
         "master/" + resource + "_total",
-        defer(master, &Master::_resources_total, resource));
+        [&master, resource]() {
+          return master._resources_total(resource);
+        });
 
-    PullGauge used(
+    PullGauge used = publisher.gauge(
         "master/" + resource + "_used",
-        defer(master, &Master::_resources_used, resource));
+        [&master, resource]() {
+          return master._resources_used(resource);
+        });
 
-    PullGauge percent(
+    PullGauge percent = publisher.gauge(
         "master/" + resource + "_percent",
-        defer(master, &Master::_resources_percent, resource));
+        [&master, resource]() {
+          return master._resources_percent(resource);
+        });
 
     resources_total.push_back(total);
     resources_used.push_back(used);
@@ -335,17 +356,23 @@ Metrics::Metrics(const Master& master)
   }
 
   foreach (const string& resource, resources) {
-    PullGauge total(
+    PullGauge total = publisher.gauge(
         "master/" + resource + "_revocable_total",
-        defer(master, &Master::_resources_revocable_total, resource));
+        [&master, resource]() {
+          return master._resources_revocable_total(resource);
+        });
 
-    PullGauge used(
+    PullGauge used = publisher.gauge(
         "master/" + resource + "_revocable_used",
-        defer(master, &Master::_resources_revocable_used, resource));
+        [&master, resource]() {
+          return master._resources_revocable_used(resource);
+        });
 
-    PullGauge percent(
+    PullGauge percent = publisher.gauge(
         "master/" + resource + "_revocable_percent",
-        defer(master, &Master::_resources_revocable_percent, resource));
+        [&master, resource]() {
+          return master._resources_revocable_percent(resource);
+        });
 
     resources_revocable_total.push_back(total);
     resources_revocable_used.push_back(used);
@@ -21,6 +21,7 @@
 #include <vector>
 
 #include <process/metrics/counter.hpp>
+#include <process/metrics/publisher.hpp>
 #include <process/metrics/pull_gauge.hpp>
 #include <process/metrics/metrics.hpp>
 
@@ -37,10 +38,14 @@ class Master;
 
 struct Metrics
 {
-  explicit Metrics(const Master& master);
+  explicit Metrics(Master& master);
 
   ~Metrics();
 
+  // Publishes the values of the gauges computed from the master's
+  // state, once per burst of events served by the master.
+  process::metrics::Publisher publisher;
+
   process::metrics::PullGauge uptime_secs;
   process::metrics::PullGauge elected;
 
@@ -108,6 +113,14 @@ struct Metrics
       : messages_received("frameworks/" + principal + "/messages_received"),
         messages_processed("frameworks/" + principal + "/messages_processed")
     {
+      // Exposed as families labeled by the principal in OpenMetrics,
+      // since different principals can have the same sanitized names.
+      messages_received.setLabels(
+          "frameworks/messages_received", {{"principal", principal}});
+
+      messages_processed.setLabels(
+          "frameworks/messages_processed", {{"principal", principal}});
+
       process::metrics::add(messages_received);
       process::metrics::add(messages_processed);
     }
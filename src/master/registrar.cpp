@@ -14,13 +14,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <deque>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include <mesos/type_utils.hpp>
 
 #include <mesos/state/state.hpp>
 
+#include <process/collect.hpp>
 #include <process/defer.hpp>
 #include <process/dispatch.hpp>
 #include <process/future.hpp>
@@ -34,15 +39,20 @@
 #include <process/metrics/metrics.hpp>
 #include <process/metrics/timer.hpp>
 
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
 #include <stout/lambda.hpp>
 #include <stout/none.hpp>
 #include <stout/nothing.hpp>
 #include <stout/option.hpp>
 #include <stout/protobuf.hpp>
 #include <stout/stopwatch.hpp>
+#include <stout/strings.hpp>
+#include <stout/uuid.hpp>
 
 #include "master/registrar.hpp"
 #include "master/registry.hpp"
+#include "master/registry_operations.hpp"
 
 using mesos::state::State;
 using mesos::state::Variable;
@@ -71,7 +81,9 @@ using process::metrics::PullGauge;
 using process::metrics::Timer;
 
 using std::deque;
+using std::set;
 using std::string;
+using std::vector;
 
 namespace mesos {
 namespace internal {
@@ -93,6 +105,7 @@ public:
       metrics(*this),
       state(_state),
       updating(false),
+      deltas(0),
       flags(_flags),
       authenticationRealm(_authenticationRealm) {}
 
@@ -148,7 +161,10 @@ private:
             "registrar/registry_size_bytes",
             defer(process, &RegistrarProcess::_registry_size_bytes)),
         state_fetch("registrar/state_fetch"),
-        state_store("registrar/state_store", Days(1))
+        state_store(
+            "registrar/state_store",
+            Days(1),
+            process::metrics::Percentiles::ESTIMATED)
     {
       process::metrics::add(queued_operations);
       process::metrics::add(registry_size_bytes);
@@ -192,15 +208,35 @@ private:
   void _recover(
       const MasterInfo& info,
       const Future<Variable>& recovery);
+  void _recoverVariables(
+      const MasterInfo& info,
+      const Future<vector<Variable>>& recovery);
   void __recover(const Future<bool>& recover);
   Future<bool> _apply(Owned<RegistryOperation> operation);
 
+  // Marks the shards of the agents of the given operation as dirty,
+  // i.e., to be stored with the next full registry.
+  void markDirty(const RegistryDelta::Operation& operation);
+
+  // Applies the `Recover` operation, i.e., stores the full registry
+  // with the given MasterInfo, which completes the recovery.
+  void persist(const MasterInfo& info);
+
   // Helper for updating state (performing store).
   void update();
   void _update(
       const Future<Option<Variable>>& store,
       const Owned<Registry>& updatedRegistry,
-      deque<Owned<RegistryOperation>> operations);
+      deque<Owned<RegistryOperation>> operations,
+      bool delta,
+      const Owned<hashmap<size_t, Variable>>& stored);
+
+  // Stores the dirty shards of the given registry under new names and
+  // then the registry without the agents, which references the shards
+  // (see `--registry_shards`). The stored shards get added to `stored`.
+  Future<Option<Variable>> storeShards(
+      Registry* updatedRegistry,
+      const Owned<hashmap<size_t, Variable>>& stored);
 
   // Fails all pending operations and transitions the Registrar
   // into an error state in which all subsequent operations will fail.
@@ -225,6 +261,20 @@ private:
   deque<Owned<RegistryOperation>> operations;
   bool updating; // Used to signify fetching (recovering) or storing.
 
+  // The number of deltas stored since the full registry was stored
+  // (see `--registry_max_deltas`).
+  size_t deltas;
+
+  // The variables of the current shards by their index, and the
+  // indices of the shards whose agents changed since they were stored
+  // (see `--registry_shards`).
+  hashmap<size_t, Variable> shards;
+  hashset<size_t> dirty;
+
+  // The variables of the deltas and of the replaced shards, which get
+  // expunged once the full registry has been stored again.
+  vector<Variable> obsolete;
+
   const Flags flags;
 
   // Used to compose our operations with recovery.
@@ -240,6 +290,34 @@ private:
 };
 
 
+// Prefix of the names of the variables of the registry deltas, which
+// is followed by the sequence number of the delta.
+static const string DELTA_PREFIX = "registry.delta.";
+
+
+// Prefix of the names of the variables of the registry shards, which
+// is followed by the index of the shard and a UUID. Shards get stored
+// under a new name each time, so that the stored registry references
+// complete shards until the registry itself has been stored.
+static const string SHARD_PREFIX = "registry.shard.";
+
+
+// Returns the index of the shard of the given agent. This uses FNV-1a
+// rather than `std::hash` since the result needs to be stable across
+// builds and platforms.
+static size_t shard(const SlaveID& slaveId, size_t count)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  foreach (char c, slaveId.value()) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+
+  return static_cast<size_t>(hash % count);
+}
+
+
 // Helper for treating State operations that timeout as failures.
 template <typename T>
 Future<T> timeout(
@@ -391,7 +469,259 @@ void RegistrarProcess::_recover(
   registry = Option<Registry>(Registry());
   registry->Swap(&deserialized.get());
 
-  // Perform the Recover operation to add the new MasterInfo.
+  // The registry might be followed by deltas if they were used, and
+  // the agents are stored in shards if it is sharded. All the shards
+  // get fetched, to expunge the ones which are no longer referenced.
+  if (registry->has_delta_sequence() || registry->shards_size() > 0) {
+    State* state = this->state;
+
+    updating = true;
+
+    state->names()
+      .then([state](const set<string>& names) {
+        vector<Future<Variable>> variables;
+        foreach (const string& name, names) {
+          if (strings::startsWith(name, DELTA_PREFIX) ||
+              strings::startsWith(name, SHARD_PREFIX)) {
+            variables.push_back(state->fetch(name));
+          }
+        }
+
+        return collect(variables);
+      })
+      .after(flags.registry_fetch_timeout,
+             lambda::bind(
+                 &timeout<vector<Variable>>,
+                 "fetch",
+                 flags.registry_fetch_timeout,
+                 lambda::_1))
+      .onAny(defer(self(), &Self::_recoverVariables, info, lambda::_1));
+
+    return;
+  }
+
+  persist(info);
+}
+
+
+void RegistrarProcess::_recoverVariables(
+    const MasterInfo& info,
+    const Future<vector<Variable>>& recovery)
+{
+  updating = false;
+
+  CHECK(!recovery.isPending());
+
+  if (!recovery.isReady()) {
+    recovered.get()->fail("Failed to recover registrar deltas and shards: " +
+        (recovery.isFailed() ? recovery.failure() : "discarded"));
+    return;
+  }
+
+  hashmap<string, size_t> indices;
+  for (int i = 0; i < registry->shards_size(); i++) {
+    indices[registry->shards(i)] = i;
+  }
+
+  // Order the shards by their indices and the deltas by their
+  // sequence numbers.
+  std::map<size_t, Registry> contents;
+  std::map<uint64_t, RegistryDelta> ordered;
+
+  foreach (const Variable& variable, recovery.get()) {
+    if (strings::startsWith(variable.name(), SHARD_PREFIX)) {
+      // Shards which are not referenced are left over from stores
+      // which did not complete or from replaced shards which were not
+      // expunged, so they get expunged once the registry is stored.
+      if (!indices.contains(variable.name())) {
+        obsolete.push_back(variable);
+        continue;
+      }
+
+      Try<Registry> shard =
+        ::protobuf::deserialize<Registry>(variable.value());
+
+      if (shard.isError()) {
+        recovered.get()->fail("Failed to recover registrar shards: " +
+                              shard.error());
+        return;
+      }
+
+      const size_t index = indices.at(variable.name());
+
+      contents[index].Swap(&shard.get());
+      shards.put(index, variable);
+      continue;
+    }
+
+    Try<RegistryDelta> delta =
+      ::protobuf::deserialize<RegistryDelta>(variable.value());
+
+    if (delta.isError()) {
+      recovered.get()->fail("Failed to recover registrar deltas: " +
+                            delta.error());
+      return;
+    }
+
+    ordered[delta->sequence()] = delta.get();
+
+    // All deltas get expunged once the registry has been stored.
+    obsolete.push_back(variable);
+  }
+
+  if (contents.size() != static_cast<size_t>(registry->shards_size())) {
+    recovered.get()->fail(
+        "Failed to recover registrar shards: Found " +
+        stringify(contents.size()) + " of the " +
+        stringify(registry->shards_size()) + " shards");
+    return;
+  }
+
+  // Merge the shards into the registry. An agent is stored in another
+  // shard than it belongs to if the registry was sharded differently
+  // before, in which case both shards need to be stored again.
+  const size_t count = contents.size();
+
+  foreachpair (size_t index, Registry& shard, contents) {
+    auto check = [this, index, count](const SlaveID& slaveId) {
+      const size_t actual = master::shard(slaveId, count);
+      if (actual != index) {
+        dirty.insert(index);
+        dirty.insert(actual);
+      }
+    };
+
+    foreach (Registry::Slave& slave,
+             *shard.mutable_slaves()->mutable_slaves()) {
+      check(slave.info().id());
+      registry->mutable_slaves()->add_slaves()->Swap(&slave);
+    }
+
+    foreach (Registry::UnreachableSlave& slave,
+             *shard.mutable_unreachable()->mutable_slaves()) {
+      check(slave.id());
+      registry->mutable_unreachable()->add_slaves()->Swap(&slave);
+    }
+
+    foreach (Registry::GoneSlave& slave,
+             *shard.mutable_gone()->mutable_slaves()) {
+      check(slave.id());
+      registry->mutable_gone()->add_slaves()->Swap(&slave);
+    }
+  }
+
+  // The unreachable and gone agents are pruned by their timestamps, in
+  // the order in which they were added, so restore that order.
+  if (count > 0) {
+    auto unreachable = registry->mutable_unreachable()->mutable_slaves();
+    std::stable_sort(
+        unreachable->pointer_begin(),
+        unreachable->pointer_end(),
+        [](const Registry::UnreachableSlave* left,
+           const Registry::UnreachableSlave* right) {
+          return left->timestamp().nanoseconds() <
+                 right->timestamp().nanoseconds();
+        });
+
+    auto gone = registry->mutable_gone()->mutable_slaves();
+    std::stable_sort(
+        gone->pointer_begin(),
+        gone->pointer_end(),
+        [](const Registry::GoneSlave* left, const Registry::GoneSlave* right) {
+          return left->timestamp().nanoseconds() <
+                 right->timestamp().nanoseconds();
+        });
+
+    LOG(INFO) << "Merged the " << count << " registry shards";
+  }
+
+  hashset<SlaveID> slaveIDs;
+  foreach (const Registry::Slave& slave, registry->slaves().slaves()) {
+    slaveIDs.insert(slave.info().id());
+  }
+
+  // Apply the deltas which follow the registry. Deltas which the
+  // registry already includes (or which do not follow the registry
+  // without a gap) are left over from compactions which did not
+  // expunge them.
+  size_t applied = 0;
+
+  for (uint64_t sequence = registry->delta_sequence() + 1;
+       ordered.count(sequence) > 0;
+       sequence++) {
+    foreach (const RegistryDelta::Operation& operation_,
+             ordered.at(sequence).operations()) {
+      Try<Owned<RegistryOperation>> operation = createOperation(operation_);
+
+      if (operation.isError()) {
+        recovered.get()->fail("Failed to recover registrar deltas: " +
+                              operation.error());
+        return;
+      }
+
+      // No need to process the result of the operation, see `update`.
+      (*operation.get())(&registry.get(), &slaveIDs);
+
+      // The agents of the delta are only stored in the shards once the
+      // registry has been stored, which expunges the delta.
+      markDirty(operation_);
+    }
+
+    registry->set_delta_sequence(sequence);
+    applied++;
+  }
+
+  LOG(INFO) << "Applied " << applied << " of the " << ordered.size()
+            << " registry deltas";
+
+  persist(info);
+}
+
+
+void RegistrarProcess::markDirty(const RegistryDelta::Operation& operation)
+{
+  if (flags.registry_shards == 0) {
+    return;
+  }
+
+  vector<SlaveID> slaveIds;
+
+  if (operation.has_slave_info()) {
+    slaveIds.push_back(operation.slave_info().id());
+  }
+
+  if (operation.has_slave_id()) {
+    slaveIds.push_back(operation.slave_id());
+  }
+
+  slaveIds.insert(
+      slaveIds.end(),
+      operation.unreachable().begin(),
+      operation.unreachable().end());
+
+  slaveIds.insert(
+      slaveIds.end(),
+      operation.gone().begin(),
+      operation.gone().end());
+
+  foreach (const SlaveID& slaveId, slaveIds) {
+    dirty.insert(shard(slaveId, flags.registry_shards));
+  }
+}
+
+
+void RegistrarProcess::persist(const MasterInfo& info)
+{
+  // All shards need to be stored if the registry was not stored with
+  // the current number of shards.
+  if (static_cast<size_t>(registry->shards_size()) != flags.registry_shards) {
+    for (size_t index = 0; index < flags.registry_shards; index++) {
+      dirty.insert(index);
+    }
+  }
+
+  // Perform the Recover operation to add the new MasterInfo. Since it
+  // can not be stored as a delta, this stores the full registry.
   Owned<RegistryOperation> operation(new Recover(info));
   operations.push_back(operation);
   operation->future()
@@ -479,9 +809,32 @@ void RegistrarProcess::update()
     slaveIDs.insert(slave.info().id());
   }
 
+  // The update gets stored as a delta if all the operations can be
+  // stored in a delta and the full registry was stored recently
+  // enough. The delta contains all the operations (i.e., also the
+  // ones which fail or do not mutate the registry), since they are
+  // deterministic and will have the same result when recovering.
+  RegistryDelta delta;
+  bool isDelta = deltas < flags.registry_max_deltas;
+
   foreach (Owned<RegistryOperation>& operation, operations) {
     // No need to process the result of the operation.
     (*operation)(updatedRegistry.get(), &slaveIDs);
+
+    Option<RegistryDelta::Operation> operation_ = operation->delta();
+
+    if (operation_.isNone()) {
+      isDelta = false;
+      continue;
+    }
+
+    // Operations which do not have a delta do not change the agents
+    // (e.g., the `Recover` operation).
+    markDirty(operation_.get());
+
+    if (isDelta) {
+      *delta.add_operations() = operation_.get();
+    }
   }
 
   LOG(INFO) << "Applied " << operations.size() << " operations in "
@@ -490,16 +843,58 @@ void RegistrarProcess::update()
   // Perform the store, and time the operation.
   metrics.state_store.start();
 
-  // Serialize updated registry.
-  Try<string> serialized = ::protobuf::serialize(*updatedRegistry);
-  if (serialized.isError()) {
-    string message = "Failed to update registry: " + serialized.error();
-    fail(&operations, message);
-    abort(message);
-    return;
+  Future<Option<Variable>> store;
+  Owned<hashmap<size_t, Variable>> stored(new hashmap<size_t, Variable>());
+
+  if (isDelta) {
+    updatedRegistry->set_delta_sequence(registry->delta_sequence() + 1);
+    delta.set_sequence(updatedRegistry->delta_sequence());
+
+    // Serialize the delta.
+    Try<string> serialized = ::protobuf::serialize(delta);
+    if (serialized.isError()) {
+      string message = "Failed to update registry: " + serialized.error();
+      fail(&operations, message);
+      abort(message);
+      return;
+    }
+
+    State* state = this->state;
+    const string value = serialized.get();
+
+    store = state->fetch(DELTA_PREFIX + stringify(delta.sequence()))
+      .then([state, value](const Variable& variable) {
+        return state->store(variable.mutate(value));
+      });
+  } else {
+    // Deltas need to be applied on top of this registry if deltas
+    // are (or were) used.
+    if (flags.registry_max_deltas > 0 &&
+        !updatedRegistry->has_delta_sequence()) {
+      updatedRegistry->set_delta_sequence(0);
+    }
+
+    if (flags.registry_shards > 0) {
+      store = storeShards(updatedRegistry.get(), stored);
+    } else {
+      // The registry is no longer sharded, its shards get expunged
+      // once it has been stored.
+      updatedRegistry->clear_shards();
+
+      // Serialize updated registry.
+      Try<string> serialized = ::protobuf::serialize(*updatedRegistry);
+      if (serialized.isError()) {
+        string message = "Failed to update registry: " + serialized.error();
+        fail(&operations, message);
+        abort(message);
+        return;
+      }
+
+      store = state->store(variable->mutate(serialized.get()));
+    }
   }
 
-  state->store(variable->mutate(serialized.get()))
+  store
     .after(flags.registry_store_timeout,
            lambda::bind(
                &timeout<Option<Variable>>,
@@ -507,17 +902,135 @@ void RegistrarProcess::update()
                flags.registry_store_timeout,
                lambda::_1))
     .onAny(defer(
-        self(), &Self::_update, lambda::_1, updatedRegistry, operations));
+        self(),
+        &Self::_update,
+        lambda::_1,
+        updatedRegistry,
+        operations,
+        isDelta,
+        stored));
 
   // Clear the operations, _update will transition the Promises!
   operations.clear();
 }
 
 
+Future<Option<Variable>> RegistrarProcess::storeShards(
+    Registry* updatedRegistry,
+    const Owned<hashmap<size_t, Variable>>& stored)
+{
+  const size_t count = flags.registry_shards;
+
+  // All shards are dirty if the number of shards changed, see `persist`.
+  if (static_cast<size_t>(updatedRegistry->shards_size()) != count) {
+    updatedRegistry->clear_shards();
+
+    for (size_t index = 0; index < count; index++) {
+      updatedRegistry->add_shards();
+    }
+  }
+
+  std::map<size_t, Registry> contents;
+
+  foreach (size_t index, dirty) {
+    contents[index];
+
+    updatedRegistry->set_shards(
+        index,
+        SHARD_PREFIX + stringify(index) + "." +
+          stringify(id::UUID::random()));
+  }
+
+  // Split the agents of the dirty shards into the shards.
+  foreach (const Registry::Slave& slave, updatedRegistry->slaves().slaves()) {
+    auto shard = contents.find(master::shard(slave.info().id(), count));
+    if (shard != contents.end()) {
+      shard->second.mutable_slaves()->add_slaves()->CopyFrom(slave);
+    }
+  }
+
+  foreach (const Registry::UnreachableSlave& slave,
+           updatedRegistry->unreachable().slaves()) {
+    auto shard = contents.find(master::shard(slave.id(), count));
+    if (shard != contents.end()) {
+      shard->second.mutable_unreachable()->add_slaves()->CopyFrom(slave);
+    }
+  }
+
+  foreach (const Registry::GoneSlave& slave,
+           updatedRegistry->gone().slaves()) {
+    auto shard = contents.find(master::shard(slave.id(), count));
+    if (shard != contents.end()) {
+      shard->second.mutable_gone()->add_slaves()->CopyFrom(slave);
+    }
+  }
+
+  // Serialize the registry without the agents, which we swap out
+  // rather than copying the registry.
+  Registry::Slaves slaves;
+  Registry::UnreachableSlaves unreachable;
+  Registry::GoneSlaves gone;
+
+  updatedRegistry->mutable_slaves()->Swap(&slaves);
+  updatedRegistry->mutable_unreachable()->Swap(&unreachable);
+  updatedRegistry->mutable_gone()->Swap(&gone);
+
+  Try<string> serialized = ::protobuf::serialize(*updatedRegistry);
+
+  updatedRegistry->mutable_slaves()->Swap(&slaves);
+  updatedRegistry->mutable_unreachable()->Swap(&unreachable);
+  updatedRegistry->mutable_gone()->Swap(&gone);
+
+  if (serialized.isError()) {
+    return Failure(serialized.error());
+  }
+
+  // Store the dirty shards in parallel.
+  State* state = this->state;
+
+  vector<size_t> indices;
+  vector<Future<Option<Variable>>> futures;
+
+  foreachpair (size_t index, const Registry& shard, contents) {
+    Try<string> value = ::protobuf::serialize(shard);
+    if (value.isError()) {
+      return Failure(value.error());
+    }
+
+    indices.push_back(index);
+    futures.push_back(state->fetch(updatedRegistry->shards(index))
+      .then([state, value](const Variable& variable) {
+        return state->store(variable.mutate(value.get()));
+      }));
+  }
+
+  // The registry can only be stored once all of its shards have been
+  // stored, since it is what makes them visible.
+  const Variable variable = this->variable.get();
+  const string value = serialized.get();
+
+  return collect(futures)
+    .then([=](const vector<Option<Variable>>& variables)
+        -> Future<Option<Variable>> {
+      for (size_t i = 0; i < variables.size(); i++) {
+        if (variables[i].isNone()) {
+          return None(); // Version mismatch.
+        }
+
+        stored->put(indices[i], variables[i].get());
+      }
+
+      return state->store(variable.mutate(value));
+    });
+}
+
+
 void RegistrarProcess::_update(
     const Future<Option<Variable>>& store,
     const Owned<Registry>& updatedRegistry,
-    deque<Owned<RegistryOperation>> applied)
+    deque<Owned<RegistryOperation>> applied,
+    bool delta,
+    const Owned<hashmap<size_t, Variable>>& stored)
 {
   updating = false;
 
@@ -541,9 +1054,51 @@ void RegistrarProcess::_update(
 
   Duration elapsed = metrics.state_store.stop();
 
-  LOG(INFO) << "Successfully updated the registry in " << elapsed;
+  LOG(INFO) << "Successfully updated the registry"
+            << (delta ? " (delta " + stringify(
+                            updatedRegistry->delta_sequence()) + ")" : "")
+            << " in " << elapsed;
+
+  if (delta) {
+    deltas++;
+    obsolete.push_back(store->get());
+  } else {
+    variable = store->get();
+
+    // The stored registry references the stored shards rather than the
+    // ones they replace, and the shards beyond the current number of
+    // shards (if it was reduced) are no longer referenced.
+    foreachpair (size_t index, const Variable& shard, *stored) {
+      if (shards.contains(index)) {
+        obsolete.push_back(shards.at(index));
+      }
+
+      shards.put(index, shard);
+    }
+
+    foreach (size_t index, shards.keys()) {
+      if (index >= flags.registry_shards) {
+        obsolete.push_back(shards.at(index));
+        shards.erase(index);
+      }
+    }
+
+    // The stored registry includes all the deltas, so they are no
+    // longer needed. If expunging fails, the deltas and shards get
+    // ignored (and expunged) when recovering.
+    foreach (const Variable& obsoleteVariable, obsolete) {
+      state->expunge(obsoleteVariable)
+        .onFailed([](const string& failure) {
+          LOG(WARNING) << "Failed to expunge registry delta or shard: "
+                       << failure;
+        });
+    }
+
+    deltas = 0;
+    obsolete.clear();
+    dirty.clear();
+  }
 
-  variable = store->get();
   registry->Swap(updatedRegistry.get());
 
   // Remove the operations.
@@ -66,6 +66,11 @@ public:
   // Sets the promise based on whether the operation was successful.
   bool set() { return process::Promise<bool>::set(success); }
 
+  // Returns the operation as it gets stored in a `RegistryDelta`, or
+  // none if the operation can not be stored in a delta, in which case
+  // the full registry gets stored when the operation is applied.
+  virtual Option<RegistryDelta::Operation> delta() const { return None(); }
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* slaveIDs) = 0;
 
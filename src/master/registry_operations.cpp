@@ -15,11 +15,15 @@
 // limitations under the License.
 
 #include <stout/check.hpp>
+#include <stout/foreach.hpp>
+#include <stout/stringify.hpp>
 
 #include "master/registry_operations.hpp"
 
 #include "common/resources_utils.hpp"
 
+using process::Owned;
+
 namespace mesos {
 namespace internal {
 namespace master {
@@ -51,6 +55,15 @@ Try<bool> AdmitSlave::perform(Registry* registry, hashset<SlaveID>* slaveIDs)
 }
 
 
+Option<RegistryDelta::Operation> AdmitSlave::delta() const
+{
+  RegistryDelta::Operation operation;
+  operation.set_type(RegistryDelta::Operation::ADMIT_SLAVE);
+  operation.mutable_slave_info()->CopyFrom(info);
+  return operation;
+}
+
+
 UpdateSlave::UpdateSlave(const SlaveInfo& _info) : info(_info)
 {
   CHECK(info.has_id()) << "SlaveInfo is missing the 'id' field";
@@ -92,6 +105,15 @@ Try<bool> UpdateSlave::perform(Registry* registry, hashset<SlaveID>* slaveIDs)
 }
 
 
+Option<RegistryDelta::Operation> UpdateSlave::delta() const
+{
+  RegistryDelta::Operation operation;
+  operation.set_type(RegistryDelta::Operation::UPDATE_SLAVE);
+  operation.mutable_slave_info()->CopyFrom(info);
+  return operation;
+}
+
+
 // Move a slave from the list of admitted slaves to the list of
 // unreachable slaves.
 MarkSlaveUnreachable::MarkSlaveUnreachable(
@@ -137,6 +159,16 @@ Try<bool> MarkSlaveUnreachable::perform(
 }
 
 
+Option<RegistryDelta::Operation> MarkSlaveUnreachable::delta() const
+{
+  RegistryDelta::Operation operation;
+  operation.set_type(RegistryDelta::Operation::MARK_SLAVE_UNREACHABLE);
+  operation.mutable_slave_info()->CopyFrom(info);
+  operation.mutable_timestamp()->CopyFrom(unreachableTime);
+  return operation;
+}
+
+
 // Add a slave back to the list of admitted slaves. The slave will
 // typically be in the "unreachable" list; if so, it is removed from
 // that list. The slave might also be in the "admitted" list already.
@@ -198,6 +230,15 @@ Try<bool> MarkSlaveReachable::perform(
 }
 
 
+Option<RegistryDelta::Operation> MarkSlaveReachable::delta() const
+{
+  RegistryDelta::Operation operation;
+  operation.set_type(RegistryDelta::Operation::MARK_SLAVE_REACHABLE);
+  operation.mutable_slave_info()->CopyFrom(info);
+  return operation;
+}
+
+
 Prune::Prune(
     const hashset<SlaveID>& _toRemoveUnreachable,
     const hashset<SlaveID>& _toRemoveGone)
@@ -257,6 +298,23 @@ Try<bool> Prune::perform(Registry* registry, hashset<SlaveID>* /*slaveIDs*/)
 }
 
 
+Option<RegistryDelta::Operation> Prune::delta() const
+{
+  RegistryDelta::Operation operation;
+  operation.set_type(RegistryDelta::Operation::PRUNE);
+
+  foreach (const SlaveID& id, toRemoveUnreachable) {
+    operation.add_unreachable()->CopyFrom(id);
+  }
+
+  foreach (const SlaveID& id, toRemoveGone) {
+    operation.add_gone()->CopyFrom(id);
+  }
+
+  return operation;
+}
+
+
 RemoveSlave::RemoveSlave(const SlaveInfo& _info)
   : info(_info)
 {
@@ -283,6 +341,15 @@ Try<bool> RemoveSlave::perform(
 }
 
 
+Option<RegistryDelta::Operation> RemoveSlave::delta() const
+{
+  RegistryDelta::Operation operation;
+  operation.set_type(RegistryDelta::Operation::REMOVE_SLAVE);
+  operation.mutable_slave_info()->CopyFrom(info);
+  return operation;
+}
+
+
 MarkSlaveGone::MarkSlaveGone(
     const SlaveID& _id,
     const TimeInfo& _goneTime)
@@ -347,6 +414,56 @@ Try<bool> MarkSlaveGone::perform(Registry* registry, hashset<SlaveID>* slaveIDs)
   return Error("Failed to find agent " + stringify(id));
 }
 
+
+Option<RegistryDelta::Operation> MarkSlaveGone::delta() const
+{
+  RegistryDelta::Operation operation;
+  operation.set_type(RegistryDelta::Operation::MARK_SLAVE_GONE);
+  operation.mutable_slave_id()->CopyFrom(id);
+  operation.mutable_timestamp()->CopyFrom(goneTime);
+  return operation;
+}
+
+
+Try<Owned<RegistryOperation>> createOperation(
+    const RegistryDelta::Operation& operation)
+{
+  switch (operation.type()) {
+    case RegistryDelta::Operation::ADMIT_SLAVE:
+      return Owned<RegistryOperation>(new AdmitSlave(operation.slave_info()));
+    case RegistryDelta::Operation::UPDATE_SLAVE:
+      return Owned<RegistryOperation>(new UpdateSlave(operation.slave_info()));
+    case RegistryDelta::Operation::MARK_SLAVE_UNREACHABLE:
+      return Owned<RegistryOperation>(new MarkSlaveUnreachable(
+          operation.slave_info(), operation.timestamp()));
+    case RegistryDelta::Operation::MARK_SLAVE_REACHABLE:
+      return Owned<RegistryOperation>(
+          new MarkSlaveReachable(operation.slave_info()));
+    case RegistryDelta::Operation::MARK_SLAVE_GONE:
+      return Owned<RegistryOperation>(new MarkSlaveGone(
+          operation.slave_id(), operation.timestamp()));
+    case RegistryDelta::Operation::REMOVE_SLAVE:
+      return Owned<RegistryOperation>(new RemoveSlave(operation.slave_info()));
+    case RegistryDelta::Operation::PRUNE: {
+      hashset<SlaveID> unreachable;
+      foreach (const SlaveID& id, operation.unreachable()) {
+        unreachable.insert(id);
+      }
+
+      hashset<SlaveID> gone;
+      foreach (const SlaveID& id, operation.gone()) {
+        gone.insert(id);
+      }
+
+      return Owned<RegistryOperation>(new Prune(unreachable, gone));
+    }
+    case RegistryDelta::Operation::UNKNOWN:
+      break;
+  }
+
+  return Error("Unknown registry operation " + stringify(operation.type()));
+}
+
 } // namespace master {
 } // namespace internal {
 } // namespace mesos {
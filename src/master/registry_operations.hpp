@@ -20,7 +20,14 @@
 #include <mesos/mesos.hpp>
 #include <mesos/type_utils.hpp>
 
+#include <process/owned.hpp>
+
+#include <stout/hashset.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
 #include "master/registrar.hpp"
+#include "master/registry.hpp"
 
 
 namespace mesos {
@@ -33,6 +40,8 @@ class AdmitSlave : public RegistryOperation
 public:
   explicit AdmitSlave(const SlaveInfo& _info);
 
+  virtual Option<RegistryDelta::Operation> delta() const;
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* slaveIDs);
 
@@ -47,6 +56,8 @@ class UpdateSlave : public RegistryOperation
 public:
   explicit UpdateSlave(const SlaveInfo& _info);
 
+  virtual Option<RegistryDelta::Operation> delta() const;
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* slaveIDs);
 
@@ -64,6 +75,8 @@ public:
       const SlaveInfo& _info,
       const TimeInfo& _unreachableTime);
 
+  virtual Option<RegistryDelta::Operation> delta() const;
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* slaveIDs);
 
@@ -84,6 +97,8 @@ class MarkSlaveReachable : public RegistryOperation
 public:
   explicit MarkSlaveReachable(const SlaveInfo& _info);
 
+  virtual Option<RegistryDelta::Operation> delta() const;
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* slaveIDs);
 
@@ -99,6 +114,8 @@ public:
       const hashset<SlaveID>& _toRemoveUnreachable,
       const hashset<SlaveID>& _toRemoveGone);
 
+  virtual Option<RegistryDelta::Operation> delta() const;
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* /*slaveIDs*/);
 
@@ -113,6 +130,8 @@ class RemoveSlave : public RegistryOperation
 public:
   explicit RemoveSlave(const SlaveInfo& _info);
 
+  virtual Option<RegistryDelta::Operation> delta() const;
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* slaveIDs);
 
@@ -128,6 +147,8 @@ class MarkSlaveGone : public RegistryOperation
 public:
   MarkSlaveGone(const SlaveID& _id, const TimeInfo& _goneTime);
 
+  virtual Option<RegistryDelta::Operation> delta() const;
+
 protected:
   virtual Try<bool> perform(Registry* registry, hashset<SlaveID>* slaveIDs);
 
@@ -136,6 +157,12 @@ private:
   const TimeInfo goneTime;
 };
 
+
+// Returns the registry operation of the given operation of a
+// `RegistryDelta`, see `RegistryOperation::delta`.
+Try<process::Owned<RegistryOperation>> createOperation(
+    const RegistryDelta::Operation& operation);
+
 } // namespace master {
 } // namespace internal {
 } // namespace mesos {
@@ -16,6 +16,8 @@
 
 #include <string>
 
+#include <process/clock.hpp>
+
 #include <process/metrics/pull_gauge.hpp>
 #include <process/metrics/metrics.hpp>
 
@@ -32,30 +34,32 @@ namespace slave {
 
 using process::metrics::PullGauge;
 
-Metrics::Metrics(const Slave& slave)
-  : uptime_secs(
+Metrics::Metrics(Slave& slave)
+  : publisher(slave),
+    uptime_secs(publisher.gauge(
         "slave/uptime_secs",
-        defer(slave, &Slave::_uptime_secs)),
-    registered(
+        [&slave]() { return slave.startTime.secs(); },
+        [](double start) { return process::Clock::now().secs() - start; })),
+    registered(publisher.gauge(
         "slave/registered",
-        defer(slave, &Slave::_registered)),
+        [&slave]() { return slave._registered(); })),
     recovery_errors(
         "slave/recovery_errors"),
-    frameworks_active(
+    frameworks_active(publisher.gauge(
         "slave/frameworks_active",
-        defer(slave, &Slave::_frameworks_active)),
-    tasks_staging(
+        [&slave]() { return slave._frameworks_active(); })),
+    tasks_staging(publisher.gauge(
         "slave/tasks_staging",
-        defer(slave, &Slave::_tasks_staging)),
-    tasks_starting(
+        [&slave]() { return slave._tasks_staging(); })),
+    tasks_starting(publisher.gauge(
         "slave/tasks_starting",
-        defer(slave, &Slave::_tasks_starting)),
-    tasks_running(
+        [&slave]() { return slave._tasks_starting(); })),
+    tasks_running(publisher.gauge(
         "slave/tasks_running",
-        defer(slave, &Slave::_tasks_running)),
-    tasks_killing(
+        [&slave]() { return slave._tasks_running(); })),
+    tasks_killing(publisher.gauge(
         "slave/tasks_killing",
-        defer(slave, &Slave::_tasks_killing)),
+        [&slave]() { return slave._tasks_killing(); })),
     tasks_finished(
         "slave/tasks_finished"),
     tasks_failed(
@@ -66,15 +70,15 @@ Metrics::Metrics(const Slave& slave)
         "slave/tasks_lost"),
     tasks_gone(
         "slave/tasks_gone"),
-    executors_registering(
+    executors_registering(publisher.gauge(
         "slave/executors_registering",
-        defer(slave, &Slave::_executors_registering)),
-    executors_running(
+        [&slave]() { return slave._executors_registering(); })),
+    executors_running(publisher.gauge(
         "slave/executors_running",
-        defer(slave, &Slave::_executors_running)),
-    executors_terminating(
+        [&slave]() { return slave._executors_running(); })),
+    executors_terminating(publisher.gauge(
         "slave/executors_terminating",
-        defer(slave, &Slave::_executors_terminating)),
+        [&slave]() { return slave._executors_terminating(); })),
     executors_terminated(
         "slave/executors_terminated"),
     executors_preempted(
@@ -87,9 +91,11 @@ Metrics::Metrics(const Slave& slave)
         "slave/valid_framework_messages"),
     invalid_framework_messages(
         "slave/invalid_framework_messages"),
-    executor_directory_max_allowed_age_secs(
+    executor_directory_max_allowed_age_secs(publisher.gauge(
         "slave/executor_directory_max_allowed_age_secs",
-        defer(slave, &Slave::_executor_directory_max_allowed_age_secs)),
+        [&slave]() {
+          return slave._executor_directory_max_allowed_age_secs();
+        })),
     container_launch_errors(
         "slave/container_launch_errors")
 {
@@ -133,17 +139,23 @@ Metrics::Metrics(const Slave& slave)
   const string resources[] = {"cpus", "gpus", "mem", "disk"};
 
   foreach (const string& resource, resources) {
-    PullGauge total(
+    PullGauge total = publisher.gauge(
         "slave/" + resource + "_total",
-        defer(slave, &Slave::_resources_total, resource));
+        [&slave, resource]() {
+          return slave._resources_total(resource);
+        });
 
-    PullGauge used(
+    PullGauge used = publisher.gauge(
         "slave/" + resource + "_used",
-        defer(slave, &Slave::_resources_used, resource));
+        [&slave, resource]() {
+          return slave._resources_used(resource);
+        });
 
-    PullGauge percent(
+    PullGauge percent = publisher.gauge(
         "slave/" + resource + "_percent",
-        defer(slave, &Slave::_resources_percent, resource));
+        [&slave, resource]() {
+          return slave._resources_percent(resource);
+        });
 
     resources_total.push_back(total);
     resources_used.push_back(used);
@@ -155,17 +167,23 @@ Metrics::Metrics(const Slave& slave)
   }
 
   foreach (const string& resource, resources) {
-    PullGauge total(
+    PullGauge total = publisher.gauge(
         "slave/" + resource + "_revocable_total",
-        defer(slave, &Slave::_resources_revocable_total, resource));
+        [&slave, resource]() {
+          return slave._resources_revocable_total(resource);
+        });
 
-    PullGauge used(
+    PullGauge used = publisher.gauge(
         "slave/" + resource + "_revocable_used",
-        defer(slave, &Slave::_resources_revocable_used, resource));
+        [&slave, resource]() {
+          return slave._resources_revocable_used(resource);
+        });
 
-    PullGauge percent(
+    PullGauge percent = publisher.gauge(
         "slave/" + resource + "_revocable_percent",
-        defer(slave, &Slave::_resources_revocable_percent, resource));
+        [&slave, resource]() {
+          return slave._resources_revocable_percent(resource);
+        });
 
     resources_revocable_total.push_back(total);
     resources_revocable_used.push_back(used);
@@ -256,9 +274,9 @@ void Metrics::setRecoveryTime(const Duration& duration)
 
   const double recovery_seconds = duration.secs();
 
-  recovery_time_secs = process::metrics::PullGauge(
+  recovery_time_secs = PullGauge::sampled(
         "slave/recovery_time_secs",
-        [recovery_seconds]() { return recovery_seconds;});
+        [recovery_seconds]() { return recovery_seconds; });
 
   process::metrics::add(recovery_time_secs.get());
 }
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include <process/metrics/counter.hpp>
+#include <process/metrics/publisher.hpp>
 #include <process/metrics/pull_gauge.hpp>
 
 
@@ -31,12 +32,16 @@ class Slave;
 
 struct Metrics
 {
-  explicit Metrics(const Slave& slave);
+  explicit Metrics(Slave& slave);
 
   ~Metrics();
 
   void setRecoveryTime(const Duration& duration);
 
+  // Publishes the values of the gauges computed from the agent's
+  // state, once per burst of events served by the agent.
+  process::metrics::Publisher publisher;
+
   process::metrics::PullGauge uptime_secs;
   process::metrics::PullGauge registered;
 
@@ -663,6 +663,10 @@ void Slave::initialize()
 
   startTime = Clock::now();
 
+  // Publish the start time for the uptime, the other gauges get
+  // published once the agent serves its first events.
+  metrics.publisher.publish();
+
   // Install protobuf handlers.
   install<SlaveRegisteredMessage>(
       &Slave::registered,
@@ -22,6 +22,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/circular_buffer.hpp>
@@ -46,6 +47,7 @@
 
 #include <mesos/v1/executor/executor.hpp>
 
+#include <process/event.hpp>
 #include <process/http.hpp>
 #include <process/future.hpp>
 #include <process/owned.hpp>
@@ -425,6 +427,14 @@ public:
   virtual void finalize();
   virtual void exited(const process::UPID& pid);
 
+  void serve(process::Event&& event) override
+  {
+    ProtobufProcess<Slave>::serve(std::move(event));
+
+    // Publish the gauges once the queued events have been served.
+    metrics.publisher.served();
+  }
+
   process::Future<Secret> generateSecret(
       const FrameworkID& frameworkId,
       const ExecutorID& executorId,
@@ -680,11 +690,6 @@ private:
     return static_cast<double>(frameworks.size());
   }
 
-  double _uptime_secs()
-  {
-    return (process::Clock::now() - startTime).secs();
-  }
-
   double _registered()
   {
     return master.isSome() ? 1 : 0;
@@ -0,0 +1,196 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <mesos/resources.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/gtest.hpp>
+#include <stout/hashset.hpp>
+
+#include "master/allocator/mesos/agent_index.hpp"
+
+#include "tests/mesos.hpp"
+
+using mesos::internal::master::allocator::internal::AgentShapeIndex;
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace tests {
+
+// Returns the candidate agents as a set.
+static hashset<SlaveID> agents(const AgentShapeIndex::Candidates& candidates)
+{
+  hashset<SlaveID> result;
+
+  foreach (const hashset<SlaveID>* slaveIds, candidates.agents()) {
+    foreach (const SlaveID& slaveId, *slaveIds) {
+      EXPECT_TRUE(candidates.contains(slaveId));
+      result.insert(slaveId);
+    }
+  }
+
+  EXPECT_EQ(result.size(), candidates.size());
+
+  return result;
+}
+
+
+static SlaveID createSlaveId(const string& value)
+{
+  SlaveID slaveId;
+  slaveId.set_value(value);
+  return slaveId;
+}
+
+
+// Without minimum allocatable resources, all agents are candidates,
+// even those without any available resources.
+TEST(AgentShapeIndexTest, NoMinAllocatableResources)
+{
+  AgentShapeIndex index;
+
+  const SlaveID agent1 = createSlaveId("agent1");
+  const SlaveID agent2 = createSlaveId("agent2");
+
+  const Resources total = Resources::parse("cpus:2;mem:1024").get();
+
+  index.update(agent1, total, total);
+  index.update(agent2, Resources(), total);
+
+  EXPECT_EQ(
+      hashset<SlaveID>({agent1, agent2}),
+      agents(index.candidates(None())));
+
+  EXPECT_EQ(
+      hashset<SlaveID>({agent1, agent2}),
+      agents(index.candidates(vector<Resources>())));
+}
+
+
+// Agents whose available resources cannot contain any of the minimum
+// allocatable resources are not candidates, and their candidacy
+// follows the updates of their available resources.
+TEST(AgentShapeIndexTest, MinAllocatableResources)
+{
+  AgentShapeIndex index;
+
+  const SlaveID agent1 = createSlaveId("agent1");
+  const SlaveID agent2 = createSlaveId("agent2");
+  const SlaveID agent3 = createSlaveId("agent3");
+
+  const Resources total = Resources::parse("cpus:2;mem:1024").get();
+
+  const vector<Resources> minAllocatableResources = {
+    Resources::parse("cpus:1").get(),
+    Resources::parse("mem:512").get()
+  };
+
+  index.update(agent1, total, total);
+  index.update(agent2, Resources::parse("cpus:0.5;mem:256").get(), total);
+  index.update(agent3, Resources(), total);
+
+  AgentShapeIndex::Candidates candidates =
+    index.candidates(minAllocatableResources);
+
+  EXPECT_EQ(hashset<SlaveID>({agent1}), agents(candidates));
+  EXPECT_FALSE(candidates.contains(agent2));
+  EXPECT_FALSE(candidates.contains(agent3));
+  EXPECT_FALSE(candidates.contains(createSlaveId("unknown")));
+
+  // Only the memory of `agent3` is allocatable.
+  index.update(agent1, Resources(), total);
+  index.update(agent3, Resources::parse("mem:1024").get(), total);
+
+  EXPECT_EQ(
+      hashset<SlaveID>({agent3}),
+      agents(index.candidates(minAllocatableResources)));
+
+  index.remove(agent3);
+
+  EXPECT_TRUE(agents(index.candidates(minAllocatableResources)).empty());
+  EXPECT_EQ(
+      hashset<SlaveID>({agent1, agent2}),
+      agents(index.candidates(None())));
+}
+
+
+// The index only tracks power-of-two upper bounds of the available
+// cpus and memory, so it may return agents that do not actually have
+// the minimum allocatable resources, but never omits one that does.
+TEST(AgentShapeIndexTest, Conservative)
+{
+  AgentShapeIndex index;
+
+  const SlaveID agent1 = createSlaveId("agent1");
+  const SlaveID agent2 = createSlaveId("agent2");
+  const SlaveID agent3 = createSlaveId("agent3");
+
+  const Resources total = Resources::parse("cpus:4;mem:1024").get();
+
+  const vector<Resources> minAllocatableResources = {
+    Resources::parse("mem:64").get()
+  };
+
+  index.update(agent1, Resources::parse("mem:64").get(), total);
+  index.update(agent2, Resources::parse("mem:48").get(), total);
+  index.update(agent3, Resources::parse("mem:32").get(), total);
+
+  EXPECT_EQ(
+      hashset<SlaveID>({agent1, agent2}),
+      agents(index.candidates(minAllocatableResources)));
+}
+
+
+// Whether reserved and revocable resources are allocatable depends
+// on the role and the framework, so agents with such resources are
+// always candidates.
+TEST(AgentShapeIndexTest, ReservedAndRevocable)
+{
+  AgentShapeIndex index;
+
+  const SlaveID agent1 = createSlaveId("agent1");
+  const SlaveID agent2 = createSlaveId("agent2");
+
+  const Resources reserved = Resources::parse("cpus(role1):0.1").get();
+
+  Resource cpus = Resources::parse("cpus", "0.1", "*").get();
+  cpus.mutable_revocable();
+
+  const Resources revocable = cpus;
+
+  index.update(agent1, reserved, reserved);
+  index.update(agent2, revocable, revocable);
+
+  const vector<Resources> minAllocatableResources = {
+    Resources::parse("cpus:1").get()
+  };
+
+  EXPECT_EQ(
+      hashset<SlaveID>({agent1, agent2}),
+      agents(index.candidates(minAllocatableResources)));
+}
+
+} // namespace tests {
+} // namespace internal {
+} // namespace mesos {
@@ -45,7 +45,7 @@ namespace tests {
 
 ACTION_P(InvokeInitialize, allocator)
 {
-  allocator->real->initialize(arg0, arg1, arg2, arg3, arg4, arg5, arg6);
+  allocator->real->initialize(arg0, arg1, arg2);
 }
 
 
@@ -235,9 +235,9 @@ public:
     // to get the best of both worlds: the ability to use 'DoDefault'
     // and no warnings when expectations are not explicit.
 
-    ON_CALL(*this, initialize(_, _, _, _, _, _, _))
+    ON_CALL(*this, initialize(_, _, _))
       .WillByDefault(InvokeInitialize(this));
-    EXPECT_CALL(*this, initialize(_, _, _, _, _, _, _))
+    EXPECT_CALL(*this, initialize(_, _, _))
       .WillRepeatedly(DoDefault());
 
     ON_CALL(*this, recover(_, _))
@@ -368,18 +368,40 @@ public:
 
   virtual ~TestAllocator() {}
 
-  MOCK_METHOD7(initialize, void(
-      const Duration&,
+  void initialize(
+      const Duration& allocationInterval,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<std::string, hashmap<SlaveID, Resources>>&)>&
+                   offerCallback,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, UnavailableResources>&)>&
+        inverseOfferCallback,
+      const Option<std::set<std::string>>& fairnessExcludeResourceNames,
+      bool filterGpuResources,
+      const Option<DomainInfo>& domain,
+      const Option<std::vector<Resources>>& minAllocatableResources)
+  {
+    mesos::allocator::Options options;
+
+    options.allocationInterval = allocationInterval;
+    options.fairnessExcludeResourceNames = fairnessExcludeResourceNames;
+    options.filterGpuResources = filterGpuResources;
+    options.domain = domain;
+    options.minAllocatableResources = minAllocatableResources;
+
+    initialize(options, offerCallback, inverseOfferCallback);
+  }
+
+  MOCK_METHOD3(initialize, void(
+      const mesos::allocator::Options&,
       const lambda::function<
           void(const FrameworkID&,
                const hashmap<std::string, hashmap<SlaveID, Resources>>&)>&,
       const lambda::function<
           void(const FrameworkID&,
-               const hashmap<SlaveID, UnavailableResources>&)>&,
-      const Option<std::set<std::string>>&,
-      bool,
-      const Option<DomainInfo>&,
-      const Option<std::vector<Resources>>&));
+               const hashmap<SlaveID, UnavailableResources>&)>&));
 
   MOCK_METHOD2(recover, void(
       const int expectedAgentCount,
@@ -76,6 +76,7 @@ using mesos::internal::devolve;
 using mesos::internal::evolve;
 
 using mesos::internal::master::DEFAULT_HEARTBEAT_INTERVAL;
+using mesos::internal::master::SUBSCRIBER_APPROVERS_TTL;
 
 using mesos::internal::recordio::Reader;
 
@@ -105,7 +106,6 @@ using testing::AtMost;
 using testing::DoAll;
 using testing::Eq;
 using testing::Return;
-using testing::Sequence;
 using testing::WithParamInterface;
 
 namespace mesos {
@@ -1196,7 +1196,7 @@ TEST_P(MasterAPITest, ReserveResources)
 {
   TestAllocator<> allocator;
 
-  EXPECT_CALL(allocator, initialize(_, _, _, _, _, _, _));
+  EXPECT_CALL(allocator, initialize(_, _, _));
 
   Try<Owned<cluster::Master>> master = StartMaster(&allocator);
   ASSERT_SOME(master);
@@ -1287,7 +1287,7 @@ TEST_P(MasterAPITest, UnreserveResources)
 {
   TestAllocator<> allocator;
 
-  EXPECT_CALL(allocator, initialize(_, _, _, _, _, _, _));
+  EXPECT_CALL(allocator, initialize(_, _, _));
 
   Try<Owned<cluster::Master>> master = StartMaster(&allocator);
   ASSERT_SOME(master);
@@ -1858,6 +1858,525 @@ TEST_P(MasterAPITest, SubscribeAgentEvents)
 }
 
 
+// This test verifies that subscribers which filter the event types
+// only receive the events of these types.
+TEST_P(MasterAPITest, SubscribeEventTypesFiltering)
+{
+  ContentType contentType = GetParam();
+
+  Try<Owned<cluster::Master>> master = this->StartMaster();
+  ASSERT_SOME(master);
+
+  v1::master::Call v1Call;
+  v1Call.set_type(v1::master::Call::SUBSCRIBE);
+  v1Call.mutable_subscribe()->add_event_types(
+      v1::master::Event::AGENT_REMOVED);
+
+  http::Headers headers = createBasicAuthHeaders(DEFAULT_CREDENTIAL);
+
+  headers["Accept"] = stringify(contentType);
+
+  Future<http::Response> response = http::streaming::post(
+      master.get()->pid,
+      "api/v1",
+      headers,
+      serialize(contentType, v1Call),
+      stringify(contentType));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  ASSERT_EQ(http::Response::PIPE, response->type);
+  ASSERT_SOME(response->reader);
+
+  http::Pipe::Reader reader = response->reader.get();
+
+  auto deserializer =
+    lambda::bind(deserialize<v1::master::Event>, contentType, lambda::_1);
+
+  Reader<v1::master::Event> decoder(
+      Decoder<v1::master::Event>(deserializer), reader);
+
+  // The `SUBSCRIBED` and `HEARTBEAT` events are always sent.
+  Future<Result<v1::master::Event>> event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::SUBSCRIBED, event->get().type());
+
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::HEARTBEAT, event->get().type());
+
+  Future<SlaveRegisteredMessage> agentRegisteredMessage =
+    FUTURE_PROTOBUF(SlaveRegisteredMessage(), master.get()->pid, _);
+
+  Owned<MasterDetector> detector = master.get()->createDetector();
+  Try<Owned<cluster::Slave>> slave = StartSlave(detector.get());
+  ASSERT_SOME(slave);
+
+  AWAIT_READY(agentRegisteredMessage);
+
+  // Forcefully trigger a shutdown on the slave so that master will remove it.
+  slave.get()->shutdown();
+  slave->reset();
+
+  // The `AGENT_ADDED` event is not sent.
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  ASSERT_EQ(v1::master::Event::AGENT_REMOVED, event->get().type());
+  EXPECT_EQ(
+      evolve(agentRegisteredMessage->slave_id()),
+      event->get().agent_removed().agent_id());
+}
+
+
+// This test verifies that subscribers which filter the frameworks only
+// receive the events of these frameworks.
+TEST_P(MasterAPITest, SubscribeFrameworkIdsFiltering)
+{
+  ContentType contentType = GetParam();
+
+  Try<Owned<cluster::Master>> master = this->StartMaster();
+  ASSERT_SOME(master);
+
+  // Start the framework whose events get subscribed to.
+  auto scheduler1 = std::make_shared<v1::MockHTTPScheduler>();
+
+  EXPECT_CALL(*scheduler1, connected(_))
+    .WillOnce(v1::scheduler::SendSubscribe(v1::DEFAULT_FRAMEWORK_INFO));
+
+  Future<v1::scheduler::Event::Subscribed> subscribed1;
+  EXPECT_CALL(*scheduler1, subscribed(_, _))
+    .WillOnce(FutureArg<1>(&subscribed1));
+
+  EXPECT_CALL(*scheduler1, heartbeat(_))
+    .WillRepeatedly(Return()); // Ignore heartbeats.
+
+  v1::scheduler::TestMesos mesos1(
+      master.get()->pid,
+      contentType,
+      scheduler1);
+
+  AWAIT_READY(subscribed1);
+
+  const v1::FrameworkID frameworkId1 = subscribed1->framework_id();
+
+  v1::master::Call v1Call;
+  v1Call.set_type(v1::master::Call::SUBSCRIBE);
+  v1Call.mutable_subscribe()->add_framework_ids()->CopyFrom(frameworkId1);
+
+  http::Headers headers = createBasicAuthHeaders(DEFAULT_CREDENTIAL);
+
+  headers["Accept"] = stringify(contentType);
+
+  Future<http::Response> response = http::streaming::post(
+      master.get()->pid,
+      "api/v1",
+      headers,
+      serialize(contentType, v1Call),
+      stringify(contentType));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  ASSERT_EQ(http::Response::PIPE, response->type);
+  ASSERT_SOME(response->reader);
+
+  http::Pipe::Reader reader = response->reader.get();
+
+  auto deserializer =
+    lambda::bind(deserialize<v1::master::Event>, contentType, lambda::_1);
+
+  Reader<v1::master::Event> decoder(
+      Decoder<v1::master::Event>(deserializer), reader);
+
+  Future<Result<v1::master::Event>> event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::SUBSCRIBED, event->get().type());
+
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::HEARTBEAT, event->get().type());
+
+  // Start another framework, whose `FRAMEWORK_ADDED` event is not sent.
+  auto scheduler2 = std::make_shared<v1::MockHTTPScheduler>();
+
+  EXPECT_CALL(*scheduler2, connected(_))
+    .WillOnce(v1::scheduler::SendSubscribe(v1::DEFAULT_FRAMEWORK_INFO));
+
+  Future<v1::scheduler::Event::Subscribed> subscribed2;
+  EXPECT_CALL(*scheduler2, subscribed(_, _))
+    .WillOnce(FutureArg<1>(&subscribed2));
+
+  EXPECT_CALL(*scheduler2, heartbeat(_))
+    .WillRepeatedly(Return()); // Ignore heartbeats.
+
+  v1::scheduler::TestMesos mesos2(
+      master.get()->pid,
+      contentType,
+      scheduler2);
+
+  AWAIT_READY(subscribed2);
+
+  Future<Nothing> disconnected;
+  EXPECT_CALL(*scheduler1, disconnected(_))
+    .WillOnce(FutureSatisfy(&disconnected));
+
+  // Tear down the first framework, whose `FRAMEWORK_REMOVED` event is
+  // the next event sent.
+  {
+    Future<http::Response> response = process::http::post(
+        master.get()->pid,
+        "teardown",
+        createBasicAuthHeaders(DEFAULT_CREDENTIAL),
+        "frameworkId=" + frameworkId1.value());
+
+    AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  }
+
+  AWAIT_READY(disconnected);
+
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  ASSERT_EQ(v1::master::Event::FRAMEWORK_REMOVED, event->get().type());
+  EXPECT_EQ(
+      frameworkId1,
+      event->get().framework_removed().framework_info().id());
+}
+
+
+// This test verifies that subscribers which filter the roles only
+// receive the events of the frameworks subscribed to these roles.
+TEST_P(MasterAPITest, SubscribeRolesFiltering)
+{
+  ContentType contentType = GetParam();
+
+  Try<Owned<cluster::Master>> master = this->StartMaster();
+  ASSERT_SOME(master);
+
+  v1::master::Call v1Call;
+  v1Call.set_type(v1::master::Call::SUBSCRIBE);
+  v1Call.mutable_subscribe()->add_roles("role1");
+
+  http::Headers headers = createBasicAuthHeaders(DEFAULT_CREDENTIAL);
+
+  headers["Accept"] = stringify(contentType);
+
+  Future<http::Response> response = http::streaming::post(
+      master.get()->pid,
+      "api/v1",
+      headers,
+      serialize(contentType, v1Call),
+      stringify(contentType));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  ASSERT_EQ(http::Response::PIPE, response->type);
+  ASSERT_SOME(response->reader);
+
+  http::Pipe::Reader reader = response->reader.get();
+
+  auto deserializer =
+    lambda::bind(deserialize<v1::master::Event>, contentType, lambda::_1);
+
+  Reader<v1::master::Event> decoder(
+      Decoder<v1::master::Event>(deserializer), reader);
+
+  Future<Result<v1::master::Event>> event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::SUBSCRIBED, event->get().type());
+
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::HEARTBEAT, event->get().type());
+
+  // Start a framework of another role, whose `FRAMEWORK_ADDED` event
+  // is not sent.
+  v1::FrameworkInfo frameworkInfo1 = v1::DEFAULT_FRAMEWORK_INFO;
+  frameworkInfo1.set_roles(0, "role2");
+
+  auto scheduler1 = std::make_shared<v1::MockHTTPScheduler>();
+
+  EXPECT_CALL(*scheduler1, connected(_))
+    .WillOnce(v1::scheduler::SendSubscribe(frameworkInfo1));
+
+  Future<v1::scheduler::Event::Subscribed> subscribed1;
+  EXPECT_CALL(*scheduler1, subscribed(_, _))
+    .WillOnce(FutureArg<1>(&subscribed1));
+
+  EXPECT_CALL(*scheduler1, heartbeat(_))
+    .WillRepeatedly(Return()); // Ignore heartbeats.
+
+  v1::scheduler::TestMesos mesos1(
+      master.get()->pid,
+      contentType,
+      scheduler1);
+
+  AWAIT_READY(subscribed1);
+
+  // Start a framework of the subscribed role.
+  v1::FrameworkInfo frameworkInfo2 = v1::DEFAULT_FRAMEWORK_INFO;
+  frameworkInfo2.set_roles(0, "role1");
+
+  auto scheduler2 = std::make_shared<v1::MockHTTPScheduler>();
+
+  EXPECT_CALL(*scheduler2, connected(_))
+    .WillOnce(v1::scheduler::SendSubscribe(frameworkInfo2));
+
+  Future<v1::scheduler::Event::Subscribed> subscribed2;
+  EXPECT_CALL(*scheduler2, subscribed(_, _))
+    .WillOnce(FutureArg<1>(&subscribed2));
+
+  EXPECT_CALL(*scheduler2, heartbeat(_))
+    .WillRepeatedly(Return()); // Ignore heartbeats.
+
+  v1::scheduler::TestMesos mesos2(
+      master.get()->pid,
+      contentType,
+      scheduler2);
+
+  AWAIT_READY(subscribed2);
+
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  ASSERT_EQ(v1::master::Event::FRAMEWORK_ADDED, event->get().type());
+
+  const v1::FrameworkInfo& frameworkInfo =
+    event->get().framework_added().framework().framework_info();
+
+  EXPECT_EQ(subscribed2->framework_id(), frameworkInfo.id());
+  ASSERT_EQ(1, frameworkInfo.roles_size());
+  EXPECT_EQ("role1", frameworkInfo.roles(0));
+}
+
+
+// An object approver which does not authorize any object.
+class RejectingObjectApprover : public ObjectApprover
+{
+public:
+  virtual Try<bool> approved(
+      const Option<ObjectApprover::Object>& object) const noexcept override
+  {
+    return false;
+  }
+};
+
+
+// This test verifies that subscribers keep using their approvers until
+// these expire, i.e., the changes of the permissions of a subscriber
+// take effect after `SUBSCRIBER_APPROVERS_TTL`.
+TEST_P(MasterAPITest, SubscribeApproversRefresh)
+{
+  Clock::pause();
+
+  ContentType contentType = GetParam();
+
+  MockAuthorizer authorizer;
+  Try<Owned<cluster::Master>> master = StartMaster(&authorizer);
+  ASSERT_SOME(master);
+
+  // The subscriber is not permitted to view frameworks at first.
+  EXPECT_CALL(authorizer, getObjectApprover(_, authorization::VIEW_FRAMEWORK))
+    .WillOnce(Return(Owned<ObjectApprover>(new RejectingObjectApprover())));
+
+  v1::master::Call v1Call;
+  v1Call.set_type(v1::master::Call::SUBSCRIBE);
+
+  http::Headers headers = createBasicAuthHeaders(DEFAULT_CREDENTIAL);
+
+  headers["Accept"] = stringify(contentType);
+
+  Future<http::Response> response = http::streaming::post(
+      master.get()->pid,
+      "api/v1",
+      headers,
+      serialize(contentType, v1Call),
+      stringify(contentType));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  ASSERT_EQ(http::Response::PIPE, response->type);
+  ASSERT_SOME(response->reader);
+
+  http::Pipe::Reader reader = response->reader.get();
+
+  auto deserializer =
+    lambda::bind(deserialize<v1::master::Event>, contentType, lambda::_1);
+
+  Reader<v1::master::Event> decoder(
+      Decoder<v1::master::Event>(deserializer), reader);
+
+  Future<Result<v1::master::Event>> event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::SUBSCRIBED, event->get().type());
+
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::HEARTBEAT, event->get().type());
+
+  // Permit the subscriber to view frameworks.
+  EXPECT_CALL(authorizer, getObjectApprover(_, authorization::VIEW_FRAMEWORK))
+    .WillRepeatedly(Return(Owned<ObjectApprover>(
+        new AcceptingObjectApprover())));
+
+  auto scheduler = std::make_shared<v1::MockHTTPScheduler>();
+
+  EXPECT_CALL(*scheduler, connected(_))
+    .WillOnce(v1::scheduler::SendSubscribe(v1::DEFAULT_FRAMEWORK_INFO));
+
+  Future<v1::scheduler::Event::Subscribed> subscribed;
+  EXPECT_CALL(*scheduler, subscribed(_, _))
+    .WillOnce(FutureArg<1>(&subscribed));
+
+  EXPECT_CALL(*scheduler, heartbeat(_))
+    .WillRepeatedly(Return()); // Ignore heartbeats.
+
+  v1::scheduler::TestMesos mesos(
+      master.get()->pid,
+      contentType,
+      scheduler);
+
+  AWAIT_READY(subscribed);
+
+  // The `FRAMEWORK_ADDED` event is not sent, since the subscriber still
+  // uses the approvers which were created before the change.
+  event = decoder.read();
+
+  Clock::settle();
+
+  EXPECT_TRUE(event.isPending());
+
+  // Once the approvers expired, they get recreated for the next event.
+  // This also triggers a heartbeat, since the heartbeat interval is the
+  // same.
+  Clock::advance(SUBSCRIBER_APPROVERS_TTL);
+
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::HEARTBEAT, event->get().type());
+
+  Future<Nothing> disconnected;
+  EXPECT_CALL(*scheduler, disconnected(_))
+    .WillOnce(FutureSatisfy(&disconnected));
+
+  {
+    Future<http::Response> response = process::http::post(
+        master.get()->pid,
+        "teardown",
+        createBasicAuthHeaders(DEFAULT_CREDENTIAL),
+        "frameworkId=" + subscribed->framework_id().value());
+
+    AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  }
+
+  AWAIT_READY(disconnected);
+
+  event = decoder.read();
+  AWAIT_READY(event);
+
+  ASSERT_EQ(v1::master::Event::FRAMEWORK_REMOVED, event->get().type());
+  EXPECT_EQ(
+      subscribed->framework_id(),
+      event->get().framework_removed().framework_info().id());
+}
+
+
+// This test verifies that subscribers with different content types all
+// receive the events in their content type, although each event only
+// gets encoded once per content type.
+TEST_P(MasterAPITest, SubscribeContentTypes)
+{
+  ContentType contentType = GetParam();
+
+  ContentType otherContentType = contentType == ContentType::PROTOBUF
+    ? ContentType::JSON
+    : ContentType::PROTOBUF;
+
+  Try<Owned<cluster::Master>> master = this->StartMaster();
+  ASSERT_SOME(master);
+
+  v1::master::Call v1Call;
+  v1Call.set_type(v1::master::Call::SUBSCRIBE);
+
+  // The first two subscribers share the encoding of the events.
+  const vector<ContentType> contentTypes =
+    {contentType, contentType, otherContentType};
+
+  vector<Owned<Reader<v1::master::Event>>> decoders;
+
+  foreach (ContentType contentType_, contentTypes) {
+    http::Headers headers = createBasicAuthHeaders(DEFAULT_CREDENTIAL);
+
+    headers["Accept"] = stringify(contentType_);
+
+    Future<http::Response> response = http::streaming::post(
+        master.get()->pid,
+        "api/v1",
+        headers,
+        serialize(contentType_, v1Call),
+        stringify(contentType_));
+
+    AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+    ASSERT_EQ(http::Response::PIPE, response->type);
+    ASSERT_SOME(response->reader);
+
+    auto deserializer =
+      lambda::bind(deserialize<v1::master::Event>, contentType_, lambda::_1);
+
+    Owned<Reader<v1::master::Event>> decoder(new Reader<v1::master::Event>(
+        Decoder<v1::master::Event>(deserializer),
+        response->reader.get()));
+
+    Future<Result<v1::master::Event>> event = decoder->read();
+    AWAIT_READY(event);
+
+    EXPECT_EQ(v1::master::Event::SUBSCRIBED, event->get().type());
+
+    event = decoder->read();
+    AWAIT_READY(event);
+
+    EXPECT_EQ(v1::master::Event::HEARTBEAT, event->get().type());
+
+    decoders.push_back(decoder);
+  }
+
+  Future<SlaveRegisteredMessage> agentRegisteredMessage =
+    FUTURE_PROTOBUF(SlaveRegisteredMessage(), master.get()->pid, _);
+
+  Owned<MasterDetector> detector = master.get()->createDetector();
+  Try<Owned<cluster::Slave>> slave = StartSlave(detector.get());
+  ASSERT_SOME(slave);
+
+  AWAIT_READY(agentRegisteredMessage);
+
+  Option<v1::Resources> totalResources;
+
+  foreach (const Owned<Reader<v1::master::Event>>& decoder, decoders) {
+    Future<Result<v1::master::Event>> event = decoder->read();
+    AWAIT_READY(event);
+
+    ASSERT_EQ(v1::master::Event::AGENT_ADDED, event->get().type());
+
+    const v1::master::Response::GetAgents::Agent& agent =
+      event->get().agent_added().agent();
+
+    EXPECT_EQ(
+        evolve(agentRegisteredMessage->slave_id()),
+        agent.agent_info().id());
+
+    if (totalResources.isNone()) {
+      totalResources = v1::Resources(agent.total_resources());
+    }
+
+    EXPECT_EQ(totalResources.get(), v1::Resources(agent.total_resources()));
+  }
+}
+
+
 // This test verifies that no information about reservations and/or allocations
 // is returned to unauthorized users in response to the GET_AGENTS call.
 TEST_P(MasterAPITest, GetAgentsFiltering)
@@ -3129,29 +3648,26 @@ TEST_P(MasterAPITest, EventAuthorizationDelayed)
   event = decoder.read();
   EXPECT_TRUE(event.isPending());
 
-  // When the authorizer is called, return pending futures
-  // that we can satisfy later.
-  Promise<Owned<ObjectApprover>> taskAddedApprover;
-  Promise<Owned<ObjectApprover>> updateRunningApprover;
-  Promise<Owned<ObjectApprover>> updateFinishedApprover;
+  // The subscriber reuses its approvers until they expire, so let them
+  // expire in order to have the authorizer called for the events. This
+  // also triggers a heartbeat, since the heartbeat interval is the same.
+  Clock::advance(SUBSCRIBER_APPROVERS_TTL);
 
-  Sequence approverSequence;
+  AWAIT_READY(event);
+
+  EXPECT_EQ(v1::master::Event::HEARTBEAT, event->get().type());
+
+  event = decoder.read();
+  EXPECT_TRUE(event.isPending());
+
+  // When the authorizer is called, return a pending future that we can
+  // satisfy later. The approvers are recreated once, with 4 calls into
+  // the authorizer, and all the events wait for them.
+  Promise<Owned<ObjectApprover>> approver;
 
-  // Each event results in 4 calls into the authorizer.
-  // NOTE: This may change when the operator event stream code is refactored
-  // to avoid unnecessary authorizer calls. See MESOS-8475.
-  EXPECT_CALL(authorizer, getObjectApprover(_, _))
-    .Times(4)
-    .InSequence(approverSequence)
-    .WillRepeatedly(Return(taskAddedApprover.future()));
-  EXPECT_CALL(authorizer, getObjectApprover(_, _))
-    .Times(4)
-    .InSequence(approverSequence)
-    .WillRepeatedly(Return(updateRunningApprover.future()));
   EXPECT_CALL(authorizer, getObjectApprover(_, _))
     .Times(4)
-    .InSequence(approverSequence)
-    .WillRepeatedly(Return(updateFinishedApprover.future()));
+    .WillRepeatedly(Return(approver.future()));
 
   const v1::Offer& offer = offers->offers(0);
 
@@ -3204,9 +3720,9 @@ TEST_P(MasterAPITest, EventAuthorizationDelayed)
   AWAIT_READY(acknowledgeRunning);
   AWAIT_READY(acknowledgeFinished);
 
-  {
-    taskAddedApprover.set(Owned<ObjectApprover>(new AcceptingObjectApprover()));
+  approver.set(Owned<ObjectApprover>(new AcceptingObjectApprover()));
 
+  {
     AWAIT_READY(event);
 
     ASSERT_EQ(v1::master::Event::TASK_ADDED, event->get().type());
@@ -3217,9 +3733,6 @@ TEST_P(MasterAPITest, EventAuthorizationDelayed)
   event = decoder.read();
 
   {
-    updateRunningApprover.set(Owned<ObjectApprover>(
-        new AcceptingObjectApprover()));
-
     AWAIT_READY(event);
 
     ASSERT_EQ(v1::master::Event::TASK_UPDATED, event->get().type());
@@ -3234,9 +3747,6 @@ TEST_P(MasterAPITest, EventAuthorizationDelayed)
   event = decoder.read();
 
   {
-    updateFinishedApprover.set(Owned<ObjectApprover>(
-        new AcceptingObjectApprover()));
-
     AWAIT_READY(event);
 
     ASSERT_EQ(v1::master::Event::TASK_UPDATED, event->get().type());
@@ -131,6 +131,7 @@ class HierarchicalAllocatorTestBase : public ::testing::Test
 protected:
   HierarchicalAllocatorTestBase()
     : allocator(createAllocator<HierarchicalDRFAllocator>()),
+      validateQuotaHeadroom(true),
       nextSlaveId(1),
       nextFrameworkId(1) {}
 
@@ -182,14 +183,19 @@ protected:
     minAllocatableResources.push_back(CHECK_NOTERROR(Resources::parse(
         "mem:" + stringify((double)MIN_MEM.bytes() / Bytes::MEGABYTES))));
 
+    mesos::allocator::Options options;
+    options.allocationInterval = flags.allocation_interval;
+    options.fairnessExcludeResourceNames =
+      flags.fair_sharing_excluded_resource_names;
+    options.minAllocatableResources = minAllocatableResources;
+    options.allocationShards = flags.allocation_shards;
+    options.offerBatchSize = flags.offer_batch_size;
+    options.validateQuotaHeadroom = validateQuotaHeadroom;
+
     allocator->initialize(
-        flags.allocation_interval,
+        options,
         offerCallback.get(),
-        inverseOfferCallback.get(),
-        flags.fair_sharing_excluded_resource_names,
-        true,
-        None(),
-        minAllocatableResources);
+        inverseOfferCallback.get());
   }
 
   SlaveInfo createSlaveInfo(const Resources& resources)
@@ -282,6 +288,11 @@ protected:
   process::Queue<Allocation> allocations;
   process::Queue<Deallocation> deallocations;
 
+  // Whether the allocator validates its incrementally maintained quota
+  // headroom in each allocation run. The benchmarks disable this since
+  // the validation iterates over all roles and agents.
+  bool validateQuotaHeadroom;
+
 private:
   int nextSlaveId;
   int nextFrameworkId;
@@ -4343,6 +4354,104 @@ TEST_F(HierarchicalAllocatorTest, QuotaSetAsideReservedResources)
 }
 
 
+// This test ensures that the reservations which count towards a role's
+// consumed quota follow the changes of the agents' total resources,
+// i.e., that unreserved resources are set aside for the quota role once
+// its reservations are gone, and are no longer set aside once they are
+// back. The allocator validates its quota headroom in every allocation
+// run in this test, see `validateQuotaHeadroom`.
+TEST_F(HierarchicalAllocatorTest, QuotaWithUpdatedReservations)
+{
+  Clock::pause();
+
+  const string QUOTA_ROLE{"quota-role"};
+  const string NO_QUOTA_ROLE{"no-quota-role"};
+
+  initialize();
+
+  const Quota quota = createQuota(QUOTA_ROLE, "cpus:2;mem:1024");
+  allocator->setQuota(QUOTA_ROLE, quota);
+
+  const Resources unreserved = Resources::parse("cpus:2;mem:1024").get();
+  const Resources reserved = unreserved.pushReservation(
+      createDynamicReservationInfo(QUOTA_ROLE, "ops"));
+
+  // The quota guarantee is consumed by the reservations on `agent1`.
+  SlaveInfo agent1 = createSlaveInfo(reserved);
+  allocator->addSlave(
+      agent1.id(),
+      agent1,
+      AGENT_CAPABILITIES(),
+      None(),
+      agent1.resources(),
+      {});
+
+  SlaveInfo agent2 = createSlaveInfo(unreserved);
+  allocator->addSlave(
+      agent2.id(),
+      agent2,
+      AGENT_CAPABILITIES(),
+      None(),
+      agent2.resources(),
+      {});
+
+  // Hence `framework` is offered the unreserved resources on `agent2`.
+  FrameworkInfo framework = createFrameworkInfo({NO_QUOTA_ROLE});
+  allocator->addFramework(framework.id(), framework, {}, true, {});
+
+  Allocation expected = Allocation(
+      framework.id(),
+      {{NO_QUOTA_ROLE, {{agent2.id(), unreserved}}}});
+
+  AWAIT_EXPECT_EQ(expected, allocations.get());
+
+  // Once the reservations on `agent1` are gone, its resources are set
+  // aside for the quota guarantee.
+  allocator->updateSlave(agent1.id(), agent1, unreserved);
+
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  Future<Allocation> allocation = allocations.get();
+  EXPECT_TRUE(allocation.isPending());
+
+  // Once they are back, `framework` is offered the unreserved
+  // resources of a new agent.
+  allocator->updateSlave(agent1.id(), agent1, reserved);
+
+  SlaveInfo agent3 = createSlaveInfo(unreserved);
+  allocator->addSlave(
+      agent3.id(),
+      agent3,
+      AGENT_CAPABILITIES(),
+      None(),
+      agent3.resources(),
+      {});
+
+  expected = Allocation(
+      framework.id(),
+      {{NO_QUOTA_ROLE, {{agent3.id(), unreserved}}}});
+
+  AWAIT_EXPECT_EQ(expected, allocation);
+
+  // Removing `agent1` removes its reservations as well, so the
+  // resources recovered from `agent3` are set aside again.
+  allocator->removeSlave(agent1.id());
+
+  allocator->recoverResources(
+      framework.id(),
+      agent3.id(),
+      allocatedResources(unreserved, NO_QUOTA_ROLE),
+      None());
+
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  allocation = allocations.get();
+  EXPECT_TRUE(allocation.isPending());
+}
+
+
 // This test checks that if a framework suppresses offers, disconnects and
 // reconnects again, it will start receiving resource offers again.
 TEST_F(HierarchicalAllocatorTest, DeactivateAndReactivateFramework)
@@ -4554,6 +4663,95 @@ TEST_F_TEMP_DISABLED_ON_WINDOWS(HierarchicalAllocatorTest, ResourceMetrics)
 }
 
 
+// This test checks that the available quota headroom, which the
+// allocator maintains incrementally, is correctly reflected in the
+// metrics endpoint.
+TEST_F_TEMP_DISABLED_ON_WINDOWS(HierarchicalAllocatorTest, QuotaHeadroomMetrics)
+{
+  Clock::pause();
+
+  initialize();
+
+  // Reservations are not part of the available headroom.
+  SlaveInfo agent = createSlaveInfo("cpus:2;mem:1024;disk(role2):100");
+  allocator->addSlave(
+      agent.id(),
+      agent,
+      AGENT_CAPABILITIES(),
+      None(),
+      agent.resources(),
+      {});
+
+  Clock::settle();
+
+  JSON::Object expected;
+
+  expected.values = {
+      {"allocator/mesos/quota/headroom/cpus/available",   2},
+      {"allocator/mesos/quota/headroom/mem/available", 1024},
+      {"allocator/mesos/quota/headroom/disk/available",   0},
+  };
+
+  JSON::Value metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expected));
+
+  // All of the unreserved resources are offered to `framework`, so
+  // no headroom is left.
+  FrameworkInfo framework = createFrameworkInfo({"role1"});
+  allocator->addFramework(framework.id(), framework, {}, true, {});
+
+  Resources unreserved = Resources::parse("cpus:2;mem:1024").get();
+
+  Allocation expectedAllocation = Allocation(
+      framework.id(),
+      {{"role1", {{agent.id(), allocatedResources(unreserved, "role1")}}}});
+
+  AWAIT_EXPECT_EQ(expectedAllocation, allocations.get());
+
+  expected.values = {
+      {"allocator/mesos/quota/headroom/cpus/available", 0},
+      {"allocator/mesos/quota/headroom/mem/available",  0},
+      {"allocator/mesos/quota/headroom/disk/available", 0},
+  };
+
+  metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expected));
+
+  // Recovering the resources makes them available again.
+  allocator->recoverResources(
+      framework.id(),
+      agent.id(),
+      allocatedResources(unreserved, "role1"),
+      None());
+
+  Clock::settle();
+
+  expected.values = {
+      {"allocator/mesos/quota/headroom/cpus/available",   2},
+      {"allocator/mesos/quota/headroom/mem/available", 1024},
+      {"allocator/mesos/quota/headroom/disk/available",   0},
+  };
+
+  metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expected));
+
+  allocator->removeSlave(agent.id());
+  Clock::settle();
+
+  expected.values = {
+      {"allocator/mesos/quota/headroom/cpus/available", 0},
+      {"allocator/mesos/quota/headroom/mem/available",  0},
+      {"allocator/mesos/quota/headroom/disk/available", 0},
+  };
+
+  metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expected));
+}
+
 // The allocator is not fully initialized until `allocator->initialize(...)`
 // is called (e.g., from `Master::initialize()` or
 // `HierarchicalAllocatorTestBase::initialize(...)`). This test
@@ -4720,6 +4918,58 @@ TEST_F_TEMP_DISABLED_ON_WINDOWS(
 }
 
 
+// This test checks that the time spent in each phase of the last
+// allocation run is reported in the metrics endpoint.
+TEST_F(HierarchicalAllocatorTest, AllocationRunPhaseMetrics)
+{
+  Clock::pause();
+
+  initialize();
+
+  SlaveInfo agent = createSlaveInfo("cpus:2;mem:1024;disk:0");
+  allocator->addSlave(
+      agent.id(),
+      agent,
+      AGENT_CAPABILITIES(),
+      None(),
+      agent.resources(),
+      {});
+
+  FrameworkInfo framework = createFrameworkInfo({"role1"});
+  allocator->addFramework(framework.id(), framework, {}, true, {});
+
+  // The framework is offered the agent's resources.
+  AWAIT_READY(allocations.get());
+
+  Clock::settle();
+
+  auto phases = {
+    "select_agents",
+    "quota_headroom",
+    "quota_allocation",
+    "allocation",
+    "offer_callbacks",
+    "deallocation",
+    "sort",
+    "shrink",
+    "filter",
+  };
+
+  JSON::Object metrics = Metrics();
+
+  foreach (const string& phase, phases) {
+    const string key = "allocator/mesos/allocation_run/" + phase + "_ms";
+
+    ASSERT_EQ(1u, metrics.values.count(key))
+      << "Expected " << key << " to be present";
+
+    JSON::Value value = metrics.values[key];
+    ASSERT_TRUE(value.is<JSON::Number>()) << value.which();
+    EXPECT_GE(value.as<JSON::Number>().as<double>(), 0.0);
+  }
+}
+
+
 // This test checks that the allocation run latency
 // metrics are reported in the metrics endpoint.
 // TODO(xujyan): This test is structurally similar to
@@ -4908,6 +5158,81 @@ TEST_F_TEMP_DISABLED_ON_WINDOWS(
 }
 
 
+// This test checks that an offer filter replaces the filters on the
+// same agent which it dominates, i.e., which refuse a subset of its
+// resources and expire no later, without changing which resources
+// are filtered.
+TEST_F_TEMP_DISABLED_ON_WINDOWS(
+    HierarchicalAllocatorTest,
+    DominatedOfferFilters)
+{
+  // Pausing the clock is not necessary, but ensures that the test
+  // doesn't rely on the batch allocation in the allocator, which
+  // would slow down the test.
+  Clock::pause();
+
+  initialize();
+
+  SlaveInfo agent = createSlaveInfo("cpus:2;mem:1024;disk:0");
+  allocator->addSlave(
+      agent.id(),
+      agent,
+      AGENT_CAPABILITIES(),
+      None(),
+      agent.resources(),
+      {});
+
+  FrameworkInfo framework = createFrameworkInfo({"role"});
+  allocator->addFramework(framework.id(), framework, {}, true, {});
+
+  Allocation expected = Allocation(
+      framework.id(),
+      {{"role", {{agent.id(), agent.resources()}}}});
+
+  Future<Allocation> allocation = allocations.get();
+  AWAIT_EXPECT_EQ(expected, allocation);
+
+  Duration filterTimeout = flags.allocation_interval * 2;
+  Filters offerFilter;
+  offerFilter.set_refuse_seconds(filterTimeout.secs());
+
+  // Decline the offered resources in two equal halves. The second
+  // filter dominates the first one.
+  Resources half = Resources::parse("cpus:1;mem:512").get();
+  half.allocate("role");
+
+  allocator->recoverResources(framework.id(), agent.id(), half, offerFilter);
+  allocator->recoverResources(framework.id(), agent.id(), half, offerFilter);
+
+  JSON::Object expectedMetrics;
+  expectedMetrics.values = {
+      {"allocator/mesos/offer_filters/active", 1},
+      {"allocator/mesos/offer_filters/roles/role/active", 1},
+  };
+
+  JSON::Value metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expectedMetrics));
+
+  // The whole agent is not a subset of the refused resources,
+  // so it is offered in the next batch allocation.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  allocation = allocations.get();
+  AWAIT_EXPECT_EQ(expected, allocation);
+
+  // The filter was consulted during the batch allocation.
+  JSON::Object snapshot = Metrics();
+
+  Result<JSON::Number> lookups =
+    snapshot.at<JSON::Number>("allocator/mesos/offer_filters/lookups");
+
+  ASSERT_SOME(lookups);
+  EXPECT_LT(0, lookups->as<int64_t>());
+}
+
+
 // Verifies that per-role dominant share metrics are correctly reported.
 TEST_F_TEMP_DISABLED_ON_WINDOWS(HierarchicalAllocatorTest, DominantShareMetrics)
 {
@@ -5971,6 +6296,152 @@ TEST_F(HierarchicalAllocatorTest, DISABLED_NestedQuotaAccounting)
 }
 
 
+// This test verifies that when agents are partitioned into allocation
+// shards, all agents are offered and the roles are visited round-robin
+// within each shard instead of offering the whole shard to one role.
+TEST_F(HierarchicalAllocatorTest, AllocationShards)
+{
+  Clock::pause();
+
+  master::Flags flags_;
+  flags_.allocation_shards = 2;
+
+  initialize(flags_);
+
+  vector<SlaveInfo> agents;
+  for (size_t i = 0; i < 4; i++) {
+    SlaveInfo agent = createSlaveInfo("cpus:1;mem:512;disk:0");
+    allocator->addSlave(
+        agent.id(),
+        agent,
+        AGENT_CAPABILITIES(),
+        None(),
+        agent.resources(),
+        {});
+
+    agents.push_back(agent);
+  }
+
+  // `framework1` is the only framework, so it is offered all agents.
+  FrameworkInfo framework1 = createFrameworkInfo({"role1"});
+  allocator->addFramework(framework1.id(), framework1, {}, true, {});
+
+  hashmap<SlaveID, Resources> agentResources;
+  foreach (const SlaveInfo& agent, agents) {
+    agentResources[agent.id()] = agent.resources();
+  }
+
+  Allocation expected = Allocation(
+      framework1.id(),
+      {{"role1", agentResources}});
+
+  AWAIT_EXPECT_EQ(expected, allocations.get());
+
+  FrameworkInfo framework2 = createFrameworkInfo({"role2"});
+  allocator->addFramework(framework2.id(), framework2, {}, true, {});
+
+  // Recover all resources from `framework1`. Both roles now have the
+  // same (zero) share.
+  foreach (const SlaveInfo& agent, agents) {
+    allocator->recoverResources(
+        framework1.id(),
+        agent.id(),
+        allocatedResources(agent.resources(), "role1"),
+        None());
+  }
+
+  Clock::settle();
+
+  // Trigger a batch allocation.
+  Clock::advance(flags.allocation_interval);
+
+  hashmap<FrameworkID, size_t> offeredAgents;
+  hashset<SlaveID> offered;
+
+  for (size_t i = 0; i < 2; i++) {
+    Future<Allocation> allocation = allocations.get();
+    AWAIT_READY(allocation);
+
+    ASSERT_EQ(1u, allocation->resources.size());
+
+    foreachkey (const string& role, allocation->resources) {
+      const hashmap<SlaveID, Resources>& resources =
+        allocation->resources.at(role);
+
+      offeredAgents[allocation->frameworkId] += resources.size();
+
+      foreachkey (const SlaveID& slaveId, resources) {
+        EXPECT_FALSE(offered.contains(slaveId));
+        offered.insert(slaveId);
+      }
+    }
+  }
+
+  // Each shard of two agents is split evenly between the two roles.
+  EXPECT_EQ(4u, offered.size());
+  EXPECT_EQ(2u, offeredAgents[framework1.id()]);
+  EXPECT_EQ(2u, offeredAgents[framework2.id()]);
+}
+
+
+// This test verifies that when offers are pipelined, the offers of an
+// allocation run are sent in batches as soon as enough of them have
+// been computed, and that each agent is offered in exactly one batch.
+TEST_F(HierarchicalAllocatorTest, PipelinedOffers)
+{
+  Clock::pause();
+
+  master::Flags flags_;
+  flags_.offer_batch_size = 2;
+
+  initialize(flags_);
+
+  hashset<SlaveID> agents;
+  for (size_t i = 0; i < 3; i++) {
+    SlaveInfo agent = createSlaveInfo("cpus:1;mem:512;disk:0");
+    allocator->addSlave(
+        agent.id(),
+        agent,
+        AGENT_CAPABILITIES(),
+        None(),
+        agent.resources(),
+        {});
+
+    agents.insert(agent.id());
+  }
+
+  // Adding the framework triggers an allocation of all three agents,
+  // which is sent as a batch of two offers followed by the remaining
+  // offer at the end of the allocation run.
+  FrameworkInfo framework = createFrameworkInfo({"role1"});
+  allocator->addFramework(framework.id(), framework, {}, true, {});
+
+  hashset<SlaveID> offered;
+
+  foreach (size_t batchSize, vector<size_t>({2u, 1u})) {
+    Future<Allocation> allocation = allocations.get();
+    AWAIT_READY(allocation);
+
+    EXPECT_EQ(framework.id(), allocation->frameworkId);
+    ASSERT_EQ(1u, allocation->resources.size());
+    ASSERT_TRUE(allocation->resources.contains("role1"));
+    EXPECT_EQ(batchSize, allocation->resources.at("role1").size());
+
+    foreachkey (const SlaveID& slaveId, allocation->resources.at("role1")) {
+      EXPECT_FALSE(offered.contains(slaveId));
+      offered.insert(slaveId);
+    }
+  }
+
+  EXPECT_EQ(agents, offered);
+
+  // No further offers are made.
+  Future<Allocation> allocation = allocations.get();
+  Clock::settle();
+  EXPECT_TRUE(allocation.isPending());
+}
+
+
 class HierarchicalAllocatorTestWithParam
   : public HierarchicalAllocatorTestBase,
     public WithParamInterface<bool> {};
@@ -6116,7 +6587,14 @@ ostream& operator<<(ostream& stream, Sharedness type)
 
 class HierarchicalAllocations_BENCHMARK_Test
   : public HierarchicalAllocatorTestBase,
-    public WithParamInterface<std::tr1::tuple<size_t, size_t, Sharedness>> {};
+    public WithParamInterface<std::tr1::tuple<size_t, size_t, Sharedness>>
+{
+protected:
+  HierarchicalAllocations_BENCHMARK_Test()
+  {
+    validateQuotaHeadroom = false;
+  }
+};
 
 
 INSTANTIATE_TEST_CASE_P(
@@ -6316,7 +6794,14 @@ TEST_P(HierarchicalAllocations_BENCHMARK_Test, PersistentVolumes)
 
 class HierarchicalAllocator_BENCHMARK_Test
   : public HierarchicalAllocatorTestBase,
-    public WithParamInterface<std::tuple<size_t, size_t>> {};
+    public WithParamInterface<std::tuple<size_t, size_t>>
+{
+protected:
+  HierarchicalAllocator_BENCHMARK_Test()
+  {
+    validateQuotaHeadroom = false;
+  }
+};
 
 
 // The Hierarchical Allocator benchmark tests are parameterized
@@ -6585,6 +7070,106 @@ TEST_P(HierarchicalAllocator_BENCHMARK_Test, DeclineOffers)
 }
 
 
+// This benchmark measures the latency of a batch allocation cycle over
+// all agents for a varying number of allocation shards.
+TEST_P(HierarchicalAllocator_BENCHMARK_Test, AllocationShards)
+{
+  size_t slaveCount = std::get<0>(GetParam());
+  size_t frameworkCount = std::get<1>(GetParam());
+
+  cout << "Using " << slaveCount << " agents and "
+       << frameworkCount << " frameworks" << endl;
+
+  struct OfferedResources
+  {
+    FrameworkID   frameworkId;
+    SlaveID       slaveId;
+    Resources     resources;
+  };
+
+  const Resources agentResources = Resources::parse(
+      "cpus:24;mem:4096;disk:4096;ports:[31000-32000]").get();
+
+  const size_t shardCounts[] = {1U, 2U, 4U, 8U, 16U};
+
+  foreach (size_t shardCount, shardCounts) {
+    // Use a fresh allocator for each shard count.
+    delete allocator;
+    allocator = createAllocator<HierarchicalDRFAllocator>();
+
+    // Pause the clock because we want to manually drive the allocations.
+    Clock::pause();
+
+    vector<OfferedResources> offers;
+
+    auto offerCallback = [&offers](
+        const FrameworkID& frameworkId,
+        const hashmap<string, hashmap<SlaveID, Resources>>& resources_)
+    {
+      foreachkey (const string& role, resources_) {
+        foreachpair (const SlaveID& slaveId,
+                     const Resources& resources,
+                     resources_.at(role)) {
+          offers.push_back(OfferedResources{frameworkId, slaveId, resources});
+        }
+      }
+    };
+
+    master::Flags flags_;
+    flags_.allocation_shards = shardCount;
+
+    initialize(flags_, offerCallback);
+
+    // Each framework is in its own role so that the agents are shared
+    // across roles (rather than across frameworks within a role).
+    for (size_t i = 0; i < frameworkCount; i++) {
+      FrameworkInfo framework = createFrameworkInfo({"role" + stringify(i)});
+      allocator->addFramework(framework.id(), framework, {}, true, {});
+    }
+
+    for (size_t i = 0; i < slaveCount; i++) {
+      SlaveInfo slave = createSlaveInfo(agentResources);
+      allocator->addSlave(
+          slave.id(),
+          slave,
+          AGENT_CAPABILITIES(),
+          None(),
+          slave.resources(),
+          {});
+    }
+
+    // Wait for all the `addFramework` and `addSlave` operations
+    // to be processed.
+    Clock::settle();
+
+    // Decline all offers without installing filters, so that the
+    // next allocation cycle has to consider every agent again.
+    foreach (const OfferedResources& offer, offers) {
+      allocator->recoverResources(
+          offer.frameworkId, offer.slaveId, offer.resources, None());
+    }
+
+    Clock::settle();
+    offers.clear();
+
+    Stopwatch watch;
+    watch.start();
+
+    // Advance the clock and trigger a batch allocation cycle.
+    Clock::advance(flags.allocation_interval);
+    Clock::settle();
+
+    watch.stop();
+
+    cout << "allocate() with " << shardCount << " shard(s) took "
+         << watch.elapsed() << " to make " << offers.size() << " offers"
+         << endl;
+
+    Clock::resume();
+  }
+}
+
+
 // Returns the requested number of labels:
 //   [{"<key>_1": "<value>_1"}, ..., {"<key>_<count>":"<value>_<count>"}]
 static Labels createLabels(
@@ -14,6 +14,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -23,11 +24,18 @@
 
 #include <process/clock.hpp>
 #include <process/collect.hpp>
+#include <process/delay.hpp>
+#include <process/dispatch.hpp>
 #include <process/future.hpp>
 #include <process/pid.hpp>
 #include <process/process.hpp>
 #include <process/protobuf.hpp>
 
+#include <stout/duration.hpp>
+#include <stout/none.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/os.hpp>
 #include <stout/stopwatch.hpp>
 
 #include "common/protobuf_utils.hpp"
@@ -38,6 +46,8 @@ namespace http = process::http;
 
 using process::await;
 using process::Clock;
+using process::delay;
+using process::dispatch;
 using process::Failure;
 using process::Future;
 using process::Owned;
@@ -180,9 +190,16 @@ public:
     }
   }
 
-  Future<Nothing> reregister()
+  // Reregisters with the master, retrying at the given interval (like
+  // real agents do with backoff) if the master might drop the message.
+  Future<Nothing> reregister(const Option<Duration>& retryInterval)
   {
     send(masterPid, message);
+
+    if (retryInterval.isSome()) {
+      delay(retryInterval.get(), self(), &Self::retry, retryInterval.get());
+    }
+
     return promise.future();
   }
 
@@ -195,6 +212,13 @@ private:
     promise.set(Nothing());
   }
 
+  void retry(const Duration& retryInterval)
+  {
+    if (promise.future().isPending()) {
+      reregister(retryInterval);
+    }
+  }
+
   // We need to answer pings to keep the agent registered.
   void ping(const UPID& from, bool)
   {
@@ -240,9 +264,10 @@ public:
     process::wait(process.get());
   }
 
-  Future<Nothing> reregister()
+  Future<Nothing> reregister(const Option<Duration>& retryInterval = None())
   {
-    return dispatch(process.get(), &TestSlaveProcess::reregister);
+    return dispatch(
+        process.get(), &TestSlaveProcess::reregister, retryInterval);
   }
 
 private:
@@ -252,7 +277,12 @@ private:
 
 class MasterFailover_BENCHMARK_Test
   : public MesosTest,
-    public WithParamInterface<tuple<size_t, size_t, size_t, size_t, size_t>> {};
+    public WithParamInterface<tuple<size_t, size_t, size_t, size_t, size_t>>
+{
+protected:
+  void agentReregistrationDelay(
+      const Option<size_t>& maxAgentReregistrations = None());
+};
 
 
 // The value tuples are defined as:
@@ -273,6 +303,22 @@ INSTANTIATE_TEST_CASE_P(
 // This test measures the time from all agents start to reregister to
 // to when all have received `SlaveReregisteredMessage`.
 TEST_P(MasterFailover_BENCHMARK_Test, AgentReregistrationDelay)
+{
+  agentReregistrationDelay();
+}
+
+
+// Like the `AgentReregistrationDelay` test above, but the master only
+// admits a bounded number of re-registrations at a time, and the agents
+// retry the ones which get dropped.
+TEST_P(MasterFailover_BENCHMARK_Test, AgentReregistrationDelayWithAdmission)
+{
+  agentReregistrationDelay(1000);
+}
+
+
+void MasterFailover_BENCHMARK_Test::agentReregistrationDelay(
+    const Option<size_t>& maxAgentReregistrations)
 {
   size_t agentCount;
   size_t frameworksPerAgent;
@@ -288,6 +334,7 @@ TEST_P(MasterFailover_BENCHMARK_Test, AgentReregistrationDelay)
 
   master::Flags masterFlags = CreateMasterFlags();
   masterFlags.authenticate_agents = false;
+  masterFlags.max_agent_reregistrations = maxAgentReregistrations;
 
   // Use replicated log so it better simulates the production scenario.
   masterFlags.registry = "replicated_log";
@@ -321,8 +368,14 @@ TEST_P(MasterFailover_BENCHMARK_Test, AgentReregistrationDelay)
   Stopwatch watch;
   watch.start();
 
+  // The agents only need to retry if the master might drop messages.
+  Option<Duration> retryInterval;
+  if (maxAgentReregistrations.isSome()) {
+    retryInterval = Seconds(1);
+  }
+
   foreach (TestSlave& slave, slaves) {
-    reregistered.push_back(slave.reregister());
+    reregistered.push_back(slave.reregister(retryInterval));
   }
 
   await(reregistered).await();
@@ -354,6 +407,32 @@ INSTANTIATE_TEST_CASE_P(
         make_tuple(40000, 5, 2, 5, 2)));
 
 
+// Returns the longest time it took the master to serve a dispatch
+// while the given response was pending, i.e., roughly the longest
+// time for which the master actor was blocked by the request.
+static Duration blocked(
+    const UPID& master,
+    const Future<http::Response>& response)
+{
+  Duration max = Duration::zero();
+
+  while (response.isPending()) {
+    Stopwatch watch;
+    watch.start();
+
+    dispatch(master, []() { return Nothing(); }).await();
+
+    watch.stop();
+
+    max = std::max(max, Duration(watch.elapsed()));
+
+    os::sleep(Milliseconds(1));
+  }
+
+  return max;
+}
+
+
 // This test measures the performance of the `master::call::GetState`
 // v1 api (and also measures master v0 '/state' endpoint as the
 // baseline). We set up a lot of master state from artificial agents
@@ -425,13 +504,16 @@ TEST_P(MasterStateQuery_BENCHMARK_Test, GetState)
       None(),
       createBasicAuthHeaders(DEFAULT_CREDENTIAL));
 
+  Duration v0Blocked = blocked(master.get()->pid, v0Response);
+
   v0Response.await();
 
   watch.stop();
 
   ASSERT_EQ(v0Response->status, http::OK().status);
 
-  cout << "v0 '/state' response took " << watch.elapsed() << endl;
+  cout << "v0 '/state' response took " << watch.elapsed()
+       << " (master blocked for up to " << v0Blocked << ")" << endl;
 
   // Helper function to post a request to '/api/v1' master endpoint
   // and return the response.
@@ -464,6 +546,8 @@ TEST_P(MasterStateQuery_BENCHMARK_Test, GetState)
     Future<http::Response> response =
       post(master.get()->pid, v1Call, contentType);
 
+    Duration v1Blocked = blocked(master.get()->pid, response);
+
     response.await();
 
     watch.stop();
@@ -477,7 +561,8 @@ TEST_P(MasterStateQuery_BENCHMARK_Test, GetState)
     EXPECT_EQ(v1::master::Response::GET_STATE, v1Response->type());
 
     cout << "v1 'master::call::GetState' "
-         << contentType << " response took " << watch.elapsed() << endl;
+         << contentType << " response took " << watch.elapsed()
+         << " (master blocked for up to " << v1Blocked << ")" << endl;
   }
 }
 
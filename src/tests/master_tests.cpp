@@ -8272,6 +8272,178 @@ TEST_F(MasterTest, RegistrationWithoutRequiredAgentDomain)
 }
 
 
+// This test verifies that the master drops re-registration attempts
+// while `--max_agent_reregistrations` re-registrations are in progress,
+// and admits them again once the re-registrations have completed.
+TEST_F(MasterTest, MaxAgentReregistrations)
+{
+  Clock::pause();
+
+  master::Flags masterFlags = CreateMasterFlags();
+  masterFlags.max_agent_reregistrations = 1;
+
+  Try<Owned<cluster::Master>> master = StartMaster(masterFlags);
+  ASSERT_SOME(master);
+
+  slave::Flags slaveFlags = CreateSlaveFlags();
+
+  Future<SlaveRegisteredMessage> slaveRegisteredMessage =
+    FUTURE_PROTOBUF(SlaveRegisteredMessage(), _, _);
+
+  Owned<MasterDetector> detector = master.get()->createDetector();
+  Try<Owned<cluster::Slave>> slave = StartSlave(detector.get(), slaveFlags);
+  ASSERT_SOME(slave);
+
+  Clock::advance(slaveFlags.registration_backoff_factor);
+
+  AWAIT_READY(slaveRegisteredMessage);
+
+  // Restart the agent and intercept its re-registration, which we
+  // later pass on to the master ourselves.
+  Future<ReregisterSlaveMessage> reregisterSlaveMessage =
+    DROP_PROTOBUF(ReregisterSlaveMessage(), _, _);
+
+  slave.get()->terminate();
+  slave = StartSlave(detector.get(), slaveFlags);
+  ASSERT_SOME(slave);
+
+  Clock::advance(slaveFlags.registration_backoff_factor);
+
+  AWAIT_READY(reregisterSlaveMessage);
+
+  // Have another (unknown) agent reregister, and hold its registry
+  // operation so that its re-registration stays in progress.
+  ReregisterSlaveMessage message = reregisterSlaveMessage.get();
+  message.mutable_slave()->mutable_id()->set_value("other-agent");
+  message.clear_tasks();
+  message.clear_executor_infos();
+
+  Future<Owned<master::RegistryOperation>> operation;
+  Promise<bool> promise;
+  EXPECT_CALL(*master.get()->registrar, apply(_))
+    .WillOnce(DoAll(FutureArg<0>(&operation),
+                    Return(promise.future())));
+
+  process::UPID other("other-agent", master.get()->pid.address);
+
+  process::post(other, master.get()->pid, message);
+
+  AWAIT_READY(operation);
+
+  // The re-registration of the agent gets dropped.
+  EXPECT_NO_FUTURE_PROTOBUFS(SlaveReregisteredMessage(), _, slave.get()->pid);
+
+  JSON::Object snapshot = Metrics();
+  const int64_t dropped =
+    snapshot.values["master/dropped_messages"].as<JSON::Number>().as<int64_t>();
+
+  process::post(
+      slave.get()->pid, master.get()->pid, reregisterSlaveMessage.get());
+
+  Clock::settle();
+
+  snapshot = Metrics();
+  EXPECT_EQ(dropped + 1, snapshot.values["master/dropped_messages"]);
+
+  // Once the other agent has reregistered, the agent can reregister.
+  Future<SlaveReregisteredMessage> otherReregistered =
+    FUTURE_PROTOBUF(SlaveReregisteredMessage(), _, other);
+
+  promise.set(true);
+
+  AWAIT_READY(otherReregistered);
+
+  Future<SlaveReregisteredMessage> slaveReregisteredMessage =
+    FUTURE_PROTOBUF(SlaveReregisteredMessage(), _, slave.get()->pid);
+
+  process::post(
+      slave.get()->pid, master.get()->pid, reregisterSlaveMessage.get());
+
+  AWAIT_READY(slaveReregisteredMessage);
+}
+
+
+// This test verifies that the master drops a re-registration of an
+// agent without the MULTI_ROLE capability whose tasks of a multi-role
+// framework lack the allocation info, and that re-registrations of
+// unauthenticated agents are refused before they get prepared.
+TEST_F(MasterTest, ReregistrationWithMissingAllocationInfo)
+{
+  Clock::pause();
+
+  Try<Owned<cluster::Master>> master = StartMaster();
+  ASSERT_SOME(master);
+
+  slave::Flags slaveFlags = CreateSlaveFlags();
+
+  Future<SlaveRegisteredMessage> slaveRegisteredMessage =
+    FUTURE_PROTOBUF(SlaveRegisteredMessage(), _, _);
+
+  Owned<MasterDetector> detector = master.get()->createDetector();
+  Try<Owned<cluster::Slave>> slave = StartSlave(detector.get(), slaveFlags);
+  ASSERT_SOME(slave);
+
+  Clock::advance(slaveFlags.registration_backoff_factor);
+
+  AWAIT_READY(slaveRegisteredMessage);
+
+  // Restart the agent and intercept its re-registration, which we
+  // modify and pass on to the master ourselves.
+  Future<ReregisterSlaveMessage> reregisterSlaveMessage =
+    DROP_PROTOBUF(ReregisterSlaveMessage(), _, _);
+
+  slave.get()->terminate();
+  slave = StartSlave(detector.get(), slaveFlags);
+  ASSERT_SOME(slave);
+
+  Clock::advance(slaveFlags.registration_backoff_factor);
+
+  AWAIT_READY(reregisterSlaveMessage);
+
+  ReregisterSlaveMessage message = reregisterSlaveMessage.get();
+  message.clear_agent_capabilities();
+
+  FrameworkInfo framework = DEFAULT_FRAMEWORK_INFO;
+  framework.mutable_id()->set_value("framework");
+  framework.clear_role();
+  framework.clear_roles();
+  framework.add_roles("role1");
+  framework.add_roles("role2");
+  framework.add_capabilities()->set_type(
+      FrameworkInfo::Capability::MULTI_ROLE);
+
+  message.add_frameworks()->CopyFrom(framework);
+
+  Task task = protobuf::createTask(
+      createTask(
+          message.slave().id(),
+          Resources::parse("cpus:1;mem:32").get(),
+          "sleep 1000"),
+      TASK_RUNNING,
+      framework.id());
+
+  message.add_tasks()->CopyFrom(task);
+
+  // Neither re-registration gets to the registry.
+  EXPECT_CALL(*master.get()->registrar, apply(_))
+    .Times(0);
+
+  EXPECT_NO_FUTURE_PROTOBUFS(SlaveReregisteredMessage(), _, _);
+
+  process::UPID unauthenticated("unauthenticated", master.get()->pid.address);
+
+  process::post(unauthenticated, master.get()->pid, message);
+  process::post(slave.get()->pid, master.get()->pid, message);
+
+  Clock::settle();
+
+  // The master is still running and counted both messages.
+  JSON::Object snapshot = Metrics();
+  EXPECT_EQ(1, snapshot.values["master/elected"]);
+  EXPECT_EQ(2, snapshot.values["master/messages_reregister_slave"]);
+}
+
+
 // This test checks that if the `--require_agent_domain` flag is set and
 // the agent does not have a domain configured when trying to reregister,
 // the re-registration attempt will fail.
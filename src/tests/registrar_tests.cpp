@@ -116,6 +116,7 @@ using mesos::http::authentication::BasicAuthenticatorFactory;
 using mesos::state::LogStorage;
 using mesos::state::State;
 using mesos::state::Storage;
+using mesos::state::Variable;
 
 using state::Entry;
 
@@ -1211,6 +1212,198 @@ TEST_F(RegistrarTest, Bootstrap)
 }
 
 
+// This test verifies that updates get stored as deltas, which get
+// compacted into the full registry, and that the registry gets
+// recovered from the full registry and the deltas.
+TEST_F(RegistrarTest, Deltas)
+{
+  flags.registry_max_deltas = 2;
+
+  SlaveInfo slave2 = slave;
+  slave2.mutable_id()->set_value("2");
+
+  SlaveInfo slave3 = slave;
+  slave3.mutable_id()->set_value("3");
+
+  {
+    Registrar registrar(flags, state);
+    AWAIT_READY(registrar.recover(master));
+
+    // The first two updates get stored as deltas, the third one as the
+    // full registry and the last two as deltas again.
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new AdmitSlave(slave))));
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new AdmitSlave(slave2))));
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new AdmitSlave(slave3))));
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new MarkSlaveUnreachable(slave, protobuf::getCurrentTime()))));
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new RemoveSlave(slave2))));
+  }
+
+  {
+    Registrar registrar(flags, state);
+
+    Future<Registry> registry = registrar.recover(master);
+    AWAIT_READY(registry);
+
+    EXPECT_EQ(4u, registry->delta_sequence());
+
+    ASSERT_EQ(1, registry->slaves().slaves().size());
+    EXPECT_EQ(slave3, registry->slaves().slaves(0).info());
+
+    ASSERT_EQ(1, registry->unreachable().slaves().size());
+    EXPECT_EQ(slave.id(), registry->unreachable().slaves(0).id());
+
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new MarkSlaveReachable(slave))));
+  }
+
+  // The registry can also be recovered once deltas are disabled, and
+  // the deltas which the registry already includes are not applied.
+  flags.registry_max_deltas = 0;
+
+  {
+    Registrar registrar(flags, state);
+
+    Future<Registry> registry = registrar.recover(master);
+    AWAIT_READY(registry);
+
+    ASSERT_EQ(2, registry->slaves().slaves().size());
+    EXPECT_EQ(slave3, registry->slaves().slaves(0).info());
+    EXPECT_EQ(slave, registry->slaves().slaves(1).info());
+
+    EXPECT_TRUE(registry->unreachable().slaves().empty());
+  }
+}
+
+
+TEST_F(RegistrarTest, Shards)
+{
+  flags.registry_shards = 4;
+
+  vector<SlaveInfo> slaves;
+  for (int i = 1; i <= 4; i++) {
+    SlaveInfo info = slave;
+    info.mutable_id()->set_value(stringify(i));
+    slaves.push_back(info);
+  }
+
+  {
+    Registrar registrar(flags, state);
+    AWAIT_READY(registrar.recover(master));
+
+    foreach (const SlaveInfo& info, slaves) {
+      AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+          new AdmitSlave(info))));
+    }
+
+    TimeInfo earlier = protobuf::getCurrentTime();
+    TimeInfo later = earlier;
+    later.set_nanoseconds(earlier.nanoseconds() + 1);
+
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new MarkSlaveUnreachable(slaves[1], earlier))));
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new MarkSlaveUnreachable(slaves[0], later))));
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new RemoveSlave(slaves[3]))));
+  }
+
+  // The agents are not stored in the registry itself.
+  Future<Variable> variable = state->fetch("registry");
+  AWAIT_READY(variable);
+
+  Try<Registry> stored = ::protobuf::deserialize<Registry>(variable->value());
+  ASSERT_SOME(stored);
+
+  EXPECT_EQ(4, stored->shards_size());
+  EXPECT_TRUE(stored->slaves().slaves().empty());
+  EXPECT_TRUE(stored->unreachable().slaves().empty());
+
+  // The registry can be recovered with the same number of shards,
+  // resharded, and stored without shards again.
+  foreach (size_t shards, vector<size_t>({4u, 2u, 0u})) {
+    flags.registry_shards = shards;
+
+    Registrar registrar(flags, state);
+
+    Future<Registry> registry = registrar.recover(master);
+    AWAIT_READY(registry);
+
+    EXPECT_EQ(static_cast<int>(shards), registry->shards_size());
+
+    ASSERT_EQ(1, registry->slaves().slaves().size());
+    EXPECT_EQ(slaves[2], registry->slaves().slaves(0).info());
+
+    // The unreachable agents are ordered by their timestamps.
+    ASSERT_EQ(2, registry->unreachable().slaves().size());
+    EXPECT_EQ(slaves[1].id(), registry->unreachable().slaves(0).id());
+    EXPECT_EQ(slaves[0].id(), registry->unreachable().slaves(1).id());
+  }
+}
+
+
+// Tests that the agents of the deltas get stored in the shards when the
+// registry is recovered, i.e., that they are not lost once the deltas
+// have been expunged.
+TEST_F(RegistrarTest, ShardsWithDeltas)
+{
+  flags.registry_shards = 4;
+  flags.registry_max_deltas = 10;
+
+  vector<SlaveInfo> slaves;
+  for (int i = 1; i <= 4; i++) {
+    SlaveInfo info = slave;
+    info.mutable_id()->set_value(stringify(i));
+    slaves.push_back(info);
+  }
+
+  {
+    Registrar registrar(flags, state);
+    AWAIT_READY(registrar.recover(master));
+
+    // All these updates get stored as deltas.
+    foreach (const SlaveInfo& info, slaves) {
+      AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+          new AdmitSlave(info))));
+    }
+
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new MarkSlaveUnreachable(slaves[0], protobuf::getCurrentTime()))));
+    AWAIT_TRUE(registrar.apply(Owned<RegistryOperation>(
+        new RemoveSlave(slaves[3]))));
+  }
+
+  // The first recovery applies the deltas and stores the registry
+  // (and its shards), which expunges the deltas. The second recovery
+  // only recovers from the shards.
+  for (int i = 0; i < 2; i++) {
+    Registrar registrar(flags, state);
+
+    Future<Registry> registry = registrar.recover(master);
+    AWAIT_READY(registry);
+
+    EXPECT_EQ(4, registry->shards_size());
+
+    ASSERT_EQ(2, registry->slaves().slaves().size());
+
+    hashset<SlaveID> slaveIds;
+    foreach (const Registry::Slave& slave, registry->slaves().slaves()) {
+      slaveIds.insert(slave.info().id());
+    }
+
+    EXPECT_TRUE(slaveIds.contains(slaves[1].id()));
+    EXPECT_TRUE(slaveIds.contains(slaves[2].id()));
+
+    ASSERT_EQ(1, registry->unreachable().slaves().size());
+    EXPECT_EQ(slaves[0].id(), registry->unreachable().slaves(0).id());
+  }
+}
+
+
 class MockStorage : public Storage
 {
 public:
@@ -1361,7 +1554,13 @@ TEST_F(RegistrarTest, Authentication)
 
 class Registrar_BENCHMARK_Test
   : public RegistrarTestBase,
-    public WithParamInterface<size_t> {};
+    public WithParamInterface<size_t>
+{
+protected:
+  // Admits the agents, marks them reachable, recovers the registry and
+  // removes the agents.
+  void performance();
+};
 
 
 // The Registrar benchmark tests are parameterized by the number of slaves.
@@ -1372,6 +1571,32 @@ INSTANTIATE_TEST_CASE_P(
 
 
 TEST_P(Registrar_BENCHMARK_Test, Performance)
+{
+  performance();
+}
+
+
+// Like the `Performance` test above, but the updates of the registry
+// get stored as deltas rather than storing the full registry.
+TEST_P(Registrar_BENCHMARK_Test, PerformanceWithDeltas)
+{
+  flags.registry_max_deltas = 100;
+
+  performance();
+}
+
+
+// Like the `Performance` test above, but the agents are stored in
+// shards, so that the updates only store the shards of their agents.
+TEST_P(Registrar_BENCHMARK_Test, PerformanceWithShards)
+{
+  flags.registry_shards = 64;
+
+  performance();
+}
+
+
+void Registrar_BENCHMARK_Test::performance()
 {
   Registrar registrar(flags, state);
   AWAIT_READY(registrar.recover(master));
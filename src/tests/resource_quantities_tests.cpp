@@ -0,0 +1,128 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <mesos/resources.hpp>
+
+#include <stout/gtest.hpp>
+#include <stout/stringify.hpp>
+
+#include "common/resource_quantities.hpp"
+
+#include "tests/mesos.hpp"
+#include "tests/resources_utils.hpp"
+
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace tests {
+
+static ResourceQuantities quantities(const string& text)
+{
+  return CHECK_NOTERROR(ResourceQuantities::fromString(text));
+}
+
+
+TEST(ResourceQuantitiesTest, FromString)
+{
+  ResourceQuantities result = quantities("cpus:1;mem:128");
+  EXPECT_EQ(2u, result.size());
+  EXPECT_EQ(1, result.get("cpus").value());
+  EXPECT_EQ(128, result.get("mem").value());
+  EXPECT_EQ(0, result.get("disk").value());
+
+  // Quantities of the same name are summed up.
+  result = quantities("cpus:1;cpus:0.5");
+  EXPECT_EQ(1u, result.size());
+  EXPECT_EQ(1.5, result.get("cpus").value());
+
+  // Zero quantities are not stored.
+  EXPECT_TRUE(quantities("cpus:0").empty());
+  EXPECT_TRUE(quantities("").empty());
+
+  EXPECT_ERROR(ResourceQuantities::fromString("cpus"));
+  EXPECT_ERROR(ResourceQuantities::fromString("cpus:abc"));
+  EXPECT_ERROR(ResourceQuantities::fromString("cpus:-1"));
+  EXPECT_ERROR(ResourceQuantities::fromString(":1"));
+}
+
+
+TEST(ResourceQuantitiesTest, FromScalarResources)
+{
+  // Reservations, disk info and sharedness are stripped.
+  Resources resources =
+    Resources::parse("cpus:1;mem:128;cpus(role1):2;ports:[1-10]").get() +
+    createDiskResource("10", "role1", "id1", "path1", None(), true);
+
+  ResourceQuantities result =
+    ResourceQuantities::fromScalarResources(resources);
+
+  EXPECT_EQ(quantities("cpus:3;mem:128;disk:10"), result);
+
+  // The result is consistent with `createStrippedScalarQuantity()`.
+  EXPECT_EQ(
+      resources.createStrippedScalarQuantity(),
+      result.toResources());
+}
+
+
+TEST(ResourceQuantitiesTest, Arithmetic)
+{
+  ResourceQuantities total = quantities("cpus:1;mem:128");
+
+  total += quantities("cpus:1;disk:10");
+  EXPECT_EQ(quantities("cpus:2;mem:128;disk:10"), total);
+
+  // Absent names in the subtrahend are ignored, and non-positive
+  // results are removed.
+  total -= quantities("cpus:3;gpus:1;mem:28");
+  EXPECT_EQ(quantities("mem:100;disk:10"), total);
+
+  EXPECT_EQ(quantities("mem:100;disk:10;cpus:1"),
+            total + quantities("cpus:1"));
+  EXPECT_EQ(quantities("disk:10"), total - quantities("mem:100"));
+
+  total -= total;
+  EXPECT_TRUE(total.empty());
+}
+
+
+TEST(ResourceQuantitiesTest, Contains)
+{
+  ResourceQuantities total = quantities("cpus:2;mem:128");
+
+  EXPECT_TRUE(total.contains(ResourceQuantities()));
+  EXPECT_TRUE(total.contains(quantities("cpus:2")));
+  EXPECT_TRUE(total.contains(quantities("cpus:1;mem:128")));
+  EXPECT_FALSE(total.contains(quantities("cpus:3")));
+  EXPECT_FALSE(total.contains(quantities("cpus:1;disk:1")));
+  EXPECT_FALSE(ResourceQuantities().contains(quantities("cpus:1")));
+}
+
+
+TEST(ResourceQuantitiesTest, Printing)
+{
+  EXPECT_EQ("{}", stringify(ResourceQuantities()));
+  EXPECT_EQ("cpus:1; mem:128", stringify(quantities("mem:128;cpus:1")));
+}
+
+} // namespace tests {
+} // namespace internal {
+} // namespace mesos {
@@ -1770,6 +1770,36 @@ TEST(ResourcesTest, ToUnreserved)
 }
 
 
+// Tests that the arithmetic operators and `contains()` take into account
+// the modifications of the resource metadata, e.g., by allocating or
+// reserving resources.
+TEST(ResourcesTest, ModifiedMetadata)
+{
+  Resources unreserved = Resources::parse("cpus:1;mem:5").get();
+  Resources reserved = unreserved.pushReservation(
+      createDynamicReservationInfo("role1", "principal1"));
+
+  // Reserved and unreserved resources are not combined.
+  EXPECT_EQ(4u, (unreserved + reserved).size());
+  EXPECT_FALSE(reserved.contains(unreserved));
+
+  // Once unreserved, the resources are combined again.
+  EXPECT_EQ(Resources::parse("cpus:2;mem:10").get(),
+            unreserved + reserved.toUnreserved());
+  EXPECT_EQ(2u, (unreserved + reserved.toUnreserved()).size());
+  EXPECT_TRUE(reserved.popReservation().contains(unreserved));
+
+  Resources allocated = unreserved;
+  allocated.allocate("role1");
+  EXPECT_FALSE(allocated.contains(unreserved));
+  EXPECT_EQ(allocated, allocated - unreserved);
+
+  allocated.unallocate();
+  EXPECT_EQ(unreserved, allocated);
+  EXPECT_TRUE((allocated - unreserved).empty());
+}
+
+
 TEST(ResourcesTest, Find)
 {
   Resources resources1 = Resources::parse(
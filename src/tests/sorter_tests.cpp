@@ -24,6 +24,8 @@
 
 #include <stout/gtest.hpp>
 
+#include "common/resource_quantities.hpp"
+
 #include "master/allocator/sorter/drf/sorter.hpp"
 
 #include "master/allocator/sorter/random/sorter.hpp"
@@ -714,6 +716,67 @@ TEST(DRFSorterTest, HierarchicalIterationOrder)
 }
 
 
+// This test checks that resorting only the path of a client whose
+// allocation changed yields the same order as resorting the whole
+// tree. Allocation changes do not dirty the tree, whereas updating a
+// weight does, which lets us compare both orders.
+TEST(DRFSorterTest, IncrementalSort)
+{
+  DRFSorter sorter;
+
+  SlaveID slaveId;
+  slaveId.set_value("agentId");
+
+  Resources totalResources = Resources::parse("cpus:100;mem:100").get();
+  sorter.add(slaveId, totalResources);
+
+  const vector<string> clients = {"a", "b/c", "b/d", "b/d/e", "f/g/h", "i"};
+
+  foreach (const string& client, clients) {
+    sorter.add(client);
+    sorter.activate(client);
+  }
+
+  // Deactivate a client so that its parent contains an inactive leaf.
+  sorter.deactivate("b/d");
+
+  EXPECT_EQ(vector<string>({"a", "b/c", "b/d/e", "f/g/h", "i"}),
+            sorter.sort());
+
+  for (size_t i = 0; i < 20; i++) {
+    const string& client = clients[(i * 7) % clients.size()];
+
+    sorter.allocated(
+        client,
+        slaveId,
+        Resources::parse(
+            "cpus:" + stringify(i % 3 + 1) +
+            ";mem:" + stringify((i * 5) % 4 + 1)).get());
+
+    if (i % 4 == 3) {
+      sorter.unallocated(
+          client, slaveId, Resources::parse("cpus:1;mem:1").get());
+    }
+
+    const vector<string> incremental = sorter.sort();
+
+    // Force a full resort by updating the weight of an unknown path.
+    sorter.updateWeight("unknown", 1.0);
+
+    EXPECT_EQ(sorter.sort(), incremental);
+  }
+
+  // Activating a client places it according to its current share.
+  sorter.activate("b/d");
+
+  const vector<string> incremental = sorter.sort();
+
+  sorter.updateWeight("unknown", 1.0);
+
+  EXPECT_EQ(sorter.sort(), incremental);
+}
+
+
 // This test checks what happens when a new sorter client is added as
 // a child of what was previously a leaf node.
 TEST(DRFSorterTest, AddChildToLeaf)
@@ -1628,15 +1691,17 @@ TYPED_TEST(CommonSorterTest, RemoveSharedResources)
   sorter.add(
       slaveId, Resources::parse("cpus:100;mem:100;disk(role1):900").get());
 
-  Resources quantity1 = sorter.totalScalarQuantities();
+  ResourceQuantities quantity1 = sorter.totalScalarQuantities();
 
   sorter.add(slaveId, sharedDisk);
-  Resources quantity2 = sorter.totalScalarQuantities();
+  ResourceQuantities quantity2 = sorter.totalScalarQuantities();
 
-  EXPECT_EQ(Resources::parse("disk:100").get(), quantity2 - quantity1);
+  EXPECT_EQ(
+      CHECK_NOTERROR(ResourceQuantities::fromString("disk:100")),
+      quantity2 - quantity1);
 
   sorter.add(slaveId, sharedDisk);
-  Resources quantity3 = sorter.totalScalarQuantities();
+  ResourceQuantities quantity3 = sorter.totalScalarQuantities();
 
   EXPECT_NE(quantity1, quantity3);
   EXPECT_EQ(quantity2, quantity3);
@@ -1971,6 +2036,167 @@ TYPED_TEST(CommonSorterTest, BENCHMARK_HierarchyFullSort)
   }
 }
 
+
+// This benchmark measures sorting after allocating to one (active)
+// client at a time, which mirrors what the allocator does within an
+// allocation cycle. Unlike in the benchmarks above, the clients are
+// active, so that `sort()` returns (and orders) all of them.
+TYPED_TEST(CommonSorterTest, BENCHMARK_IncrementalSort)
+{
+  size_t agentCounts[] = {1000U, 10000U, 50000U};
+  size_t clientCounts[] = {1U, 100U, 1000U, 5000U};
+
+  foreach (size_t agentCount, agentCounts) {
+    foreach (size_t clientCount, clientCounts) {
+      cout << "Using " << agentCount << " agents and "
+           << clientCount << " clients" << endl;
+
+      vector<SlaveID> agents;
+      agents.reserve(agentCount);
+
+      vector<string> clients;
+      clients.reserve(clientCount);
+
+      TypeParam sorter;
+      Stopwatch watch;
+
+      for (size_t i = 0; i < clientCount; i++) {
+        const string clientId = stringify(i);
+
+        clients.push_back(clientId);
+
+        sorter.add(clientId);
+        sorter.activate(clientId);
+      }
+
+      Resources agentResources = Resources::parse(
+          "cpus:24;mem:4096;disk:4096;ports:[31000-32000]").get();
+
+      for (size_t i = 0; i < agentCount; i++) {
+        SlaveID slaveId;
+        slaveId.set_value("agent" + stringify(i));
+
+        agents.push_back(slaveId);
+
+        sorter.add(slaveId, agentResources);
+      }
+
+      // Allocate resources on all agents, round-robin through the
+      // clients, so that the clients have different shares.
+      Resources allocated = Resources::parse("cpus:16;mem:2014").get();
+
+      for (size_t i = 0; i < agentCount; i++) {
+        sorter.allocated(
+            clients[(i * 7) % clients.size()],
+            agents[i],
+            allocated);
+      }
+
+      sorter.sort();
+
+      const Resources increment = Resources::parse("cpus:1;mem:1").get();
+      const size_t incrementCount = 1000U;
+
+      watch.start();
+      {
+        for (size_t i = 0; i < incrementCount; i++) {
+          const string& client = clients[i % clients.size()];
+          sorter.allocated(client, agents[i % agents.size()], increment);
+          sorter.sort();
+        }
+      }
+      watch.stop();
+
+      cout << "Allocating to one client and resorting " << incrementCount
+           << " times with " << clientCount << " clients took "
+           << watch.elapsed() << endl;
+
+      watch.start();
+      {
+        for (size_t i = 0; i < incrementCount; i++) {
+          const string& client = clients[i % clients.size()];
+          sorter.unallocated(client, agents[i % agents.size()], increment);
+          sorter.sort();
+        }
+      }
+      watch.stop();
+
+      cout << "Removing an allocation from one client and resorting "
+           << incrementCount << " times with " << clientCount
+           << " clients took " << watch.elapsed() << endl;
+    }
+  }
+}
+
+
+class ResourceQuantities_Arithmetic_BENCHMARK_Test
+  : public ::testing::Test,
+    public ::testing::WithParamInterface<size_t> {};
+
+
+// The benchmark is parameterized by the number of reservations
+// (i.e., `Resource` objects with distinct metadata) aggregated into
+// quantities, as happens in the sorters and for the quota headroom.
+INSTANTIATE_TEST_CASE_P(
+    Reservations,
+    ResourceQuantities_Arithmetic_BENCHMARK_Test,
+    ::testing::Values(1U, 100U, 1000U));
+
+
+// Compares the stripped scalar quantity arithmetic done with
+// `Resources` against the same arithmetic with `ResourceQuantities`.
+TEST_P(ResourceQuantities_Arithmetic_BENCHMARK_Test, Arithmetic)
+{
+  const size_t reservationCount = GetParam();
+  const size_t totalOperations = 10000;
+
+  const Resources scalars =
+    Resources::parse("cpus:1;gpus:1;mem:128;disk:256").get();
+
+  Resources resources;
+  for (size_t i = 0; i < reservationCount; ++i) {
+    resources += scalars.pushReservation(createDynamicReservationInfo(
+        "role" + stringify(i), "principal" + stringify(i)));
+  }
+
+  Stopwatch watch;
+
+  Resources resourcesTotal;
+
+  watch.start();
+  for (size_t i = 0; i < totalOperations; i++) {
+    resourcesTotal += resources.createStrippedScalarQuantity();
+  }
+  for (size_t i = 0; i < totalOperations; i++) {
+    resourcesTotal -= resources.createStrippedScalarQuantity();
+  }
+  watch.stop();
+
+  cout << "Took " << watch.elapsed() << " to perform " << totalOperations
+       << " 'total += r' and 'total -= r' operations on stripped"
+       << " 'Resources' of " << reservationCount << " reservations" << endl;
+
+  ASSERT_TRUE(resourcesTotal.empty()) << resourcesTotal;
+
+  ResourceQuantities quantitiesTotal;
+
+  watch.start();
+  for (size_t i = 0; i < totalOperations; i++) {
+    quantitiesTotal += ResourceQuantities::fromScalarResources(resources);
+  }
+  for (size_t i = 0; i < totalOperations; i++) {
+    quantitiesTotal -= ResourceQuantities::fromScalarResources(resources);
+  }
+  watch.stop();
+
+  cout << "Took " << watch.elapsed() << " to perform " << totalOperations
+       << " 'total += r' and 'total -= r' operations on"
+       << " 'ResourceQuantities' of " << reservationCount << " reservations"
+       << endl;
+
+  ASSERT_TRUE(quantitiesTotal.empty()) << quantitiesTotal;
+}
+
 } // namespace tests {
 } // namespace internal {
 } // namespace mesos {
@@ -16,11 +16,17 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <boost/functional/hash.hpp>
+
 #include <glog/logging.h>
 
 #include <google/protobuf/repeated_field.h>
@@ -37,18 +43,26 @@
 #include <stout/lambda.hpp>
 #include <stout/protobuf.hpp>
 #include <stout/strings.hpp>
+#include <stout/synchronized.hpp>
 #include <stout/unreachable.hpp>
 
 #include "common/resources_utils.hpp"
+#include "common/values.hpp"
 
 using std::map;
 using std::ostream;
+using std::pair;
 using std::set;
+using std::shared_ptr;
 using std::string;
 using std::vector;
+using std::weak_ptr;
 
 using google::protobuf::RepeatedPtrField;
 
+using mesos::internal::values::convertToFixed;
+using mesos::internal::values::convertToFloating;
+
 namespace mesos {
 namespace v1 {
 
@@ -262,7 +276,7 @@ bool operator!=(const Resource::DiskInfo& left, const Resource::DiskInfo& right)
 }
 
 
-bool operator==(const Resource& left, const Resource& right)
+static bool compareResourceMetadata(const Resource& left, const Resource& right)
 {
   if (left.name() != right.name() || left.type() != right.type()) {
     return false;
@@ -317,6 +331,67 @@ bool operator==(const Resource& left, const Resource& right)
     return false;
   }
 
+  return true;
+}
+
+
+// Hashes the fields compared by `compareResourceMetadata()`, in a way
+// that is consistent with their equality operators. For example, the
+// labels of a ReservationInfo are compared but not hashed.
+static size_t hashResourceMetadata(const Resource& resource)
+{
+  size_t seed = 0;
+
+  boost::hash_combine(seed, resource.name());
+  boost::hash_combine(seed, static_cast<int>(resource.type()));
+
+  boost::hash_combine(seed, resource.has_allocation_info());
+  if (resource.has_allocation_info()) {
+    boost::hash_combine(seed, resource.allocation_info().role());
+  }
+
+  foreach (const Resource::ReservationInfo& reservation,
+           resource.reservations()) {
+    boost::hash_combine(seed, static_cast<int>(reservation.type()));
+    boost::hash_combine(seed, reservation.role());
+    boost::hash_combine(seed, reservation.principal());
+  }
+
+  boost::hash_combine(seed, resource.has_disk());
+  if (resource.has_disk()) {
+    const Resource::DiskInfo& disk = resource.disk();
+
+    boost::hash_combine(seed, disk.has_source());
+    if (disk.has_source()) {
+      boost::hash_combine(seed, static_cast<int>(disk.source().type()));
+      boost::hash_combine(seed, disk.source().id());
+    }
+
+    boost::hash_combine(seed, disk.has_persistence());
+    if (disk.has_persistence()) {
+      boost::hash_combine(seed, disk.persistence().id());
+    }
+  }
+
+  boost::hash_combine(seed, resource.has_revocable());
+
+  boost::hash_combine(seed, resource.has_provider_id());
+  if (resource.has_provider_id()) {
+    boost::hash_combine(seed, resource.provider_id().value());
+  }
+
+  boost::hash_combine(seed, resource.has_shared());
+
+  return seed;
+}
+
+
+bool operator==(const Resource& left, const Resource& right)
+{
+  if (!compareResourceMetadata(left, right)) {
+    return false;
+  }
+
   if (left.type() == Value::SCALAR) {
     return left.scalar() == right.scalar();
   } else if (left.type() == Value::RANGES) {
@@ -566,6 +641,57 @@ static bool contains(const Resource& left, const Resource& right)
 }
 
 
+// Tests if any two Resource objects with the same metadata as the given
+// one (see `compareResourceMetadata()`) are addable and subtractable,
+// regardless of their values. This is not the case for shared resources
+// and for resources with an identity, e.g., MOUNT disks or persistent
+// volumes, which can only be combined if they are equal.
+static bool combinable(const Resource& resource)
+{
+  if (resource.has_shared()) {
+    return false;
+  }
+
+  if (resource.has_disk()) {
+    if (resource.disk().has_source()) {
+      switch (resource.disk().source().type()) {
+        case Resource::DiskInfo::Source::PATH:
+          break;
+        case Resource::DiskInfo::Source::BLOCK:
+        case Resource::DiskInfo::Source::MOUNT:
+          return false;
+        case Resource::DiskInfo::Source::RAW:
+          if (resource.disk().source().has_id()) {
+            return false;
+          }
+          break;
+        case Resource::DiskInfo::Source::UNKNOWN:
+          return false;
+      }
+    }
+
+    if (resource.disk().has_persistence()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+// The minimum number of resources of both operands for which arithmetic
+// and `contains()` look up the resources of the right operand in an
+// index of the left operand, rather than scanning the left operand for
+// each of them. Below that, the scans are cheaper than building the index.
+static const size_t INDEX_THRESHOLD = 32;
+
+
+static bool indexed(const Resources& left, const Resources& right)
+{
+  return std::min(left.size(), right.size()) >= INDEX_THRESHOLD;
+}
+
+
 /**
  * Checks that a Resources object is valid for command line specification.
  *
@@ -1330,6 +1456,97 @@ bool Resources::shrink(Resource* resource, const Value::Scalar& target)
 // Public member functions.
 /////////////////////////////////////////////////
 
+struct Resources::Resource_::Metadata
+{
+  // The resource for which the metadata was first interned, without
+  // its value.
+  Resource resource;
+
+  size_t hash;
+
+  // Whether any two resources with this metadata are addable and
+  // subtractable, see `internal::combinable()`. Otherwise, this needs
+  // to be determined by `internal::addable()` and `subtractable()`.
+  bool combinable;
+};
+
+
+void Resources::Resource_::intern()
+{
+  // The interned metadata by hash. The table only holds weak references:
+  // the metadata is removed when the last `Resource_` referring to it is
+  // destroyed. It is leaked so that it outlives any static `Resources`.
+  typedef pair<const Metadata*, weak_ptr<const Metadata>> Entry;
+  typedef hashmap<size_t, vector<Entry>> Table;
+
+  static Table* table = new Table();
+  static std::mutex* table_mutex = new std::mutex();
+
+  scalar = resource.type() == Value::SCALAR
+    ? convertToFixed(resource.scalar().value())
+    : 0;
+
+  const size_t hash = hashResourceMetadata(resource);
+
+  // NOTE: Releasing the last reference to metadata acquires the lock,
+  // so the previously interned metadata is only released at the end.
+  shared_ptr<const Metadata> previous = std::move(metadata);
+
+  synchronized (table_mutex) {
+    vector<Entry>& entries = (*table)[hash];
+
+    foreach (const auto& entry, entries) {
+      // NOTE: Metadata is only deleted after its entry is removed, so
+      // it can be compared here even if the last reference is gone.
+      if (compareResourceMetadata(entry.first->resource, resource)) {
+        metadata = entry.second.lock();
+
+        if (metadata) {
+          break;
+        }
+      }
+    }
+
+    if (!metadata) {
+      Resource stripped = resource;
+      stripped.clear_scalar();
+      stripped.clear_ranges();
+      stripped.clear_set();
+
+      Metadata* interned = new Metadata{
+          std::move(stripped),
+          hash,
+          internal::combinable(resource)};
+
+      metadata.reset(interned, [](const Metadata* expired) {
+        synchronized (table_mutex) {
+          auto it = table->find(expired->hash);
+
+          // Remove this and any other expired entries with the same hash;
+          // the latter are already gone when their deleters get the lock.
+          if (it != table->end()) {
+            it->second.erase(
+                std::remove_if(
+                    it->second.begin(),
+                    it->second.end(),
+                    [](const Entry& entry) { return entry.second.expired(); }),
+                it->second.end());
+
+            if (it->second.empty()) {
+              table->erase(it);
+            }
+          }
+        }
+
+        delete expired;
+      });
+
+      entries.push_back(std::make_pair(interned, metadata));
+    }
+  }
+}
+
+
 Option<Error> Resources::Resource_::validate() const
 {
   if (isShared() && sharedCount.get() < 0) {
@@ -1346,6 +1563,10 @@ bool Resources::Resource_::isEmpty() const
     return true;
   }
 
+  if (resource.type() == Value::SCALAR) {
+    return scalar == 0;
+  }
+
   return Resources::isEmpty(resource);
 }
 
@@ -1357,6 +1578,12 @@ bool Resources::Resource_::contains(const Resource_& that) const
     return false;
   }
 
+  // Resource objects with different metadata are not subtractable,
+  // hence they cannot contain each other.
+  if (metadata != that.metadata) {
+    return false;
+  }
+
   // Assuming the wrapped Resource objects are equal, the 'contains'
   // relationship is determined by the relationship of the counters
   // for shared resources.
@@ -1365,8 +1592,19 @@ bool Resources::Resource_::contains(const Resource_& that) const
            resource == that.resource;
   }
 
-  // For non-shared resources just compare the protobufs.
-  return internal::contains(resource, that.resource);
+  if (!metadata->combinable) {
+    return internal::contains(resource, that.resource);
+  }
+
+  if (resource.type() == Value::SCALAR) {
+    return that.scalar <= scalar;
+  } else if (resource.type() == Value::RANGES) {
+    return that.resource.ranges() <= resource.ranges();
+  } else if (resource.type() == Value::SET) {
+    return that.resource.set() <= resource.set();
+  } else {
+    return false;
+  }
 }
 
 
@@ -1375,7 +1613,12 @@ Resources::Resource_& Resources::Resource_::operator+=(const Resource_& that)
   // This function assumes that the 'resource' fields are addable.
 
   if (!isShared()) {
-    resource += that.resource;
+    if (resource.type() == Value::SCALAR) {
+      scalar += that.scalar;
+      resource.mutable_scalar()->set_value(convertToFloating(scalar));
+    } else {
+      resource += that.resource;
+    }
   } else {
     // 'addable' makes sure both 'resource' fields are shared and
     // equal, so we just need to sum up the counters here.
@@ -1394,7 +1637,12 @@ Resources::Resource_& Resources::Resource_::operator-=(const Resource_& that)
   // This function assumes that the 'resource' fields are subtractable.
 
   if (!isShared()) {
-    resource -= that.resource;
+    if (resource.type() == Value::SCALAR) {
+      scalar -= that.scalar;
+      resource.mutable_scalar()->set_value(convertToFloating(scalar));
+    } else {
+      resource -= that.resource;
+    }
   } else {
     // 'subtractable' makes sure both 'resource' fields are shared and
     // equal, so we just need to subtract the counters here.
@@ -1420,6 +1668,14 @@ bool Resources::Resource_::operator==(const Resource_& that) const
     return false;
   }
 
+  if (metadata != that.metadata) {
+    return false;
+  }
+
+  if (resource.type() == Value::SCALAR) {
+    return scalar == that.scalar;
+  }
+
   return resource == that.resource;
 }
 
@@ -1457,18 +1713,42 @@ Resources::Resources(const RepeatedPtrField<Resource>& _resources)
 
 bool Resources::contains(const Resources& that) const
 {
-  Resources remaining = *this;
+  // The remaining resources after subtracting the persistent volumes
+  // found so far, copied when the first one is found.
+  Option<Resources> remaining;
+
+  Option<Index> index;
+  if (internal::indexed(*this, that)) {
+    index = this->index();
+  }
 
   foreach (const Resource_& resource_, that.resources) {
+    // NOTE: Only persistent volumes are subtracted from the remaining
+    // resources, which are never combinable, so combinable resources
+    // can be looked up in the index of this object.
+    if (index.isSome() && resource_.metadata->combinable) {
+      Option<size_t> i = index->get(resource_.metadata.get());
+
+      if (i.isNone() || !resources[i.get()].contains(resource_)) {
+        return false;
+      }
+
+      continue;
+    }
+
     // NOTE: We use _contains because Resources only contain valid
     // Resource objects, and we don't want the performance hit of the
     // validity check.
-    if (!remaining._contains(resource_)) {
+    if (!(remaining.isSome() ? remaining.get() : *this)._contains(resource_)) {
       return false;
     }
 
     if (isPersistentVolume(resource_.resource)) {
-      remaining.subtract(resource_);
+      if (remaining.isNone()) {
+        remaining = *this;
+      }
+
+      remaining->subtract(resource_);
     }
   }
 
@@ -1503,6 +1783,7 @@ void Resources::allocate(const string& role)
 {
   foreach (Resource_& resource_, resources) {
     resource_.resource.mutable_allocation_info()->set_role(role);
+    resource_.intern();
   }
 }
 
@@ -1512,6 +1793,7 @@ void Resources::unallocate()
   foreach (Resource_& resource_, resources) {
     if (resource_.resource.has_allocation_info()) {
       resource_.resource.clear_allocation_info();
+      resource_.intern();
     }
   }
 }
@@ -1617,6 +1899,7 @@ Resources Resources::pushReservation(
 
   foreach (Resource_ resource_, *this) {
     resource_.resource.add_reservations()->CopyFrom(reservation);
+    resource_.intern();
     CHECK_NONE(Resources::validate(resource_.resource));
     result.add(resource_);
   }
@@ -1632,6 +1915,7 @@ Resources Resources::popReservation() const
   foreach (Resource_ resource_, resources) {
     CHECK_GT(resource_.resource.reservations_size(), 0);
     resource_.resource.mutable_reservations()->RemoveLast();
+    resource_.intern();
     result.add(resource_);
   }
 
@@ -1645,6 +1929,7 @@ Resources Resources::toUnreserved() const
 
   foreach (Resource_ resource_, *this) {
     resource_.resource.clear_reservations();
+    resource_.intern();
     result.add(resource_);
   }
 
@@ -1899,6 +2184,26 @@ Option<Value::Ranges> Resources::ephemeral_ports() const
 // Private member functions.
 /////////////////////////////////////////////////
 
+Option<Resources::Index> Resources::index() const
+{
+  Index index;
+
+  for (size_t i = 0; i < resources.size(); i++) {
+    const Resource_::Metadata* metadata = resources[i].metadata.get();
+
+    if (metadata->combinable) {
+      if (index.contains(metadata)) {
+        return None();
+      }
+
+      index.put(metadata, i);
+    }
+  }
+
+  return index;
+}
+
+
 bool Resources::_contains(const Resource_& that) const
 {
   foreach (const Resource_& resource_, resources) {
@@ -1938,6 +2243,7 @@ Option<Resources> Resources::find(const Resource& target) const
         foreach (Resource_ r, remaining) {
           r.resource.mutable_reservations()->CopyFrom(
               resource_.resource.reservations());
+          r.intern();
 
           found.add(r);
         }
@@ -2007,15 +2313,32 @@ Resources Resources::operator+(const Resources& that) const
 }
 
 
-void Resources::add(const Resource_& that)
+void Resources::add(const Resource_& that, Index* index)
 {
   if (that.isEmpty()) {
     return;
   }
 
+  const bool combinable = that.metadata->combinable;
+
+  if (index != nullptr && combinable) {
+    Option<size_t> i = index->get(that.metadata.get());
+
+    if (i.isSome()) {
+      resources[i.get()] += that;
+    } else {
+      index->put(that.metadata.get(), resources.size());
+      resources.push_back(that);
+    }
+
+    return;
+  }
+
   bool found = false;
   foreach (Resource_& resource_, resources) {
-    if (internal::addable(resource_.resource, that)) {
+    // NOTE: Resource objects with different metadata are not addable.
+    if (resource_.metadata == that.metadata &&
+        (combinable || internal::addable(resource_.resource, that))) {
       resource_ += that;
       found = true;
       break;
@@ -2049,8 +2372,13 @@ Resources& Resources::operator+=(const Resource& that)
 
 Resources& Resources::operator+=(const Resources& that)
 {
+  Option<Index> index;
+  if (internal::indexed(*this, that)) {
+    index = this->index();
+  }
+
   foreach (const Resource_& resource_, that) {
-    add(resource_);
+    add(resource_, index.isSome() ? &index.get() : nullptr);
   }
 
   return *this;
@@ -2081,41 +2409,68 @@ Resources Resources::operator-(const Resources& that) const
 }
 
 
-void Resources::subtract(const Resource_& that)
+void Resources::subtract(const Resource_& that, Index* index)
 {
   if (that.isEmpty()) {
     return;
   }
 
-  for (size_t i = 0; i < resources.size(); i++) {
-    Resource_& resource_ = resources[i];
-
-    if (internal::subtractable(resource_.resource, that)) {
-      resource_ -= that;
-
-      // Remove the resource if it has become negative or empty.
-      // Note that a negative resource means the caller is
-      // subtracting more than they should!
-      //
-      // TODO(gyliu513): Provide a stronger interface to avoid
-      // silently allowing this to occur.
-
-      // A "negative" Resource_ either has a negative sharedCount or
-      // a negative scalar value.
-      bool negative =
-        (resource_.isShared() && resource_.sharedCount.get() < 0) ||
-        (resource_.resource.type() == Value::SCALAR &&
-         resource_.resource.scalar().value() < 0);
-
-      if (negative || resource_.isEmpty()) {
-        // As `resources` is not ordered, and erasing an element
-        // from the middle is expensive, we swap with the last element
-        // and then shrink the vector by one.
-        resources[i] = resources.back();
-        resources.pop_back();
+  const bool combinable = that.metadata->combinable;
+
+  Option<size_t> found;
+
+  if (index != nullptr && combinable) {
+    found = index->get(that.metadata.get());
+  } else {
+    for (size_t i = 0; i < resources.size(); i++) {
+      // NOTE: Resource objects with different metadata are not
+      // subtractable.
+      if (resources[i].metadata == that.metadata &&
+          (combinable ||
+           internal::subtractable(resources[i].resource, that))) {
+        found = i;
+        break;
       }
+    }
+  }
 
-      break;
+  if (found.isNone()) {
+    return;
+  }
+
+  const size_t i = found.get();
+  Resource_& resource_ = resources[i];
+
+  resource_ -= that;
+
+  // Remove the resource if it has become negative or empty.
+  // Note that a negative resource means the caller is
+  // subtracting more than they should!
+  //
+  // TODO(gyliu513): Provide a stronger interface to avoid
+  // silently allowing this to occur.
+
+  // A "negative" Resource_ either has a negative sharedCount or
+  // a negative scalar value.
+  bool negative =
+    (resource_.isShared() && resource_.sharedCount.get() < 0) ||
+    (resource_.resource.type() == Value::SCALAR && resource_.scalar < 0);
+
+  if (negative || resource_.isEmpty()) {
+    if (index != nullptr && combinable) {
+      index->erase(that.metadata.get());
+    }
+
+    // As `resources` is not ordered, and erasing an element
+    // from the middle is expensive, we swap with the last element
+    // and then shrink the vector by one.
+    resources[i] = resources.back();
+    resources.pop_back();
+
+    if (index != nullptr &&
+        i < resources.size() &&
+        resources[i].metadata->combinable) {
+      index->put(resources[i].metadata.get(), i);
     }
   }
 }
@@ -2141,8 +2496,13 @@ Resources& Resources::operator-=(const Resource& that)
 
 Resources& Resources::operator-=(const Resources& that)
 {
+  Option<Index> index;
+  if (internal::indexed(*this, that)) {
+    index = this->index();
+  }
+
   foreach (const Resource_& resource_, that) {
-    subtract(resource_);
+    subtract(resource_, index.isSome() ? &index.get() : nullptr);
   }
 
   return *this;